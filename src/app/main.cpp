@@ -1,9 +1,17 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "startup_timing.h"
+#include "trace.h"
 
 int main(int argc, char **argv) {
+    StartupTiming::begin();
     QApplication app(argc, argv);
+    app.setOrganizationName("ide");
+    app.setApplicationName("ide");
+    Trace::startFromEnvironment();
+    StartupTiming::mark("application");
     MainWindow w;
+    StartupTiming::mark("window");
     w.show();
     return app.exec();
 }
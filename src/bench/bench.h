@@ -0,0 +1,28 @@
+#pragma once
+#include <QtGlobal>
+#include <functional>
+#include <string>
+
+// Cases for ide-bench. Each run does its work once and says how much it did;
+// the runner times it, keeps the best of several runs and prints the time per
+// item, plus throughput when bytes are given.
+namespace Bench {
+	struct Result {
+		qint64 items = 0;
+		qint64 bytes = 0;
+		// Anything else worth printing, such as a percentile.
+		std::string detail;
+	};
+	using Case = std::function<Result()>;
+
+	// For a static object in the file that defines the case.
+	struct Register {
+		Register(const char* name, Case run);
+	};
+
+	inline volatile qint64 sink = 0;
+	// Keeps the optimizer from dropping the work behind a value.
+	inline void keep(qint64 value) {
+		sink = value;
+	}
+}
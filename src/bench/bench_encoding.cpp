@@ -0,0 +1,99 @@
+#include "bench.h"
+#include "../buffer/textEncoding.h"
+#include <QByteArray>
+#include <QString>
+#include <QStringDecoder>
+
+namespace {
+constexpr qsizetype kBytes = 16 << 20;
+
+// Source-like text: indented lines of identifiers and punctuation.
+const QByteArray& asciiText() {
+	static const QByteArray text = [] {
+		const QByteArray line("\tconst qsizetype count = std::min(first + delta.removedLines, lines); // ok\n");
+		QByteArray out;
+		out.reserve(kBytes + line.size());
+		while (out.size() < kBytes) out += line;
+		return out;
+	}();
+	return text;
+}
+
+// The same with a two- or three-byte character in every line, as in comments
+// of non-English code.
+const QByteArray& utf8Text() {
+	static const QByteArray text = [] {
+		const QByteArray line("\tconst qsizetype count = 0; // Größe der Änderung, 変更の大きさ\n");
+		QByteArray out;
+		out.reserve(kBytes + line.size());
+		while (out.size() < kBytes) out += line;
+		return out;
+	}();
+	return text;
+}
+
+// Windows-1252 bytes for the same sort of text.
+const QByteArray& singleByteText() {
+	static const QByteArray text = [] {
+		const QByteArray line("\tconst qsizetype count = 0; // Gr\xF6\xDF" "e der \xC4nderung \x93quoted\x94\n");
+		QByteArray out;
+		out.reserve(kBytes + line.size());
+		while (out.size() < kBytes) out += line;
+		return out;
+	}();
+	return text;
+}
+
+const Bench::Register validateAscii("encoding.validate-ascii", [] {
+	const QByteArray& bytes = asciiText();
+	Bench::keep(TextEncoding::isValidUtf8(bytes));
+	return Bench::Result{bytes.size(), bytes.size(), {}};
+});
+
+const Bench::Register validateUtf8("encoding.validate-utf8", [] {
+	const QByteArray& bytes = utf8Text();
+	Bench::keep(TextEncoding::isValidUtf8(bytes));
+	return Bench::Result{bytes.size(), bytes.size(), {}};
+});
+
+// What Document::readFile does with UTF-8 besides validating it.
+const Bench::Register decodeUtf8("encoding.decode-utf8", [] {
+	const QByteArray& bytes = utf8Text();
+	QString text(bytes.size(), Qt::Uninitialized);
+	QStringDecoder decoder(QStringConverter::Utf8);
+	const QChar* end = decoder.appendToBuffer(text.data(), bytes);
+	Bench::keep(end - text.constData());
+	return Bench::Result{bytes.size(), bytes.size(), {}};
+});
+
+const Bench::Register decodeSingleByte("encoding.decode-windows1252", [] {
+	const QByteArray& bytes = singleByteText();
+	QString text(bytes.size(), Qt::Uninitialized);
+	const QChar* end = TextEncoding::decodeSingleByte(bytes, TextEncoding::Encoding::Windows1252, text.data());
+	Bench::keep(end - text.constData());
+	return Bench::Result{bytes.size(), bytes.size(), {}};
+});
+
+const Bench::Register encodeSingleByte("encoding.encode-windows1252", [] {
+	static const QString text = [] {
+		const QByteArray& bytes = singleByteText();
+		QString out(bytes.size(), Qt::Uninitialized);
+		TextEncoding::decodeSingleByte(bytes, TextEncoding::Encoding::Windows1252, out.data());
+		return out;
+	}();
+	QByteArray bytes;
+	TextEncoding::encodeSingleByte(text, TextEncoding::Encoding::Windows1252, &bytes);
+	Bench::keep(bytes.size());
+	return Bench::Result{text.size(), bytes.size(), {}};
+});
+
+const Bench::Register lineEndings("encoding.line-endings", [] {
+	static const QString text = QString::fromUtf8(asciiText());
+	TextEncoding::LineEndingCounter counter;
+	counter.add(text);
+	TextEncoding::Format format;
+	counter.apply(&format);
+	Bench::keep(qint64(format.lineEnding));
+	return Bench::Result{text.size(), text.size() * qsizetype(sizeof(QChar)), {}};
+});
+}
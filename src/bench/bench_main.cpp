@@ -0,0 +1,65 @@
+#include "bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+struct Entry {
+	const char* name;
+	Bench::Case run;
+};
+
+std::vector<Entry>& registry() {
+	static std::vector<Entry> entries;
+	return entries;
+}
+}
+
+Bench::Register::Register(const char* name, Case run) {
+	registry().push_back({name, std::move(run)});
+}
+
+// ide-bench [--runs N] [filter...]: runs the cases whose names contain any of
+// the filters, or all of them.
+int main(int argc, char** argv) {
+	int runs = 5;
+	std::vector<const char*> filters;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+			runs = std::max(1, std::atoi(argv[++i]));
+		} else {
+			filters.push_back(argv[i]);
+		}
+	}
+
+	std::vector<Entry> entries = registry();
+	std::sort(entries.begin(), entries.end(),
+		[](const Entry& a, const Entry& b) { return std::strcmp(a.name, b.name) < 0; });
+	for (const Entry& entry : entries) {
+		if (!filters.empty() && std::none_of(filters.begin(), filters.end(),
+				[&](const char* filter) { return std::strstr(entry.name, filter) != nullptr; })) {
+			continue;
+		}
+		// The first run warms caches and thread pools and isn't counted.
+		entry.run();
+		double best = 0;
+		Bench::Result result;
+		for (int run = 0; run < runs; ++run) {
+			const auto start = std::chrono::steady_clock::now();
+			Bench::Result current = entry.run();
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (run == 0 || seconds < best) {
+				best = seconds;
+				result = std::move(current);
+			}
+		}
+		std::printf("%-32s %10.1f ns/item", entry.name, result.items > 0 ? best * 1e9 / double(result.items) : 0.0);
+		if (result.bytes > 0) std::printf("  %8.2f GB/s", double(result.bytes) / best / 1e9);
+		if (!result.detail.empty()) std::printf("  %s", result.detail.c_str());
+		std::printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,134 @@
+#include "bench.h"
+#include "../index/work_stealing.h"
+#include "../util/task_scheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr int kTasks = 100000;
+
+// Counts down to zero and wakes whoever waits for it.
+class Countdown {
+public:
+	explicit Countdown(int count) : m_count(count) {}
+
+	void done() {
+		if (m_count.fetch_sub(1) != 1) return;
+		const std::lock_guard lock(m_mutex);
+		m_zero.notify_all();
+	}
+	void wait() {
+		std::unique_lock lock(m_mutex);
+		m_zero.wait(lock, [this] { return m_count.load() == 0; });
+	}
+
+private:
+	std::atomic<int> m_count;
+	std::mutex m_mutex;
+	std::condition_variable m_zero;
+};
+
+std::string microseconds(const char* label, const LatencyHistogram& waits) {
+	return std::string(label) + " wait p50 " + std::to_string(waits.percentile(50)) + " us, p99 "
+		+ std::to_string(waits.percentile(99)) + " us";
+}
+
+// Submit to finish for tasks that do nothing, from a thread outside the pool.
+const Bench::Register submitCase("scheduler.submit", [] {
+	TaskScheduler& scheduler = TaskScheduler::shared();
+	scheduler.resetStats();
+	Countdown left(kTasks);
+	for (int i = 0; i < kTasks; ++i) {
+		scheduler.submit(TaskPriority::Background, [&left] { left.done(); });
+	}
+	left.wait();
+	return Bench::Result{kTasks, 0, microseconds("background", scheduler.waitTimes(TaskPriority::Background))};
+});
+
+// Tasks that submit the next one, which go to the worker's own queue.
+const Bench::Register chainCase("scheduler.submit-from-worker", [] {
+	TaskScheduler& scheduler = TaskScheduler::shared();
+	Countdown left(1);
+	std::function<void(int)> step = [&](int remaining) {
+		if (remaining == 0) {
+			left.done();
+			return;
+		}
+		scheduler.submit(TaskPriority::Background, [&step, remaining] { step(remaining - 1); });
+	};
+	step(kTasks);
+	left.wait();
+	return Bench::Result{kTasks, 0, {}};
+});
+
+// How long a task for the user waits while every thread background work may
+// have is busy.
+const Bench::Register interactiveCase("scheduler.interactive-under-load", [] {
+	TaskScheduler& scheduler = TaskScheduler::shared();
+	scheduler.resetStats();
+	std::atomic<bool> stop{false};
+	// On one thread Background may take it, and the probes would never run.
+	const int busy = std::min(scheduler.maxRunning(TaskPriority::Background), scheduler.threadCount() - 1);
+	Countdown stopped(busy);
+	for (int i = 0; i < busy; ++i) {
+		scheduler.submit(TaskPriority::Background, [&] {
+			while (!stop.load(std::memory_order_relaxed)) {
+				std::this_thread::yield();
+			}
+			stopped.done();
+		});
+	}
+	constexpr int kProbes = 2000;
+	for (int i = 0; i < kProbes; ++i) {
+		Countdown probe(1);
+		scheduler.submit(TaskPriority::Interactive, [&probe] { probe.done(); });
+		probe.wait();
+	}
+	stop = true;
+	stopped.wait();
+	return Bench::Result{kProbes, 0, microseconds("interactive", scheduler.waitTimes(TaskPriority::Interactive))};
+});
+
+const Bench::Register sequenceCase("scheduler.sequence", [] {
+	Countdown left(kTasks);
+	TaskSequence tasks(TaskPriority::Visible);
+	for (int i = 0; i < kTasks; ++i) {
+		tasks.submit([&left] { left.done(); });
+	}
+	left.wait();
+	return Bench::Result{kTasks, 0, {}};
+});
+
+// Submits as fast as a keystroke handler could; most jobs are dropped unrun.
+const Bench::Register latestCase("scheduler.latest", [] {
+	std::atomic<int> ran{0};
+	{
+		LatestTask task(TaskPriority::Interactive);
+		for (int i = 0; i < kTasks; ++i) {
+			task.submit([&ran](const CancelToken&) { ran.fetch_add(1, std::memory_order_relaxed); });
+		}
+		Countdown last(1);
+		task.submit([&last](const CancelToken&) { last.done(); });
+		last.wait();
+	}
+	return Bench::Result{kTasks, 0, std::to_string(ran.load()) + " of " + std::to_string(kTasks) + " ran"};
+});
+
+// Items too small to be worth a task each, which is what stealing ranges is for.
+const Bench::Register parallelForCase("index.parallel-for", [] {
+	constexpr qsizetype kItems = 1 << 22;
+	std::vector<quint32> values(kItems);
+	WorkStealing::parallelFor(kItems, [&values](qsizetype i, int) {
+		values[std::size_t(i)] = quint32(i) * 2654435761u;
+	});
+	Bench::keep(values.back());
+	return Bench::Result{kItems, 0, {}};
+});
+}
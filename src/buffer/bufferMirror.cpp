@@ -0,0 +1,38 @@
+#include "bufferMirror.h"
+#include <algorithm>
+
+LinePatch BufferMirror::capture(const ITextBuffer& buffer, const TextDelta& delta) {
+	const qsizetype lines = buffer.lineCount();
+	const qsizetype start = buffer.lineStart(delta.firstLine);
+	const qsizetype next = delta.firstLine + delta.addedLines + 1;
+	const qsizetype end = next < lines ? buffer.lineStart(next) : buffer.size();
+	return {delta, buffer.slice(start, end - start)};
+}
+
+void BufferMirror::reset(const TextSnapshot& snapshot) {
+	m_text.setText(snapshot.text());
+}
+
+void BufferMirror::clear() {
+	m_text.clear();
+}
+
+void BufferMirror::apply(const LinePatch& patch) {
+	const qsizetype count = m_text.lineCount();
+	const qsizetype at = std::clamp<qsizetype>(patch.delta.firstLine, 0, count - 1);
+	const qsizetype removed = std::clamp<qsizetype>(patch.delta.removedLines, 0, count - 1 - at);
+	const qsizetype start = m_text.lineStart(at);
+	const qsizetype end = at + removed + 1 < count ? m_text.lineStart(at + removed + 1) : m_text.size();
+	m_text.erase(start, end - start);
+	m_text.insert(start, patch.lines);
+}
+
+QString BufferMirror::line(qsizetype index) const {
+	const qsizetype start = m_text.lineStart(index);
+	const qsizetype end = index + 1 < m_text.lineCount() ? m_text.lineStart(index + 1) : m_text.size();
+	QString text = m_text.slice(start, end - start);
+	while (text.endsWith(u'\n') || text.endsWith(u'\r')) {
+		text.chop(1);
+	}
+	return text;
+}
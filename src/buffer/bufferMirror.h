@@ -0,0 +1,28 @@
+#pragma once
+#include "gapBuffer.h"
+
+// The text of the lines an edit left behind, enough to replay the edit on a
+// copy of the buffer without sending the whole document.
+struct LinePatch {
+	TextDelta delta;
+	QString lines;
+};
+
+// A copy of a buffer kept in step through LinePatches, for workers that need
+// the text on their own thread. The owner captures each edit right after
+// making it; the mirror can replay the patches later on any thread.
+class BufferMirror {
+public:
+	static LinePatch capture(const ITextBuffer& buffer, const TextDelta& delta);
+
+	void reset(const TextSnapshot& snapshot);
+	void clear();
+	void apply(const LinePatch& patch);
+
+	qsizetype lineCount() const { return m_text.lineCount(); }
+	// Without the line break.
+	QString line(qsizetype index) const;
+
+private:
+	GapBuffer m_text;
+};
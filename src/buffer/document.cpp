@@ -0,0 +1,440 @@
+#include "document.h"
+#include "../util/trace.h"
+#include <QByteArrayView>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringDecoder>
+#include <QStringEncoder>
+#include <QtEndian>
+#include <algorithm>
+#include <bit>
+#include <functional>
+#include <optional>
+
+namespace {
+using TextEncoding::Encoding;
+
+constexpr qint64 kDetectBytes = 4096;
+constexpr qint64 kReadChunk = 1 << 20;
+
+// The hash of the file's first size bytes, whatever follows them; nullopt if
+// the file is shorter.
+std::optional<Document::StreamHash> hashOf(QFile& file, qint64 size) {
+	Document::StreamHash hash;
+	file.seek(0);
+	for (qint64 left = size; left > 0;) {
+		const QByteArray chunk = file.read(std::min(kReadChunk, left));
+		if (chunk.isEmpty()) return std::nullopt;
+		hash.add(chunk);
+		left -= chunk.size();
+	}
+	return hash;
+}
+
+qint64 modifiedOf(const QFile& file) {
+	return QFileInfo(file).lastModified().toMSecsSinceEpoch();
+}
+
+// Length of data without a multi-byte sequence cut off at its end.
+qsizetype completeUtf8(const QByteArray& data) {
+	const qsizetype size = data.size();
+	for (qsizetype i = size - 1; i >= 0 && i >= size - 4; --i) {
+		const uchar c = uchar(data[i]);
+		if ((c & 0xC0) == 0x80) continue;
+		const qsizetype length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+		return i + length > size ? i : size;
+	}
+	return size;
+}
+
+bool isSingleByte(Encoding encoding) {
+	return encoding == Encoding::Latin1 || encoding == Encoding::Windows1252;
+}
+
+QStringConverter::Encoding converterFor(Encoding encoding) {
+	switch (encoding) {
+	case Encoding::Utf16LE: return QStringConverter::Utf16LE;
+	case Encoding::Utf16BE: return QStringConverter::Utf16BE;
+	default: return QStringConverter::Utf8;
+	}
+}
+
+QByteArrayView bomFor(Encoding encoding) {
+	switch (encoding) {
+	case Encoding::Utf8: return "\xEF\xBB\xBF";
+	case Encoding::Utf16LE: return "\xFF\xFE";
+	case Encoding::Utf16BE: return "\xFE\xFF";
+	default: return {};
+	}
+}
+
+// A byte order mark is taken off before decoding starts, so one found by the
+// decoder is part of the text.
+QStringDecoder decoderFor(Encoding encoding) {
+	return QStringDecoder(converterFor(encoding), QStringConverter::Flag::ConvertInitialBom);
+}
+
+QString decode(QByteArrayView bytes, Encoding encoding) {
+	if (!isSingleByte(encoding)) {
+		return decoderFor(encoding)(bytes);
+	}
+	QString text(bytes.size(), Qt::Uninitialized);
+	TextEncoding::decodeSingleByte(bytes, encoding, text.data());
+	return text;
+}
+
+// Decodes the rest of the file in chunks straight into text, counting line
+// breaks on the way, and adds the bytes read to *read and *hash. A single-byte encoding
+// turns from Latin-1 to Windows-1252 at the first byte only the latter
+// defines. False if UTF-8 turns out not to be valid.
+bool decodeRest(QFile& file, TextEncoding::Format* format, QString* text, qint64* read, Document::StreamHash* hash) {
+	const Encoding encoding = format->encoding;
+	std::optional<QStringDecoder> decoder;
+	if (!isSingleByte(encoding)) decoder.emplace(decoderFor(encoding));
+	TextEncoding::Utf8Validator validator;
+	TextEncoding::LineEndingCounter lines;
+	const qint64 remaining = std::max<qint64>(file.size() - file.pos(), 0);
+	text->resize(encoding == Encoding::Utf16LE || encoding == Encoding::Utf16BE ? remaining / 2 + 1 : remaining);
+	qsizetype used = 0;
+	for (;;) {
+		const QByteArray chunk = file.read(kReadChunk);
+		if (chunk.isEmpty()) break;
+		*read += chunk.size();
+		hash->add(chunk);
+		if (encoding == Encoding::Utf8 && !validator.feed(chunk)) return false;
+		if (format->encoding == Encoding::Latin1) {
+			format->encoding = TextEncoding::singleByteFallback(chunk);
+		}
+		const qsizetype needed = decoder ? decoder->requiredSpace(chunk.size()) : chunk.size();
+		if (used + needed > text->size()) {
+			text->resize(std::max(used + needed, 2 * text->size()));
+		}
+		QChar* begin = text->data() + used;
+		QChar* end = decoder ? decoder->appendToBuffer(begin, chunk)
+			: TextEncoding::decodeSingleByte(chunk, format->encoding, begin);
+		lines.add(QStringView(begin, end));
+		used = end - text->constData();
+	}
+	if (encoding == Encoding::Utf8 && !validator.finish()) return false;
+	text->truncate(used);
+	lines.apply(format);
+	return true;
+}
+
+// Writes size characters, read through slice a chunk at a time, to path in
+// format; a single-byte encoding that can't hold the text turns into UTF-8.
+// On success state describes the file as written.
+bool writeText(const QString& path, qsizetype size, const std::function<QString(qsizetype, qsizetype)>& slice,
+	TextEncoding::Format format, Document::DiskState* state, QString* error) {
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		if (error) {
+			*error = file.errorString();
+		}
+		return false;
+	}
+	constexpr qsizetype kChunk = 1 << 20;
+	auto forEachChunk = [&](auto&& fn) {
+		for (qsizetype pos = 0; pos < size;) {
+			QString chunk = slice(pos, std::min(kChunk, size - pos));
+			if (pos + chunk.size() < size && chunk.back().isHighSurrogate()) {
+				chunk.chop(1);
+			}
+			pos += chunk.size();
+			if (!fn(chunk)) return;
+		}
+	};
+	if (isSingleByte(format.encoding)) {
+		forEachChunk([&](const QString& chunk) {
+			if (TextEncoding::canEncode(chunk, format.encoding)) return true;
+			format.encoding = Encoding::Utf8;
+			return false;
+		});
+	}
+	std::optional<QStringEncoder> encoder;
+	if (!isSingleByte(format.encoding)) {
+		encoder.emplace(converterFor(format.encoding));
+	}
+	Document::StreamHash hash;
+	qint64 written = 0;
+	if (format.bom) {
+		const QByteArrayView bom = bomFor(format.encoding);
+		file.write(bom.data(), bom.size());
+		hash.add(bom);
+		written += bom.size();
+	}
+	QByteArray bytes;
+	forEachChunk([&](const QString& chunk) {
+		if (encoder) {
+			bytes.resize(encoder->requiredSpace(chunk.size()));
+			bytes.truncate(encoder->appendToBuffer(bytes.data(), chunk) - bytes.constData());
+		} else {
+			bytes.clear();
+			TextEncoding::encodeSingleByte(chunk, format.encoding, &bytes);
+		}
+		hash.add(bytes);
+		written += bytes.size();
+		return file.write(bytes) >= 0;
+	});
+	file.close();
+	if (file.error() != QFile::NoError) {
+		if (error) {
+			*error = file.errorString();
+		}
+		return false;
+	}
+	*state = {modifiedOf(file), written, hash, format};
+	return true;
+}
+}
+
+void Document::StreamHash::mix(quint64 word) {
+	m_hash = std::rotl(m_hash ^ (word * 0x9E3779B97F4A7C15ull), 29) * 0xBF58476D1CE4E5B9ull;
+}
+
+void Document::StreamHash::add(QByteArrayView bytes) {
+	const char* p = bytes.data();
+	const char* const end = p + bytes.size();
+	// Bytes left over from the last call are topped up to a whole word first.
+	while (m_tailBytes > 0 && p != end) {
+		m_tail |= quint64(uchar(*p++)) << (8 * m_tailBytes);
+		if (++m_tailBytes == 8) {
+			mix(m_tail);
+			m_tail = 0;
+			m_tailBytes = 0;
+		}
+	}
+	for (; end - p >= 8; p += 8) {
+		mix(qFromLittleEndian<quint64>(p));
+	}
+	for (; p != end; ++m_tailBytes) {
+		m_tail |= quint64(uchar(*p++)) << (8 * m_tailBytes);
+	}
+}
+
+Document::Document(QString path) : m_path(std::move(path)) {
+}
+
+QString Document::displayName() const {
+	return m_path.isEmpty() ? QStringLiteral("Untitled") : QFileInfo(m_path).fileName();
+}
+
+bool Document::readFile(const QString& path, QString* text, DiskState* state, QString* error) {
+	IDE_TRACE_SPAN("Document::readFile");
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		if (error) {
+			*error = file.errorString();
+		}
+		return false;
+	}
+	const qint64 modified = modifiedOf(file);
+	TextEncoding::Format format;
+	qsizetype bom = 0;
+	const QByteArray head = file.peek(kDetectBytes);
+	format.encoding = TextEncoding::detect(head, &bom);
+	format.bom = bom > 0;
+	file.seek(bom);
+	qint64 read = bom;
+	StreamHash hash;
+	hash.add(QByteArrayView(head).first(bom));
+	if (!decodeRest(file, &format, text, &read, &hash)) {
+		// Not UTF-8 after all: read it again a byte per character.
+		format = {};
+		format.encoding = Encoding::Latin1;
+		file.seek(0);
+		read = 0;
+		hash = {};
+		decodeRest(file, &format, text, &read, &hash);
+	}
+	if (file.error() != QFile::NoError) {
+		if (error) {
+			*error = file.errorString();
+		}
+		return false;
+	}
+	*state = {modified, read, hash, format};
+	return true;
+}
+
+bool Document::load(QString* error) {
+	IDE_TRACE_SPAN("Document::load");
+	QString text;
+	DiskState state;
+	if (!readFile(m_path, &text, &state, error)) {
+		return false;
+	}
+	// The raw and decoded copies are temporaries; only the gap buffer's stays resident.
+	m_text.setText(text);
+	m_disk = state;
+	m_compressed = QByteArray();
+	m_hibernating = false;
+	m_loaded = true;
+	m_undo.clear();
+	m_modified = false;
+	return true;
+}
+
+void Document::defer() {
+	m_text = GapBuffer();
+	m_compressed = QByteArray();
+	m_disk = {};
+	m_hibernating = true;
+	m_loaded = false;
+}
+
+void Document::setCompressed(QByteArray compressed, const DiskState& state) {
+	if (m_loaded) return;
+	m_compressed = std::move(compressed);
+	m_disk = state;
+	m_loaded = true;
+}
+
+QByteArray Document::compress(const QString& text) {
+	// The raw UTF-16, so lone surrogates come back as they were; the fastest
+	// level, as source text still compresses well.
+	return qCompress(reinterpret_cast<const uchar*>(text.constData()), text.size() * qsizetype(sizeof(QChar)), 1);
+}
+
+bool Document::save(const QString& path, QString* error) {
+	IDE_TRACE_SPAN("Document::save");
+	wake();
+	// Encoded in slices so saving doesn't need a second full copy of the text.
+	const auto slice = [this](qsizetype pos, qsizetype length) { return m_text.slice(pos, length); };
+	DiskState state;
+	if (!writeText(path, m_text.size(), slice, m_disk.format, &state, error)) {
+		return false;
+	}
+	m_path = path;
+	m_disk = state;
+	setModified(false);
+	return true;
+}
+
+Document::SaveJob Document::prepareSave(const QString& path) {
+	GapBuffer& buffer = text();
+	return {path, buffer.toString(), m_disk.format, buffer.version()};
+}
+
+bool Document::writeFile(const SaveJob& job, DiskState* state, QString* error) {
+	IDE_TRACE_SPAN("Document::writeFile");
+	const auto slice = [&job](qsizetype pos, qsizetype length) { return job.text.sliced(pos, length); };
+	return writeText(job.path, job.text.size(), slice, job.format, state, error);
+}
+
+void Document::finishSave(const SaveJob& job, const DiskState& state) {
+	m_path = job.path;
+	m_disk = state;
+	if (!m_hibernating && m_text.version() == job.version) {
+		setModified(false);
+	}
+}
+
+bool Document::isChangedOnDisk() const {
+	if (m_path.isEmpty()) return false;
+	const QFileInfo info(m_path);
+	if (!info.exists()) return m_disk.size >= 0;
+	return info.size() != m_disk.size || info.lastModified().toMSecsSinceEpoch() != m_disk.modified;
+}
+
+bool Document::readAppended(QString* appended) {
+	if (m_path.isEmpty() || m_disk.size < 0) return false;
+	IDE_TRACE_SPAN("Document::readAppended");
+	QFile file(m_path);
+	if (!file.open(QIODevice::ReadOnly)) return false;
+	const qint64 size = file.size();
+	const qint64 modified = modifiedOf(file);
+	if (size < m_disk.size || (size == m_disk.size && modified != m_disk.modified)) {
+		return false;
+	}
+	// Every byte already read is checked, since an edit anywhere in them
+	// leaves the text no longer matching the file.
+	std::optional<StreamHash> hash = hashOf(file, m_disk.size);
+	if (!hash || *hash != m_disk.hash) {
+		return false;
+	}
+	QByteArray bytes = file.read(size - m_disk.size);
+	// A character cut in half by a write still in progress waits for the next read.
+	const Encoding encoding = m_disk.format.encoding;
+	if (encoding == Encoding::Utf8) {
+		bytes.truncate(completeUtf8(bytes));
+	} else if (!isSingleByte(encoding)) {
+		bytes.truncate(bytes.size() & ~qsizetype(1));
+	}
+	*appended = decode(bytes, encoding);
+	m_disk.modified = modified;
+	m_disk.size += bytes.size();
+	hash->add(bytes);
+	m_disk.hash = *hash;
+	return true;
+}
+
+void Document::replace(qsizetype pos, qsizetype length, const QString& text) {
+	GapBuffer& buffer = this->text();
+	QString removed;
+	if (length > 0) {
+		removed = buffer.slice(pos, length);
+		buffer.erase(pos, length);
+	}
+	if (!text.isEmpty()) {
+		buffer.insert(pos, text);
+	}
+	if (removed.isEmpty()) {
+		if (!text.isEmpty()) m_undo.push({Edit::Insert, pos, text, pos + text.size()});
+	} else if (text.isEmpty()) {
+		m_undo.push({Edit::Erase, pos, removed, pos});
+	} else {
+		m_undo.push({Edit::Replace, pos, text, pos + text.size(), removed});
+	}
+}
+
+void Document::setModified(bool modified) {
+	m_modified = modified;
+	if (!modified) m_undo.setClean();
+}
+
+GapBuffer& Document::text() {
+	wake();
+	return m_text;
+}
+
+void Document::hibernate() {
+	if (m_hibernating) return;
+	m_compressed = compress(m_text.toString());
+	m_text = GapBuffer();
+	m_hibernating = true;
+}
+
+void Document::wake() {
+	if (!m_hibernating) return;
+	if (!m_loaded) {
+		// A file that can't be read leaves an empty document, as for a new file.
+		m_loaded = true;
+		m_hibernating = false;
+		load();
+		return;
+	}
+	const QByteArray raw = qUncompress(m_compressed);
+	m_text.setText(QStringView(reinterpret_cast<const QChar*>(raw.constData()), raw.size() / qsizetype(sizeof(QChar))));
+	m_compressed = QByteArray();
+	m_hibernating = false;
+}
+
+qsizetype Document::residentBytes() const {
+	if (m_hibernating) return m_compressed.size();
+	return m_text.capacity() * qsizetype(sizeof(QChar)) + m_text.lineCount() * qsizetype(sizeof(qsizetype));
+}
+
+Document::MemoryUsage Document::memoryUsage() const {
+	MemoryUsage usage;
+	usage.undoBytes = m_undo.memoryUsage();
+	if (m_hibernating) {
+		usage.compressedBytes = m_compressed.capacity();
+		return usage;
+	}
+	usage.textBytes = m_text.size() * qsizetype(sizeof(QChar));
+	usage.gapBytes = (m_text.capacity() - m_text.size()) * qsizetype(sizeof(QChar));
+	usage.lineIndexBytes = m_text.lineIndexBytes();
+	return usage;
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include "gapBuffer.h"
+#include "textEncoding.h"
+#include "undoStack.h"
+
+// One open file apart from any view: its text, undo history and where a view
+// last left it. A document nobody is looking at can hibernate, replacing the
+// gap buffer with a compressed copy of the text until it is needed again.
+class Document {
+public:
+	struct ViewState {
+		qsizetype cursor = 0;
+		qsizetype anchor = 0;
+		qsizetype firstLine = 0;
+	};
+	// A hash of a byte stream that comes out the same however the stream is
+	// split up, so it can be carried on as a file grows.
+	class StreamHash {
+	public:
+		void add(QByteArrayView bytes);
+		bool operator==(const StreamHash&) const = default;
+
+	private:
+		void mix(quint64 word);
+
+		quint64 m_hash = 0;
+		quint64 m_tail = 0;
+		int m_tailBytes = 0;
+	};
+	// The file as last read or written: its mtime, size, a hash of all those
+	// bytes, and the encoding and line breaks it was found in.
+	struct DiskState {
+		qint64 modified = -1;
+		qint64 size = -1;
+		StreamHash hash;
+		TextEncoding::Format format;
+	};
+
+	explicit Document(QString path = {});
+
+	const QString& path() const { return m_path; }
+	void setPath(const QString& path) { m_path = path; }
+	QString displayName() const;
+
+	// Reads and decodes a whole file in the encoding it is found to be in.
+	// Safe to call from any thread.
+	static bool readFile(const QString& path, QString* text, DiskState* state, QString* error = nullptr);
+
+	bool load(QString* error = nullptr);
+	// Leaves the file unread. The document hibernates until wake() reads it or
+	// setCompressed() hands it the text.
+	void defer();
+	bool isLoaded() const { return m_loaded; }
+	// Text compressed by compress(), read elsewhere while the document was deferred.
+	void setCompressed(QByteArray compressed, const DiskState& state);
+	// The form hibernate() keeps text in. Safe to call from any thread.
+	static QByteArray compress(const QString& text);
+	// Writes the text to path, which becomes the document's path, in the
+	// encoding it was read in. Text that no longer fits a single-byte
+	// encoding is written as UTF-8 instead.
+	bool save(const QString& path, QString* error = nullptr);
+	// save() in three steps, so the encoding and writing can happen on another
+	// thread: prepareSave() copies the text, writeFile() writes it from any
+	// thread, and finishSave() takes the file as written.
+	struct SaveJob {
+		QString path;
+		QString text;
+		TextEncoding::Format format;
+		qsizetype version = 0;
+	};
+	SaveJob prepareSave(const QString& path);
+	static bool writeFile(const SaveJob& job, DiskState* state, QString* error = nullptr);
+	// The document stays modified if it was edited since prepareSave().
+	void finishSave(const SaveJob& job, const DiskState& state);
+	// False for the document's own loads and saves.
+	bool isChangedOnDisk() const;
+	const DiskState& diskState() const { return m_disk; }
+	void setDiskState(const DiskState& state) { m_disk = state; }
+	// If the file only grew since it was last read, reads the new part into
+	// appended, marks it as read and returns true; the caller adds it to the text.
+	bool readAppended(QString* appended);
+	// Applies an edit no view is showing, recording it for undo.
+	void replace(qsizetype pos, qsizetype length, const QString& text);
+
+	// Wakes the document.
+	GapBuffer& text();
+	UndoStack& undo() { return m_undo; }
+
+	bool isModified() const { return m_modified; }
+	// Clearing the flag makes the current undo state the clean one.
+	void setModified(bool modified);
+
+	ViewState viewState;
+
+	bool isHibernating() const { return m_hibernating; }
+	void hibernate();
+	void wake();
+	// Memory held for the text, compressed or not.
+	qsizetype residentBytes() const;
+	struct MemoryUsage {
+		// Characters in the text, and room allocated past them for the gap.
+		qsizetype textBytes = 0;
+		qsizetype gapBytes = 0;
+		qsizetype lineIndexBytes = 0;
+		qsizetype compressedBytes = 0;
+		qsizetype undoBytes = 0;
+	};
+	// Doesn't wake the document.
+	MemoryUsage memoryUsage() const;
+
+private:
+	QString m_path;
+	GapBuffer m_text;
+	UndoStack m_undo;
+	QByteArray m_compressed;
+	DiskState m_disk;
+	bool m_modified = false;
+	bool m_hibernating = false;
+	bool m_loaded = true;
+};
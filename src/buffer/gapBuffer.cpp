@@ -1,4 +1,5 @@
 #include "gapBuffer.h"
+#include "../util/trace.h"
 #include <QVector>
 #include <algorithm>
 #include <cassert>
@@ -7,12 +8,18 @@ static inline bool isNewLine (QChar c) {
 	return c == u'\n';
 }
 
+static inline qsizetype cellsOf(QChar c) {
+	if (c == u'\t') return ITextBuffer::kTabCells;
+	return c.isLowSurrogate() ? 0 : 1;
+}
+
 GapBuffer::GapBuffer() {
 	m_buf.resize(256);
 	m_gapBegin = 0;
 	m_gapEnd = qsizetype(m_buf.size());
 	m_lines .clear();
 	m_lines.push_back(0);
+	m_checkpoints.push_back({0, 0});
 }
 
 GapBuffer::GapBuffer(QStringView initial) : GapBuffer() {
@@ -25,7 +32,8 @@ void GapBuffer::clear() {
 	m_gapEnd = qsizetype(m_buf.size());
 	m_lines.clear();
 	m_lines.push_back(0);
-	m_version = 0;
+	m_checkpoints.assign(1, {0, 0});
+	++m_version;
 }
 
 qsizetype GapBuffer::size() const {
@@ -39,6 +47,7 @@ qsizetype GapBuffer::logicalToPhysical(qsizetype pos) const {
 }
 
 void GapBuffer::growGap(qsizetype minExtra) {
+    IDE_TRACE_SPAN("GapBuffer::growGap");
     const qsizetype oldGap = m_gapEnd - m_gapBegin;
     qsizetype need = std::max<qsizetype>(minExtra, oldGap ? oldGap : 32);
     qsizetype newCap = qsizetype(m_buf.size()) + need;
@@ -56,6 +65,8 @@ void GapBuffer::growGap(qsizetype minExtra) {
 
 void GapBuffer::moveGapTo(qsizetype at) {
     if (at == m_gapBegin) return;
+    IDE_TRACE_SPAN("GapBuffer::moveGapTo");
+    IDE_TRACE_COUNTER("gap move distance", at < m_gapBegin ? m_gapBegin - at : at - m_gapBegin);
     if (at < m_gapBegin) {
         qsizetype delta = m_gapBegin - at;
         std::move_backward(m_buf.begin() + at, m_buf.begin() + m_gapBegin, m_buf.begin() + m_gapEnd);
@@ -86,6 +97,7 @@ void GapBuffer::insert(qsizetype pos, QStringView stringview) {
     m_gapBegin += stringview.size();
 
     updateLinesForInsert(pos, stringview);
+	updateCheckpoints(pos, 0, stringview.size());
 	++m_version;
 }
 
@@ -115,17 +127,13 @@ void GapBuffer::erase(qsizetype pos, qsizetype len) {
     m_gapEnd += len;
 
     updateLinesForErase(pos, len, removed);
+	updateCheckpoints(pos, len, 0);
 	++m_version;
 }
 
 QString GapBuffer::readRange(qsizetype physStart, qsizetype physEnd) const {
     if (physStart >= physEnd) return {};
-    QString out;
-    out.resize(physEnd - physStart);
-    for (qsizetype i = 0; i < out.size(); ++i) {
-        out[i] = m_buf[physStart + i];
-    }
-    return out;
+    return QString(m_buf.data() + physStart, physEnd - physStart);
 }
 
 
@@ -185,19 +193,22 @@ void GapBuffer::updateLinesForInsert(qsizetype at, QStringView stringview) {
         m_lines[i] += delta;
     }
 
+    // The new lines go before the ones that moved along.
+    std::vector<qsizetype> added;
     for (qsizetype i = 0; i < stringview.size(); ++i) {
         if (isNewLine(stringview[i])) {
-            m_lines.insert(m_lines.begin() + lineIdx + 1, at + i + 1);
-            ++lineIdx;
+            added.push_back(at + i + 1);
         }
     }
+    m_lines.insert(m_lines.begin() + lineIdx, added.begin(), added.end());
 }
 
 void GapBuffer::updateLinesForErase(qsizetype at, qsizetype len, QStringView removed) {
     const qsizetype end = at + len;
 
+    // A line starts after each removed line break.
     auto newEnd = std::remove_if(m_lines.begin() + 1, m_lines.end(), [&](qsizetype start){
-        return start >= at && start < end;
+        return start > at && start <= end;
     });
     m_lines.erase(newEnd, m_lines.end());
 
@@ -226,12 +237,105 @@ qsizetype GapBuffer::lineStart(qsizetype line) const {
     return m_lines[line];
 }
 
+qsizetype GapBuffer::lineFromPosition(qsizetype pos) const {
+    auto it = std::upper_bound(m_lines.begin(), m_lines.end(), pos);
+    return std::max<qsizetype>(0, qsizetype(it - m_lines.begin()) - 1);
+}
+
 qsizetype GapBuffer::positionFromLineCol(qsizetype line, qsizetype col) const {
     const qsizetype start = lineStart(line);
     const qsizetype end   = (line + 1 < lineCount()) ? lineStart(line + 1) : size();
     return std::clamp<qsizetype>(start + col, start, end);
 }
 
+qsizetype GapBuffer::scanCells(qsizetype from, qsizetype cell, qsizetype end, std::vector<Checkpoint>* out) const {
+	qsizetype last = from;
+	auto scan = [&](qsizetype begin, qsizetype stop, qsizetype shift) {
+		for (qsizetype p = begin; p < stop; ++p) {
+			if (out && p - last >= kCheckpointChars) {
+				out->push_back({p, cell});
+				last = p;
+			}
+			const QChar c = m_buf[std::size_t(p + shift)];
+			cell = isNewLine(c) ? 0 : cell + cellsOf(c);
+		}
+	};
+	// Before the gap, then after it.
+	scan(from, std::min(end, m_gapBegin), 0);
+	scan(std::max(from, m_gapBegin), end, m_gapEnd - m_gapBegin);
+	return cell;
+}
+
+void GapBuffer::updateCheckpoints(qsizetype at, qsizetype removed, qsizetype added) {
+	auto byPos = [](qsizetype value, const Checkpoint& c) { return value < c.pos; };
+	// Checkpoints up to the edit keep their columns; those in the removed text
+	// go, and the stretch up to the next one is checkpointed again.
+	const auto base = std::prev(std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), at, byPos));
+	const auto next = std::lower_bound(base + 1, m_checkpoints.end(), at + removed,
+		[](const Checkpoint& c, qsizetype value) { return c.pos < value; });
+	const qsizetype shift = added - removed;
+	const bool hasNext = next != m_checkpoints.end();
+	const qsizetype end = hasNext ? next->pos + shift : size();
+	std::vector<Checkpoint> placed;
+	const qsizetype cellAtEnd = scanCells(base->pos, base->cell, end, &placed);
+
+	const qsizetype first = (base - m_checkpoints.begin()) + 1;
+	m_checkpoints.erase(base + 1, next);
+	m_checkpoints.insert(m_checkpoints.begin() + first, placed.begin(), placed.end());
+	const qsizetype moved = first + qsizetype(placed.size());
+	for (qsizetype i = moved; i < qsizetype(m_checkpoints.size()); ++i) {
+		m_checkpoints[std::size_t(i)].pos += shift;
+	}
+	if (!hasNext) return;
+	// The rest of the line the stretch ends in moved by as many cells as its end.
+	const qsizetype delta = cellAtEnd - m_checkpoints[std::size_t(moved)].cell;
+	if (delta == 0) return;
+	const qsizetype line = lineFromPosition(end);
+	const qsizetype lineEnd = line + 1 < lineCount() ? lineStart(line + 1) : size() + 1;
+	for (qsizetype i = moved; i < qsizetype(m_checkpoints.size()) && m_checkpoints[std::size_t(i)].pos < lineEnd; ++i) {
+		m_checkpoints[std::size_t(i)].cell += delta;
+	}
+}
+
+qsizetype GapBuffer::cellColumn(qsizetype pos) const {
+	pos = std::clamp<qsizetype>(pos, 0, size());
+	const qsizetype begin = lineStart(lineFromPosition(pos));
+	auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), pos,
+		[](qsizetype value, const Checkpoint& c) { return value < c.pos; });
+	const Checkpoint& from = *std::prev(it);
+	// A line that starts past the checkpoint is less than a checkpoint long so far.
+	if (from.pos < begin) return scanCells(begin, 0, pos);
+	return scanCells(from.pos, from.cell, pos);
+}
+
+qsizetype GapBuffer::positionFromCell(qsizetype line, qsizetype cell) const {
+	const qsizetype begin = lineStart(line);
+	qsizetype end = (line + 1 < lineCount()) ? lineStart(line + 1) : size();
+	while (end > begin && (isNewLine(charAt(end - 1)) || charAt(end - 1) == u'\r')) {
+		--end;
+	}
+	// Within a line, checkpoint columns grow with their positions.
+	auto lo = std::lower_bound(m_checkpoints.begin(), m_checkpoints.end(), begin,
+		[](const Checkpoint& c, qsizetype value) { return c.pos < value; });
+	auto hi = std::upper_bound(lo, m_checkpoints.end(), end,
+		[](qsizetype value, const Checkpoint& c) { return value < c.pos; });
+	auto at = std::upper_bound(lo, hi, cell, [](qsizetype value, const Checkpoint& c) { return value < c.cell; });
+	qsizetype pos = begin;
+	qsizetype current = 0;
+	if (at != lo) {
+		pos = std::prev(at)->pos;
+		current = std::prev(at)->cell;
+	}
+	while (pos < end && current < cell) {
+		current += cellsOf(charAt(pos));
+		++pos;
+	}
+	while (pos < end && charAt(pos).isLowSurrogate()) {
+		++pos;
+	}
+	return pos;
+}
+
 TextSnapshot GapBuffer::snapshot() const {
 	QString txt = toString();
 	std::vector<qsizetype> starts = m_lines;
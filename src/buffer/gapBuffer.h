@@ -17,19 +17,44 @@ public:
 
 	qsizetype lineCount() const override;
 	qsizetype lineStart(qsizetype line) const override;
+	qsizetype lineFromPosition(qsizetype pos) const override;
 	qsizetype positionFromLineCol(qsizetype line, qsizetype col) const override;
+	qsizetype cellColumn(qsizetype pos) const override;
+	qsizetype positionFromCell(qsizetype line, qsizetype cell) const override;
+
+	// Cell columns are checkpointed at least this often, so within even a huge
+	// line they map to positions and back by a binary search and a short scan.
+	static constexpr qsizetype kCheckpointChars = 4096;
 
 	TextSnapshot snapshot() const override;
+	// The text on either side of the gap, for reading it in place. Any edit
+	// invalidates both.
+	QStringView beforeGap() const { return QStringView(m_buf.data(), m_gapBegin); }
+	QStringView afterGap() const { return QStringView(m_buf.data() + m_gapEnd, qsizetype(m_buf.size()) - m_gapEnd); }
+	// Characters allocated, gap included.
+	qsizetype capacity() const { return qsizetype(m_buf.size()); }
+	qsizetype lineIndexBytes() const {
+		return qsizetype(m_lines.capacity() * sizeof(qsizetype) + m_checkpoints.capacity() * sizeof(Checkpoint));
+	}
+	// Changes with every edit, clear() included.
+	qsizetype version() const { return m_version; }
 
 	void setText(QStringView stringview) {
 		clear();
 		insert(0, stringview);
 	}
 private:
+	struct Checkpoint {
+		qsizetype pos;
+		qsizetype cell;
+	};
+
 	std::vector<QChar> m_buf;
 	qsizetype m_gapBegin = 0;
 	qsizetype m_gapEnd = 0;
 	std::vector<qsizetype> m_lines;
+	// Sorted by position, the first at 0, none more than kCheckpointChars apart.
+	std::vector<Checkpoint> m_checkpoints;
 	qsizetype m_version = 0;
 
 	qsizetype logicalToPhysical(qsizetype pos) const ;
@@ -42,4 +67,10 @@ private:
 	void updateLinesForErase(qsizetype at, qsizetype len, QStringView removed);
 	QString readRange(qsizetype physStart, qsizetype physEnd) const;
 	void collectRemoved(qsizetype pos, qsizetype len, QString& out) const;
+
+	QChar charAt(qsizetype pos) const { return m_buf[std::size_t(logicalToPhysical(pos))]; }
+	// Follows the cell column from `from`, where it is cell, to end, adding a
+	// checkpoint to out wherever the last is kCheckpointChars behind.
+	qsizetype scanCells(qsizetype from, qsizetype cell, qsizetype end, std::vector<Checkpoint>* out = nullptr) const;
+	void updateCheckpoints(qsizetype at, qsizetype removed, qsizetype added);
 };
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "lineDiff.h"
+#include "textSnapshot.h"
+#include "../util/trace.h"
+#include <QHash>
+#include <algorithm>
+
+// A line without its '\r', which the gutter doesn't count as a change.
+static inline QStringView hashedPart(QStringView line) {
+	if (!line.isEmpty() && line.back() == u'\r') {
+		line.chop(1);
+	}
+	return line;
+}
+
+static inline size_t hashLine(QStringView line) {
+	return qHash(hashedPart(line));
+}
+
+std::vector<size_t> LineDiff::hashLines(QStringView text) {
+	std::vector<size_t> out;
+	qsizetype start = 0;
+	for (;;) {
+		const qsizetype nl = text.indexOf(u'\n', start);
+		if (nl < 0) break;
+		out.push_back(hashLine(text.sliced(start, nl - start)));
+		start = nl + 1;
+	}
+	out.push_back(hashLine(text.sliced(start)));
+	return out;
+}
+
+std::vector<size_t> LineDiff::hashLines(const TextSnapshot& snapshot) {
+	std::vector<size_t> out;
+	out.reserve(std::size_t(snapshot.lineCount()));
+	hashLines(snapshot, 0, snapshot.lineCount(), &out);
+	return out;
+}
+
+void LineDiff::hashLines(const TextSnapshot& snapshot, qsizetype first, qsizetype last, std::vector<size_t>* out) {
+	for (qsizetype line = first; line < last; ++line) {
+		out->push_back(qHash(lineAt(snapshot, line)));
+	}
+}
+
+QStringView LineDiff::lineAt(const TextSnapshot& snapshot, qsizetype line) {
+	const qsizetype start = snapshot.lineStart(line);
+	qsizetype end = (line + 1 < snapshot.lineCount()) ? snapshot.lineStart(line + 1) - 1 : snapshot.size();
+	if (end < start) end = start;
+	return hashedPart(QStringView(snapshot.text()).sliced(start, end - start));
+}
+
+namespace {
+// Hashes of every line, '\r' included, and where each starts. A sentinel start
+// one past the end stands for the newline the last line doesn't have.
+void indexLines(QStringView text, std::vector<size_t>& hashes, std::vector<qsizetype>& starts) {
+	starts.push_back(0);
+	for (;;) {
+		const qsizetype nl = text.indexOf(u'\n', starts.back());
+		if (nl < 0) break;
+		hashes.push_back(qHash(text.sliced(starts.back(), nl - starts.back())));
+		starts.push_back(nl + 1);
+	}
+	hashes.push_back(qHash(text.sliced(starts.back())));
+	starts.push_back(text.size() + 1);
+}
+
+// Past the first line each line is taken with the newline before it, so a last
+// line without one still lines up with the same line followed by more.
+std::pair<qsizetype, qsizetype> lineRange(const std::vector<qsizetype>& starts, qsizetype size,
+	qsizetype first, qsizetype count) {
+	if (first > 0) {
+		return {starts[std::size_t(first)] - 1, starts[std::size_t(first + count)] - 1};
+	}
+	return {0, std::min(starts[std::size_t(count)], size)};
+}
+
+enum class Op { Equal, Delete, Insert };
+
+void appendHunks(const std::vector<Op>& ops, qsizetype aBegin, qsizetype bBegin, std::vector<DiffHunk>& out) {
+	qsizetype x = aBegin;
+	qsizetype y = bBegin;
+	std::size_t i = 0;
+	while (i < ops.size()) {
+		if (ops[i] == Op::Equal) {
+			++x;
+			++y;
+			++i;
+			continue;
+		}
+		DiffHunk hunk{x, 0, y, 0};
+		while (i < ops.size() && ops[i] != Op::Equal) {
+			if (ops[i] == Op::Delete) {
+				++hunk.oldCount;
+				++x;
+			} else {
+				++hunk.newCount;
+				++y;
+			}
+			++i;
+		}
+		out.push_back(hunk);
+	}
+}
+}
+
+std::vector<DiffHunk> LineDiff::diff(const std::vector<size_t>& a, qsizetype aBegin, qsizetype aEnd,
+	const std::vector<size_t>& b, qsizetype bBegin, qsizetype bEnd, qsizetype maxCost, const SameLine& same) {
+	// A hash match alone may be a collision.
+	auto sameLine = [&](qsizetype x, qsizetype y) {
+		return a[std::size_t(x)] == b[std::size_t(y)] && (!same || same(x, y));
+	};
+
+	std::vector<DiffHunk> out;
+	while (aBegin < aEnd && bBegin < bEnd && sameLine(aBegin, bBegin)) {
+		++aBegin;
+		++bBegin;
+	}
+	while (aEnd > aBegin && bEnd > bBegin && sameLine(aEnd - 1, bEnd - 1)) {
+		--aEnd;
+		--bEnd;
+	}
+	const qsizetype n = aEnd - aBegin;
+	const qsizetype m = bEnd - bBegin;
+	if (n == 0 && m == 0) return out;
+	if (n == 0 || m == 0) {
+		out.push_back({aBegin, n, bBegin, m});
+		return out;
+	}
+
+	auto equal = [&](qsizetype x, qsizetype y) {
+		return sameLine(aBegin + x, bBegin + y);
+	};
+
+	// Greedy forward Myers; trace[d] holds the furthest x for diagonals -d..d.
+	std::vector<std::vector<qsizetype>> trace;
+	qsizetype found = -1;
+	const qsizetype limit = std::min(n + m, maxCost);
+	for (qsizetype d = 0; d <= limit && found < 0; ++d) {
+		std::vector<qsizetype> v(std::size_t(2 * d + 1));
+		const std::vector<qsizetype>* prev = d > 0 ? &trace.back() : nullptr;
+		auto prevAt = [&](qsizetype k) { return (*prev)[std::size_t(k + d - 1)]; };
+		for (qsizetype k = -d; k <= d; k += 2) {
+			qsizetype x;
+			if (d == 0) {
+				x = 0;
+			} else if (k == -d || (k != d && prevAt(k - 1) < prevAt(k + 1))) {
+				x = prevAt(k + 1);
+			} else {
+				x = prevAt(k - 1) + 1;
+			}
+			qsizetype y = x - k;
+			while (x < n && y < m && equal(x, y)) {
+				++x;
+				++y;
+			}
+			v[std::size_t(k + d)] = x;
+			if (x >= n && y >= m) {
+				found = d;
+				break;
+			}
+		}
+		trace.push_back(std::move(v));
+	}
+	if (found < 0) {
+		out.push_back({aBegin, n, bBegin, m});
+		return out;
+	}
+
+	std::vector<Op> ops;
+	qsizetype x = n;
+	qsizetype y = m;
+	for (qsizetype d = found; d > 0; --d) {
+		const std::vector<qsizetype>& v = trace[std::size_t(d - 1)];
+		auto prevAt = [&](qsizetype k) { return v[std::size_t(k + d - 1)]; };
+		const qsizetype k = x - y;
+		const bool down = (k == -d || (k != d && prevAt(k - 1) < prevAt(k + 1)));
+		const qsizetype prevK = down ? k + 1 : k - 1;
+		const qsizetype prevX = prevAt(prevK);
+		const qsizetype prevY = prevX - prevK;
+		while (x > prevX && y > prevY) {
+			ops.push_back(Op::Equal);
+			--x;
+			--y;
+		}
+		ops.push_back(down ? Op::Insert : Op::Delete);
+		x = prevX;
+		y = prevY;
+	}
+	while (x > 0 && y > 0) {
+		ops.push_back(Op::Equal);
+		--x;
+		--y;
+	}
+	std::reverse(ops.begin(), ops.end());
+	appendHunks(ops, aBegin, bBegin, out);
+	return out;
+}
+
+std::vector<TextPatch> LineDiff::patches(QStringView from, QStringView to) {
+	IDE_TRACE_SPAN("LineDiff::patches");
+	std::vector<size_t> a;
+	std::vector<size_t> b;
+	std::vector<qsizetype> aStarts;
+	std::vector<qsizetype> bStarts;
+	indexLines(from, a, aStarts);
+	indexLines(to, b, bStarts);
+	auto line = [](QStringView text, const std::vector<qsizetype>& starts, qsizetype i) {
+		const qsizetype start = starts[std::size_t(i)];
+		return text.sliced(start, starts[std::size_t(i + 1)] - 1 - start);
+	};
+	const std::vector<DiffHunk> hunks = diff(a, b, [&](qsizetype x, qsizetype y) {
+		return line(from, aStarts, x) == line(to, bStarts, y);
+	});
+
+	std::vector<TextPatch> out;
+	out.reserve(hunks.size());
+	for (auto it = hunks.rbegin(); it != hunks.rend(); ++it) {
+		const auto [oldBegin, oldEnd] = lineRange(aStarts, from.size(), it->oldStart, it->oldCount);
+		const auto [newBegin, newEnd] = lineRange(bStarts, to.size(), it->newStart, it->newCount);
+		out.push_back({oldBegin, oldEnd - oldBegin, to.sliced(newBegin, newEnd - newBegin).toString()});
+	}
+	return out;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <QString>
+#include <QStringView>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class TextSnapshot;
+
+struct DiffHunk {
+	qsizetype oldStart = 0;
+	qsizetype oldCount = 0;
+	qsizetype newStart = 0;
+	qsizetype newCount = 0;
+
+	bool isAdd() const { return oldCount == 0; }
+	bool isDelete() const { return newCount == 0; }
+};
+using DiffHunksPtr = std::shared_ptr<const std::vector<DiffHunk>>;
+
+// Replace `removed` characters at pos with text.
+struct TextPatch {
+	qsizetype pos = 0;
+	qsizetype removed = 0;
+	QString text;
+};
+
+namespace LineDiff {
+	std::vector<size_t> hashLines(QStringView text);
+	std::vector<size_t> hashLines(const TextSnapshot& snapshot);
+	// Appends the hashes of lines [first, last).
+	void hashLines(const TextSnapshot& snapshot, qsizetype first, qsizetype last, std::vector<size_t>* out);
+	// The part of a line that hashLines hashes: its text without the line ending.
+	QStringView lineAt(const TextSnapshot& snapshot, qsizetype line);
+
+	// Whether line x of a and line y of b, whose hashes match, are the same.
+	using SameLine = std::function<bool(qsizetype x, qsizetype y)>;
+
+	// Myers diff of a[aBegin, aEnd) against b[bBegin, bEnd); hunk coordinates are absolute.
+	// Past maxCost edits the remaining middle is reported as a single replace hunk.
+	// Lines are equal when their hashes are, and same, if given, agrees.
+	std::vector<DiffHunk> diff(const std::vector<size_t>& a, qsizetype aBegin, qsizetype aEnd,
+		const std::vector<size_t>& b, qsizetype bBegin, qsizetype bEnd, qsizetype maxCost = 1024,
+		const SameLine& same = {});
+
+	inline std::vector<DiffHunk> diff(const std::vector<size_t>& a, const std::vector<size_t>& b,
+		const SameLine& same = {}) {
+		return diff(a, 0, qsizetype(a.size()), b, 0, qsizetype(b.size()), 1024, same);
+	}
+
+	// Line-level patches turning from into to, last first so each one applies
+	// to the text the previous ones left. Unlike hashLines, line endings count.
+	std::vector<TextPatch> patches(QStringView from, QStringView to);
+}
@@ -4,6 +4,19 @@
 #include <vector>
 #include "textSnapshot.h"
 
+// One contiguous replacement, in both character and line terms.
+struct TextDelta {
+	qsizetype pos = 0;
+	qsizetype removed = 0;
+	qsizetype added = 0;
+	qsizetype firstLine = 0;
+	qsizetype removedLines = 0;
+	qsizetype addedLines = 0;
+	// Characters removed after the last removed line break, or all of them if
+	// none was; with firstLine and removedLines it places the removed end.
+	qsizetype removedTail = 0;
+};
+
 class ITextBuffer {
 public:
 	virtual ~ITextBuffer() = default;
@@ -17,8 +30,17 @@ public:
 	virtual QString toString() const = 0;
 	virtual qsizetype lineCount() const = 0;
 	virtual qsizetype lineStart(qsizetype line) const = 0;
+	virtual qsizetype lineFromPosition(qsizetype pos) const = 0;
 	virtual qsizetype positionFromLineCol(qsizetype line, qsizetype col) const = 0;
 
+	// Display cells from the start of pos's line to pos: one per character,
+	// none for the low half of a surrogate pair and kTabCells for a tab.
+	static constexpr qsizetype kTabCells = 4;
+	virtual qsizetype cellColumn(qsizetype pos) const = 0;
+	// The first position on the line at or past the cell column, without
+	// splitting a surrogate pair; the line's end if it is shorter.
+	virtual qsizetype positionFromCell(qsizetype line, qsizetype cell) const = 0;
+
 	virtual TextSnapshot snapshot() const = 0;
 	virtual void beginEdit() {}
 	virtual void endEdit() {}
@@ -0,0 +1,246 @@
+#include "textEncoding.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IDE_ENCODING_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define IDE_ENCODING_NEON
+#endif
+
+namespace {
+// Windows-1252 from 0x80 to 0x9F; the five bytes it leaves undefined keep
+// their Latin-1 meaning.
+constexpr std::array<char16_t, 32> kWindows1252{
+	0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+	0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+	0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+	0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+};
+
+// The byte for c, or -1.
+int singleByteOf(char16_t c, TextEncoding::Encoding encoding) {
+	if (c < 0x80 || (c >= 0xA0 && c <= 0xFF)) return c;
+	if (encoding == TextEncoding::Encoding::Latin1) return c <= 0xFF ? int(c) : -1;
+	const auto* it = std::find(kWindows1252.begin(), kWindows1252.end(), c);
+	return it != kWindows1252.end() ? 0x80 + int(it - kWindows1252.begin()) : -1;
+}
+
+// The length of the leading run of chars below 0x80.
+qsizetype asciiPrefix16(const char16_t* text, qsizetype size) {
+	qsizetype i = 0;
+#if defined(IDE_ENCODING_SSE2)
+	const __m128i high = _mm_set1_epi16(qint16(0xFF80));
+	for (; i + 8 <= size; i += 8) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+		const __m128i outside = _mm_cmpeq_epi16(_mm_and_si128(chunk, high), _mm_setzero_si128());
+		const int mask = ~_mm_movemask_epi8(outside) & 0xFFFF;
+		if (mask) return i + std::countr_zero(unsigned(mask)) / 2;
+	}
+#elif defined(IDE_ENCODING_NEON)
+	for (; i + 8 <= size; i += 8) {
+		if (vmaxvq_u16(vld1q_u16(reinterpret_cast<const quint16*>(text + i))) >= 0x80) break;
+	}
+#endif
+	while (i < size && text[i] < 0x80) {
+		++i;
+	}
+	return i;
+}
+}
+
+QString TextEncoding::Format::description() const {
+	QString name;
+	switch (encoding) {
+	case Encoding::Utf8: name = QStringLiteral("UTF-8"); break;
+	case Encoding::Utf16LE: name = QStringLiteral("UTF-16LE"); break;
+	case Encoding::Utf16BE: name = QStringLiteral("UTF-16BE"); break;
+	case Encoding::Latin1: name = QStringLiteral("ISO-8859-1"); break;
+	case Encoding::Windows1252: name = QStringLiteral("Windows-1252"); break;
+	}
+	if (bom) name += QStringLiteral(" with BOM");
+	name += lineEnding == LineEnding::CrLf ? QStringLiteral(", CRLF") : QStringLiteral(", LF");
+	if (mixedLineEndings) name += QStringLiteral(" (mixed)");
+	return name;
+}
+
+qsizetype TextEncoding::asciiPrefix(QByteArrayView bytes) {
+	const char* data = bytes.data();
+	const qsizetype size = bytes.size();
+	qsizetype i = 0;
+#if defined(IDE_ENCODING_SSE2)
+	for (; i + 16 <= size; i += 16) {
+		const int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)));
+		if (mask) return i + std::countr_zero(unsigned(mask));
+	}
+#elif defined(IDE_ENCODING_NEON)
+	for (; i + 16 <= size; i += 16) {
+		if (vmaxvq_u8(vld1q_u8(reinterpret_cast<const uint8_t*>(data + i))) >= 0x80) break;
+	}
+#endif
+	for (; i + 8 <= size; i += 8) {
+		quint64 word;
+		std::memcpy(&word, data + i, sizeof(word));
+		if (word & 0x8080808080808080ull) break;
+	}
+	while (i < size && uchar(data[i]) < 0x80) {
+		++i;
+	}
+	return i;
+}
+
+bool TextEncoding::Utf8Validator::feed(QByteArrayView bytes) {
+	const uchar* data = reinterpret_cast<const uchar*>(bytes.data());
+	const qsizetype size = bytes.size();
+	qsizetype i = 0;
+	while (m_valid && i < size) {
+		if (m_needed > 0) {
+			const uchar c = data[i++];
+			if (c < m_lower || c > m_upper) {
+				m_valid = false;
+				break;
+			}
+			m_lower = 0x80;
+			m_upper = 0xBF;
+			--m_needed;
+			continue;
+		}
+		i += asciiPrefix(bytes.sliced(i));
+		if (i == size) break;
+		// The ranges of Unicode's table of well-formed UTF-8.
+		const uchar lead = data[i++];
+		if (lead >= 0xC2 && lead <= 0xDF) {
+			m_needed = 1;
+		} else if (lead >= 0xE0 && lead <= 0xEF) {
+			m_needed = 2;
+			if (lead == 0xE0) m_lower = 0xA0;
+			if (lead == 0xED) m_upper = 0x9F;
+		} else if (lead >= 0xF0 && lead <= 0xF4) {
+			m_needed = 3;
+			if (lead == 0xF0) m_lower = 0x90;
+			if (lead == 0xF4) m_upper = 0x8F;
+		} else {
+			m_valid = false;
+		}
+	}
+	return m_valid;
+}
+
+bool TextEncoding::isValidUtf8(QByteArrayView bytes) {
+	Utf8Validator validator;
+	validator.feed(bytes);
+	return validator.finish();
+}
+
+TextEncoding::Encoding TextEncoding::detect(QByteArrayView head, qsizetype* bomBytes) {
+	if (bomBytes) *bomBytes = 0;
+	if (head.startsWith("\xEF\xBB\xBF")) {
+		if (bomBytes) *bomBytes = 3;
+		return Encoding::Utf8;
+	}
+	if (head.startsWith("\xFF\xFE")) {
+		if (bomBytes) *bomBytes = 2;
+		return Encoding::Utf16LE;
+	}
+	if (head.startsWith("\xFE\xFF")) {
+		if (bomBytes) *bomBytes = 2;
+		return Encoding::Utf16BE;
+	}
+	// ASCII in UTF-16 has a zero in every other byte; text never does.
+	qsizetype even = 0;
+	qsizetype odd = 0;
+	const qsizetype pairs = head.size() / 2;
+	for (qsizetype i = 0; i < pairs; ++i) {
+		even += head[2 * i] == '\0';
+		odd += head[2 * i + 1] == '\0';
+	}
+	if (pairs >= 2 && odd > pairs / 2 && even == 0) return Encoding::Utf16LE;
+	if (pairs >= 2 && even > pairs / 2 && odd == 0) return Encoding::Utf16BE;
+	return Encoding::Utf8;
+}
+
+TextEncoding::Encoding TextEncoding::singleByteFallback(QByteArrayView bytes) {
+	for (qsizetype i = 0; i < bytes.size();) {
+		i += asciiPrefix(bytes.sliced(i));
+		if (i == bytes.size()) break;
+		const uchar c = uchar(bytes[i++]);
+		if (c >= 0x80 && c <= 0x9F) return Encoding::Windows1252;
+	}
+	return Encoding::Latin1;
+}
+
+QChar* TextEncoding::decodeSingleByte(QByteArrayView bytes, Encoding encoding, QChar* out) {
+	const qsizetype size = bytes.size();
+	for (qsizetype i = 0; i < size;) {
+#if defined(IDE_ENCODING_SSE2)
+		// ASCII widens with zeros, 16 bytes at a time.
+		for (; i + 16 <= size; i += 16, out += 16) {
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes.data() + i));
+			if (_mm_movemask_epi8(chunk)) break;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi8(chunk, _mm_setzero_si128()));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8), _mm_unpackhi_epi8(chunk, _mm_setzero_si128()));
+		}
+#endif
+		const qsizetype ascii = asciiPrefix(bytes.sliced(i));
+		const char* run = bytes.data() + i;
+		for (qsizetype k = 0; k < ascii; ++k) {
+			out[k] = QLatin1Char(run[k]);
+		}
+		out += ascii;
+		i += ascii;
+		if (i == size) break;
+		const uchar c = uchar(bytes[i++]);
+		const bool table = encoding == Encoding::Windows1252 && c <= 0x9F;
+		*out++ = QChar(table ? kWindows1252[c - 0x80] : char16_t(c));
+	}
+	return out;
+}
+
+bool TextEncoding::canEncode(QStringView text, Encoding encoding) {
+	if (encoding != Encoding::Latin1 && encoding != Encoding::Windows1252) return true;
+	const char16_t* data = text.utf16();
+	const qsizetype size = text.size();
+	for (qsizetype i = 0; i < size;) {
+		i += asciiPrefix16(data + i, size - i);
+		if (i == size) break;
+		if (singleByteOf(data[i++], encoding) < 0) return false;
+	}
+	return true;
+}
+
+void TextEncoding::encodeSingleByte(QStringView text, Encoding encoding, QByteArray* out) {
+	const qsizetype start = out->size();
+	out->resize(start + text.size());
+	char* dest = out->data() + start;
+	const char16_t* data = text.utf16();
+	const qsizetype size = text.size();
+	for (qsizetype i = 0; i < size;) {
+		const qsizetype ascii = asciiPrefix16(data + i, size - i);
+		for (qsizetype k = 0; k < ascii; ++k) {
+			dest[i + k] = char(data[i + k]);
+		}
+		i += ascii;
+		if (i == size) break;
+		const int byte = singleByteOf(data[i], encoding);
+		dest[i++] = byte >= 0 ? char(byte) : '?';
+	}
+}
+
+void TextEncoding::LineEndingCounter::add(QStringView text) {
+	if (text.isEmpty()) return;
+	const char16_t* begin = text.utf16();
+	const char16_t* end = begin + text.size();
+	for (const char16_t* it = std::find(begin, end, u'\n'); it != end; it = std::find(it + 1, end, u'\n')) {
+		const bool crlf = it == begin ? m_afterCr : it[-1] == u'\r';
+		++(crlf ? m_crlf : m_lf);
+	}
+	m_afterCr = end[-1] == u'\r';
+}
+
+void TextEncoding::LineEndingCounter::apply(Format* format) const {
+	format->lineEnding = m_crlf > m_lf ? LineEnding::CrLf : LineEnding::Lf;
+	format->mixedLineEndings = m_crlf > 0 && m_lf > 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QStringView>
+
+// How a file's bytes map to text, found when it is read and kept for writing
+// it back. Validation and the ASCII runs that make up most source text are
+// checked 16 bytes at a time with SSE2 or NEON; UTF-8 and UTF-16 are decoded
+// and encoded by Qt's converters, which are vectorized the same way, straight
+// into their destination buffers, so text goes through in chunks without an
+// intermediate copy.
+namespace TextEncoding {
+	enum class Encoding : quint8 {
+		Utf8,
+		Utf16LE,
+		Utf16BE,
+		Latin1,
+		Windows1252,
+	};
+	enum class LineEnding : quint8 { Lf, CrLf };
+
+	struct Format {
+		Encoding encoding = Encoding::Utf8;
+		bool bom = false;
+		// The more common one, used for new lines. Existing line breaks are
+		// kept as they are, whatever the mix.
+		LineEnding lineEnding = LineEnding::Lf;
+		bool mixedLineEndings = false;
+
+		QString lineBreak() const { return lineEnding == LineEnding::CrLf ? QStringLiteral("\r\n") : QStringLiteral("\n"); }
+		// E.g. "UTF-8 with BOM, CRLF".
+		QString description() const;
+	};
+
+	// Checks UTF-8 piece by piece; a sequence may be split between pieces.
+	// Overlong forms, surrogates and code points past U+10FFFF are invalid.
+	class Utf8Validator {
+	public:
+		// False from the first invalid byte on.
+		bool feed(QByteArrayView bytes);
+		// Whether everything fed was valid and ended on a whole character.
+		bool finish() const { return m_valid && m_needed == 0; }
+
+	private:
+		int m_needed = 0;
+		uchar m_lower = 0x80;
+		uchar m_upper = 0xBF;
+		bool m_valid = true;
+	};
+
+	// The length of the leading run of bytes below 0x80.
+	qsizetype asciiPrefix(QByteArrayView bytes);
+	bool isValidUtf8(QByteArrayView bytes);
+
+	// From the start of a file: a byte order mark, or failing that the zero
+	// bytes of mostly-ASCII UTF-16. Anything else is taken for UTF-8 until a
+	// validator says otherwise. Sets *bomBytes to the length of the mark.
+	Encoding detect(QByteArrayView head, qsizetype* bomBytes = nullptr);
+	// For bytes that aren't UTF-8: Windows-1252 if any byte would be a C1
+	// control in Latin-1, which is what such bytes nearly always mean.
+	Encoding singleByteFallback(QByteArrayView bytes);
+
+	// Decodes single-byte text into out, which has room for bytes.size()
+	// characters, and returns the end of what was written.
+	QChar* decodeSingleByte(QByteArrayView bytes, Encoding encoding, QChar* out);
+	// Whether every character of text has a byte in the encoding.
+	bool canEncode(QStringView text, Encoding encoding);
+	// Appends text in a single-byte encoding; characters without a byte
+	// become '?'.
+	void encodeSingleByte(QStringView text, Encoding encoding, QByteArray* out);
+
+	// Counts the line breaks of text read in pieces.
+	class LineEndingCounter {
+	public:
+		void add(QStringView text);
+		// Sets the line ending of format from the counts.
+		void apply(Format* format) const;
+
+	private:
+		qsizetype m_lf = 0;
+		qsizetype m_crlf = 0;
+		// The last piece ended in '\r', which may begin a "\r\n".
+		bool m_afterCr = false;
+	};
+}
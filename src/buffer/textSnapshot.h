@@ -2,6 +2,7 @@
 #include <QString>
 #include <QtGlobal>
 #include <vector>
+#include <algorithm>
 
 class TextSnapshot {
 public:
@@ -20,6 +21,10 @@ public:
         if (line >=static_cast<qsizetype>(m_lineStarts.size())) line =  static_cast<qsizetype>(m_lineStarts.size()) - 1;
         return m_lineStarts[static_cast<std::size_t>(line)];
     }
+    qsizetype lineFromPosition(qsizetype pos) const {
+        auto it = std::upper_bound(m_lineStarts.begin(), m_lineStarts.end(), pos);
+        return std::max<qsizetype>(0, static_cast<qsizetype>(it - m_lineStarts.begin()) - 1);
+    }
     qsizetype positionFromLineCol(qsizetype line, qsizetype col) const {
         const qsizetype start = lineStart(line);
         const qsizetype end = (line + 1 < lineCount()) ? lineStart(line + 1) : size();
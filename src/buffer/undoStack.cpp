@@ -5,10 +5,16 @@
 void UndoStack::clear() {
 	m_done.clear();
 	m_redo.clear();
+	m_clean = 0;
+}
+
+void UndoStack::setClean() {
+	m_clean = qsizetype(m_done.size());
 }
 
 bool UndoStack::tryCoalesce(const Edit& edit) {
-	if (!m_coalesce || m_done.empty()) return false;
+	// The saved state must stay a step of its own.
+	if (!m_coalesce || m_done.empty() || isClean()) return false;
 	auto now = std::chrono::steady_clock::now();
 	if (m_lastTime.time_since_epoch().count() == 0) {
 		m_lastTime = now;
@@ -18,7 +24,8 @@ bool UndoStack::tryCoalesce(const Edit& edit) {
 	m_lastTime = now;
 
 	Edit& last = m_done.back();
-	if (last.type == Edit::Insert && edit.type == Edit::Insert) {
+	// Typing on after replacing a selection extends the replacement.
+	if ((last.type == Edit::Insert || last.type == Edit::Replace) && edit.type == Edit::Insert) {
 		if (edit.pos == last.pos +last.text.size()) {
 			last.text +=edit.text;
 			last.cursorAfter = edit.cursorAfter;
@@ -40,14 +47,21 @@ void UndoStack::push(const Edit& edit) {
 	if (!tryCoalesce(edit)) {
 		m_done.push_back(edit);
 	}
+	// A clean state left on the redo side is gone with it.
+	if (m_clean >= qsizetype(m_done.size())) {
+		m_clean = -1;
+	}
 	m_redo.clear();
 }
 
 static inline void apply(ITextBuffer& buf, const Edit& edit) {
 	if (edit.type == Edit::Insert) {
 		buf.insert(edit.pos, edit.text);
-	} else {
+	} else if (edit.type == Edit::Erase) {
 		buf.erase(edit.pos, edit.text.size());
+	} else {
+		buf.erase(edit.pos, edit.removed.size());
+		buf.insert(edit.pos, edit.text);
 	}
 }
 
@@ -58,11 +72,17 @@ static inline Edit inverseOf(const Edit& edit) {
         inv.pos = edit.pos;
         inv.text = edit.text;
         inv.cursorAfter = edit.pos;
-    } else {
+    } else if (edit.type == Edit::Erase) {
         inv.type = Edit::Insert;
         inv.pos = edit.pos;
         inv.text = edit.text;
         inv.cursorAfter = edit.pos + edit.text.size();
+    } else {
+        inv.type = Edit::Replace;
+        inv.pos = edit.pos;
+        inv.text = edit.removed;
+        inv.removed = edit.text;
+        inv.cursorAfter = edit.pos + edit.removed.size();
     }
     return inv;
 }
@@ -84,4 +104,14 @@ qsizetype UndoStack::redo(ITextBuffer& buf) {
     apply(buf, edit);
     m_done.push_back(edit);
     return edit.cursorAfter;
-}
\ No newline at end of file
+}
+
+qsizetype UndoStack::memoryUsage() const {
+	qsizetype bytes = qsizetype((m_done.capacity() + m_redo.capacity()) * sizeof(Edit));
+	for (const auto* edits : {&m_done, &m_redo}) {
+		for (const Edit& edit : *edits) {
+			bytes += (edit.text.capacity() + edit.removed.capacity()) * qsizetype(sizeof(QChar));
+		}
+	}
+	return bytes;
+}
@@ -6,10 +6,12 @@
 class ITextBuffer;
 
 struct Edit {
-	enum Type { Insert, Erase } type;
+	// Replace puts text where removed was, as one step.
+	enum Type { Insert, Erase, Replace } type;
 	qsizetype pos = 0;
 	QString text;
 	qsizetype cursorAfter = 0;
+	QString removed;
 };
 
 class UndoStack {
@@ -19,15 +21,26 @@ public:
 
 	bool canUndo() const { return !m_done.empty(); }
 	bool canRedo() const { return !m_redo.empty(); }
+	// The edits undo()/redo() would revert or reapply next.
+	const Edit* nextUndo() const { return m_done.empty() ? nullptr : &m_done.back(); }
+	const Edit* nextRedo() const { return m_redo.empty() ? nullptr : &m_redo.back(); }
 	qsizetype undo(ITextBuffer& buf);
 	qsizetype redo(ITextBuffer& buf);
 
 	void enableCoalescing(bool on) { m_coalesce = on; }
+	// Marks the current state as the one on disk; undoing or redoing back to
+	// it makes the text unmodified again.
+	void setClean();
+	bool isClean() const { return qsizetype(m_done.size()) == m_clean; }
+	// Bytes held by both histories, text included.
+	qsizetype memoryUsage() const;
 private:
 	bool tryCoalesce(const Edit& edit);
 
 	std::vector<Edit> m_done;
 	std::vector<Edit> m_redo;
 	bool m_coalesce = true;
+	// Edits done at the clean state, or -1 once no undo or redo reaches it.
+	qsizetype m_clean = 0;
 	std::chrono::steady_clock::time_point m_lastTime{};
 };
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "build_jobs.h"
+#include "build_output.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+
+namespace {
+struct ConfigurePreset {
+	QString binaryDir;
+	QString parent;
+};
+
+QString firstInherited(const QJsonValue& inherits) {
+	if (inherits.isArray()) {
+		const QJsonArray parents = inherits.toArray();
+		return parents.isEmpty() ? QString() : parents.first().toString();
+	}
+	return inherits.toString();
+}
+
+QString expandMacros(QString text, const QString& sourceDir, const QString& presetName) {
+	const QFileInfo source(sourceDir);
+	text.replace(QLatin1String("${sourceDir}"), sourceDir);
+	text.replace(QLatin1String("${sourceParentDir}"), source.absolutePath());
+	text.replace(QLatin1String("${sourceDirName}"), source.fileName());
+	text.replace(QLatin1String("${presetName}"), presetName);
+	text.replace(QLatin1String("${dollar}"), QLatin1String("$"));
+	return QDir::cleanPath(QDir(sourceDir).absoluteFilePath(text));
+}
+}
+
+std::vector<BuildPreset> readBuildPresets(const QString& sourceDir) {
+	QHash<QString, ConfigurePreset> configures;
+	std::vector<std::pair<QString, QString>> builds;
+	for (const char* name : {"CMakePresets.json", "CMakeUserPresets.json"}) {
+		QFile file(QDir(sourceDir).filePath(QLatin1String(name)));
+		if (!file.open(QIODevice::ReadOnly)) continue;
+		const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+		for (const QJsonValue& value : root.value(QLatin1String("configurePresets")).toArray()) {
+			const QJsonObject preset = value.toObject();
+			configures.insert(preset.value(QLatin1String("name")).toString(),
+				{preset.value(QLatin1String("binaryDir")).toString(), firstInherited(preset.value(QLatin1String("inherits")))});
+		}
+		for (const QJsonValue& value : root.value(QLatin1String("buildPresets")).toArray()) {
+			const QJsonObject preset = value.toObject();
+			if (preset.value(QLatin1String("hidden")).toBool()) continue;
+			builds.emplace_back(preset.value(QLatin1String("name")).toString(),
+				preset.value(QLatin1String("configurePreset")).toString());
+		}
+	}
+
+	std::vector<BuildPreset> presets;
+	presets.reserve(builds.size());
+	for (const auto& [name, configure] : builds) {
+		// binaryDir may come from a parent; the depth cap guards against cycles.
+		QString binaryDir;
+		QString current = configure;
+		for (int depth = 0; depth < 16 && binaryDir.isEmpty() && configures.contains(current); ++depth) {
+			const ConfigurePreset& preset = configures[current];
+			binaryDir = preset.binaryDir;
+			if (binaryDir.isEmpty()) current = preset.parent;
+		}
+		if (!binaryDir.isEmpty()) binaryDir = expandMacros(binaryDir, sourceDir, configure);
+		presets.push_back({name, binaryDir});
+	}
+	return presets;
+}
+
+QStringList BuildRequest::arguments() const {
+	QStringList args{"--build"};
+	if (preset.isEmpty()) {
+		args << buildDir;
+	} else {
+		args << "--preset" << preset;
+	}
+	if (!config.isEmpty()) {
+		args << "--config" << config;
+	}
+	if (parallel > 0) {
+		args << "--parallel" << QString::number(parallel);
+	}
+	return args;
+}
+
+BuildJobManager::BuildJobManager(BuildOutput* output, QObject* parent) : QObject(parent), m_output(output) {
+	m_directories = QSettings().value("build/directories").toStringList();
+	connect(m_output, &BuildOutput::finished, this, &BuildJobManager::onFinished);
+	connect(m_output, &BuildOutput::failedToStart, this, &BuildJobManager::onFailedToStart);
+}
+
+void BuildJobManager::rememberDirectory(const QString& dir) {
+	if (dir.isEmpty()) return;
+	m_directories.removeAll(dir);
+	m_directories.prepend(dir);
+	while (m_directories.size() > kMaxDirectories) {
+		m_directories.removeLast();
+	}
+	saveDirectories();
+	emit directoriesChanged();
+}
+
+void BuildJobManager::forgetDirectory(const QString& dir) {
+	if (m_directories.removeAll(dir) == 0) return;
+	saveDirectories();
+	emit directoriesChanged();
+}
+
+void BuildJobManager::saveDirectories() const {
+	QSettings().setValue("build/directories", m_directories);
+}
+
+bool BuildJobManager::isRunning() const {
+	return m_output->isRunning() || m_queued.has_value();
+}
+
+void BuildJobManager::start(const BuildRequest& request) {
+	if (!request.isValid()) return;
+	if (request.preset.isEmpty()) {
+		rememberDirectory(request.buildDir);
+	}
+	if (m_output->isRunning()) {
+		m_queued = request;
+		cancel();
+		return;
+	}
+	launch(request);
+}
+
+void BuildJobManager::cancel() {
+	if (!m_output->isRunning()) return;
+	m_cancelled = true;
+	m_output->cancel();
+}
+
+void BuildJobManager::restart() {
+	if (hasLastRequest()) {
+		start(m_current);
+	}
+}
+
+void BuildJobManager::launch(const BuildRequest& request) {
+	m_current = request;
+	m_cancelled = false;
+	const QString program = "cmake";
+	const QStringList args = request.arguments();
+	m_output->clear();
+	m_output->appendMessage(QString("Running: %1 %2").arg(program, args.join(' ')));
+	m_output->appendMessage(QString());
+	m_clock.start();
+	m_output->start(program, args, request.workingDirectory(), request.buildDir);
+	emit runningChanged(true);
+}
+
+void BuildJobManager::onFinished(int exitCode, bool crashed) {
+	const double seconds = double(m_clock.elapsed()) / 1000.0;
+	const bool success = !crashed && exitCode == 0;
+	m_output->appendMessage(QString());
+	if (m_cancelled) {
+		m_output->appendMessage(QString("Build cancelled after %1 s").arg(seconds, 0, 'f', 1));
+	} else if (success) {
+		m_output->appendMessage(QString("Build finished successfully in %1 s").arg(seconds, 0, 'f', 1));
+	} else {
+		m_output->appendMessage(QString("Build failed after %1 s").arg(seconds, 0, 'f', 1));
+	}
+	emit jobFinished(success && !m_cancelled);
+	startQueued();
+}
+
+void BuildJobManager::onFailedToStart(const QString& error) {
+	m_output->appendMessage(QString("Could not start cmake: %1").arg(error));
+	emit jobFinished(false);
+	startQueued();
+}
+
+void BuildJobManager::startQueued() {
+	if (!m_queued) {
+		emit runningChanged(false);
+		return;
+	}
+	const BuildRequest next = std::move(*m_queued);
+	m_queued.reset();
+	launch(next);
+}
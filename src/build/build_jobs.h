@@ -0,0 +1,74 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QObject>
+#include <QStringList>
+#include <optional>
+#include <vector>
+
+class BuildOutput;
+
+struct BuildPreset {
+	QString name;
+	// Build tree of the preset's configure preset; empty if it can't be resolved.
+	QString binaryDir;
+};
+
+// Build presets of a source tree from CMakePresets.json and CMakeUserPresets.json.
+std::vector<BuildPreset> readBuildPresets(const QString& sourceDir);
+
+// One `cmake --build` invocation. With a preset cmake runs in sourceDir and
+// the preset picks the tree; otherwise buildDir is passed directly.
+struct BuildRequest {
+	QString buildDir;
+	QString sourceDir;
+	QString preset;
+	QString config;
+	// --parallel N; 0 leaves it to the generator.
+	int parallel = 0;
+
+	bool isValid() const { return preset.isEmpty() ? !buildDir.isEmpty() : !sourceDir.isEmpty(); }
+	QStringList arguments() const;
+	QString workingDirectory() const { return preset.isEmpty() ? buildDir : sourceDir; }
+};
+
+// Owns the build lifecycle on top of BuildOutput: at most one build runs, a
+// new request cancels the running one and starts once it has exited, and the
+// build directories used are remembered across sessions.
+class BuildJobManager : public QObject {
+	Q_OBJECT
+public:
+	static constexpr int kMaxDirectories = 10;
+
+	explicit BuildJobManager(BuildOutput* output, QObject* parent = nullptr);
+
+	const QStringList& directories() const { return m_directories; }
+	void rememberDirectory(const QString& dir);
+	void forgetDirectory(const QString& dir);
+
+	void start(const BuildRequest& request);
+	void cancel();
+	// Runs the last request again, cancelling it first if it is still running.
+	void restart();
+	bool isRunning() const;
+	bool hasLastRequest() const { return m_current.isValid(); }
+	const BuildRequest& lastRequest() const { return m_current; }
+
+signals:
+	void runningChanged(bool running);
+	void directoriesChanged();
+	void jobFinished(bool success);
+
+private:
+	void launch(const BuildRequest& request);
+	void onFinished(int exitCode, bool crashed);
+	void onFailedToStart(const QString& error);
+	void startQueued();
+	void saveDirectories() const;
+
+	BuildOutput* m_output;
+	QStringList m_directories;
+	BuildRequest m_current;
+	std::optional<BuildRequest> m_queued;
+	QElapsedTimer m_clock;
+	bool m_cancelled = false;
+};
@@ -0,0 +1,263 @@
+#include "build_output.h"
+#include "../util/trace.h"
+#include <QProcess>
+#include <QStringDecoder>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace {
+// Longer lines are broken up so one runaway line cannot grow without bound.
+constexpr qsizetype kMaxLineLength = 64 * 1024;
+}
+
+struct BuildOutput::State {
+	QProcess* process = nullptr;
+	QStringDecoder decoder{QStringDecoder::System};
+	QString partial;
+	DiagnosticParser parser;
+	std::atomic<qsizetype> maxLines{0};
+
+	std::deque<QString> split(const QByteArray& bytes);
+	std::deque<QString> finish();
+};
+
+std::deque<QString> BuildOutput::State::split(const QByteArray& bytes) {
+	std::deque<QString> lines;
+	const QString text = decoder.decode(bytes);
+	qsizetype start = 0;
+	for (qsizetype nl = text.indexOf(u'\n'); nl >= 0; nl = text.indexOf(u'\n', start)) {
+		partial += QStringView(text).mid(start, nl - start);
+		if (partial.endsWith(u'\r')) partial.chop(1);
+		lines.push_back(std::move(partial));
+		partial = QString();
+		start = nl + 1;
+	}
+	partial += QStringView(text).mid(start);
+	if (partial.size() > kMaxLineLength) {
+		lines.push_back(std::move(partial));
+		partial = QString();
+	}
+	return lines;
+}
+
+std::deque<QString> BuildOutput::State::finish() {
+	std::deque<QString> lines;
+	if (!partial.isEmpty()) {
+		lines.push_back(std::move(partial));
+		partial = QString();
+	}
+	decoder.resetState();
+	return lines;
+}
+
+BuildOutput::BuildOutput(QObject* parent) : QObject(parent), m_state(new State) {
+	m_state->maxLines = m_lines.capacity();
+	m_thread = new QThread(this);
+	m_thread->setObjectName(QStringLiteral("build-output"));
+	m_worker = new QObject;
+	m_worker->moveToThread(m_thread);
+	m_thread->start();
+
+	m_frameTimer = new QTimer(this);
+	m_frameTimer->setSingleShot(true);
+	m_frameTimer->setInterval(kFrameMs);
+	connect(m_frameTimer, &QTimer::timeout, this, &BuildOutput::flush);
+}
+
+BuildOutput::~BuildOutput() {
+	State* state = m_state.get();
+	QMetaObject::invokeMethod(m_worker, [state] {
+		if (state->process) {
+			state->process->disconnect();
+			state->process->kill();
+			state->process->waitForFinished(1000);
+			delete state->process;
+			state->process = nullptr;
+		}
+	}, Qt::BlockingQueuedConnection);
+	m_thread->quit();
+	m_thread->wait();
+	delete m_worker;
+}
+
+void BuildOutput::start(const QString& program, const QStringList& args, const QString& workingDir, const QString& outputDir) {
+	if (m_running) return;
+	m_running = true;
+	State* state = m_state.get();
+	QObject* worker = m_worker;
+	const QString baseDir = outputDir.isEmpty() ? workingDir : outputDir;
+	QMetaObject::invokeMethod(m_worker, [this, state, worker, program, args, workingDir, baseDir] {
+		auto* process = new QProcess(worker);
+		state->process = process;
+		state->partial.clear();
+		state->decoder.resetState();
+		state->parser.reset();
+		state->parser.setBaseDir(baseDir);
+		process->setWorkingDirectory(workingDir);
+		process->setProcessChannelMode(QProcess::MergedChannels);
+		QObject::connect(process, &QProcess::readyReadStandardOutput, process, [this, state, process] {
+			IDE_TRACE_SPAN("BuildOutput::readyRead");
+			post(state->split(process->readAllStandardOutput()), true);
+		});
+		QObject::connect(process, &QProcess::errorOccurred, process, [this, state, process](QProcess::ProcessError error) {
+			if (error != QProcess::FailedToStart) return;
+			const QString message = process->errorString();
+			state->process = nullptr;
+			process->deleteLater();
+			QMetaObject::invokeMethod(this, [this, message] {
+				m_running = false;
+				emit failedToStart(message);
+			}, Qt::QueuedConnection);
+		});
+		QObject::connect(process, &QProcess::finished, process, [this, state, process](int code, QProcess::ExitStatus status) {
+			post(state->split(process->readAllStandardOutput()), true);
+			post(state->finish(), true, true);
+			state->process = nullptr;
+			process->deleteLater();
+			const bool crashed = status == QProcess::CrashExit;
+			QMetaObject::invokeMethod(this, [this, code, crashed] {
+				flush();
+				m_running = false;
+				emit finished(code, crashed);
+			}, Qt::QueuedConnection);
+		});
+		process->start(program, args);
+		if (process->state() != QProcess::NotRunning) {
+			QMetaObject::invokeMethod(this, [this] { emit started(); }, Qt::QueuedConnection);
+		}
+	}, Qt::QueuedConnection);
+}
+
+void BuildOutput::cancel() {
+	State* state = m_state.get();
+	QMetaObject::invokeMethod(m_worker, [state] {
+		QProcess* process = state->process;
+		if (!process) return;
+		process->terminate();
+		QTimer::singleShot(3000, process, [process] { process->kill(); });
+	}, Qt::QueuedConnection);
+}
+
+void BuildOutput::appendMessage(const QString& line) {
+	post({line});
+}
+
+void BuildOutput::post(std::deque<QString> lines, bool parse, bool last) {
+	if (lines.empty() && !last) return;
+	IDE_TRACE_SPAN("BuildOutput::post");
+	{
+		std::lock_guard lock(m_pendingMutex);
+		const qsizetype max = m_state->maxLines;
+		if (parse) {
+			// Parsed under the lock so output lines get the same absolute index
+			// the ring will give them, even with our own messages interleaved.
+			DiagnosticParser& parser = m_state->parser;
+			qint64 index = m_postedLines;
+			for (const QString& line : lines) {
+				parser.feed(line, index++, m_pendingDiagnostics);
+			}
+			if (last) parser.finish(m_pendingDiagnostics);
+			m_pendingDetachedNotes += parser.takeDetachedNotes();
+		}
+		m_postedLines += qint64(lines.size());
+		for (QString& line : lines) {
+			m_pending.push_back(std::move(line));
+		}
+		// If the GUI falls behind, lines the ring would evict anyway are dropped here.
+		while (qsizetype(m_pending.size()) > max) {
+			m_pending.pop_front();
+			++m_pendingSkipped;
+		}
+	}
+	if (!m_flushPending.exchange(true)) {
+		QMetaObject::invokeMethod(this, [this] { scheduleFlush(); }, Qt::QueuedConnection);
+	}
+}
+
+void BuildOutput::scheduleFlush() {
+	if (!m_frameTimer->isActive()) {
+		m_frameTimer->start();
+	}
+}
+
+void BuildOutput::flush() {
+	IDE_TRACE_SPAN("BuildOutput::flush");
+	m_flushPending = false;
+	std::deque<QString> batch;
+	std::vector<Diagnostic> diagnostics;
+	int detachedNotes = 0;
+	qint64 skipped = 0;
+	{
+		std::lock_guard lock(m_pendingMutex);
+		batch.swap(m_pending);
+		diagnostics.swap(m_pendingDiagnostics);
+		detachedNotes = std::exchange(m_pendingDetachedNotes, 0);
+		skipped = std::exchange(m_pendingSkipped, 0);
+	}
+	flushDiagnostics(diagnostics, detachedNotes);
+	// The ring may have shrunk since the batch was queued; lines it can't
+	// hold never reach it.
+	const qsizetype excess = qsizetype(batch.size()) - m_lines.capacity();
+	if (excess > 0) {
+		batch.erase(batch.begin(), batch.begin() + excess);
+		skipped += excess;
+	}
+	if (skipped > 0) {
+		const qsizetype held = m_lines.size();
+		if (held > 0) emit linesAboutToBeRemoved(held);
+		m_lines.discard(skipped);
+		if (held > 0) emit linesRemoved();
+	}
+	IDE_TRACE_COUNTER("build lines per frame", batch.size());
+	if (batch.empty()) return;
+	const qsizetype removed = m_lines.overflow(qsizetype(batch.size()));
+	if (removed > 0) {
+		emit linesAboutToBeRemoved(removed);
+		m_lines.dropFront(removed);
+		emit linesRemoved();
+	}
+	emit linesAboutToBeAppended(qsizetype(batch.size()));
+	m_lines.append(batch);
+	emit linesAppended();
+}
+
+void BuildOutput::flushDiagnostics(std::vector<Diagnostic>& diagnostics, int detachedNotes) {
+	IDE_TRACE_SPAN("BuildOutput::flushDiagnostics");
+	// Notes continuing the previous frame's last diagnostic.
+	if (detachedNotes > 0 && !m_diagnostics.empty()) {
+		m_diagnostics.back().notes += detachedNotes;
+		emit diagnosticChanged(qsizetype(m_diagnostics.size()) - 1);
+	}
+	const qsizetype room = kMaxDiagnostics - qsizetype(m_diagnostics.size());
+	const qsizetype count = std::min(room, qsizetype(diagnostics.size()));
+	if (count <= 0) return;
+	emit diagnosticsAboutToBeAppended(count);
+	m_diagnostics.insert(m_diagnostics.end(), std::make_move_iterator(diagnostics.begin()),
+		std::make_move_iterator(diagnostics.begin() + count));
+	emit diagnosticsAppended();
+}
+
+void BuildOutput::clear() {
+	{
+		std::lock_guard lock(m_pendingMutex);
+		m_pending.clear();
+		m_pendingDiagnostics.clear();
+		m_pendingDetachedNotes = 0;
+		m_pendingSkipped = 0;
+		m_postedLines = 0;
+	}
+	emit aboutToReset();
+	m_lines.clear();
+	m_diagnostics.clear();
+	emit reset();
+}
+
+void BuildOutput::setMaxLines(qsizetype lines) {
+	emit aboutToReset();
+	m_lines.setCapacity(lines);
+	m_state->maxLines = m_lines.capacity();
+	emit reset();
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "diagnostics.h"
+#include "line_ring.h"
+#include <QObject>
+#include <QStringList>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class QThread;
+class QTimer;
+
+// Runs a build process on a worker thread. Output is decoded and split into
+// lines there; the GUI thread moves finished lines into a capped ring at most
+// once per frame, so a noisy build costs one model update per frame no
+// matter how fast it writes. Compiler diagnostics are parsed from the same
+// lines on the worker and delivered with them.
+class BuildOutput : public QObject {
+	Q_OBJECT
+public:
+	static constexpr int kFrameMs = 16;
+	static constexpr qsizetype kMaxDiagnostics = 50000;
+
+	explicit BuildOutput(QObject* parent = nullptr);
+	~BuildOutput() override;
+
+	// Relative paths in diagnostics are resolved against outputDir, or
+	// workingDir when it is empty.
+	void start(const QString& program, const QStringList& args, const QString& workingDir, const QString& outputDir = QString());
+	void cancel();
+	bool isRunning() const { return m_running; }
+
+	// Queues a line of our own (headers, status) behind any pending output.
+	void appendMessage(const QString& line);
+	void clear();
+
+	void setMaxLines(qsizetype lines);
+	qsizetype maxLines() const { return m_lines.capacity(); }
+	const LineRing& lines() const { return m_lines; }
+	// Diagnostics of the current run; outputLine is an absolute line number
+	// (compare with lines().firstLine()).
+	const std::vector<Diagnostic>& diagnostics() const { return m_diagnostics; }
+
+signals:
+	void started();
+	void finished(int exitCode, bool crashed);
+	void failedToStart(const QString& error);
+
+	void aboutToReset();
+	void reset();
+	void linesAboutToBeRemoved(qsizetype count);
+	void linesRemoved();
+	void linesAboutToBeAppended(qsizetype count);
+	void linesAppended();
+	void diagnosticsAboutToBeAppended(qsizetype count);
+	void diagnosticsAppended();
+	void diagnosticChanged(qsizetype index);
+
+private:
+	struct State;
+
+	void post(std::deque<QString> lines, bool parse = false, bool last = false);
+	void scheduleFlush();
+	void flush();
+	void flushDiagnostics(std::vector<Diagnostic>& diagnostics, int detachedNotes);
+
+	QThread* m_thread = nullptr;
+	QObject* m_worker = nullptr;
+	std::unique_ptr<State> m_state;
+	QTimer* m_frameTimer = nullptr;
+
+	std::mutex m_pendingMutex;
+	std::deque<QString> m_pending;
+	std::vector<Diagnostic> m_pendingDiagnostics;
+	int m_pendingDetachedNotes = 0;
+	qint64 m_postedLines = 0;
+	qint64 m_pendingSkipped = 0;
+	std::atomic<bool> m_flushPending{false};
+
+	LineRing m_lines;
+	std::vector<Diagnostic> m_diagnostics;
+	bool m_running = false;
+};
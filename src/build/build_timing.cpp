@@ -0,0 +1,158 @@
+#include "build_timing.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <algorithm>
+
+namespace {
+struct LogStep {
+	qint64 start = 0;
+	qint64 end = 0;
+	QString output;
+};
+
+struct Total {
+	double ms = 0;
+	int count = 0;
+};
+
+bool readNinjaLog(const QString& path, std::vector<LogStep>& steps, QString& error) {
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		error = QStringLiteral("No .ninja_log in %1 (timing needs the Ninja generator)").arg(QFileInfo(path).absolutePath());
+		return false;
+	}
+	QSet<QByteArray> hashes;
+	qint64 lastEnd = 0;
+	while (!file.atEnd()) {
+		const QByteArray line = file.readLine().trimmed();
+		if (line.isEmpty() || line.startsWith('#')) continue;
+		const QList<QByteArray> fields = line.split('\t');
+		if (fields.size() < 5) continue;
+		LogStep step{fields[0].toLongLong(), fields[1].toLongLong(), QString::fromUtf8(fields[3])};
+		// Each run is appended to the log with times restarting from zero;
+		// a step that ends before the previous one begins a newer run.
+		if (step.end < lastEnd) {
+			steps.clear();
+			hashes.clear();
+		}
+		lastEnd = step.end;
+		// A command with several outputs is logged once per output.
+		if (hashes.contains(fields[4])) continue;
+		hashes.insert(fields[4]);
+		steps.push_back(std::move(step));
+	}
+	return true;
+}
+
+bool isObject(const QString& output) {
+	return output.endsWith(u".o") || output.endsWith(u".obj");
+}
+
+// Objects are written to CMakeFiles/<target>.dir/<source>.o.
+QString targetOf(const QString& output) {
+	const qsizetype dir = output.indexOf(u".dir/");
+	if (dir <= 0) return QFileInfo(output).fileName();
+	const qsizetype slash = output.lastIndexOf(u'/', dir);
+	return output.mid(slash + 1, dir - slash - 1);
+}
+
+QString stripExtension(const QString& output) {
+	return output.left(output.lastIndexOf(u'.'));
+}
+
+void readTimeTrace(const QString& path, QHash<QString, Total>& headers) {
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) return;
+	const QJsonArray events = QJsonDocument::fromJson(file.readAll()).object().value(QLatin1String("traceEvents")).toArray();
+	QSet<QString> seen;
+	for (const QJsonValue& value : events) {
+		const QJsonObject event = value.toObject();
+		if (event.value(QLatin1String("name")).toString() != QLatin1String("Source")) continue;
+		const QString header = QDir::cleanPath(event.value(QLatin1String("args")).toObject().value(QLatin1String("detail")).toString());
+		if (header.isEmpty()) continue;
+		Total& total = headers[header];
+		// "Source" spans are inclusive of nested includes and given in microseconds.
+		total.ms += event.value(QLatin1String("dur")).toDouble() / 1000.0;
+		if (!seen.contains(header)) {
+			seen.insert(header);
+			++total.count;
+		}
+	}
+}
+
+std::vector<TimingEntry> sorted(const QHash<QString, Total>& totals, bool nameFromPath) {
+	std::vector<TimingEntry> entries;
+	entries.reserve(std::size_t(totals.size()));
+	for (auto it = totals.begin(); it != totals.end(); ++it) {
+		const QString name = nameFromPath ? QFileInfo(it.key()).fileName() : it.key();
+		entries.push_back({name, it.key(), qint64(it->ms), it->count});
+	}
+	std::sort(entries.begin(), entries.end(), [](const TimingEntry& a, const TimingEntry& b) { return a.ms > b.ms; });
+	return entries;
+}
+}
+
+BuildTimingReport collectBuildTiming(const QString& buildDir) {
+	BuildTimingReport report;
+	std::vector<LogStep> steps;
+	if (!readNinjaLog(QDir(buildDir).filePath(".ninja_log"), steps, report.error)) {
+		return report;
+	}
+	if (steps.empty()) {
+		report.error = QStringLiteral("The last build did not run any steps");
+		return report;
+	}
+
+	QHash<QString, Total> targets;
+	QHash<QString, Total> headers;
+	qint64 first = steps.front().start;
+	qint64 last = 0;
+	for (const LogStep& step : steps) {
+		first = std::min(first, step.start);
+		last = std::max(last, step.end);
+		const qint64 ms = step.end - step.start;
+		Total& target = targets[targetOf(step.output)];
+		target.ms += double(ms);
+		++target.count;
+		if (!isObject(step.output)) continue;
+
+		const QString base = stripExtension(step.output);
+		const qsizetype dir = base.indexOf(u".dir/");
+		const QString source = dir > 0 ? base.mid(dir + 5) : QFileInfo(base).fileName();
+		report.units.push_back({source, QDir(buildDir).filePath(step.output), ms, 1});
+		readTimeTrace(QDir(buildDir).filePath(base + ".json"), headers);
+	}
+	report.wallMs = last - first;
+	report.targets = sorted(targets, false);
+	report.headers = sorted(headers, true);
+	std::sort(report.units.begin(), report.units.end(), [](const TimingEntry& a, const TimingEntry& b) { return a.ms > b.ms; });
+	return report;
+}
+
+BuildTimingService::BuildTimingService(QObject* parent) : QObject(parent) {
+}
+
+BuildTimingService::~BuildTimingService() {
+	m_tasks.stop();
+}
+
+void BuildTimingService::collect(const QString& buildDir) {
+	const quint64 token = ++m_token;
+	m_buildDir = buildDir;
+	m_collecting = true;
+	m_tasks.submit([this, buildDir, token] {
+		BuildTimingReport report = collectBuildTiming(buildDir);
+		QMetaObject::invokeMethod(this, [this, report = std::move(report), token]() mutable {
+			if (token != m_token) return;
+			m_report = std::move(report);
+			m_collecting = false;
+			emit ready();
+		}, Qt::QueuedConnection);
+	});
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <vector>
+#include "../util/task_scheduler.h"
+
+
+struct TimingEntry {
+	QString name;
+	QString path;
+	qint64 ms = 0;
+	// Steps folded into a target, or translation units that parsed a header.
+	int count = 1;
+};
+
+struct BuildTimingReport {
+	std::vector<TimingEntry> targets;
+	std::vector<TimingEntry> units;
+	std::vector<TimingEntry> headers;
+	// Wall time of the last build in .ninja_log.
+	qint64 wallMs = 0;
+	QString error;
+};
+
+// Reads the most recent build from <buildDir>/.ninja_log, aggregates steps by
+// CMake target and picks up the clang -ftime-trace JSON written next to each
+// object file to rank headers by the parse time they cost across the build.
+BuildTimingReport collectBuildTiming(const QString& buildDir);
+
+// Runs collectBuildTiming on the task scheduler; trace files can run to
+// megabytes per translation unit.
+class BuildTimingService : public QObject {
+	Q_OBJECT
+public:
+	explicit BuildTimingService(QObject* parent = nullptr);
+	~BuildTimingService() override;
+
+	void collect(const QString& buildDir);
+	const BuildTimingReport& report() const { return m_report; }
+	QString buildDir() const { return m_buildDir; }
+	bool isCollecting() const { return m_collecting; }
+
+signals:
+	void ready();
+
+private:
+	TaskSequence m_tasks{TaskPriority::Background};
+	BuildTimingReport m_report;
+	QString m_buildDir;
+	quint64 m_token = 0;
+	bool m_collecting = false;
+};
@@ -0,0 +1,264 @@
+#include "diagnostics.h"
+#include <QDir>
+#include <QFileInfo>
+#include <utility>
+
+namespace {
+struct Marker {
+	QStringView text;
+	Diagnostic::Severity severity;
+};
+
+bool parseNumber(QStringView text, int& value) {
+	if (text.isEmpty() || text.size() > 9) return false;
+	value = 0;
+	for (const QChar c : text) {
+		if (!c.isDigit()) return false;
+		value = value * 10 + c.digitValue();
+	}
+	return true;
+}
+
+bool looksLikePath(QStringView text) {
+	return text.contains(u'/') || text.contains(u'\\') || text.contains(u'.');
+}
+}
+
+void DiagnosticParser::setBaseDir(const QString& dir) {
+	m_baseDir = dir;
+	m_resolved.clear();
+}
+
+void DiagnosticParser::reset() {
+	m_resolved.clear();
+	m_seen.clear();
+	m_cmake.reset();
+	m_haveLast = false;
+	m_suppressNotes = false;
+	m_detachedNotes = 0;
+}
+
+int DiagnosticParser::takeDetachedNotes() {
+	return std::exchange(m_detachedNotes, 0);
+}
+
+QString DiagnosticParser::resolve(QStringView file) {
+	if (file.isEmpty()) return {};
+	const QString key = file.toString();
+	auto it = m_resolved.constFind(key);
+	if (it != m_resolved.constEnd()) return *it;
+	QString path = QDir::cleanPath(QDir::fromNativeSeparators(key));
+	if (QFileInfo(path).isRelative() && !m_baseDir.isEmpty()) {
+		path = QDir::cleanPath(QDir(m_baseDir).absoluteFilePath(path));
+	}
+	m_resolved.insert(key, path);
+	return path;
+}
+
+void DiagnosticParser::feed(QStringView line, qint64 lineIndex, std::vector<Diagnostic>& out) {
+	if (m_cmake) {
+		// CMake prints the location first and the message indented below it.
+		const QStringView text = line.trimmed();
+		if (text.isEmpty()) return;
+		if (line.startsWith(u"  ")) {
+			m_cmake->message = text.toString();
+			emitDiagnostic(std::move(*m_cmake), out);
+			m_cmake.reset();
+			return;
+		}
+		emitDiagnostic(std::move(*m_cmake), out);
+		m_cmake.reset();
+	}
+
+	const bool candidate = line.contains(u"error", Qt::CaseInsensitive)
+		|| line.contains(u"warning", Qt::CaseInsensitive)
+		|| line.contains(u"note")
+		|| line.contains(u"required from")
+		|| line.contains(u"undefined reference");
+	if (!candidate) return;
+
+	Diagnostic diag;
+	if (parseCMake(line, diag)) {
+		diag.outputLine = lineIndex;
+		if (diag.message.isEmpty()) {
+			m_cmake = std::move(diag);
+		} else {
+			emitDiagnostic(std::move(diag), out);
+		}
+		return;
+	}
+	if (parseGnu(line, diag) || parseMsvc(line, diag) || parseLinker(line, diag)) {
+		if (diag.severity == Diagnostic::Note) {
+			addNote(out);
+			return;
+		}
+		diag.outputLine = lineIndex;
+		emitDiagnostic(std::move(diag), out);
+		return;
+	}
+	if (line.contains(u": required from ") || line.contains(u": required by ")) {
+		addNote(out);
+	}
+}
+
+void DiagnosticParser::finish(std::vector<Diagnostic>& out) {
+	if (m_cmake) {
+		emitDiagnostic(std::move(*m_cmake), out);
+		m_cmake.reset();
+	}
+}
+
+void DiagnosticParser::emitDiagnostic(Diagnostic diag, std::vector<Diagnostic>& out) {
+	diag.file = resolve(diag.file);
+	// The same header warning is reported once per translation unit; keep the first.
+	const QString key = QString::number(diag.severity) + u'\x1f' + diag.file + u'\x1f'
+		+ QString::number(diag.line) + u':' + QString::number(diag.column) + u'\x1f' + diag.message;
+	if (m_seen.contains(key)) {
+		m_suppressNotes = true;
+		return;
+	}
+	m_seen.insert(key);
+	m_suppressNotes = false;
+	m_haveLast = true;
+	out.push_back(std::move(diag));
+}
+
+void DiagnosticParser::addNote(std::vector<Diagnostic>& out) {
+	if (m_suppressNotes || !m_haveLast) return;
+	if (!out.empty()) {
+		++out.back().notes;
+	} else {
+		++m_detachedNotes;
+	}
+}
+
+bool DiagnosticParser::parseGnu(QStringView line, Diagnostic& diag) const {
+	static const Marker markers[] = {
+		{u": fatal error: ", Diagnostic::Error},
+		{u": error: ", Diagnostic::Error},
+		{u": warning: ", Diagnostic::Warning},
+		{u": note: ", Diagnostic::Note},
+	};
+	for (const Marker& marker : markers) {
+		const qsizetype at = line.indexOf(marker.text);
+		if (at <= 0) continue;
+		QStringView location = line.left(at);
+		diag.severity = marker.severity;
+		diag.message = line.mid(at + marker.text.size()).trimmed().toString();
+
+		// Parse from the right so drive letters in Windows paths survive.
+		int numbers[2] = {0, 0};
+		int found = 0;
+		while (found < 2) {
+			const qsizetype colon = location.lastIndexOf(u':');
+			if (colon <= 0 || !parseNumber(location.mid(colon + 1), numbers[found])) break;
+			location = location.left(colon);
+			++found;
+		}
+		if (found == 2) {
+			diag.line = numbers[1];
+			diag.column = numbers[0];
+		} else if (found == 1) {
+			diag.line = numbers[0];
+		}
+		if (found > 0 || looksLikePath(location)) {
+			diag.file = location.trimmed().toString();
+		}
+		return true;
+	}
+	return false;
+}
+
+bool DiagnosticParser::parseMsvc(QStringView line, Diagnostic& diag) const {
+	static const Marker markers[] = {
+		{u"): fatal error ", Diagnostic::Error},
+		{u"): error ", Diagnostic::Error},
+		{u"): warning ", Diagnostic::Warning},
+		{u"): note: ", Diagnostic::Note},
+		{u" : fatal error ", Diagnostic::Error},
+		{u" : error ", Diagnostic::Error},
+		{u" : warning ", Diagnostic::Warning},
+	};
+	for (const Marker& marker : markers) {
+		const qsizetype at = line.indexOf(marker.text);
+		if (at <= 0) continue;
+		diag.severity = marker.severity;
+		QStringView message = line.mid(at + marker.text.size()).trimmed();
+		// MSBuild appends the project in brackets.
+		if (message.endsWith(u']')) {
+			const qsizetype bracket = message.lastIndexOf(u" [");
+			if (bracket > 0) message = message.left(bracket);
+		}
+		diag.message = message.toString();
+
+		if (marker.text.startsWith(u')')) {
+			QStringView location = line.left(at);
+			const qsizetype paren = location.lastIndexOf(u'(');
+			if (paren <= 0) return false;
+			const QStringView numbers = location.mid(paren + 1);
+			const qsizetype comma = numbers.indexOf(u',');
+			if (!parseNumber(comma < 0 ? numbers : numbers.left(comma), diag.line)) return false;
+			if (comma >= 0) parseNumber(numbers.mid(comma + 1), diag.column);
+			location = location.left(paren).trimmed();
+			// Strip the "12>" project prefix of parallel MSBuild output.
+			const qsizetype prefix = location.indexOf(u'>');
+			if (prefix > 0 && prefix < 5) {
+				int project = 0;
+				if (parseNumber(location.left(prefix), project)) location = location.mid(prefix + 1);
+			}
+			diag.file = location.toString();
+		}
+		return true;
+	}
+	return false;
+}
+
+bool DiagnosticParser::parseCMake(QStringView line, Diagnostic& diag) const {
+	QStringView rest;
+	if (line.startsWith(u"CMake Error")) {
+		diag.severity = Diagnostic::Error;
+		rest = line.mid(11);
+	} else if (line.startsWith(u"CMake Warning")) {
+		diag.severity = Diagnostic::Warning;
+		rest = line.mid(13);
+	} else {
+		return false;
+	}
+	if (rest.startsWith(u" (dev)")) rest = rest.mid(6);
+	if (rest.startsWith(u": ")) {
+		diag.message = rest.mid(2).trimmed().toString();
+		return true;
+	}
+	if (!rest.startsWith(u" at ")) return false;
+	QStringView location = rest.mid(4);
+	const qsizetype paren = location.lastIndexOf(u" (");
+	if (paren > 0) location = location.left(paren);
+	if (location.endsWith(u':')) location.chop(1);
+	const qsizetype colon = location.lastIndexOf(u':');
+	if (colon > 0 && parseNumber(location.mid(colon + 1), diag.line)) {
+		location = location.left(colon);
+	}
+	diag.file = location.toString();
+	return true;
+}
+
+bool DiagnosticParser::parseLinker(QStringView line, Diagnostic& diag) const {
+	const qsizetype at = line.indexOf(u": undefined reference to ");
+	if (at <= 0) return false;
+	diag.severity = Diagnostic::Error;
+	diag.message = line.mid(at + 2).toString();
+	QStringView location = line.left(at);
+	// "/usr/bin/ld: main.cpp:(.text+0x1e)" - drop the tool and the section.
+	const qsizetype tool = location.lastIndexOf(u": ");
+	if (tool >= 0) location = location.mid(tool + 2);
+	const qsizetype section = location.indexOf(u":(");
+	if (section > 0) location = location.left(section);
+	int lineNumber = 0;
+	const qsizetype colon = location.lastIndexOf(u':');
+	if (colon > 0 && parseNumber(location.mid(colon + 1), lineNumber)) {
+		diag.line = lineNumber;
+		location = location.left(colon);
+	}
+	if (looksLikePath(location)) diag.file = location.toString();
+	return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <optional>
+#include <vector>
+
+struct Diagnostic {
+	enum Severity : quint8 { Error, Warning, Note };
+
+	Severity severity = Error;
+	QString file;
+	int line = 0;
+	int column = 0;
+	QString message;
+	// Line in the build output this was parsed from.
+	qint64 outputLine = -1;
+	// Notes and instantiation context folded into this entry.
+	int notes = 0;
+};
+
+// Incremental parser for GCC/Clang, MSVC, GNU ld and CMake diagnostics.
+// Each output line is looked at once as it streams past; lines without an
+// error/warning/note marker are rejected by a cheap substring check.
+class DiagnosticParser {
+public:
+	void setBaseDir(const QString& dir);
+	void reset();
+
+	// Parses one line. New diagnostics are appended to out with outputLine set
+	// to lineIndex. Notes are folded into the newest entry in out, or counted
+	// as detached when that entry was emitted by an earlier batch.
+	void feed(QStringView line, qint64 lineIndex, std::vector<Diagnostic>& out);
+	// Emits a pending multi-line diagnostic at the end of the stream.
+	void finish(std::vector<Diagnostic>& out);
+	int takeDetachedNotes();
+
+private:
+	bool parseGnu(QStringView line, Diagnostic& diag) const;
+	bool parseMsvc(QStringView line, Diagnostic& diag) const;
+	bool parseCMake(QStringView line, Diagnostic& diag) const;
+	bool parseLinker(QStringView line, Diagnostic& diag) const;
+	void emitDiagnostic(Diagnostic diag, std::vector<Diagnostic>& out);
+	void addNote(std::vector<Diagnostic>& out);
+	QString resolve(QStringView file);
+
+	QString m_baseDir;
+	QHash<QString, QString> m_resolved;
+	QSet<QString> m_seen;
+	std::optional<Diagnostic> m_cmake;
+	bool m_haveLast = false;
+	bool m_suppressNotes = false;
+	int m_detachedNotes = 0;
+};
@@ -0,0 +1,53 @@
+#include "line_ring.h"
+#include <algorithm>
+
+LineRing::LineRing(qsizetype capacity) : m_lines(static_cast<std::size_t>(std::max<qsizetype>(capacity, 1))) {}
+
+void LineRing::setCapacity(qsizetype lines) {
+	lines = std::max<qsizetype>(lines, 1);
+	if (lines == capacity()) return;
+	dropFront(std::max<qsizetype>(0, m_size - lines));
+	std::vector<QString> resized(static_cast<std::size_t>(lines));
+	for (qsizetype row = 0; row < m_size; ++row) {
+		resized[std::size_t(row)] = std::move(m_lines[std::size_t((m_head + row) % capacity())]);
+	}
+	m_lines = std::move(resized);
+	m_head = 0;
+}
+
+qsizetype LineRing::overflow(qsizetype count) const {
+	return std::clamp<qsizetype>(m_size + count - capacity(), 0, m_size);
+}
+
+void LineRing::dropFront(qsizetype count) {
+	count = std::min(count, m_size);
+	for (qsizetype i = 0; i < count; ++i) {
+		m_lines[std::size_t((m_head + i) % capacity())] = QString();
+	}
+	m_head = (m_head + count) % capacity();
+	m_size -= count;
+	m_first += count;
+}
+
+void LineRing::append(std::deque<QString>& lines) {
+	// Lines that would be evicted by later ones in the same batch are never stored.
+	const qsizetype skip = std::max<qsizetype>(0, qsizetype(lines.size()) - capacity());
+	m_first += skip;
+	dropFront(overflow(qsizetype(lines.size()) - skip));
+	for (auto it = lines.begin() + skip; it != lines.end(); ++it) {
+		m_lines[std::size_t((m_head + m_size) % capacity())] = std::move(*it);
+		++m_size;
+	}
+	lines.clear();
+}
+
+void LineRing::discard(qint64 skipped) {
+	dropFront(m_size);
+	m_first += skipped;
+}
+
+void LineRing::clear() {
+	dropFront(m_size);
+	m_head = 0;
+	m_first = 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <QString>
+#include <deque>
+#include <vector>
+
+// Fixed-capacity ring of text lines. Lines are addressed by row relative to
+// the oldest line still held; firstLine() counts every line ever evicted.
+class LineRing {
+public:
+	explicit LineRing(qsizetype capacity = 200000);
+
+	qsizetype capacity() const { return qsizetype(m_lines.size()); }
+	qsizetype size() const { return m_size; }
+	qint64 firstLine() const { return m_first; }
+	const QString& at(qsizetype row) const { return m_lines[std::size_t((m_head + row) % capacity())]; }
+
+	void setCapacity(qsizetype capacity);
+	// Number of rows append(count) would evict to make room.
+	qsizetype overflow(qsizetype count) const;
+	void dropFront(qsizetype count);
+	void append(std::deque<QString>& lines);
+	// Empties the ring and counts lines that were dropped before reaching it
+	// as evicted, keeping absolute line numbers in step with the producer.
+	void discard(qint64 skipped);
+	void clear();
+
+private:
+	std::vector<QString> m_lines;
+	qsizetype m_head = 0;
+	qsizetype m_size = 0;
+	qint64 m_first = 0;
+};
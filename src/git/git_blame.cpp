@@ -0,0 +1,307 @@
+#include "git_blame.h"
+#include "git_repo.h"
+#include <git2.h>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+
+namespace {
+constexpr quint32 kCacheMagic = 0x49444542; // "IDEB"
+constexpr quint16 kCacheVersion = 1;
+}
+
+const BlameCommit* BlameInfo::commitForLine(qsizetype line) const {
+	if (line < 0 || line >= qsizetype(lines.size())) return nullptr;
+	const qint32 index = lines[std::size_t(line)];
+	return index >= 0 ? &commits[std::size_t(index)] : nullptr;
+}
+
+void BlameInfo::applyDelta(const TextDelta& delta) {
+	if (lines.empty()) return;
+	const qsizetype count = qsizetype(lines.size());
+	const qsizetype first = std::clamp<qsizetype>(delta.firstLine, 0, count);
+	const qsizetype last = std::min(count, first + delta.removedLines + 1);
+	lines.erase(lines.begin() + first, lines.begin() + last);
+	lines.insert(lines.begin() + first, std::size_t(delta.addedLines + 1), -1);
+}
+
+struct BlameService::State {
+	GitRepo repo;
+	QString path;
+	QString rel;
+	git_oid head{};
+	git_blame* reference = nullptr;
+
+	~State() { git_blame_free(reference); }
+
+	bool open(const QString& absolutePath);
+	bool ensureReference();
+	BlameInfoPtr convert(git_blame* blame);
+	QString cacheFile() const;
+	BlameInfoPtr loadCache() const;
+	void saveCache(const BlameInfo& info) const;
+};
+
+bool BlameService::State::open(const QString& absolutePath) {
+	git_blame_free(reference);
+	reference = nullptr;
+	path = absolutePath;
+	if (!repo.isOpen() || repo.relativePath(absolutePath).isEmpty()) {
+		if (!repo.open(QFileInfo(absolutePath).absolutePath())) return false;
+	}
+	rel = repo.relativePath(absolutePath);
+	return !rel.isEmpty() && git_reference_name_to_id(&head, repo.handle(), "HEAD") == 0;
+}
+
+bool BlameService::State::ensureReference() {
+	if (reference) return true;
+	if (!repo.isOpen() || rel.isEmpty()) return false;
+	git_blame_options opts = GIT_BLAME_OPTIONS_INIT;
+	git_oid_cpy(&opts.newest_commit, &head);
+	if (git_blame_file(&reference, repo.handle(), rel.toUtf8().constData(), &opts) != 0) {
+		reference = nullptr;
+		return false;
+	}
+	return true;
+}
+
+BlameInfoPtr BlameService::State::convert(git_blame* blame) {
+	auto info = std::make_shared<BlameInfo>();
+	QHash<QByteArray, qint32> index;
+	const std::uint32_t count = git_blame_get_hunk_count(blame);
+	for (std::uint32_t i = 0; i < count; ++i) {
+		const git_blame_hunk* hunk = git_blame_get_hunk_byindex(blame, i);
+		qint32 commitIndex = -1;
+		if (!git_oid_is_zero(&hunk->final_commit_id)) {
+			const QByteArray id(git_oid_tostr_s(&hunk->final_commit_id));
+			auto it = index.constFind(id);
+			if (it != index.constEnd()) {
+				commitIndex = *it;
+			} else {
+				BlameCommit commit;
+				commit.id = id;
+				if (hunk->final_signature) {
+					commit.author = QString::fromUtf8(hunk->final_signature->name);
+					commit.time = hunk->final_signature->when.time;
+				}
+				git_commit* object = nullptr;
+				if (git_commit_lookup(&object, repo.handle(), &hunk->final_commit_id) == 0) {
+					commit.summary = QString::fromUtf8(git_commit_summary(object));
+					git_commit_free(object);
+				}
+				commitIndex = qint32(info->commits.size());
+				info->commits.push_back(std::move(commit));
+				index.insert(id, commitIndex);
+			}
+		}
+		const std::size_t start = hunk->final_start_line_number - 1;
+		const std::size_t end = start + hunk->lines_in_hunk;
+		if (info->lines.size() < end) {
+			info->lines.resize(end, -1);
+		}
+		std::fill(info->lines.begin() + qsizetype(start), info->lines.begin() + qsizetype(end), commitIndex);
+	}
+	return info;
+}
+
+QString BlameService::State::cacheFile() const {
+	const QByteArray key = path.toUtf8() + '\0' + QByteArray(git_oid_tostr_s(&head));
+	const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/blame/");
+	return dir + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) + QStringLiteral(".bin");
+}
+
+BlameInfoPtr BlameService::State::loadCache() const {
+	QFile file(cacheFile());
+	if (!file.open(QIODevice::ReadOnly)) return nullptr;
+	QDataStream in(&file);
+	in.setVersion(QDataStream::Qt_6_4);
+	quint32 magic = 0;
+	quint16 version = 0;
+	quint32 commitCount = 0;
+	in >> magic >> version >> commitCount;
+	if (magic != kCacheMagic || version != kCacheVersion) return nullptr;
+
+	auto info = std::make_shared<BlameInfo>();
+	info->commits.resize(commitCount);
+	for (BlameCommit& commit : info->commits) {
+		in >> commit.id >> commit.author >> commit.time >> commit.summary;
+	}
+	quint32 lineCount = 0;
+	in >> lineCount;
+	info->lines.resize(lineCount);
+	for (qint32& line : info->lines) {
+		in >> line;
+		if (line >= qint32(commitCount)) return nullptr;
+	}
+	if (in.status() != QDataStream::Ok) return nullptr;
+	return info;
+}
+
+void BlameService::State::saveCache(const BlameInfo& info) const {
+	const QString target = cacheFile();
+	QDir().mkpath(QFileInfo(target).absolutePath());
+	QSaveFile file(target);
+	if (!file.open(QIODevice::WriteOnly)) return;
+	QDataStream out(&file);
+	out.setVersion(QDataStream::Qt_6_4);
+	out << kCacheMagic << kCacheVersion << quint32(info.commits.size());
+	for (const BlameCommit& commit : info.commits) {
+		out << commit.id << commit.author << commit.time << commit.summary;
+	}
+	out << quint32(info.lines.size());
+	for (qint32 line : info.lines) {
+		out << line;
+	}
+	file.commit();
+}
+
+BlameService::BlameService(QObject* parent) : QObject(parent), m_state(new State), m_lineState(new State) {}
+
+BlameService::~BlameService() {
+	m_tasks.stop();
+}
+
+void BlameService::setFile(const QString& path) {
+	m_path = path;
+	m_blame.reset();
+	m_deltaLog.clear();
+	m_requestedLine = -1;
+	const quint64 token = ++m_fileToken;
+	const quint64 generation = m_generation;
+	emit blameChanged();
+	if (path.isEmpty()) return;
+
+	State* state = m_state.get();
+	m_tasks.submit(TaskPriority::Visible, [this, state, path, token, generation] {
+		BlameInfoPtr info;
+		if (state->open(path)) {
+			info = state->loadCache();
+			if (!info && state->ensureReference()) {
+				info = state->convert(state->reference);
+				state->saveCache(*info);
+			}
+		}
+		QMetaObject::invokeMethod(this, [this, info, generation, token] {
+			accept(info, generation, token);
+		}, Qt::QueuedConnection);
+	});
+}
+
+void BlameService::reloadHead() {
+	if (m_path.isEmpty()) return;
+	State* state = m_state.get();
+	const quint64 token = m_fileToken;
+	const quint64 generation = m_generation;
+	m_tasks.submit([this, state, token, generation] {
+		git_oid head;
+		if (state->rel.isEmpty() || git_reference_name_to_id(&head, state->repo.handle(), "HEAD") != 0
+			|| git_oid_equal(&head, &state->head)) {
+			return;
+		}
+		git_oid_cpy(&state->head, &head);
+		git_blame_free(state->reference);
+		state->reference = nullptr;
+		BlameInfoPtr info = state->loadCache();
+		if (!info && state->ensureReference()) {
+			info = state->convert(state->reference);
+			state->saveCache(*info);
+		}
+		QMetaObject::invokeMethod(this, [this, info, generation, token] {
+			if (token != m_fileToken) return;
+			accept(info, generation, token);
+			emit headChanged();
+		}, Qt::QueuedConnection);
+	});
+}
+
+void BlameService::requestLine(qsizetype line) {
+	if (m_path.isEmpty() || line < 0) return;
+	if (m_blame) {
+		if (const BlameCommit* commit = m_blame->commitForLine(line)) {
+			emit lineBlameReady(line, *commit);
+		}
+		return;
+	}
+	if (line == m_requestedLine) return;
+	m_requestedLine = line;
+	State* state = m_lineState.get();
+	const QString path = m_path;
+	const quint64 token = m_fileToken;
+	m_lineTask.submit([this, state, path, line, token](const CancelToken&) {
+		if (state->path != path || !state->repo.isOpen()) {
+			if (!state->open(path)) return;
+		} else if (git_reference_name_to_id(&state->head, state->repo.handle(), "HEAD") != 0) {
+			return;
+		}
+		git_blame_options opts = GIT_BLAME_OPTIONS_INIT;
+		git_oid_cpy(&opts.newest_commit, &state->head);
+		opts.min_line = std::size_t(line + 1);
+		opts.max_line = std::size_t(line + 1);
+		git_blame* blame = nullptr;
+		if (git_blame_file(&blame, state->repo.handle(), state->rel.toUtf8().constData(), &opts) != 0) return;
+		BlameInfoPtr info = state->convert(blame);
+		git_blame_free(blame);
+		const BlameCommit* commit = info->commitForLine(line);
+		if (!commit) return;
+		const BlameCommit result = *commit;
+		TaskScheduler::postTo(this, [this, line, token, result] {
+			if (token == m_fileToken && !m_blame) {
+				emit lineBlameReady(line, result);
+			}
+		});
+	});
+}
+
+void BlameService::applyDelta(const TextDelta& delta) {
+	if (m_path.isEmpty()) return;
+	++m_generation;
+	m_deltaLog.emplace_back(m_generation, delta);
+	if (m_blame) {
+		m_blame->applyDelta(delta);
+	}
+}
+
+void BlameService::updateBuffer(const QString& text) {
+	if (m_path.isEmpty()) return;
+	State* state = m_state.get();
+	const QByteArray utf8 = text.toUtf8();
+	const quint64 token = m_fileToken;
+	const quint64 generation = m_generation;
+	m_tasks.submit([this, state, utf8, token, generation] {
+		BlameInfoPtr info;
+		git_blame* blame = nullptr;
+		if (state->ensureReference()
+			&& git_blame_buffer(&blame, state->reference, utf8.constData(), std::size_t(utf8.size())) == 0) {
+			info = state->convert(blame);
+			git_blame_free(blame);
+		}
+		QMetaObject::invokeMethod(this, [this, info, generation, token] {
+			accept(info, generation, token);
+		}, Qt::QueuedConnection);
+	});
+}
+
+void BlameService::accept(BlameInfoPtr blame, quint64 generation, quint64 fileToken) {
+	if (fileToken != m_fileToken) return;
+	auto firstNewer = std::find_if(m_deltaLog.begin(), m_deltaLog.end(),
+		[generation](const auto& entry) { return entry.first > generation; });
+	if (blame) {
+		// Edits made while the worker was busy still apply on top of its result.
+		for (auto it = firstNewer; it != m_deltaLog.end(); ++it) {
+			blame->applyDelta(it->second);
+		}
+		m_blame = std::move(blame);
+	}
+	m_deltaLog.erase(m_deltaLog.begin(), firstNewer);
+	emit blameChanged();
+}
+
+const BlameCommit* BlameService::commitForLine(qsizetype line) const {
+	return m_blame ? m_blame->commitForLine(line) : nullptr;
+}
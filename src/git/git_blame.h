@@ -0,0 +1,69 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <vector>
+#include "../buffer/textBuffer.h"
+#include "../util/task_scheduler.h"
+
+struct BlameCommit {
+	QByteArray id;
+	QString author;
+	qint64 time = 0;
+	QString summary;
+};
+
+struct BlameInfo {
+	std::vector<BlameCommit> commits;
+	std::vector<qint32> lines;
+
+	const BlameCommit* commitForLine(qsizetype line) const;
+	void applyDelta(const TextDelta& delta);
+};
+using BlameInfoPtr = std::shared_ptr<BlameInfo>;
+
+// Blame for the current document, computed off the GUI thread. Committed blame
+// is cached on disk per (path, HEAD oid); unsaved edits are remapped through
+// text deltas right away and corrected later with git_blame_buffer.
+class BlameService : public QObject {
+	Q_OBJECT
+public:
+	explicit BlameService(QObject* parent = nullptr);
+	~BlameService() override;
+
+	void setFile(const QString& path);
+	// Re-resolves HEAD and reloads the committed blame if it moved.
+	void reloadHead();
+	void requestLine(qsizetype line);
+	void applyDelta(const TextDelta& delta);
+	void updateBuffer(const QString& text);
+
+	const BlameCommit* commitForLine(qsizetype line) const;
+	bool isReady() const { return m_blame != nullptr; }
+
+signals:
+	void blameChanged();
+	// The committed blame was reloaded for a new HEAD; unsaved edits need a
+	// fresh updateBuffer().
+	void headChanged();
+	void lineBlameReady(qsizetype line, const BlameCommit& commit);
+
+private:
+	struct State;
+
+	void accept(BlameInfoPtr blame, quint64 generation, quint64 fileToken);
+
+	std::unique_ptr<State> m_state;
+	// Whole-file blame, which uses m_state.
+	TaskSequence m_tasks{TaskPriority::Background};
+	std::unique_ptr<State> m_lineState;
+	// Blame for the cursor line; only the latest line asked for is worked out.
+	LatestTask m_lineTask{TaskPriority::Visible};
+
+	BlameInfoPtr m_blame;
+	std::vector<std::pair<quint64, TextDelta>> m_deltaLog;
+	quint64 m_generation = 0;
+	quint64 m_fileToken = 0;
+	qsizetype m_requestedLine = -1;
+	QString m_path;
+};
@@ -0,0 +1,160 @@
+#include "git_history.h"
+#include "git_repo.h"
+#include <git2.h>
+#include <QFileInfo>
+#include <cstring>
+
+qint32 StringPool::intern(const QString& text) {
+	auto it = m_index.constFind(text);
+	if (it != m_index.constEnd()) return *it;
+	const qint32 id = qint32(m_strings.size());
+	m_strings.push_back(text);
+	m_index.insert(text, id);
+	return id;
+}
+
+void StringPool::append(std::vector<QString> strings) {
+	m_strings.insert(m_strings.end(), std::make_move_iterator(strings.begin()), std::make_move_iterator(strings.end()));
+}
+
+void StringPool::clear() {
+	m_index.clear();
+	m_strings.clear();
+}
+
+QString CommitRow::shortId() const {
+	return QString::fromLatin1(QByteArray(reinterpret_cast<const char*>(id.data()), 4).toHex());
+}
+
+struct HistoryProvider::State {
+	GitRepo repo;
+	git_revwalk* walk = nullptr;
+	StringPool strings;
+	qsizetype published = 0;
+	bool commitGraph = false;
+
+	~State() { git_revwalk_free(walk); }
+	bool open(const QString& path);
+	Page next(int count);
+};
+
+bool HistoryProvider::State::open(const QString& path) {
+	git_revwalk_free(walk);
+	walk = nullptr;
+	strings.clear();
+	published = 0;
+	commitGraph = false;
+	if (!repo.open(path)) return false;
+	// libgit2 parses parents from objects/info/commit-graph when it exists
+	// (core.commitGraph defaults to on), so the walk itself stays cheap. The
+	// objects live under the common dir, which differs from .git in worktrees
+	// and submodules.
+	const QString objectsInfo = QString::fromUtf8(git_repository_commondir(repo.handle())) + QStringLiteral("objects/info/");
+	commitGraph = QFileInfo::exists(objectsInfo + QStringLiteral("commit-graph"))
+		|| QFileInfo::exists(objectsInfo + QStringLiteral("commit-graphs"));
+	if (git_revwalk_new(&walk, repo.handle()) != 0) return false;
+	git_revwalk_sorting(walk, GIT_SORT_TIME);
+	if (git_revwalk_push_head(walk) != 0) {
+		git_revwalk_free(walk);
+		walk = nullptr;
+		return false;
+	}
+	return true;
+}
+
+HistoryProvider::Page HistoryProvider::State::next(int count) {
+	Page page;
+	if (!walk) {
+		page.atEnd = true;
+		return page;
+	}
+	page.rows.reserve(std::size_t(count));
+	git_oid oid;
+	while (int(page.rows.size()) < count) {
+		if (git_revwalk_next(&oid, walk) != 0) {
+			page.atEnd = true;
+			break;
+		}
+		git_commit* commit = nullptr;
+		if (git_commit_lookup(&commit, repo.handle(), &oid) != 0) continue;
+		CommitRow row;
+		std::memcpy(row.id.data(), oid.id, row.id.size());
+		row.time = git_commit_time(commit);
+		const git_signature* author = git_commit_author(commit);
+		row.author = strings.intern(author && author->name ? QString::fromUtf8(author->name) : QString());
+		const char* summary = git_commit_summary(commit);
+		row.summary = strings.intern(summary ? QString::fromUtf8(summary) : QString());
+		git_commit_free(commit);
+		page.rows.push_back(row);
+	}
+	for (qsizetype i = published; i < strings.size(); ++i) {
+		page.strings.push_back(strings.at(qint32(i)));
+	}
+	published = strings.size();
+	return page;
+}
+
+HistoryProvider::HistoryProvider(QObject* parent) : QObject(parent), m_state(new State) {
+}
+
+HistoryProvider::~HistoryProvider() {
+	m_tasks.stop();
+}
+
+void HistoryProvider::open(const QString& path) {
+	emit aboutToReset();
+	m_rows.clear();
+	m_rows.shrink_to_fit();
+	m_strings.clear();
+	m_atEnd = false;
+	m_fetching = true;
+	const quint64 token = ++m_token;
+	emit reset();
+
+	m_commitGraph = false;
+	m_pageSize = 256;
+
+	State* state = m_state.get();
+	m_tasks.submit([this, state, path, token] {
+		Page page;
+		if (state->open(path)) {
+			page = state->next(state->commitGraph ? 1024 : 256);
+			page.commitGraph = state->commitGraph;
+		} else {
+			page.atEnd = true;
+		}
+		QMetaObject::invokeMethod(this, [this, page = std::move(page), token]() mutable {
+			appendPage(std::move(page), token);
+		}, Qt::QueuedConnection);
+	});
+}
+
+void HistoryProvider::fetchMore() {
+	if (m_fetching || m_atEnd) return;
+	m_fetching = true;
+	State* state = m_state.get();
+	const quint64 token = m_token;
+	const int count = m_pageSize;
+	m_tasks.submit([this, state, token, count] {
+		Page page = state->next(count);
+		QMetaObject::invokeMethod(this, [this, page = std::move(page), token]() mutable {
+			appendPage(std::move(page), token);
+		}, Qt::QueuedConnection);
+	});
+}
+
+void HistoryProvider::appendPage(Page page, quint64 token) {
+	if (token != m_token) return;
+	if (page.commitGraph) {
+		m_commitGraph = true;
+		m_pageSize = 1024;
+	}
+	m_fetching = false;
+	m_atEnd = page.atEnd;
+	m_strings.append(std::move(page.strings));
+	if (page.rows.empty()) return;
+	const qsizetype first = rowCount();
+	emit rowsAboutToBeAppended(first, first + qsizetype(page.rows.size()) - 1);
+	m_rows.insert(m_rows.end(), page.rows.begin(), page.rows.end());
+	emit rowsAppended();
+}
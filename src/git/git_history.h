@@ -0,0 +1,79 @@
+#pragma once
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <array>
+#include <memory>
+#include <vector>
+#include "../util/task_scheduler.h"
+
+
+class StringPool {
+public:
+	qint32 intern(const QString& text);
+	const QString& at(qint32 id) const { return m_strings[std::size_t(id)]; }
+	qsizetype size() const { return qsizetype(m_strings.size()); }
+	void append(std::vector<QString> strings);
+	void clear();
+private:
+	QHash<QString, qint32> m_index;
+	std::vector<QString> m_strings;
+};
+
+struct CommitRow {
+	std::array<quint8, 20> id{};
+	qint64 time = 0;
+	qint32 author = -1;
+	qint32 summary = -1;
+
+	QString shortId() const;
+};
+
+// Pages through the commit log of a repository on the task scheduler. Rows keep
+// only interned string ids, so a long history costs a few dozen bytes per
+// commit and nothing beyond what has been scrolled into view.
+class HistoryProvider : public QObject {
+	Q_OBJECT
+public:
+	explicit HistoryProvider(QObject* parent = nullptr);
+	~HistoryProvider() override;
+
+	void open(const QString& path);
+	void fetchMore();
+
+	qsizetype rowCount() const { return qsizetype(m_rows.size()); }
+	const CommitRow& row(qsizetype index) const { return m_rows[std::size_t(index)]; }
+	const QString& string(qint32 id) const { return m_strings.at(id); }
+	bool atEnd() const { return m_atEnd; }
+	bool isFetching() const { return m_fetching; }
+	bool usesCommitGraph() const { return m_commitGraph; }
+
+signals:
+	void aboutToReset();
+	void reset();
+	void rowsAboutToBeAppended(qsizetype first, qsizetype last);
+	void rowsAppended();
+
+private:
+	struct State;
+	struct Page {
+		std::vector<CommitRow> rows;
+		std::vector<QString> strings;
+		bool atEnd = false;
+		// Set on the first page only.
+		bool commitGraph = false;
+	};
+
+	void appendPage(Page page, quint64 token);
+
+	TaskSequence m_tasks{TaskPriority::Visible};
+	std::unique_ptr<State> m_state;
+
+	std::vector<CommitRow> m_rows;
+	StringPool m_strings;
+	quint64 m_token = 0;
+	bool m_fetching = false;
+	bool m_atEnd = true;
+	bool m_commitGraph = false;
+	int m_pageSize = 256;
+};
@@ -1,3 +1,4 @@
+#include "git_repo.h"
 #include <git2.h>
 #include <QtCore/QtCore>
 
@@ -6,3 +7,56 @@ bool git_available()
 {
     return (git_libgit2_version(NULL, NULL, NULL), true);
 }
+
+GitRepo::GitRepo() {
+	git_libgit2_init();
+}
+
+GitRepo::~GitRepo() {
+	close();
+	git_libgit2_shutdown();
+}
+
+bool GitRepo::open(const QString& path, QString* error) {
+	close();
+	const QByteArray native = QFile::encodeName(path);
+	if (git_repository_open_ext(&m_repo, native.constData(), 0, nullptr) != 0) {
+		m_repo = nullptr;
+		if (error) {
+			*error = lastError();
+		}
+		return false;
+	}
+	return true;
+}
+
+void GitRepo::close() {
+	if (m_repo) {
+		git_repository_free(m_repo);
+		m_repo = nullptr;
+	}
+}
+
+QString GitRepo::workdir() const {
+	if (!m_repo) return {};
+	const char* dir = git_repository_workdir(m_repo);
+	return dir ? QFile::decodeName(dir) : QString();
+}
+
+QString GitRepo::gitDir() const {
+	if (!m_repo) return {};
+	return QFile::decodeName(git_repository_path(m_repo));
+}
+
+QString GitRepo::relativePath(const QString& absolutePath) const {
+	const QString root = workdir();
+	if (root.isEmpty()) return {};
+	const QString rel = QDir(root).relativeFilePath(absolutePath);
+	if (rel == QLatin1String("..") || rel.startsWith(QLatin1String("../"))) return {};
+	return rel;
+}
+
+QString GitRepo::lastError() {
+	const git_error* err = git_error_last();
+	return (err && err->message) ? QString::fromUtf8(err->message) : QStringLiteral("unknown libgit2 error");
+}
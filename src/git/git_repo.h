@@ -0,0 +1,29 @@
+#pragma once
+#include <QString>
+
+struct git_repository;
+
+bool git_available();
+
+// Owns one libgit2 repository handle. libgit2 objects are not safe to share
+// across threads, so every worker opens its own GitRepo.
+class GitRepo {
+public:
+	GitRepo();
+	~GitRepo();
+	GitRepo(const GitRepo&) = delete;
+	GitRepo& operator=(const GitRepo&) = delete;
+
+	bool open(const QString& path, QString* error = nullptr);
+	void close();
+
+	bool isOpen() const { return m_repo != nullptr; }
+	git_repository* handle() const { return m_repo; }
+	QString workdir() const;
+	QString gitDir() const;
+	QString relativePath(const QString& absolutePath) const;
+
+	static QString lastError();
+private:
+	git_repository* m_repo = nullptr;
+};
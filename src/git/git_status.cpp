@@ -0,0 +1,277 @@
+#include "git_status.h"
+#include "git_repo.h"
+#include <git2.h>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QTimer>
+
+static_assert(GitStatusIndexNew == GIT_STATUS_INDEX_NEW);
+static_assert(GitStatusWorktreeNew == GIT_STATUS_WT_NEW);
+static_assert(GitStatusWorktreeRenamed == GIT_STATUS_WT_RENAMED);
+static_assert(GitStatusConflicted == GIT_STATUS_CONFLICTED);
+
+namespace {
+struct Stamp {
+	qint64 mtime = 0;
+	qint64 size = -1;
+	bool operator==(const Stamp&) const = default;
+};
+
+Stamp stampOf(const QString& path) {
+	QFileInfo info(path);
+	if (!info.exists()) return {};
+	return {info.lastModified().toMSecsSinceEpoch(), info.size()};
+}
+}
+
+struct GitStatusService::State {
+	GitRepo repo;
+	QString workdir;
+	QString indexPath;
+	Stamp index;
+	QHash<QString, Stamp> stamps;
+	QHash<QString, unsigned> entries;
+	qint64 generation = 0;
+	bool scanned = false;
+
+	bool collect(const QString& prefix);
+	bool fullScan();
+	bool refreshPaths(const QStringList& paths);
+	GitStatusSnapshotPtr makeSnapshot();
+};
+
+bool GitStatusService::State::collect(const QString& prefix) {
+	git_status_options opts = GIT_STATUS_OPTIONS_INIT;
+	opts.show = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
+	opts.flags = GIT_STATUS_OPT_INCLUDE_UNTRACKED | GIT_STATUS_OPT_RECURSE_UNTRACKED_DIRS | GIT_STATUS_OPT_EXCLUDE_SUBMODULES;
+	QByteArray spec = prefix.toUtf8();
+	char* specPtr = spec.data();
+	if (!prefix.isEmpty()) {
+		// A path, not a pattern: names with '*' or '[' must not glob.
+		opts.flags |= GIT_STATUS_OPT_DISABLE_PATHSPEC_MATCH;
+		opts.pathspec.strings = &specPtr;
+		opts.pathspec.count = 1;
+	}
+
+	git_status_list* list = nullptr;
+	if (git_status_list_new(&list, repo.handle(), &opts) != 0) {
+		return false;
+	}
+	if (prefix.isEmpty()) {
+		entries.clear();
+	} else {
+		const QString dirPrefix = prefix + QLatin1Char('/');
+		for (auto it = entries.begin(); it != entries.end();) {
+			if (it.key() == prefix || it.key().startsWith(dirPrefix)) {
+				it = entries.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	const std::size_t count = git_status_list_entrycount(list);
+	entries.reserve(qsizetype(count));
+	for (std::size_t i = 0; i < count; ++i) {
+		const git_status_entry* entry = git_status_byindex(list, i);
+		const git_diff_delta* delta = entry->index_to_workdir ? entry->index_to_workdir : entry->head_to_index;
+		if (!delta || !delta->new_file.path) continue;
+		entries.insert(QString::fromUtf8(delta->new_file.path), unsigned(entry->status));
+	}
+	git_status_list_free(list);
+	return true;
+}
+
+bool GitStatusService::State::fullScan() {
+	index = stampOf(indexPath);
+	stamps.clear();
+	scanned = collect(QString());
+	return scanned;
+}
+
+bool GitStatusService::State::refreshPaths(const QStringList& paths) {
+	if (!scanned || stampOf(indexPath) != index) {
+		return fullScan();
+	}
+	bool changed = false;
+	for (const QString& rel : paths) {
+		const QString abs = workdir + rel;
+		if (QFileInfo(abs).isDir()) {
+			changed |= collect(rel);
+			continue;
+		}
+		const Stamp stamp = stampOf(abs);
+		auto it = stamps.find(rel);
+		if (it != stamps.end() && *it == stamp) continue;
+		stamps.insert(rel, stamp);
+
+		unsigned flags = GIT_STATUS_CURRENT;
+		const int rc = git_status_file(&flags, repo.handle(), rel.toUtf8().constData());
+		if (rc != 0 && rc != GIT_ENOTFOUND) continue;
+		if (rc == GIT_ENOTFOUND || flags == GIT_STATUS_CURRENT || (flags & GIT_STATUS_IGNORED)) {
+			changed |= entries.remove(rel) > 0;
+		} else {
+			auto existing = entries.find(rel);
+			if (existing == entries.end() || *existing != flags) {
+				entries.insert(rel, flags);
+				changed = true;
+			}
+		}
+	}
+	return changed;
+}
+
+GitStatusSnapshotPtr GitStatusService::State::makeSnapshot() {
+	auto snap = std::make_shared<GitStatusSnapshot>();
+	snap->workdir = workdir;
+	snap->entries = entries;
+	snap->generation = ++generation;
+	return snap;
+}
+
+GitStatusService::GitStatusService(QObject* parent) : QObject(parent), m_state(new State) {
+	m_debounce = new QTimer(this);
+	m_debounce->setSingleShot(true);
+	m_debounce->setInterval(50);
+	connect(m_debounce, &QTimer::timeout, this, &GitStatusService::flushPending);
+}
+
+GitStatusService::~GitStatusService() {
+	m_tasks.stop();
+}
+
+void GitStatusService::open(const QString& path) {
+	close();
+	State* state = m_state.get();
+	m_tasks.submit([this, state, path] {
+		QString error;
+		if (!state->repo.open(path, &error)) {
+			QMetaObject::invokeMethod(this, [this, error] { emit repositoryError(error); }, Qt::QueuedConnection);
+			return;
+		}
+		state->workdir = state->repo.workdir();
+		state->indexPath = state->repo.gitDir() + QStringLiteral("index");
+		const QString workdir = state->workdir;
+		const QString gitDir = state->repo.gitDir();
+		QMetaObject::invokeMethod(this, [this, workdir, gitDir] {
+			m_workdir = workdir;
+			m_gitDir = gitDir;
+			watch(true);
+			emit repositoryOpened(workdir);
+		}, Qt::QueuedConnection);
+
+		state->fullScan();
+		GitStatusSnapshotPtr snap = state->makeSnapshot();
+		QMetaObject::invokeMethod(this, [this, snap] { publish(snap); }, Qt::QueuedConnection);
+	});
+}
+
+void GitStatusService::close() {
+	m_debounce->stop();
+	m_pending.clear();
+	m_fullPending = false;
+	watch(false);
+	m_workdir.clear();
+	m_gitDir.clear();
+	m_snapshot.reset();
+	State* state = m_state.get();
+	m_tasks.submit([state] {
+		state->repo.close();
+		state->entries.clear();
+		state->stamps.clear();
+		state->scanned = false;
+	});
+}
+
+void GitStatusService::refresh() {
+	m_fullPending = true;
+	m_debounce->start();
+}
+
+void GitStatusService::pathsChanged(const QStringList& absolutePaths) {
+	if (m_workdir.isEmpty()) return;
+	const QDir root(m_workdir);
+	for (const QString& path : absolutePaths) {
+		const QString rel = root.relativeFilePath(path);
+		if (rel == QLatin1String("..") || rel.startsWith(QLatin1String("../"))) continue;
+		if (rel == QLatin1String(".git") || rel.startsWith(QLatin1String(".git/"))) {
+			m_fullPending = true;
+			continue;
+		}
+		m_pending.insert(rel);
+	}
+	if (m_fullPending || !m_pending.isEmpty()) {
+		m_debounce->start();
+	}
+}
+
+void GitStatusService::flushPending() {
+	const bool full = m_fullPending;
+	const QStringList paths(m_pending.begin(), m_pending.end());
+	m_fullPending = false;
+	m_pending.clear();
+
+	State* state = m_state.get();
+	m_tasks.submit([this, state, full, paths] {
+		if (!state->repo.isOpen()) return;
+		const bool changed = full ? state->fullScan() : state->refreshPaths(paths);
+		if (!changed) return;
+		GitStatusSnapshotPtr snap = state->makeSnapshot();
+		QMetaObject::invokeMethod(this, [this, snap] { publish(snap); }, Qt::QueuedConnection);
+	});
+}
+
+void GitStatusService::publish(GitStatusSnapshotPtr snapshot) {
+	if (m_workdir.isEmpty() || snapshot->workdir != m_workdir) return;
+	m_snapshot = std::move(snapshot);
+	emit statusChanged(m_snapshot);
+}
+
+void GitStatusService::setWatcher(FsWatcher* watcher) {
+	if (m_watcher == watcher) return;
+	watch(false);
+	if (m_watcher) {
+		disconnect(m_watcher, nullptr, this, nullptr);
+	}
+	m_watcher = watcher;
+	if (m_watcher) {
+		connect(m_watcher, &FsWatcher::changed, this, &GitStatusService::onFilesChanged);
+	}
+	watch(true);
+}
+
+void GitStatusService::watch(bool on) {
+	if (!m_watcher || m_workdir.isEmpty()) return;
+	if (on) {
+		m_watcher->addDirectory(m_workdir, true);
+		m_watcher->addDirectory(m_gitDir, false);
+	} else {
+		m_watcher->removeDirectory(m_workdir, true);
+		m_watcher->removeDirectory(m_gitDir, false);
+	}
+}
+
+void GitStatusService::onFilesChanged(const FsChangeBatch& batch) {
+	if (m_workdir.isEmpty()) return;
+	const QString root = QDir::cleanPath(m_workdir);
+	const QString gitDir = QDir::cleanPath(m_gitDir);
+	QStringList paths;
+	for (const FsChange& change : batch) {
+		if (change.kinds & FsChange::Rescan) {
+			m_fullPending |= change.path == root || change.path.startsWith(root + u'/') || change.path == gitDir;
+			continue;
+		}
+		if (change.path.startsWith(m_gitDir)) {
+			// Git writes index.lock and renames it over the index.
+			const QString name = change.path.mid(m_gitDir.size());
+			m_fullPending |= name == QLatin1String("index") || name == QLatin1String("HEAD");
+			continue;
+		}
+		paths.append(change.path);
+		if (!change.from.isEmpty()) {
+			paths.append(change.from);
+		}
+	}
+	pathsChanged(paths);
+}
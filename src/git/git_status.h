@@ -0,0 +1,80 @@
+#pragma once
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <memory>
+#include "../util/fs_watcher.h"
+#include "../util/task_scheduler.h"
+
+class QTimer;
+
+// Bit values match libgit2's git_status_t.
+enum GitStatusFlag : unsigned {
+	GitStatusCurrent = 0,
+	GitStatusIndexNew = 1u << 0,
+	GitStatusIndexModified = 1u << 1,
+	GitStatusIndexDeleted = 1u << 2,
+	GitStatusIndexRenamed = 1u << 3,
+	GitStatusIndexTypeChange = 1u << 4,
+	GitStatusWorktreeNew = 1u << 7,
+	GitStatusWorktreeModified = 1u << 8,
+	GitStatusWorktreeDeleted = 1u << 9,
+	GitStatusWorktreeTypeChange = 1u << 10,
+	GitStatusWorktreeRenamed = 1u << 11,
+	GitStatusConflicted = 1u << 15,
+};
+
+struct GitStatusSnapshot {
+	QString workdir;
+	QHash<QString, unsigned> entries;
+	qint64 generation = 0;
+
+	unsigned statusOf(const QString& relativePath) const {
+		return entries.value(relativePath, GitStatusCurrent);
+	}
+};
+using GitStatusSnapshotPtr = std::shared_ptr<const GitStatusSnapshot>;
+
+// Keeps the workspace status of one repository up to date on the task scheduler.
+// The first scan is a full git_status_list; after that only the paths reported
+// through pathsChanged() are re-queried, unless the index itself changed.
+class GitStatusService : public QObject {
+	Q_OBJECT
+public:
+	explicit GitStatusService(QObject* parent = nullptr);
+	~GitStatusService() override;
+
+	void open(const QString& path);
+	void close();
+	void refresh();
+	void pathsChanged(const QStringList& absolutePaths);
+	// Not owned. The open repository's work tree and git dir are watched through it.
+	void setWatcher(FsWatcher* watcher);
+
+	QString workdir() const { return m_workdir; }
+	GitStatusSnapshotPtr snapshot() const { return m_snapshot; }
+
+signals:
+	void statusChanged(GitStatusSnapshotPtr snapshot);
+	void repositoryOpened(const QString& workdir);
+	void repositoryError(const QString& message);
+
+private:
+	struct State;
+
+	void flushPending();
+	void publish(GitStatusSnapshotPtr snapshot);
+	void watch(bool on);
+	void onFilesChanged(const FsChangeBatch& batch);
+
+	std::unique_ptr<State> m_state;
+	TaskSequence m_tasks{TaskPriority::Background};
+	QTimer* m_debounce = nullptr;
+	FsWatcher* m_watcher = nullptr;
+	QString m_gitDir;
+	QSet<QString> m_pending;
+	bool m_fullPending = false;
+	QString m_workdir;
+	GitStatusSnapshotPtr m_snapshot;
+};
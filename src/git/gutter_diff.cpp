@@ -0,0 +1,260 @@
+#include "gutter_diff.h"
+#include "git_repo.h"
+#include <git2.h>
+#include <QFileInfo>
+#include <algorithm>
+#include <limits>
+
+struct GutterDiffService::State {
+	GitRepo repo;
+	QString path;
+	bool hasBase = false;
+	git_oid baseOid{};
+	TextSnapshot baseText;
+	std::vector<size_t> base;
+	// The snapshot current was hashed from.
+	TextSnapshot text;
+	std::vector<size_t> current;
+	std::vector<DiffHunk> hunks;
+	bool valid = false;
+
+	bool loadBase();
+	void diffFull();
+	std::vector<size_t> rehash(const TextSnapshot& next, const EditWindow& window, qsizetype* prefix, qsizetype* suffix) const;
+	bool diffIncremental(std::vector<size_t> next, const TextSnapshot& nextText, qsizetype prefix, qsizetype suffix);
+	LineDiff::SameLine sameLine() const;
+	DiffHunksPtr result() const { return std::make_shared<const std::vector<DiffHunk>>(hunks); }
+};
+
+bool GutterDiffService::State::loadBase() {
+	const QFileInfo info(path);
+	const QString absolute = info.absoluteFilePath();
+	if (!repo.isOpen() || repo.relativePath(absolute).isEmpty()) {
+		repo.open(info.absolutePath());
+	}
+	const QString rel = repo.isOpen() ? repo.relativePath(absolute) : QString();
+
+	git_object* obj = nullptr;
+	const QByteArray spec = QByteArray("HEAD:") + rel.toUtf8();
+	if (rel.isEmpty() || git_revparse_single(&obj, repo.handle(), spec.constData()) != 0
+		|| git_object_type(obj) != GIT_OBJECT_BLOB) {
+		git_object_free(obj);
+		const bool hadBase = hasBase;
+		hasBase = false;
+		valid = false;
+		base.clear();
+		baseText = TextSnapshot();
+		return hadBase;
+	}
+
+	const git_oid* oid = git_object_id(obj);
+	if (hasBase && git_oid_equal(oid, &baseOid)) {
+		git_object_free(obj);
+		return false;
+	}
+	git_oid_cpy(&baseOid, oid);
+	auto* blob = reinterpret_cast<git_blob*>(obj);
+	const char* data = static_cast<const char*>(git_blob_rawcontent(blob));
+	const qsizetype size = qsizetype(git_blob_rawsize(blob));
+	QString contents = QString::fromUtf8(data, size);
+	std::vector<qsizetype> starts{0};
+	for (qsizetype nl = contents.indexOf(u'\n'); nl >= 0; nl = contents.indexOf(u'\n', nl + 1)) {
+		starts.push_back(nl + 1);
+	}
+	baseText = TextSnapshot(std::move(contents), std::move(starts));
+	base = LineDiff::hashLines(baseText);
+	git_object_free(obj);
+	hasBase = true;
+	valid = false;
+	return true;
+}
+
+LineDiff::SameLine GutterDiffService::State::sameLine() const {
+	return [this](qsizetype x, qsizetype y) {
+		return LineDiff::lineAt(baseText, x) == LineDiff::lineAt(text, y);
+	};
+}
+
+void GutterDiffService::State::diffFull() {
+	hunks = hasBase ? LineDiff::diff(base, current, sameLine()) : std::vector<DiffHunk>{};
+	valid = hasBase;
+}
+
+// The hashes of next's lines, reused from current for the lines the edits
+// since text left alone; prefix and suffix are set to the lines at either end
+// that are the same in both.
+std::vector<size_t> GutterDiffService::State::rehash(const TextSnapshot& next, const EditWindow& window,
+	qsizetype* prefix, qsizetype* suffix) const {
+	const qsizetype oldN = qsizetype(current.size());
+	const qsizetype newN = next.lineCount();
+	if (window.known && window.baseVersion == text.version() && oldN == text.lineCount()) {
+		*prefix = std::min({window.prefix, oldN, newN});
+		*suffix = std::min({window.suffix, oldN - *prefix, newN - *prefix});
+		std::vector<size_t> out;
+		out.reserve(std::size_t(newN));
+		out.insert(out.end(), current.begin(), current.begin() + *prefix);
+		LineDiff::hashLines(next, *prefix, newN - *suffix, &out);
+		out.insert(out.end(), current.end() - *suffix, current.end());
+		return out;
+	}
+
+	std::vector<size_t> out = LineDiff::hashLines(next);
+	auto unchanged = [&](qsizetype x, qsizetype y) {
+		return current[std::size_t(x)] == out[std::size_t(y)] && LineDiff::lineAt(text, x) == LineDiff::lineAt(next, y);
+	};
+	*prefix = 0;
+	while (*prefix < oldN && *prefix < newN && unchanged(*prefix, *prefix)) {
+		++*prefix;
+	}
+	*suffix = 0;
+	while (*suffix < oldN - *prefix && *suffix < newN - *prefix && unchanged(oldN - 1 - *suffix, newN - 1 - *suffix)) {
+		++*suffix;
+	}
+	return out;
+}
+
+bool GutterDiffService::State::diffIncremental(std::vector<size_t> next, const TextSnapshot& nextText,
+	qsizetype prefix, qsizetype suffix) {
+	const qsizetype oldN = qsizetype(current.size());
+	const qsizetype newN = qsizetype(next.size());
+	text = nextText;
+	if (prefix == oldN && prefix == newN) {
+		return false;
+	}
+
+	// Widen the edited window over every hunk it touches, then map it back to base lines.
+	qsizetype c0 = prefix;
+	qsizetype c1 = oldN - suffix;
+	const qsizetype shift = newN - oldN;
+	qsizetype deltaBefore = 0;
+	qsizetype deltaInside = 0;
+	std::vector<DiffHunk> spliced;
+	std::vector<DiffHunk> after;
+	for (const DiffHunk& h : hunks) {
+		if (h.newStart + h.newCount < c0) {
+			spliced.push_back(h);
+			deltaBefore += h.newCount - h.oldCount;
+		} else if (h.newStart > c1) {
+			DiffHunk moved = h;
+			moved.newStart += shift;
+			after.push_back(moved);
+		} else {
+			c0 = std::min(c0, h.newStart);
+			c1 = std::max(c1, h.newStart + h.newCount);
+			deltaInside += h.newCount - h.oldCount;
+		}
+	}
+	const qsizetype b0 = c0 - deltaBefore;
+	const qsizetype b1 = c1 - deltaBefore - deltaInside;
+
+	current = std::move(next);
+	std::vector<DiffHunk> middle = LineDiff::diff(base, b0, b1, current, c0, c1 + shift, 1024, sameLine());
+	spliced.insert(spliced.end(), middle.begin(), middle.end());
+	spliced.insert(spliced.end(), after.begin(), after.end());
+	hunks = std::move(spliced);
+	return true;
+}
+
+GutterDiffService::GutterDiffService(QObject* parent) : QObject(parent), m_state(new State) {}
+
+GutterDiffService::~GutterDiffService() {
+	m_tasks.stop();
+}
+
+void GutterDiffService::setFile(const QString& path) {
+	m_window = EditWindow();
+	std::lock_guard lock(m_pendingMutex);
+	m_pending = Pending();
+	m_pending.path = path;
+	queuePending();
+}
+
+void GutterDiffService::reloadBase() {
+	State* state = m_state.get();
+	m_tasks.submit(TaskPriority::Background, [this, state] {
+		if (state->path.isEmpty() || !state->loadBase()) return;
+		state->diffFull();
+		publish(state->path, state->result(), state->current.empty() ? -1 : state->text.version());
+	});
+}
+
+void GutterDiffService::applyDelta(const TextDelta& delta) {
+	if (!m_window.known) return;
+	const qsizetype below = m_lineCount - (delta.firstLine + delta.removedLines + 1);
+	m_window.prefix = std::min(m_window.prefix, delta.firstLine);
+	m_window.suffix = std::min(m_window.suffix, std::max<qsizetype>(below, 0));
+	m_lineCount += delta.addedLines - delta.removedLines;
+}
+
+void GutterDiffService::update(TextSnapshot snapshot) {
+	EditWindow window = m_window;
+	constexpr qsizetype kAll = std::numeric_limits<qsizetype>::max();
+	m_window = EditWindow{true, snapshot.version(), kAll, kAll};
+	m_lineCount = snapshot.lineCount();
+
+	std::lock_guard lock(m_pendingMutex);
+	if (m_pending.snapshot) {
+		// The waiting snapshot is dropped, so the edits since the one before
+		// it count too.
+		const EditWindow& older = m_pending.window;
+		window = EditWindow{older.known && window.known, older.baseVersion,
+			std::min(older.prefix, window.prefix), std::min(older.suffix, window.suffix)};
+	}
+	m_pending.snapshot = std::move(snapshot);
+	m_pending.window = window;
+	queuePending();
+}
+
+void GutterDiffService::queuePending() {
+	if (m_queued) return;
+	m_queued = true;
+	m_tasks.submit([this] { runPending(); });
+}
+
+void GutterDiffService::runPending() {
+	Pending pending;
+	{
+		std::lock_guard lock(m_pendingMutex);
+		std::swap(pending, m_pending);
+		m_queued = false;
+	}
+
+	State& state = *m_state;
+	if (pending.path) {
+		state.path = *pending.path;
+		state.text = TextSnapshot();
+		state.current.clear();
+		state.hunks.clear();
+		state.valid = false;
+		if (!state.path.isEmpty()) {
+			state.loadBase();
+		}
+		publish(state.path, state.result(), -1);
+	}
+	if (!pending.snapshot) return;
+
+	const TextSnapshot& snapshot = *pending.snapshot;
+	qsizetype prefix = 0;
+	qsizetype suffix = 0;
+	std::vector<size_t> next = state.rehash(snapshot, pending.window, &prefix, &suffix);
+	if (!state.hasBase) {
+		state.text = snapshot;
+		state.current = std::move(next);
+		return;
+	}
+	if (!state.valid) {
+		state.text = snapshot;
+		state.current = std::move(next);
+		state.diffFull();
+	} else if (!state.diffIncremental(std::move(next), snapshot, prefix, suffix)) {
+		return;
+	}
+	publish(state.path, state.result(), snapshot.version());
+}
+
+void GutterDiffService::publish(const QString& path, DiffHunksPtr hunks, qsizetype version) {
+	QMetaObject::invokeMethod(this, [this, path, hunks, version] {
+		m_hunks = hunks;
+		emit hunksChanged(path, hunks, version);
+	}, Qt::QueuedConnection);
+}
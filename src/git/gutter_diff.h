@@ -0,0 +1,66 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include "../buffer/lineDiff.h"
+#include "../buffer/textBuffer.h"
+#include "../buffer/textSnapshot.h"
+#include "../util/task_scheduler.h"
+
+// Line diff of one open document against its HEAD blob, for gutter markers.
+// The blob is loaded once per HEAD; each new snapshot only rehashes the lines
+// edited since the previous one and re-diffs the hunks around them.
+class GutterDiffService : public QObject {
+	Q_OBJECT
+public:
+	explicit GutterDiffService(QObject* parent = nullptr);
+	~GutterDiffService() override;
+
+	void setFile(const QString& path);
+	void reloadBase();
+	// Records an edit to the document, so the next update() knows which lines
+	// it has to look at.
+	void applyDelta(const TextDelta& delta);
+	void update(TextSnapshot snapshot);
+
+	DiffHunksPtr hunks() const { return m_hunks; }
+
+signals:
+	// Hunks for the file at path, as of the snapshot with the given version;
+	// -1 before any snapshot of the file was diffed.
+	void hunksChanged(const QString& path, DiffHunksPtr hunks, qsizetype version);
+
+private:
+	struct State;
+	// Lines at the start and end that the edits since a snapshot left alone.
+	struct EditWindow {
+		bool known = false;
+		qsizetype baseVersion = 0;
+		qsizetype prefix = 0;
+		qsizetype suffix = 0;
+	};
+	struct Pending {
+		std::optional<QString> path;
+		std::optional<TextSnapshot> snapshot;
+		EditWindow window;
+	};
+
+	// Called with m_pendingMutex held.
+	void queuePending();
+	void runPending();
+	void publish(const QString& path, DiffHunksPtr hunks, qsizetype version);
+
+	std::unique_ptr<State> m_state;
+	TaskSequence m_tasks{TaskPriority::Visible};
+	DiffHunksPtr m_hunks;
+
+	// Edits since the last update(), against a text of m_lineCount lines.
+	EditWindow m_window;
+	qsizetype m_lineCount = 0;
+
+	std::mutex m_pendingMutex;
+	Pending m_pending;
+	bool m_queued = false;
+};
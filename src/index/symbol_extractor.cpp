@@ -0,0 +1,715 @@
+#include "symbol_extractor.h"
+#include <QFileInfo>
+#include <algorithm>
+#include <array>
+#include <initializer_list>
+#include <string_view>
+
+namespace {
+struct Token {
+	enum Type : quint8 { Identifier, Punct, Literal, Directive, End };
+	QByteArrayView text;
+	quint32 line = 0;
+	quint32 column = 0;
+	Type type = End;
+};
+
+bool isIdentifierStart(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == '$' || uchar(c) >= 0x80;
+}
+
+bool isIdentifierChar(char c) {
+	return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Splits C and C++ into identifiers, literals, punctuation and whole
+// preprocessor directives. Comments and whitespace are dropped.
+class CppLexer {
+public:
+	explicit CppLexer(QByteArrayView text) : m_text(text) {}
+
+	Token next() {
+		for (;;) {
+			if (m_pos >= m_text.size()) return {{}, m_line, 0, Token::End};
+			const char c = m_text[m_pos];
+			if (c == '\n') {
+				newLine(m_pos + 1);
+				++m_pos;
+				m_lineHasCode = false;
+				continue;
+			}
+			if (isSpace(c)) {
+				++m_pos;
+				continue;
+			}
+			if (c == '/' && peek(1) == '/') {
+				while (m_pos < m_text.size() && m_text[m_pos] != '\n') ++m_pos;
+				continue;
+			}
+			if (c == '/' && peek(1) == '*') {
+				skipBlockComment();
+				continue;
+			}
+			const qsizetype start = m_pos;
+			const quint32 line = m_line;
+			const quint32 column = quint32(start - m_lineStart) + 1;
+			if (c == '#' && !m_lineHasCode) {
+				skipDirective();
+				return {m_text.sliced(start, m_pos - start), line, column, Token::Directive};
+			}
+			m_lineHasCode = true;
+			if (isIdentifierStart(c)) {
+				while (m_pos < m_text.size() && isIdentifierChar(m_text[m_pos])) ++m_pos;
+				const QByteArrayView word = m_text.sliced(start, m_pos - start);
+				if (peek(0) == '"') {
+					if (word == "R" || word == "u8R" || word == "uR" || word == "UR" || word == "LR") {
+						skipRawString();
+						return {m_text.sliced(start, m_pos - start), line, column, Token::Literal};
+					}
+					if (word == "u8" || word == "u" || word == "U" || word == "L") {
+						skipQuoted('"');
+						return {m_text.sliced(start, m_pos - start), line, column, Token::Literal};
+					}
+				}
+				return {word, line, column, Token::Identifier};
+			}
+			if (c >= '0' && c <= '9') {
+				skipNumber();
+				return {m_text.sliced(start, m_pos - start), line, column, Token::Literal};
+			}
+			if (c == '"' || c == '\'') {
+				skipQuoted(c);
+				return {m_text.sliced(start, m_pos - start), line, column, Token::Literal};
+			}
+			if ((c == ':' && peek(1) == ':') || (c == '-' && peek(1) == '>')) {
+				m_pos += 2;
+			} else {
+				++m_pos;
+			}
+			return {m_text.sliced(start, m_pos - start), line, column, Token::Punct};
+		}
+	}
+
+private:
+	char peek(qsizetype ahead) const {
+		return m_pos + ahead < m_text.size() ? m_text[m_pos + ahead] : '\0';
+	}
+
+	void newLine(qsizetype start) {
+		++m_line;
+		m_lineStart = start;
+	}
+
+	void skipBlockComment() {
+		m_pos += 2;
+		while (m_pos < m_text.size()) {
+			if (m_text[m_pos] == '*' && peek(1) == '/') {
+				m_pos += 2;
+				return;
+			}
+			if (m_text[m_pos] == '\n') newLine(m_pos + 1);
+			++m_pos;
+		}
+	}
+
+	// To the end of the line, following continuations; comments inside are skipped.
+	void skipDirective() {
+		while (m_pos < m_text.size()) {
+			const char c = m_text[m_pos];
+			if (c == '\n') return;
+			if (c == '\\' && peek(1) == '\n') {
+				newLine(m_pos + 2);
+				m_pos += 2;
+				continue;
+			}
+			if (c == '/' && peek(1) == '*') {
+				skipBlockComment();
+				continue;
+			}
+			if (c == '/' && peek(1) == '/') {
+				while (m_pos < m_text.size() && m_text[m_pos] != '\n') ++m_pos;
+				return;
+			}
+			++m_pos;
+		}
+	}
+
+	void skipQuoted(char quote) {
+		++m_pos;
+		while (m_pos < m_text.size()) {
+			const char c = m_text[m_pos];
+			if (c == '\\') {
+				m_pos += 2;
+				continue;
+			}
+			// An unterminated literal ends with its line.
+			if (c == '\n') return;
+			++m_pos;
+			if (c == quote) return;
+		}
+	}
+
+	void skipRawString() {
+		const qsizetype open = m_text.indexOf('(', m_pos);
+		if (open < 0) {
+			m_pos = m_text.size();
+			return;
+		}
+		const QByteArray close = ')' + m_text.sliced(m_pos + 1, open - m_pos - 1).toByteArray() + '"';
+		const qsizetype end = m_text.indexOf(close, open);
+		const qsizetype stop = end < 0 ? m_text.size() : end + close.size();
+		for (qsizetype i = m_pos; i < stop; ++i) {
+			if (m_text[i] == '\n') newLine(i + 1);
+		}
+		m_pos = stop;
+	}
+
+	void skipNumber() {
+		while (m_pos < m_text.size()) {
+			const char c = m_text[m_pos];
+			if (isIdentifierChar(c) || c == '.' || c == '\'') {
+				++m_pos;
+			} else if ((c == '+' || c == '-') && m_pos > 0 && std::string_view("eEpP").find(m_text[m_pos - 1]) != std::string_view::npos) {
+				++m_pos;
+			} else {
+				return;
+			}
+		}
+	}
+
+	QByteArrayView m_text;
+	qsizetype m_pos = 0;
+	qsizetype m_lineStart = 0;
+	quint32 m_line = 1;
+	bool m_lineHasCode = false;
+};
+
+// Tokens of the declaration being read, each with the bracket depth it is at.
+struct StatementToken {
+	Token token;
+	int depth = 0;
+};
+
+struct Scope {
+	enum Kind : quint8 {
+		// Namespaces, classes and extern "C" blocks, whose declarations are read.
+		Declarations,
+		// Function bodies, enumerator lists and initializers, skipped whole.
+		Skipped,
+	};
+	Kind kind = Declarations;
+	// Added to the scope of symbols inside; empty for anonymous and transparent scopes.
+	QByteArray name;
+	// The declaration the scope opened in goes on after it closes, as in
+	// "typedef struct {...} Name;" or "int values[] = {...};".
+	bool keepStatement = false;
+	std::vector<StatementToken> statement;
+	int depth = 0;
+};
+
+constexpr qsizetype kMaxStatementTokens = 1024;
+
+bool isOneOf(QByteArrayView word, std::initializer_list<QByteArrayView> words) {
+	return std::find(words.begin(), words.end(), word) != words.end();
+}
+
+bool isPunct(const StatementToken& t, char c) {
+	return t.token.type == Token::Punct && t.token.text.size() == 1 && t.token.text[0] == c;
+}
+
+bool isWord(const StatementToken& t, QByteArrayView word) {
+	return t.token.type == Token::Identifier && t.token.text == word;
+}
+
+bool isMacroName(QByteArrayView word) {
+	if (word.size() < 2) return false;
+	return std::all_of(word.begin(), word.end(), [](char c) { return (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; });
+}
+
+class CppExtractor {
+public:
+	explicit CppExtractor(QByteArrayView text) : m_lexer(text) {
+		m_scopes.push_back({});
+	}
+
+	std::vector<ExtractedSymbol> run() {
+		for (Token token = m_lexer.next(); token.type != Token::End; token = m_lexer.next()) {
+			if (token.type == Token::Directive) {
+				onDirective(token);
+				continue;
+			}
+			Scope& scope = m_scopes.back();
+			if (scope.kind == Scope::Skipped) {
+				if (token.text == "{") {
+					++scope.depth;
+				} else if (token.text == "}" && --scope.depth < 0) {
+					closeScope();
+				}
+				continue;
+			}
+			onToken(token);
+		}
+		return std::move(m_symbols);
+	}
+
+private:
+	std::vector<StatementToken>& statement() { return m_scopes.back().statement; }
+
+	void onToken(const Token& token) {
+		std::vector<StatementToken>& tokens = statement();
+		const int depth = m_depth;
+		if (token.type == Token::Punct && token.text.size() == 1) {
+			switch (token.text[0]) {
+			case '(':
+			case '[':
+				++m_depth;
+				break;
+			case ')':
+			case ']':
+				m_depth = std::max(0, m_depth - 1);
+				tokens.push_back({token, m_depth});
+				return;
+			case ';':
+				if (depth == 0) {
+					onStatementEnd();
+					clearStatement();
+					return;
+				}
+				break;
+			case '{':
+				openScope();
+				return;
+			case '}':
+				if (m_scopes.size() > 1) {
+					closeScope();
+				} else {
+					clearStatement();
+				}
+				return;
+			case ':':
+				// Access specifiers end whatever came before them, such as Q_OBJECT.
+				if (depth == 0 && !tokens.empty() && isOneOf(tokens.back().token.text,
+						{"public", "protected", "private", "signals", "slots", "Q_SIGNALS", "Q_SLOTS"})) {
+					clearStatement();
+					return;
+				}
+				break;
+			}
+		}
+		if (qsizetype(tokens.size()) >= kMaxStatementTokens) {
+			clearStatement();
+			return;
+		}
+		tokens.push_back({token, depth});
+	}
+
+	void clearStatement() {
+		statement().clear();
+		m_depth = 0;
+	}
+
+	void push(Scope::Kind kind, QByteArray name, bool keepStatement) {
+		Scope scope;
+		scope.kind = kind;
+		scope.name = std::move(name);
+		scope.keepStatement = keepStatement;
+		m_savedDepths.push_back(m_depth);
+		m_depth = 0;
+		m_scopes.push_back(std::move(scope));
+	}
+
+	void closeScope() {
+		const bool keep = m_scopes.back().keepStatement;
+		m_scopes.pop_back();
+		m_depth = m_savedDepths.back();
+		m_savedDepths.pop_back();
+		if (!keep) clearStatement();
+	}
+
+	// Past any template<...> heads and leading specifiers.
+	qsizetype declarationStart(const std::vector<StatementToken>& tokens) const {
+		qsizetype i = 0;
+		const qsizetype n = qsizetype(tokens.size());
+		while (i < n) {
+			if (isWord(tokens[i], "template") && i + 1 < n && isPunct(tokens[i + 1], '<')) {
+				int angles = 0;
+				for (++i; i < n; ++i) {
+					if (tokens[i].depth != tokens[0].depth) continue;
+					if (isPunct(tokens[i], '<')) ++angles;
+					if (isPunct(tokens[i], '>') && --angles == 0) break;
+				}
+				++i;
+				continue;
+			}
+			if (tokens[i].token.type == Token::Identifier && isOneOf(tokens[i].token.text, {"export", "inline", "static", "extern", "constexpr", "consteval"})
+				&& !(isWord(tokens[i], "extern") && i + 1 < n && tokens[i + 1].token.type == Token::Literal)) {
+				++i;
+				continue;
+			}
+			break;
+		}
+		return i;
+	}
+
+	void openScope() {
+		std::vector<StatementToken>& tokens = statement();
+		if (m_depth > 0) {
+			// A lambda or braced list inside parentheses.
+			push(Scope::Skipped, {}, true);
+			return;
+		}
+		const qsizetype n = qsizetype(tokens.size());
+		const qsizetype s = declarationStart(tokens);
+		if (s < n && isWord(tokens[s], "namespace")) {
+			QByteArray name;
+			const Token* at = nullptr;
+			for (qsizetype i = s + 1; i < n; ++i) {
+				const Token& t = tokens[i].token;
+				if (t.type == Token::Identifier && t.text != "inline") {
+					if (!name.isEmpty() && !name.endsWith("::")) name.clear();
+					name += t.text;
+					at = &t;
+				} else if (t.text == "::") {
+					name += "::";
+				}
+			}
+			if (at) {
+				const qsizetype split = name.lastIndexOf("::");
+				const QByteArray last = split < 0 ? name : name.mid(split + 2);
+				const QByteArray qualifier = split < 0 ? QByteArray() : name.left(split);
+				add(last, qualifier, *at, SymbolKind::Namespace);
+			}
+			push(Scope::Declarations, name, false);
+			return;
+		}
+		if (s + 1 < n && isWord(tokens[s], "extern") && tokens[s + 1].token.type == Token::Literal) {
+			push(Scope::Declarations, {}, false);
+			return;
+		}
+		const bool isTypedef = s < n && isWord(tokens[s], "typedef");
+		for (qsizetype k = s; k < n; ++k) {
+			const StatementToken& t = tokens[k];
+			if (t.depth != 0) continue;
+			if (isPunct(t, '(') || isPunct(t, '=')) break;
+			if (t.token.type != Token::Identifier || !isOneOf(t.token.text, {"class", "struct", "union", "enum"})) continue;
+			const SymbolKind kind = t.token.text == "class" ? SymbolKind::Class
+				: t.token.text == "struct" ? SymbolKind::Struct
+				: t.token.text == "union" ? SymbolKind::Union : SymbolKind::Enum;
+			QByteArray name;
+			const Token* at = nullptr;
+			qsizetype i = k + 1;
+			for (; i < n; ++i) {
+				const StatementToken& u = tokens[i];
+				if (u.depth != 0) continue;
+				if (isPunct(u, ':') || isPunct(u, '<')) break;
+				if (u.token.type == Token::Identifier) {
+					if (isOneOf(u.token.text, {"final", "class", "struct", "alignas", "__declspec", "__attribute__"})) continue;
+					// Export macros come before the name.
+					if (!name.isEmpty() && !name.endsWith("::")) name.clear();
+					name += u.token.text;
+					at = &u.token;
+				} else if (u.token.text == "::") {
+					name += "::";
+				} else if (isPunct(u, '(') && at) {
+					break;
+				}
+			}
+			// "struct Foo* make() {" defines a function.
+			if (std::any_of(tokens.begin() + i, tokens.end(), [](const StatementToken& u) { return u.depth == 0 && isPunct(u, '('); })) {
+				break;
+			}
+			if (at) {
+				const qsizetype split = name.lastIndexOf("::");
+				add(split < 0 ? name : name.mid(split + 2), split < 0 ? QByteArray() : name.left(split), *at, kind);
+			}
+			if (kind == SymbolKind::Enum) {
+				push(Scope::Skipped, {}, isTypedef);
+			} else {
+				push(Scope::Declarations, at ? name : QByteArray(), isTypedef);
+			}
+			return;
+		}
+		if (const qsizetype call = functionName(tokens, s); call >= 0) {
+			// A braced member initializer, as in "A::A() : m_a{1}, m_b(2) {"; the
+			// body comes later.
+			const bool initializer = std::any_of(tokens.begin() + call, tokens.end(),
+				[](const StatementToken& u) { return u.depth == 0 && isPunct(u, ':'); });
+			const Token& last = tokens.back().token;
+			if (initializer && (last.type == Token::Identifier || last.text == ">")) {
+				push(Scope::Skipped, {}, true);
+				return;
+			}
+			addFunction(tokens, s, call);
+			push(Scope::Skipped, {}, false);
+			return;
+		}
+		// Initializers go on to their semicolon; anything else not understood is dropped.
+		const bool assigned = std::any_of(tokens.begin() + s, tokens.end(),
+			[](const StatementToken& u) { return u.depth == 0 && isPunct(u, '='); });
+		push(Scope::Skipped, {}, assigned);
+	}
+
+	// The index of the '(' after a function definition's name, or -1.
+	qsizetype functionName(const std::vector<StatementToken>& tokens, qsizetype s) const {
+		const qsizetype n = qsizetype(tokens.size());
+		qsizetype found = -1;
+		for (qsizetype i = s; i < n; ++i) {
+			const StatementToken& t = tokens[i];
+			if (t.depth != 0) continue;
+			if (isWord(t, "operator") && i + 1 < n && tokens[i + 1].token.type == Token::Punct) {
+				// The operator's own symbols, up to its parameters.
+				qsizetype j = i + 1;
+				if (isPunct(tokens[j], '(') && j + 1 < n && isPunct(tokens[j + 1], ')')) {
+					j += 2;
+				} else {
+					while (j < n && tokens[j].token.type == Token::Punct && !isPunct(tokens[j], '(')) ++j;
+				}
+				if (j < n && isPunct(tokens[j], '(')) found = j;
+				i = j;
+				continue;
+			}
+			if (isPunct(t, '=')) return found;
+			// Constructor initializers and trailing return types follow the parameters.
+			if ((isPunct(t, ':') || t.token.text == "->") && found >= 0) return found;
+			if (!isPunct(t, '(') || i == s) continue;
+			const StatementToken& before = tokens[i - 1];
+			if (before.token.type == Token::Identifier) {
+				if (isOneOf(before.token.text, {"noexcept", "throw", "decltype", "alignas", "__attribute__", "__declspec",
+						"requires", "sizeof", "alignof", "static_assert", "if", "for", "while", "switch", "catch", "return"})) {
+					continue;
+				}
+				// A macro invoked on its own, as in TEST(a, b) { ... }, names no function.
+				if (i - 1 == s && isMacroName(before.token.text)) continue;
+				found = i;
+			}
+		}
+		return found;
+	}
+
+	void addFunction(const std::vector<StatementToken>& tokens, qsizetype s, qsizetype call) {
+		qsizetype i = call - 1;
+		QByteArray name;
+		const Token* at = &tokens[i].token;
+		if (tokens[i].token.type != Token::Identifier) {
+			// operator+, operator==, operator() and the like.
+			qsizetype op = i;
+			while (op > s && !isWord(tokens[op], "operator")) --op;
+			name = "operator";
+			for (qsizetype j = op + 1; j < call; ++j) name += tokens[j].token.text;
+			at = &tokens[op].token;
+			i = op;
+		} else {
+			name = tokens[i].token.text.toByteArray();
+			if (i > s && isPunct(tokens[i - 1], '~')) {
+				name.prepend('~');
+				--i;
+			} else if (i > s && isWord(tokens[i - 1], "operator")) {
+				// Conversion operators.
+				name.prepend("operator ");
+				at = &tokens[i - 1].token;
+				--i;
+			}
+		}
+		QByteArray qualifier;
+		while (i >= s + 2 && tokens[i - 1].token.text == "::" && tokens[i - 2].token.type == Token::Identifier) {
+			qualifier.prepend(tokens[i - 2].token.text.toByteArray() + (qualifier.isEmpty() ? "" : "::"));
+			i -= 2;
+		}
+		add(name, qualifier, *at, SymbolKind::Function);
+	}
+
+	void onStatementEnd() {
+		const std::vector<StatementToken>& tokens = statement();
+		const qsizetype n = qsizetype(tokens.size());
+		const qsizetype s = declarationStart(tokens);
+		if (s + 1 < n && isWord(tokens[s], "typedef")) {
+			const StatementToken* name = nullptr;
+			qsizetype group = -1;
+			for (qsizetype i = s + 1; i < n; ++i) {
+				if (tokens[i].depth == 0 && isPunct(tokens[i], '(')) {
+					group = i;
+					break;
+				}
+			}
+			if (group >= 0) {
+				// typedef void (*Name)(int);
+				for (qsizetype i = group + 1; i < n && tokens[i].depth > 0; ++i) {
+					if (tokens[i].token.type == Token::Identifier) name = &tokens[i];
+				}
+			} else {
+				for (qsizetype i = n - 1; i > s; --i) {
+					if (tokens[i].depth == 0 && tokens[i].token.type == Token::Identifier) {
+						name = &tokens[i];
+						break;
+					}
+				}
+			}
+			if (name) add(name->token.text.toByteArray(), {}, name->token, SymbolKind::Type);
+			return;
+		}
+		if (s + 2 < n && isWord(tokens[s], "using") && tokens[s + 1].token.type == Token::Identifier && isPunct(tokens[s + 2], '=')) {
+			add(tokens[s + 1].token.text.toByteArray(), {}, tokens[s + 1].token, SymbolKind::Type);
+		}
+	}
+
+	void onDirective(const Token& token) {
+		QByteArrayView text = token.text.sliced(1).trimmed();
+		if (!text.startsWith("define")) return;
+		text = text.sliced(6);
+		if (text.isEmpty() || !isSpace(text[0])) return;
+		text = text.trimmed();
+		qsizetype end = 0;
+		while (end < text.size() && isIdentifierChar(text[end])) ++end;
+		if (end == 0) return;
+		Token name = token;
+		name.column = token.column + quint32(text.data() - token.text.data());
+		add(text.first(end).toByteArray(), {}, name, SymbolKind::Macro, false);
+	}
+
+	void add(const QByteArray& name, const QByteArray& qualifier, const Token& at, SymbolKind kind, bool scoped = true) {
+		if (name.isEmpty()) return;
+		QByteArray scope;
+		if (scoped) {
+			for (const Scope& s : m_scopes) {
+				if (s.name.isEmpty()) continue;
+				if (!scope.isEmpty()) scope += "::";
+				scope += s.name;
+			}
+			if (!qualifier.isEmpty()) {
+				if (!scope.isEmpty()) scope += "::";
+				scope += qualifier;
+			}
+		}
+		m_symbols.push_back({name, scope, at.line, at.column, kind});
+	}
+
+	CppLexer m_lexer;
+	std::vector<Scope> m_scopes;
+	std::vector<int> m_savedDepths;
+	int m_depth = 0;
+	std::vector<ExtractedSymbol> m_symbols;
+};
+
+std::vector<ExtractedSymbol> extractCMake(QByteArrayView text) {
+	std::vector<ExtractedSymbol> symbols;
+	qsizetype pos = 0;
+	qsizetype lineStart = 0;
+	quint32 line = 1;
+	int depth = 0;
+	const qsizetype n = text.size();
+	auto newLine = [&](qsizetype at) {
+		++line;
+		lineStart = at + 1;
+	};
+	// [[...]], [==[...]==]; pos is at the first '['.
+	auto skipBracket = [&]() -> bool {
+		qsizetype i = pos + 1;
+		while (i < n && text[i] == '=') ++i;
+		if (i >= n || text[i] != '[') return false;
+		const QByteArray close = ']' + QByteArray(i - pos - 1, '=') + ']';
+		const qsizetype end = text.indexOf(close, i);
+		const qsizetype stop = end < 0 ? n : end + close.size();
+		for (qsizetype j = pos; j < stop; ++j) {
+			if (text[j] == '\n') newLine(j);
+		}
+		pos = stop;
+		return true;
+	};
+	while (pos < n) {
+		const char c = text[pos];
+		if (c == '\n') {
+			newLine(pos);
+			++pos;
+		} else if (c == '#') {
+			++pos;
+			if (pos < n && text[pos] == '[' && skipBracket()) continue;
+			while (pos < n && text[pos] != '\n') ++pos;
+		} else if (c == '[' && skipBracket()) {
+		} else if (c == '"') {
+			for (++pos; pos < n && text[pos] != '"'; ++pos) {
+				if (text[pos] == '\\') ++pos;
+				else if (text[pos] == '\n') newLine(pos);
+			}
+			++pos;
+		} else if (c == '(') {
+			++depth;
+			++pos;
+		} else if (c == ')') {
+			depth = std::max(0, depth - 1);
+			++pos;
+		} else if (depth == 0 && isIdentifierStart(c)) {
+			const qsizetype start = pos;
+			while (pos < n && isIdentifierChar(text[pos])) ++pos;
+			const QByteArray command = text.sliced(start, pos - start).toByteArray().toLower();
+			qsizetype open = pos;
+			while (open < n && isSpace(text[open])) ++open;
+			if (open >= n || text[open] != '(') continue;
+			SymbolKind kind;
+			if (command == "function") kind = SymbolKind::Function;
+			else if (command == "macro") kind = SymbolKind::Macro;
+			else if (command == "add_library" || command == "add_executable" || command == "add_custom_target") kind = SymbolKind::Target;
+			else if (command == "option") kind = SymbolKind::Option;
+			else continue;
+			qsizetype arg = open + 1;
+			while (arg < n && (isSpace(text[arg]) || text[arg] == '\n')) {
+				if (text[arg] == '\n') newLine(arg);
+				++arg;
+			}
+			qsizetype end = arg;
+			while (end < n && !isSpace(text[end]) && !QByteArrayView("()#\"\\\n").contains(text[end])) ++end;
+			if (end > arg) {
+				symbols.push_back({text.sliced(arg, end - arg).toByteArray(), {}, line, quint32(arg - lineStart) + 1, kind});
+			}
+			pos = arg;
+		} else {
+			++pos;
+		}
+	}
+	return symbols;
+}
+}
+
+SymbolExtractor::Language SymbolExtractor::languageFor(const QString& path) {
+	const QString name = QFileInfo(path).fileName();
+	if (name == QLatin1StringView("CMakeLists.txt")) return Language::CMake;
+	const QString suffix = QFileInfo(path).suffix().toLower();
+	if (suffix == QLatin1StringView("cmake")) return Language::CMake;
+	static const std::array<QLatin1StringView, 12> cpp{
+		QLatin1StringView("c"), QLatin1StringView("cc"), QLatin1StringView("cpp"), QLatin1StringView("cxx"),
+		QLatin1StringView("c++"), QLatin1StringView("h"), QLatin1StringView("hh"), QLatin1StringView("hpp"),
+		QLatin1StringView("hxx"), QLatin1StringView("ipp"), QLatin1StringView("inl"), QLatin1StringView("tpp"),
+	};
+	return std::find(cpp.begin(), cpp.end(), suffix) != cpp.end() ? Language::Cpp : Language::None;
+}
+
+std::vector<ExtractedSymbol> SymbolExtractor::extract(QByteArrayView text, Language language) {
+	switch (language) {
+	case Language::Cpp:
+		return CppExtractor(text).run();
+	case Language::CMake:
+		return extractCMake(text);
+	case Language::None:
+		break;
+	}
+	return {};
+}
+
+const char* SymbolExtractor::kindName(SymbolKind kind) {
+	switch (kind) {
+	case SymbolKind::Namespace: return "namespace";
+	case SymbolKind::Class: return "class";
+	case SymbolKind::Struct: return "struct";
+	case SymbolKind::Union: return "union";
+	case SymbolKind::Enum: return "enum";
+	case SymbolKind::Function: return "function";
+	case SymbolKind::Type: return "type";
+	case SymbolKind::Macro: return "macro";
+	case SymbolKind::Target: return "target";
+	case SymbolKind::Option: return "option";
+	}
+	return "";
+}
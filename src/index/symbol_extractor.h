@@ -0,0 +1,44 @@
+#pragma once
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <vector>
+
+enum class SymbolKind : quint8 {
+	Namespace,
+	Class,
+	Struct,
+	Union,
+	Enum,
+	Function,
+	Type,
+	Macro,
+	// CMake targets and options.
+	Target,
+	Option,
+};
+
+struct ExtractedSymbol {
+	// UTF-8. The scope is the enclosing namespaces and classes joined by "::".
+	QByteArray name;
+	QByteArray scope;
+	// 1-based; the column counts bytes.
+	quint32 line = 0;
+	quint32 column = 0;
+	SymbolKind kind = SymbolKind::Function;
+};
+
+// A declaration scanner, not a parser: it finds namespaces, type definitions,
+// function definitions, typedefs, aliases and macros in C and C++, and
+// functions, macros, targets and options in CMake, from tokens and brace
+// nesting alone. Function bodies are skipped. Safe to call from any thread.
+namespace SymbolExtractor {
+	enum class Language { None, Cpp, CMake };
+	// Changes whenever the same text would give different symbols, so tables
+	// made by another version are rebuilt.
+	constexpr quint16 kVersion = 1;
+
+	Language languageFor(const QString& path);
+	std::vector<ExtractedSymbol> extract(QByteArrayView text, Language language);
+	const char* kindName(SymbolKind kind);
+}
@@ -0,0 +1,423 @@
+#include "symbol_index.h"
+#include "work_stealing.h"
+#include "../util/trace.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <algorithm>
+#include <atomic>
+
+namespace {
+struct Candidate {
+	QByteArray relative;
+	QString path;
+	qint64 modified = 0;
+	qint64 size = 0;
+};
+
+struct Extracted {
+	bool read = false;
+	quint64 hash = 0;
+	std::vector<ExtractedSymbol> symbols;
+};
+
+bool isIndexed(const QFileInfo& info) {
+	return info.size() <= SymbolIndex::kMaxFileBytes
+		&& SymbolExtractor::languageFor(info.fileName()) != SymbolExtractor::Language::None;
+}
+
+// Build trees are full of generated copies and dependencies nobody edits.
+bool isSkippedDir(const QFileInfo& info) {
+	return info.fileName().startsWith(QLatin1Char('.')) || info.fileName() == QLatin1String("node_modules")
+		|| QFileInfo::exists(info.filePath() + QStringLiteral("/CMakeCache.txt"));
+}
+
+SymbolLocation locationOf(const QString& root, QByteArrayView path, const SymbolView& symbol) {
+	SymbolLocation location;
+	location.name = QString::fromUtf8(symbol.name);
+	location.scope = QString::fromUtf8(symbol.scope);
+	location.path = root + QLatin1Char('/') + QString::fromUtf8(path);
+	location.line = int(symbol.line);
+	location.column = int(symbol.column);
+	location.kind = symbol.kind;
+	return location;
+}
+}
+
+struct SymbolIndex::State {
+	QString root;
+	QString cachePath;
+	SymbolTablePtr table;
+	QHash<QByteArray, IndexedFile> overlay;
+	QSet<quint32> masked;
+	// Set by the GUI thread; a sync whose generation no longer matches stops early.
+	std::atomic<quint64> generation = 0;
+
+	bool stale(quint64 expected) const { return generation.load(std::memory_order_relaxed) != expected; }
+	bool walk(const QString& dir, quint64 expected, std::vector<Candidate>& out) const;
+	bool upToDate(const QByteArray& relative, qint64 modified, qint64 size) const;
+	void sync(quint64 expected);
+	void update(const QStringList& paths, quint64 expected);
+	void index(const std::vector<Candidate>& work, quint64 expected);
+	void remove(const QByteArray& relative);
+	bool compact(QString* error);
+	void finish();
+	SymbolIndexSnapshotPtr makeSnapshot() const;
+};
+
+bool SymbolIndex::State::walk(const QString& dir, quint64 expected, std::vector<Candidate>& out) const {
+	if (stale(expected)) return false;
+	const QFileInfoList entries = QDir(dir).entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+	for (const QFileInfo& info : entries) {
+		if (info.isDir()) {
+			if (!isSkippedDir(info) && !walk(info.filePath(), expected, out)) return false;
+		} else if (isIndexed(info)) {
+			out.push_back({info.filePath().mid(root.size() + 1).toUtf8(), info.filePath(),
+				info.lastModified().toMSecsSinceEpoch(), info.size()});
+		}
+	}
+	return true;
+}
+
+bool SymbolIndex::State::upToDate(const QByteArray& relative, qint64 modified, qint64 size) const {
+	auto it = overlay.constFind(relative);
+	if (it != overlay.cend()) {
+		return it->state != IndexedFile::Removed && it->modified == modified && it->size == size;
+	}
+	const qint64 file = table ? table->findFile(relative) : -1;
+	return file >= 0 && table->fileModified(quint32(file)) == modified && table->fileSize(quint32(file)) == size;
+}
+
+void SymbolIndex::State::sync(quint64 expected) {
+	IDE_TRACE_SPAN("SymbolIndex::sync");
+	std::vector<Candidate> found;
+	if (!walk(root, expected, found)) return;
+
+	QSet<QByteArray> seen;
+	seen.reserve(qsizetype(found.size()));
+	std::vector<Candidate> work;
+	for (Candidate& candidate : found) {
+		seen.insert(candidate.relative);
+		if (!upToDate(candidate.relative, candidate.modified, candidate.size)) {
+			work.push_back(std::move(candidate));
+		}
+	}
+	QList<QByteArray> gone;
+	for (auto it = overlay.cbegin(); it != overlay.cend(); ++it) {
+		if (it->state != IndexedFile::Removed && !seen.contains(it.key())) gone.append(it.key());
+	}
+	for (quint32 file = 0; table && file < table->fileCount(); ++file) {
+		if (masked.contains(file)) continue;
+		const QByteArray path = table->filePath(file).toByteArray();
+		if (!seen.contains(path) && !overlay.contains(path)) gone.append(path);
+	}
+	for (const QByteArray& relative : gone) {
+		remove(relative);
+	}
+	index(work, expected);
+}
+
+void SymbolIndex::State::update(const QStringList& paths, quint64 expected) {
+	std::vector<Candidate> work;
+	for (const QString& path : paths) {
+		const QFileInfo info(path);
+		if (SymbolExtractor::languageFor(info.fileName()) == SymbolExtractor::Language::None) continue;
+		const QByteArray relative = path.mid(root.size() + 1).toUtf8();
+		if (!info.isFile() || !isIndexed(info)) {
+			remove(relative);
+			continue;
+		}
+		const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+		if (!upToDate(relative, modified, info.size())) {
+			work.push_back({relative, path, modified, info.size()});
+		}
+	}
+	index(work, expected);
+}
+
+void SymbolIndex::State::index(const std::vector<Candidate>& work, quint64 expected) {
+	if (work.empty()) return;
+	IDE_TRACE_SPAN("SymbolIndex::index");
+	std::vector<Extracted> results(work.size());
+	WorkStealing::parallelFor(qsizetype(work.size()), [&](qsizetype i, int) {
+		if (stale(expected)) return;
+		const Candidate& candidate = work[std::size_t(i)];
+		QFile file(candidate.path);
+		if (!file.open(QIODevice::ReadOnly)) return;
+		const QByteArray bytes = file.readAll();
+		Extracted& result = results[std::size_t(i)];
+		result.read = true;
+		result.hash = qHash(QByteArrayView(bytes), 0);
+		// Unchanged contents keep the symbols already in the table.
+		const qint64 tableFile = table ? table->findFile(candidate.relative) : -1;
+		if (tableFile >= 0 && table->fileHash(quint32(tableFile)) == result.hash) return;
+		result.symbols = SymbolExtractor::extract(bytes, SymbolExtractor::languageFor(candidate.path));
+	});
+	if (stale(expected)) return;
+
+	for (std::size_t i = 0; i < work.size(); ++i) {
+		const Candidate& candidate = work[i];
+		Extracted& result = results[i];
+		if (!result.read) {
+			remove(candidate.relative);
+			continue;
+		}
+		IndexedFile indexed;
+		indexed.modified = candidate.modified;
+		indexed.size = candidate.size;
+		indexed.hash = result.hash;
+		const qint64 tableFile = table ? table->findFile(candidate.relative) : -1;
+		if (tableFile >= 0 && table->fileHash(quint32(tableFile)) == result.hash) {
+			indexed.state = IndexedFile::Touched;
+			masked.remove(quint32(tableFile));
+		} else {
+			indexed.symbols = std::make_shared<const std::vector<ExtractedSymbol>>(std::move(result.symbols));
+			if (tableFile >= 0) masked.insert(quint32(tableFile));
+		}
+		overlay.insert(candidate.relative, std::move(indexed));
+	}
+}
+
+void SymbolIndex::State::remove(const QByteArray& relative) {
+	const qint64 tableFile = table ? table->findFile(relative) : -1;
+	if (tableFile < 0) {
+		overlay.remove(relative);
+		return;
+	}
+	IndexedFile removed;
+	removed.state = IndexedFile::Removed;
+	overlay.insert(relative, removed);
+	masked.insert(quint32(tableFile));
+}
+
+bool SymbolIndex::State::compact(QString* error) {
+	IDE_TRACE_SPAN("SymbolIndex::compact");
+	SymbolTable::Builder builder(table);
+	QSet<quint32> replaced = masked;
+	for (auto it = overlay.cbegin(); it != overlay.cend(); ++it) {
+		const IndexedFile& indexed = *it;
+		if (indexed.state == IndexedFile::Changed) {
+			builder.addFile(it.key(), indexed.modified, indexed.size, indexed.hash, *indexed.symbols);
+		} else if (indexed.state == IndexedFile::Touched) {
+			const qint64 tableFile = table ? table->findFile(it.key()) : -1;
+			if (tableFile < 0) continue;
+			builder.addBaseFile(quint32(tableFile), indexed.modified, indexed.size);
+			replaced.insert(quint32(tableFile));
+		}
+	}
+	for (quint32 file = 0; table && file < table->fileCount(); ++file) {
+		if (!replaced.contains(file)) {
+			builder.addBaseFile(file, table->fileModified(file), table->fileSize(file));
+		}
+	}
+	QByteArray bytes = builder.finish();
+	bool written = SymbolTable::write(cachePath, bytes, error);
+	SymbolTablePtr next = written ? SymbolTable::open(cachePath, error) : nullptr;
+	if (!next) {
+		// Keep going from memory; the next compaction tries the file again.
+		written = false;
+		next = SymbolTable::fromBytes(std::move(bytes));
+	}
+	if (next) {
+		table = std::move(next);
+		overlay.clear();
+		masked.clear();
+	}
+	return written;
+}
+
+void SymbolIndex::State::finish() {
+	if (!root.isEmpty() && !overlay.isEmpty()) {
+		compact(nullptr);
+	}
+	root.clear();
+	cachePath.clear();
+	table.reset();
+	overlay.clear();
+	masked.clear();
+}
+
+SymbolIndexSnapshotPtr SymbolIndex::State::makeSnapshot() const {
+	auto snap = std::make_shared<SymbolIndexSnapshot>();
+	snap->root = root;
+	snap->table = table;
+	snap->overlay = overlay;
+	snap->masked = masked;
+	return snap;
+}
+
+qsizetype SymbolIndexSnapshot::fileCount() const {
+	qsizetype count = table ? table->fileCount() - masked.size() : 0;
+	for (const IndexedFile& indexed : overlay) {
+		count += indexed.state == IndexedFile::Changed ? 1 : 0;
+	}
+	return count;
+}
+
+std::vector<SymbolLocation> SymbolIndexSnapshot::find(QStringView prefix, qsizetype limit) const {
+	IDE_TRACE_SPAN("SymbolIndex::find");
+	struct Hit {
+		QByteArrayView name;
+		QByteArrayView path;
+		SymbolView symbol;
+	};
+	const QByteArray needle = prefix.toUtf8();
+	std::vector<Hit> hits;
+	if (table) {
+		table->forEachPrefix(needle, [&](const SymbolView& symbol, quint32 file) {
+			if (masked.contains(file)) return true;
+			hits.push_back({symbol.name, table->filePath(file), symbol});
+			return qsizetype(hits.size()) < limit;
+		});
+	}
+	for (auto it = overlay.cbegin(); it != overlay.cend(); ++it) {
+		if (it->state != IndexedFile::Changed) continue;
+		for (const ExtractedSymbol& symbol : *it->symbols) {
+			if (!SymbolTable::hasPrefix(symbol.name, needle)) continue;
+			hits.push_back({symbol.name, it.key(), {symbol.name, symbol.scope, symbol.line, symbol.column, symbol.kind}});
+		}
+	}
+	std::stable_sort(hits.begin(), hits.end(),
+		[](const Hit& a, const Hit& b) { return SymbolTable::compareNames(a.name, b.name) < 0; });
+	if (qsizetype(hits.size()) > limit) hits.resize(std::size_t(limit));
+
+	std::vector<SymbolLocation> locations;
+	locations.reserve(hits.size());
+	for (const Hit& hit : hits) {
+		locations.push_back(locationOf(root, hit.path, hit.symbol));
+	}
+	return locations;
+}
+
+SymbolIndex::SymbolIndex(QObject* parent) : QObject(parent), m_state(new State) {}
+
+SymbolIndex::~SymbolIndex() {
+	// Stops a sync that is still running, then writes out what it has.
+	m_state->generation.store(++m_generation);
+	m_tasks.stop();
+	m_state->finish();
+}
+
+QString SymbolIndex::cachePath(const QString& root) {
+	const QByteArray key = QCryptographicHash::hash(QDir::cleanPath(root).toUtf8(), QCryptographicHash::Sha1).toHex();
+	return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/symbols/")
+		+ QString::fromLatin1(key.left(16)) + QStringLiteral(".idx");
+}
+
+void SymbolIndex::open(const QString& root) {
+	const QString cleaned = QDir::cleanPath(root);
+	if (cleaned == m_root) return;
+	close();
+	m_root = cleaned;
+	const quint64 generation = ++m_generation;
+	m_state->generation.store(generation);
+	watch(true);
+
+	State* state = m_state.get();
+	m_tasks.submit([this, state, generation, cleaned] {
+		state->root = cleaned;
+		state->cachePath = cachePath(cleaned);
+		// Missing or from another version: built from scratch below.
+		state->table = SymbolTable::open(state->cachePath);
+		if (state->table) {
+			SymbolIndexSnapshotPtr snap = state->makeSnapshot();
+			QMetaObject::invokeMethod(this, [this, generation, snap] {
+				if (generation == m_generation) publish(snap);
+			}, Qt::QueuedConnection);
+		}
+		const bool cold = !state->table;
+		state->sync(generation);
+		if (state->stale(generation)) return;
+		QString error;
+		if ((cold || state->overlay.size() > kCompactFiles) && !state->compact(&error) && !error.isEmpty()) {
+			QMetaObject::invokeMethod(this, [this, error] { emit indexError(error); }, Qt::QueuedConnection);
+		}
+		SymbolIndexSnapshotPtr snap = state->makeSnapshot();
+		QMetaObject::invokeMethod(this, [this, generation, snap] {
+			if (generation == m_generation) publish(snap);
+		}, Qt::QueuedConnection);
+	});
+}
+
+void SymbolIndex::close() {
+	if (m_root.isEmpty()) return;
+	watch(false);
+	m_root.clear();
+	m_snapshot.reset();
+	m_state->generation.store(++m_generation);
+	State* state = m_state.get();
+	m_tasks.submit([state] { state->finish(); });
+}
+
+void SymbolIndex::setWatcher(FsWatcher* watcher) {
+	if (m_watcher == watcher) return;
+	watch(false);
+	if (m_watcher) {
+		disconnect(m_watcher, nullptr, this, nullptr);
+	}
+	m_watcher = watcher;
+	if (m_watcher) {
+		connect(m_watcher, &FsWatcher::changed, this, &SymbolIndex::onFilesChanged);
+	}
+	watch(true);
+}
+
+void SymbolIndex::watch(bool on) {
+	if (!m_watcher || m_root.isEmpty()) return;
+	if (on) {
+		m_watcher->addDirectory(m_root, true);
+	} else {
+		m_watcher->removeDirectory(m_root, true);
+	}
+}
+
+void SymbolIndex::onFilesChanged(const FsChangeBatch& batch) {
+	if (m_root.isEmpty()) return;
+	const QString prefix = m_root + QLatin1Char('/');
+	bool full = false;
+	QStringList paths;
+	for (const FsChange& change : batch) {
+		const bool inside = change.path.startsWith(prefix) || change.from.startsWith(prefix);
+		if (change.kinds & FsChange::Rescan) {
+			full |= inside || change.path == m_root;
+			continue;
+		}
+		if (!inside) continue;
+		if (change.isDir) {
+			// Files in a new directory are reported on their own.
+			full |= (change.kinds & (FsChange::Removed | FsChange::Renamed)) != 0;
+			continue;
+		}
+		if (change.path.startsWith(prefix)) paths.append(change.path);
+		if (change.from.startsWith(prefix)) paths.append(change.from);
+	}
+	if (!full && paths.isEmpty()) return;
+
+	const quint64 generation = m_generation;
+	State* state = m_state.get();
+	m_tasks.submit([this, state, generation, full, paths] {
+		if (state->stale(generation) || state->root.isEmpty()) return;
+		if (full) {
+			state->sync(generation);
+		} else {
+			state->update(paths, generation);
+		}
+		if (state->stale(generation)) return;
+		QString error;
+		if (state->overlay.size() > kCompactFiles && !state->compact(&error) && !error.isEmpty()) {
+			QMetaObject::invokeMethod(this, [this, error] { emit indexError(error); }, Qt::QueuedConnection);
+		}
+		SymbolIndexSnapshotPtr snap = state->makeSnapshot();
+		QMetaObject::invokeMethod(this, [this, generation, snap] {
+			if (generation == m_generation) publish(snap);
+		}, Qt::QueuedConnection);
+	});
+}
+
+void SymbolIndex::publish(SymbolIndexSnapshotPtr snapshot) {
+	m_snapshot = std::move(snapshot);
+	emit updated(m_snapshot);
+}
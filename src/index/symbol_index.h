@@ -0,0 +1,97 @@
+#pragma once
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <memory>
+#include <vector>
+#include "symbol_table.h"
+#include "../util/fs_watcher.h"
+#include "../util/task_scheduler.h"
+
+
+struct SymbolLocation {
+	QString name;
+	QString scope;
+	QString path;
+	int line = 0;
+	int column = 0;
+	SymbolKind kind = SymbolKind::Function;
+};
+
+// A file indexed since the table was written.
+struct IndexedFile {
+	qint64 modified = -1;
+	qint64 size = -1;
+	quint64 hash = 0;
+	enum State : quint8 {
+		Changed,
+		// Same contents as in the table, which still holds its symbols.
+		Touched,
+		Removed,
+	};
+	State state = Changed;
+	std::shared_ptr<const std::vector<ExtractedSymbol>> symbols;
+};
+
+// The index at one moment: the table on disk plus the files indexed since,
+// which hide their older entries in the table. Immutable; queries are safe
+// from any thread.
+struct SymbolIndexSnapshot {
+	QString root;
+	SymbolTablePtr table;
+	// By path relative to the root.
+	QHash<QByteArray, IndexedFile> overlay;
+	// Table files the overlay replaces or removes.
+	QSet<quint32> masked;
+
+	qsizetype fileCount() const;
+	// Symbols whose names start with prefix, ignoring ASCII case, in name order.
+	std::vector<SymbolLocation> find(QStringView prefix, qsizetype limit) const;
+};
+using SymbolIndexSnapshotPtr = std::shared_ptr<const SymbolIndexSnapshot>;
+
+// Indexes the C, C++ and CMake files under a root at background priority on
+// the task scheduler, with the extraction itself spread over all cores. The table is cached on disk per
+// root and used as soon as it is mapped; only files whose size or mtime moved
+// since are read again, and only those whose contents changed are re-indexed.
+// After that, changes reported by the watcher are indexed as they come, and
+// the table is rewritten once enough files have changed, or on close.
+class SymbolIndex : public QObject {
+	Q_OBJECT
+public:
+	static constexpr qsizetype kCompactFiles = 256;
+	static constexpr qint64 kMaxFileBytes = 4 * 1024 * 1024;
+
+	explicit SymbolIndex(QObject* parent = nullptr);
+	~SymbolIndex() override;
+
+	// Not owned. The root is watched through it.
+	void setWatcher(FsWatcher* watcher);
+	void open(const QString& root);
+	void close();
+	QString root() const { return m_root; }
+	SymbolIndexSnapshotPtr snapshot() const { return m_snapshot; }
+
+	static QString cachePath(const QString& root);
+
+signals:
+	void updated(SymbolIndexSnapshotPtr snapshot);
+	void indexError(const QString& message);
+
+private:
+	struct State;
+
+	void watch(bool on);
+	void onFilesChanged(const FsChangeBatch& batch);
+	void publish(SymbolIndexSnapshotPtr snapshot);
+
+	std::unique_ptr<State> m_state;
+	TaskSequence m_tasks{TaskPriority::Background};
+	FsWatcher* m_watcher = nullptr;
+	QString m_root;
+	// Bumped by open() and close(); work for an older root is dropped.
+	quint64 m_generation = 0;
+	SymbolIndexSnapshotPtr m_snapshot;
+};
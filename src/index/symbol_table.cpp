@@ -0,0 +1,514 @@
+#include "symbol_table.h"
+#include "../util/trace.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace {
+constexpr char kMagic[8] = {'I', 'D', 'E', 'S', 'Y', 'M', 'B', '\0'};
+
+// Offsets into the header.
+enum : quint32 {
+	kMagicAt = 0,
+	kMajorAt = 8,
+	kMinorAt = 10,
+	kHeaderSizeAt = 12,
+	kFileCountAt = 16,
+	kFileSizeAt = 20,
+	kBlockCountAt = 24,
+	kBlockSizeAt = 28,
+	kSymbolCountAt = 32,
+	kSymbolSizeAt = 36,
+	kStringBytesAt = 40,
+	kExtractorAt = 44,
+	kCarriedAt = 46,
+	kHeaderSize = 48,
+};
+// Offsets into a file record.
+enum : quint32 {
+	kPathOffsetAt = 0,
+	kPathLengthAt = 4,
+	kModifiedAt = 8,
+	kFileSizeFieldAt = 16,
+	kBlockAt = 24,
+	kFileSize = 32,
+};
+// Offsets into a block record.
+enum : quint32 {
+	kHashAt = 0,
+	kFirstSymbolAt = 8,
+	kSymbolsAt = 12,
+	kFirstFileRefAt = 16,
+	kFileRefsAt = 20,
+	kBlockSize = 24,
+};
+// Offsets into a symbol record.
+enum : quint32 {
+	kNameOffsetAt = 0,
+	kNameLengthAt = 4,
+	kScopeOffsetAt = 8,
+	kScopeLengthAt = 12,
+	kLineAt = 16,
+	kColumnAt = 20,
+	kKindAt = 22,
+	kSymbolSize = 24,
+};
+constexpr quint32 kNone = std::numeric_limits<quint32>::max();
+// Rebuilds copy the previous string table whole, strings of dropped files
+// included, this many times in a row before interning everything afresh.
+constexpr quint16 kMaxCarried = 8;
+
+template <typename T>
+T load(const uchar* data, quint32 at) {
+	return qFromLittleEndian<T>(data + at);
+}
+
+template <typename T>
+void store(QByteArray& out, qsizetype at, T value) {
+	qToLittleEndian<T>(value, out.data() + at);
+}
+
+bool fail(QString* error, const QString& message) {
+	if (error) {
+		*error = message;
+	}
+	return false;
+}
+
+char fold(char c) {
+	return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+}
+
+// Compares ASCII case foldings.
+int compareFolded(QByteArrayView a, QByteArrayView b) {
+	const qsizetype n = std::min(a.size(), b.size());
+	for (qsizetype i = 0; i < n; ++i) {
+		const char x = fold(a[i]);
+		const char y = fold(b[i]);
+		if (x != y) return uchar(x) < uchar(y) ? -1 : 1;
+	}
+	return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+}
+}
+
+int SymbolTable::compareNames(QByteArrayView a, QByteArrayView b) {
+	if (const int folded = compareFolded(a, b)) return folded;
+	return a.compare(b);
+}
+
+bool SymbolTable::hasPrefix(QByteArrayView name, QByteArrayView prefix) {
+	return name.size() >= prefix.size() && compareFolded(name.first(prefix.size()), prefix) == 0;
+}
+
+struct SymbolTable::Builder::State {
+	struct File {
+		QByteArray path;
+		qint64 modified = 0;
+		qint64 size = 0;
+		quint64 hash = 0;
+		// A base table file, or symbols of its own.
+		quint32 baseFile = kNone;
+		quint32 pathOffset = kNone;
+		std::vector<ExtractedSymbol> symbols;
+	};
+	SymbolTablePtr base;
+	std::vector<File> files;
+};
+
+SymbolTable::Builder::Builder(SymbolTablePtr base) : m_state(new State) {
+	m_state->base = std::move(base);
+}
+
+SymbolTable::Builder::~Builder() = default;
+
+void SymbolTable::Builder::addFile(QByteArrayView path, qint64 modified, qint64 size, quint64 hash, std::vector<ExtractedSymbol> symbols) {
+	m_state->files.push_back({path.toByteArray(), modified, size, hash, kNone, kNone, std::move(symbols)});
+}
+
+void SymbolTable::Builder::addBaseFile(quint32 file, qint64 modified, qint64 size) {
+	const SymbolTable& base = *m_state->base;
+	const uchar* r = base.fileRecord(file);
+	m_state->files.push_back({base.filePath(file).toByteArray(), modified, size, base.fileHash(file), file,
+		r ? load<quint32>(r, kPathOffsetAt) : kNone, {}});
+}
+
+QByteArray SymbolTable::Builder::finish() {
+	IDE_TRACE_SPAN("SymbolTable::Builder::finish");
+	std::vector<State::File>& files = m_state->files;
+	const SymbolTable* base = m_state->base.get();
+	std::sort(files.begin(), files.end(), [](const State::File& a, const State::File& b) { return a.path < b.path; });
+
+	// One block per distinct content, taken from the first file with it.
+	struct Block {
+		quint64 hash = 0;
+		quint32 source = 0;
+		quint32 firstSymbol = 0;
+		quint32 symbolCount = 0;
+		quint32 firstFileRef = 0;
+		quint32 fileRefCount = 0;
+	};
+	std::vector<Block> blocks;
+	std::vector<quint32> fileBlocks(files.size());
+	QHash<quint64, quint32> blockByHash;
+	for (quint32 i = 0; i < quint32(files.size()); ++i) {
+		auto it = blockByHash.constFind(files[i].hash);
+		if (it == blockByHash.constEnd()) {
+			it = blockByHash.insert(files[i].hash, quint32(blocks.size()));
+			blocks.push_back({files[i].hash, i});
+		}
+		fileBlocks[i] = it.value();
+		++blocks[it.value()].fileRefCount;
+	}
+
+	// Strings of carried over symbols keep their offsets if the base string
+	// table is copied.
+	const bool carryStrings = base && base->m_carried < kMaxCarried;
+	QByteArray strings;
+	if (carryStrings) {
+		strings = base->string(0, base->m_stringBytes).toByteArray();
+	}
+
+	// Symbols, block after block, with views of the strings they keep.
+	struct Symbol {
+		QByteArrayView name;
+		QByteArrayView scope;
+		quint32 line = 0;
+		quint32 column = 0;
+		SymbolKind kind = SymbolKind::Function;
+		quint32 nameOffset = kNone;
+		quint32 scopeOffset = kNone;
+	};
+	std::vector<Symbol> symbols;
+	std::vector<quint32> fromBase(base ? base->symbolCount() : 0, kNone);
+	std::vector<quint32> fresh;
+	for (Block& block : blocks) {
+		const State::File& source = files[block.source];
+		block.firstSymbol = quint32(symbols.size());
+		if (source.baseFile != kNone) {
+			const uchar* file = base->fileRecord(source.baseFile);
+			const uchar* record = file ? base->blockRecord(load<quint32>(file, kBlockAt)) : nullptr;
+			const quint32 first = record ? load<quint32>(record, kFirstSymbolAt) : 0;
+			const quint32 count = record ? load<quint32>(record, kSymbolsAt) : 0;
+			for (quint32 s = first; s < first + count && s < base->symbolCount(); ++s) {
+				const SymbolView view = base->symbol(s);
+				fromBase[s] = quint32(symbols.size());
+				symbols.push_back({view.name, view.scope, view.line, view.column, view.kind});
+				if (carryStrings && !view.name.isEmpty()) {
+					const uchar* r = base->symbolRecord(s);
+					symbols.back().nameOffset = load<quint32>(r, kNameOffsetAt);
+					symbols.back().scopeOffset = view.scope.isEmpty() ? kNone : load<quint32>(r, kScopeOffsetAt);
+				}
+			}
+		} else {
+			for (const ExtractedSymbol& symbol : source.symbols) {
+				fresh.push_back(quint32(symbols.size()));
+				symbols.push_back({symbol.name, symbol.scope, symbol.line, symbol.column, symbol.kind});
+			}
+		}
+		block.symbolCount = quint32(symbols.size()) - block.firstSymbol;
+	}
+
+	// The base order still holds for the symbols carried over; only the new
+	// ones are sorted, and the two merged.
+	auto byName = [&symbols](quint32 a, quint32 b) { return compareNames(symbols[a].name, symbols[b].name) < 0; };
+	std::sort(fresh.begin(), fresh.end(), byName);
+	std::vector<quint32> carried;
+	if (base) {
+		carried.reserve(base->symbolCount());
+		for (quint32 i = 0; i < base->symbolCount(); ++i) {
+			const quint32 index = base->orderAt(i);
+			if (index < fromBase.size() && fromBase[index] != kNone) carried.push_back(fromBase[index]);
+		}
+	}
+	std::vector<quint32> order(carried.size() + fresh.size());
+	std::merge(carried.begin(), carried.end(), fresh.begin(), fresh.end(), order.begin(), byName);
+
+	// Files of each block, in path order.
+	quint32 next = 0;
+	for (Block& block : blocks) {
+		block.firstFileRef = next;
+		next += block.fileRefCount;
+		block.fileRefCount = 0;
+	}
+	std::vector<quint32> fileRefs(files.size());
+	for (quint32 i = 0; i < quint32(files.size()); ++i) {
+		Block& block = blocks[fileBlocks[i]];
+		fileRefs[block.firstFileRef + block.fileRefCount++] = i;
+	}
+
+	QHash<QByteArrayView, quint32> interned;
+	auto intern = [&](QByteArrayView text, quint32 offset = kNone) {
+		if (offset != kNone) return std::pair(offset, quint32(text.size()));
+		auto it = interned.constFind(text);
+		if (it == interned.constEnd()) {
+			it = interned.insert(text, quint32(strings.size()));
+			strings += text;
+		}
+		return std::pair(it.value(), quint32(text.size()));
+	};
+
+	const qsizetype filesAt = kHeaderSize;
+	const qsizetype blocksAt = filesAt + qsizetype(files.size()) * kFileSize;
+	const qsizetype symbolsAt = blocksAt + qsizetype(blocks.size()) * kBlockSize;
+	const qsizetype fileRefsAt = symbolsAt + qsizetype(symbols.size()) * kSymbolSize;
+	const qsizetype orderAt = fileRefsAt + qsizetype(fileRefs.size()) * 4;
+	const qsizetype stringsAt = orderAt + qsizetype(order.size()) * 4;
+	QByteArray out(stringsAt, '\0');
+	for (std::size_t i = 0; i < files.size(); ++i) {
+		const qsizetype at = filesAt + qsizetype(i) * kFileSize;
+		const auto [offset, length] = intern(files[i].path, carryStrings ? files[i].pathOffset : kNone);
+		store<quint32>(out, at + kPathOffsetAt, offset);
+		store<quint32>(out, at + kPathLengthAt, length);
+		store<qint64>(out, at + kModifiedAt, files[i].modified);
+		store<qint64>(out, at + kFileSizeFieldAt, files[i].size);
+		store<quint32>(out, at + kBlockAt, fileBlocks[i]);
+	}
+	for (std::size_t i = 0; i < blocks.size(); ++i) {
+		const qsizetype at = blocksAt + qsizetype(i) * kBlockSize;
+		store<quint64>(out, at + kHashAt, blocks[i].hash);
+		store<quint32>(out, at + kFirstSymbolAt, blocks[i].firstSymbol);
+		store<quint32>(out, at + kSymbolsAt, blocks[i].symbolCount);
+		store<quint32>(out, at + kFirstFileRefAt, blocks[i].firstFileRef);
+		store<quint32>(out, at + kFileRefsAt, blocks[i].fileRefCount);
+	}
+	for (std::size_t i = 0; i < symbols.size(); ++i) {
+		const qsizetype at = symbolsAt + qsizetype(i) * kSymbolSize;
+		const auto [nameOffset, nameLength] = intern(symbols[i].name, symbols[i].nameOffset);
+		const auto [scopeOffset, scopeLength] = intern(symbols[i].scope, symbols[i].scopeOffset);
+		store<quint32>(out, at + kNameOffsetAt, nameOffset);
+		store<quint32>(out, at + kNameLengthAt, nameLength);
+		store<quint32>(out, at + kScopeOffsetAt, scopeOffset);
+		store<quint32>(out, at + kScopeLengthAt, scopeLength);
+		store<quint32>(out, at + kLineAt, symbols[i].line);
+		store<quint16>(out, at + kColumnAt, quint16(std::min<quint32>(symbols[i].column, 0xffff)));
+		out[at + kKindAt] = char(symbols[i].kind);
+	}
+	for (std::size_t i = 0; i < fileRefs.size(); ++i) {
+		store<quint32>(out, fileRefsAt + qsizetype(i) * 4, fileRefs[i]);
+	}
+	for (std::size_t i = 0; i < order.size(); ++i) {
+		store<quint32>(out, orderAt + qsizetype(i) * 4, order[i]);
+	}
+	out += strings;
+
+	std::memcpy(out.data() + kMagicAt, kMagic, sizeof(kMagic));
+	store<quint16>(out, kMajorAt, kMajor);
+	store<quint16>(out, kMinorAt, kMinor);
+	store<quint32>(out, kHeaderSizeAt, kHeaderSize);
+	store<quint32>(out, kFileCountAt, quint32(files.size()));
+	store<quint32>(out, kFileSizeAt, kFileSize);
+	store<quint32>(out, kBlockCountAt, quint32(blocks.size()));
+	store<quint32>(out, kBlockSizeAt, kBlockSize);
+	store<quint32>(out, kSymbolCountAt, quint32(symbols.size()));
+	store<quint32>(out, kSymbolSizeAt, kSymbolSize);
+	store<quint32>(out, kStringBytesAt, quint32(strings.size()));
+	store<quint16>(out, kExtractorAt, SymbolExtractor::kVersion);
+	store<quint16>(out, kCarriedAt, carryStrings ? base->m_carried + 1 : 0);
+	return out;
+}
+
+SymbolTablePtr SymbolTable::open(const QString& path, QString* error) {
+	auto file = std::make_unique<QFile>(path);
+	if (!file->open(QIODevice::ReadOnly)) {
+		fail(error, file->errorString());
+		return nullptr;
+	}
+	std::shared_ptr<SymbolTable> table(new SymbolTable);
+	table->m_size = file->size();
+	table->m_data = table->m_size > 0 ? file->map(0, table->m_size) : nullptr;
+	if (!table->m_data) {
+		fail(error, table->m_size > 0 ? file->errorString() : QStringLiteral("Symbol table is empty"));
+		return nullptr;
+	}
+	table->m_file = std::move(file);
+	if (!table->init(error)) return nullptr;
+	return table;
+}
+
+SymbolTablePtr SymbolTable::fromBytes(QByteArray bytes, QString* error) {
+	std::shared_ptr<SymbolTable> table(new SymbolTable);
+	table->m_bytes = std::move(bytes);
+	table->m_data = reinterpret_cast<const uchar*>(table->m_bytes.constData());
+	table->m_size = table->m_bytes.size();
+	if (!table->init(error)) return nullptr;
+	return table;
+}
+
+bool SymbolTable::write(const QString& path, const QByteArray& bytes, QString* error) {
+	QDir().mkpath(QFileInfo(path).absolutePath());
+	QSaveFile file(path);
+	if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() || !file.commit()) {
+		return fail(error, file.errorString());
+	}
+	return true;
+}
+
+bool SymbolTable::init(QString* error) {
+	const uchar* data = m_data;
+	if (m_size < kHeaderSize || std::memcmp(data + kMagicAt, kMagic, sizeof(kMagic)) != 0) {
+		return fail(error, QStringLiteral("Not a symbol table"));
+	}
+	if (load<quint16>(data, kMajorAt) != kMajor || load<quint16>(data, kExtractorAt) != SymbolExtractor::kVersion) {
+		return fail(error, QStringLiteral("Symbol table is from another version"));
+	}
+	m_fileCount = load<quint32>(data, kFileCountAt);
+	m_fileStride = load<quint32>(data, kFileSizeAt);
+	m_blockCount = load<quint32>(data, kBlockCountAt);
+	m_blockStride = load<quint32>(data, kBlockSizeAt);
+	m_symbolCount = load<quint32>(data, kSymbolCountAt);
+	m_symbolStride = load<quint32>(data, kSymbolSizeAt);
+	m_stringBytes = load<quint32>(data, kStringBytesAt);
+	m_carried = load<quint16>(data, kCarriedAt);
+	// 64-bit sums of 32-bit products can't overflow.
+	const quint64 filesAt = load<quint32>(data, kHeaderSizeAt);
+	const quint64 blocksAt = filesAt + quint64(m_fileCount) * m_fileStride;
+	const quint64 symbolsAt = blocksAt + quint64(m_blockCount) * m_blockStride;
+	const quint64 fileRefsAt = symbolsAt + quint64(m_symbolCount) * m_symbolStride;
+	const quint64 orderAt = fileRefsAt + quint64(m_fileCount) * 4;
+	const quint64 stringsAt = orderAt + quint64(m_symbolCount) * 4;
+	if (filesAt < kHeaderSize || m_fileStride < kFileSize || m_blockStride < kBlockSize || m_symbolStride < kSymbolSize
+		|| stringsAt + m_stringBytes != quint64(m_size) || stringsAt > std::numeric_limits<quint32>::max()) {
+		return fail(error, QStringLiteral("Symbol table is corrupt"));
+	}
+	m_filesAt = quint32(filesAt);
+	m_blocksAt = quint32(blocksAt);
+	m_symbolsAt = quint32(symbolsAt);
+	m_fileRefsAt = quint32(fileRefsAt);
+	m_orderAt = quint32(orderAt);
+	m_stringsAt = quint32(stringsAt);
+	return true;
+}
+
+const uchar* SymbolTable::fileRecord(quint32 file) const {
+	return file < m_fileCount ? m_data + m_filesAt + quint64(file) * m_fileStride : nullptr;
+}
+
+const uchar* SymbolTable::blockRecord(quint32 block) const {
+	return block < m_blockCount ? m_data + m_blocksAt + quint64(block) * m_blockStride : nullptr;
+}
+
+const uchar* SymbolTable::symbolRecord(quint32 symbol) const {
+	return symbol < m_symbolCount ? m_data + m_symbolsAt + quint64(symbol) * m_symbolStride : nullptr;
+}
+
+QByteArrayView SymbolTable::string(quint32 offset, quint32 length) const {
+	if (quint64(offset) + length > m_stringBytes) return {};
+	return QByteArrayView(reinterpret_cast<const char*>(m_data + m_stringsAt + offset), length);
+}
+
+QByteArrayView SymbolTable::filePath(quint32 file) const {
+	const uchar* r = fileRecord(file);
+	return r ? string(load<quint32>(r, kPathOffsetAt), load<quint32>(r, kPathLengthAt)) : QByteArrayView();
+}
+
+qint64 SymbolTable::fileModified(quint32 file) const {
+	const uchar* r = fileRecord(file);
+	return r ? load<qint64>(r, kModifiedAt) : -1;
+}
+
+qint64 SymbolTable::fileSize(quint32 file) const {
+	const uchar* r = fileRecord(file);
+	return r ? load<qint64>(r, kFileSizeFieldAt) : -1;
+}
+
+quint64 SymbolTable::fileHash(quint32 file) const {
+	const uchar* r = fileRecord(file);
+	const uchar* block = r ? blockRecord(load<quint32>(r, kBlockAt)) : nullptr;
+	return block ? load<quint64>(block, kHashAt) : 0;
+}
+
+qint64 SymbolTable::findFile(QByteArrayView path) const {
+	quint32 low = 0;
+	quint32 high = m_fileCount;
+	while (low < high) {
+		const quint32 mid = low + (high - low) / 2;
+		if (filePath(mid).compare(path) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low < m_fileCount && filePath(low) == path ? qint64(low) : -1;
+}
+
+std::vector<SymbolView> SymbolTable::fileSymbols(quint32 file) const {
+	std::vector<SymbolView> out;
+	const uchar* r = fileRecord(file);
+	const uchar* block = r ? blockRecord(load<quint32>(r, kBlockAt)) : nullptr;
+	if (!block) return out;
+	const quint32 first = load<quint32>(block, kFirstSymbolAt);
+	const quint32 count = load<quint32>(block, kSymbolsAt);
+	for (quint32 s = first; s < first + count && s < m_symbolCount; ++s) {
+		out.push_back(symbol(s));
+	}
+	return out;
+}
+
+SymbolView SymbolTable::symbol(quint32 index) const {
+	const uchar* r = symbolRecord(index);
+	if (!r) return {};
+	return {
+		string(load<quint32>(r, kNameOffsetAt), load<quint32>(r, kNameLengthAt)),
+		string(load<quint32>(r, kScopeOffsetAt), load<quint32>(r, kScopeLengthAt)),
+		load<quint32>(r, kLineAt),
+		load<quint16>(r, kColumnAt),
+		SymbolKind(std::min<quint8>(r[kKindAt], quint8(SymbolKind::Option))),
+	};
+}
+
+quint32 SymbolTable::orderAt(quint32 i) const {
+	return i < m_symbolCount ? load<quint32>(m_data, m_orderAt + i * 4) : kNone;
+}
+
+quint32 SymbolTable::fileRefAt(quint32 i) const {
+	return i < m_fileCount ? load<quint32>(m_data, m_fileRefsAt + i * 4) : kNone;
+}
+
+quint32 SymbolTable::blockFirstSymbol(quint32 block) const {
+	const uchar* r = blockRecord(block);
+	return r ? load<quint32>(r, kFirstSymbolAt) : m_symbolCount;
+}
+
+quint32 SymbolTable::blockFirstFileRef(quint32 block) const {
+	const uchar* r = blockRecord(block);
+	return r ? load<quint32>(r, kFirstFileRefAt) : 0;
+}
+
+quint32 SymbolTable::blockFileRefCount(quint32 block) const {
+	const uchar* r = blockRecord(block);
+	return r ? load<quint32>(r, kFileRefsAt) : 0;
+}
+
+quint32 SymbolTable::blockOf(quint32 symbol) const {
+	// Blocks hold consecutive runs of symbols, in order.
+	quint32 low = 0;
+	quint32 high = m_blockCount;
+	while (low < high) {
+		const quint32 mid = low + (high - low) / 2;
+		if (blockFirstSymbol(mid) <= symbol) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low > 0 ? low - 1 : kNone;
+}
+
+quint32 SymbolTable::lowerBound(QByteArrayView prefix) const {
+	quint32 low = 0;
+	quint32 high = m_symbolCount;
+	while (low < high) {
+		const quint32 mid = low + (high - low) / 2;
+		if (compareFolded(symbol(orderAt(mid)).name, prefix) < 0) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	return low;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QFile>
+#include <QString>
+#include <memory>
+#include <vector>
+#include "symbol_extractor.h"
+
+struct SymbolView {
+	QByteArrayView name;
+	QByteArrayView scope;
+	quint32 line = 0;
+	quint32 column = 0;
+	SymbolKind kind = SymbolKind::Function;
+};
+
+// Immutable symbol table, used straight out of a memory map. Files, sorted by
+// path, point at blocks of symbols; a block is keyed by the hash of the file
+// contents it came from, so identical files share one. Names and scopes are
+// interned in a UTF-8 string table, and a name-sorted order over all symbols
+// makes prefix lookups a binary search.
+//
+// Only the header is checked when a table is opened, so opening costs nothing
+// however large it is; every access is bounds checked instead, and a damaged
+// table gives wrong answers rather than crashes.
+class SymbolTable {
+public:
+	static constexpr quint16 kMajor = 1;
+	static constexpr quint16 kMinor = 0;
+
+	// Collects files and writes them out as a table. Files from the table the
+	// builder was made with are carried over without being decoded, and its
+	// sorted order is merged with that of the new symbols rather than redone.
+	class Builder {
+	public:
+		explicit Builder(std::shared_ptr<const SymbolTable> base = nullptr);
+		~Builder();
+
+		void addFile(QByteArrayView path, qint64 modified, qint64 size, quint64 hash, std::vector<ExtractedSymbol> symbols);
+		// A file of the base table, with a new stat if it was only touched.
+		void addBaseFile(quint32 file, qint64 modified, qint64 size);
+		QByteArray finish();
+
+	private:
+		struct State;
+		std::unique_ptr<State> m_state;
+	};
+
+	static std::shared_ptr<const SymbolTable> open(const QString& path, QString* error = nullptr);
+	static std::shared_ptr<const SymbolTable> fromBytes(QByteArray bytes, QString* error = nullptr);
+	// Replaces the file atomically.
+	static bool write(const QString& path, const QByteArray& bytes, QString* error = nullptr);
+
+	quint32 fileCount() const { return m_fileCount; }
+	quint32 symbolCount() const { return m_symbolCount; }
+	qsizetype byteSize() const { return m_size; }
+
+	// Relative to the indexed root, UTF-8.
+	QByteArrayView filePath(quint32 file) const;
+	qint64 fileModified(quint32 file) const;
+	qint64 fileSize(quint32 file) const;
+	quint64 fileHash(quint32 file) const;
+	// The file with this path, or -1.
+	qint64 findFile(QByteArrayView path) const;
+	std::vector<SymbolView> fileSymbols(quint32 file) const;
+
+	SymbolView symbol(quint32 index) const;
+	// Calls fn(symbol, file) for each symbol whose name starts with prefix,
+	// ignoring ASCII case, in name order, and for each file it is in, until fn
+	// returns false.
+	template <typename Fn>
+	void forEachPrefix(QByteArrayView prefix, Fn&& fn) const {
+		for (quint32 i = lowerBound(prefix); i < m_symbolCount; ++i) {
+			const quint32 index = orderAt(i);
+			const SymbolView view = symbol(index);
+			if (!hasPrefix(view.name, prefix)) return;
+			const quint32 block = blockOf(index);
+			const quint32 first = blockFirstFileRef(block);
+			const quint32 count = blockFileRefCount(block);
+			for (quint32 f = first; f < first + count; ++f) {
+				if (!fn(view, fileRefAt(f))) return;
+			}
+		}
+	}
+
+	// Names sort by their ASCII case folding, then by their bytes.
+	static int compareNames(QByteArrayView a, QByteArrayView b);
+	static bool hasPrefix(QByteArrayView name, QByteArrayView prefix);
+
+private:
+	SymbolTable() = default;
+	bool init(QString* error);
+
+	quint32 lowerBound(QByteArrayView prefix) const;
+	quint32 orderAt(quint32 i) const;
+	quint32 fileRefAt(quint32 i) const;
+	quint32 blockOf(quint32 symbol) const;
+	quint32 blockFirstSymbol(quint32 block) const;
+	quint32 blockFirstFileRef(quint32 block) const;
+	quint32 blockFileRefCount(quint32 block) const;
+	QByteArrayView string(quint32 offset, quint32 length) const;
+	const uchar* fileRecord(quint32 file) const;
+	const uchar* blockRecord(quint32 block) const;
+	const uchar* symbolRecord(quint32 symbol) const;
+
+	std::unique_ptr<QFile> m_file;
+	QByteArray m_bytes;
+	const uchar* m_data = nullptr;
+	qsizetype m_size = 0;
+	quint32 m_fileCount = 0;
+	quint32 m_fileStride = 0;
+	quint32 m_blockCount = 0;
+	quint32 m_blockStride = 0;
+	quint32 m_symbolCount = 0;
+	quint32 m_symbolStride = 0;
+	quint32 m_filesAt = 0;
+	quint32 m_blocksAt = 0;
+	quint32 m_symbolsAt = 0;
+	quint32 m_fileRefsAt = 0;
+	quint32 m_orderAt = 0;
+	quint32 m_stringsAt = 0;
+	quint32 m_stringBytes = 0;
+	quint16 m_carried = 0;
+};
+using SymbolTablePtr = std::shared_ptr<const SymbolTable>;
@@ -0,0 +1,94 @@
+#include "work_stealing.h"
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace {
+// One per worker, on its own cache line.
+struct alignas(64) Range {
+	std::mutex mutex;
+	qsizetype begin = 0;
+	qsizetype end = 0;
+};
+
+bool steal(Range* ranges, int workers, int self) {
+	for (int step = 1; step < workers; ++step) {
+		Range& victim = ranges[(self + step) % workers];
+		qsizetype begin = 0;
+		qsizetype end = 0;
+		{
+			const std::lock_guard lock(victim.mutex);
+			const qsizetype remaining = victim.end - victim.begin;
+			if (remaining <= 0) continue;
+			begin = victim.end - (remaining + 1) / 2;
+			end = victim.end;
+			victim.end = begin;
+		}
+		Range& own = ranges[self];
+		const std::lock_guard lock(own.mutex);
+		own.begin = begin;
+		own.end = end;
+		return true;
+	}
+	return false;
+}
+
+// Helpers still queued when the caller is done must not touch its ranges, so
+// the caller waits only for those that started.
+struct Helpers {
+	std::mutex mutex;
+	std::condition_variable done;
+	int running = 0;
+	bool closed = false;
+};
+}
+
+int WorkStealing::workerCount(qsizetype count, int threads) {
+	if (threads <= 0) threads = TaskScheduler::shared().threadCount();
+	return int(std::clamp<qsizetype>(threads, 1, std::max<qsizetype>(count, 1)));
+}
+
+void WorkStealing::parallelFor(qsizetype count, const std::function<void(qsizetype index, int worker)>& task, int threads,
+	TaskPriority priority) {
+	if (count <= 0) return;
+	const int workers = workerCount(count, threads);
+	const std::unique_ptr<Range[]> ranges(new Range[std::size_t(workers)]);
+	for (int i = 0; i < workers; ++i) {
+		ranges[i].begin = count * i / workers;
+		ranges[i].end = count * (i + 1) / workers;
+	}
+	auto run = [&](int self) {
+		Range& own = ranges[self];
+		for (;;) {
+			qsizetype index = -1;
+			{
+				const std::lock_guard lock(own.mutex);
+				if (own.begin < own.end) index = own.begin++;
+			}
+			if (index >= 0) {
+				task(index, self);
+			} else if (!steal(ranges.get(), workers, self)) {
+				// Everything left is already being run.
+				return;
+			}
+		}
+	};
+	const auto helpers = std::make_shared<Helpers>();
+	for (int i = 1; i < workers; ++i) {
+		TaskScheduler::shared().submit(priority, [helpers, &run, i] {
+			{
+				const std::lock_guard lock(helpers->mutex);
+				if (helpers->closed) return;
+				++helpers->running;
+			}
+			run(i);
+			const std::lock_guard lock(helpers->mutex);
+			if (--helpers->running == 0) helpers->done.notify_all();
+		});
+	}
+	run(0);
+	std::unique_lock lock(helpers->mutex);
+	helpers->closed = true;
+	helpers->done.wait(lock, [&] { return helpers->running == 0; });
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <QtGlobal>
+#include <functional>
+#include "../util/task_scheduler.h"
+
+namespace WorkStealing {
+	// Runs task(index, worker) for every index in [0, count) on up to `threads`
+	// threads, the calling one included, and returns when all have run. The
+	// other workers are tasks of the shared TaskScheduler at the given
+	// priority. Each worker starts with an even share of the range and takes
+	// from its front; one that runs out steals the back half of another's
+	// remaining range, so a few slow items don't leave the other cores idle,
+	// and the share of a worker that never got a thread is stolen the same
+	// way. Worker numbers are below the thread count actually used, which
+	// workerCount() returns.
+	int workerCount(qsizetype count, int threads = 0);
+	void parallelFor(qsizetype count, const std::function<void(qsizetype index, int worker)>& task, int threads = 0,
+		TaskPriority priority = TaskPriority::Background);
+}
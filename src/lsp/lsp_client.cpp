@@ -0,0 +1,318 @@
+#include "lsp_client.h"
+#include "lsp_framing.h"
+#include "../util/trace.h"
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QProcess>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <utility>
+
+namespace {
+// JSON-RPC error codes.
+constexpr int kMethodNotFound = -32601;
+
+QJsonObject clientCapabilities() {
+	return {
+		{QStringLiteral("general"), QJsonObject{
+			{QStringLiteral("positionEncodings"), QJsonArray{QStringLiteral("utf-16")}},
+		}},
+		{QStringLiteral("textDocument"), QJsonObject{
+			{QStringLiteral("synchronization"), QJsonObject{{QStringLiteral("didSave"), true}}},
+			{QStringLiteral("publishDiagnostics"), QJsonObject{}},
+			{QStringLiteral("hover"), QJsonObject{
+				{QStringLiteral("contentFormat"), QJsonArray{QStringLiteral("plaintext")}},
+			}},
+		}},
+	};
+}
+}
+
+struct LspClient::State {
+	QProcess* process = nullptr;
+	LspMessageReader reader;
+};
+
+LspClient::LspClient(QObject* parent) : QObject(parent), m_state(new State) {
+	m_thread = new QThread(this);
+	m_thread->setObjectName(QStringLiteral("lsp"));
+	m_worker = new QObject;
+	m_worker->moveToThread(m_thread);
+	m_thread->start();
+}
+
+LspClient::~LspClient() {
+	State* state = m_state.get();
+	QMetaObject::invokeMethod(m_worker, [state] {
+		if (state->process) {
+			state->process->disconnect();
+			// A server told to exit gets a moment to do so.
+			state->process->closeWriteChannel();
+			if (!state->process->waitForFinished(500)) {
+				state->process->kill();
+				state->process->waitForFinished(1000);
+			}
+			delete state->process;
+			state->process = nullptr;
+		}
+	}, Qt::BlockingQueuedConnection);
+	m_thread->quit();
+	m_thread->wait();
+	delete m_worker;
+}
+
+void LspClient::start(const QString& program, const QStringList& args, const QString& rootPath) {
+	if (m_running) return;
+	m_running = true;
+	m_initialized = false;
+	m_capabilities = {};
+	State* state = m_state.get();
+	QObject* worker = m_worker;
+	QMetaObject::invokeMethod(m_worker, [this, state, worker, program, args, rootPath] {
+		auto* process = new QProcess(worker);
+		state->process = process;
+		state->reader = LspMessageReader();
+		process->setWorkingDirectory(rootPath);
+		// Its stderr is a log nobody reads.
+		process->setStandardErrorFile(QProcess::nullDevice());
+		QObject::connect(process, &QProcess::readyReadStandardOutput, process, [this, state, process] {
+			IDE_TRACE_SPAN("LspClient::read");
+			state->reader.feed(process->readAllStandardOutput());
+			QByteArray body;
+			while (state->reader.next(&body)) {
+				const QJsonDocument json = QJsonDocument::fromJson(body);
+				if (!json.isObject()) continue;
+				QMetaObject::invokeMethod(this, [this, message = json.object()] { onMessage(message); }, Qt::QueuedConnection);
+			}
+			if (state->reader.hasFailed()) {
+				const QString message = state->reader.errorString();
+				process->kill();
+				QMetaObject::invokeMethod(this, [this, message] { emit serverError(message); }, Qt::QueuedConnection);
+			}
+		});
+		QObject::connect(process, &QProcess::errorOccurred, process, [this, state, process](QProcess::ProcessError error) {
+			if (error != QProcess::FailedToStart) return;
+			const QString message = process->errorString();
+			state->process = nullptr;
+			process->deleteLater();
+			QMetaObject::invokeMethod(this, [this, message] {
+				emit serverError(message);
+				onExited();
+			}, Qt::QueuedConnection);
+		});
+		QObject::connect(process, &QProcess::finished, process, [this, state, process] {
+			state->process = nullptr;
+			process->deleteLater();
+			QMetaObject::invokeMethod(this, [this] { onExited(); }, Qt::QueuedConnection);
+		});
+		process->start(program, args);
+	}, Qt::QueuedConnection);
+
+	m_initializeId = ++m_nextId;
+	write({
+		{QStringLiteral("jsonrpc"), QStringLiteral("2.0")},
+		{QStringLiteral("id"), m_initializeId},
+		{QStringLiteral("method"), QStringLiteral("initialize")},
+		{QStringLiteral("params"), QJsonObject{
+			{QStringLiteral("processId"), QCoreApplication::applicationPid()},
+			{QStringLiteral("rootUri"), QUrl::fromLocalFile(rootPath).toString()},
+			{QStringLiteral("clientInfo"), QJsonObject{{QStringLiteral("name"), QCoreApplication::applicationName()}}},
+			{QStringLiteral("capabilities"), clientCapabilities()},
+		}},
+	});
+}
+
+void LspClient::stop() {
+	if (!m_running) return;
+	if (!m_initialized) {
+		State* state = m_state.get();
+		QMetaObject::invokeMethod(m_worker, [state] {
+			if (state->process) state->process->kill();
+		}, Qt::QueuedConnection);
+		return;
+	}
+	// Its answer is of no interest; it isn't tracked, so it will be dropped.
+	write({
+		{QStringLiteral("jsonrpc"), QStringLiteral("2.0")},
+		{QStringLiteral("id"), ++m_nextId},
+		{QStringLiteral("method"), QStringLiteral("shutdown")},
+	});
+	write({
+		{QStringLiteral("jsonrpc"), QStringLiteral("2.0")},
+		{QStringLiteral("method"), QStringLiteral("exit")},
+	});
+}
+
+qint64 LspClient::request(const QString& method, const QJsonObject& params, const QString& key, int debounceMs) {
+	const qint64 id = ++m_nextId;
+	if (!key.isEmpty()) {
+		if (const qint64 previous = m_latestByKey.value(key)) {
+			cancel(previous);
+		}
+		m_latestByKey.insert(key, id);
+	}
+	if (key.isEmpty() || debounceMs <= 0) {
+		sendRequest(id, method, params, key);
+		return id;
+	}
+	m_debounced.insert(key, {id, method, params});
+	QTimer*& timer = m_debounceTimers[key];
+	if (!timer) {
+		timer = new QTimer(this);
+		timer->setSingleShot(true);
+		connect(timer, &QTimer::timeout, this, [this, key] {
+			const auto it = m_debounced.constFind(key);
+			if (it == m_debounced.constEnd()) return;
+			const Debounced pending = it.value();
+			m_debounced.erase(it);
+			sendRequest(pending.id, pending.method, pending.params, key);
+		});
+	}
+	timer->start(debounceMs);
+	return id;
+}
+
+void LspClient::cancel(qint64 id) {
+	for (auto it = m_debounced.begin(); it != m_debounced.end(); ++it) {
+		if (it.value().id != id) continue;
+		m_debounceTimers.value(it.key())->stop();
+		m_latestByKey.remove(it.key());
+		m_debounced.erase(it);
+		return;
+	}
+	const auto it = m_inFlight.constFind(id);
+	if (it == m_inFlight.constEnd()) return;
+	if (!it.value().isEmpty() && m_latestByKey.value(it.value()) == id) {
+		m_latestByKey.remove(it.value());
+	}
+	m_inFlight.erase(it);
+	notify(QStringLiteral("$/cancelRequest"), {{QStringLiteral("id"), id}});
+}
+
+void LspClient::notify(const QString& method, const QJsonObject& params) {
+	if (!m_running) return;
+	send({
+		{QStringLiteral("jsonrpc"), QStringLiteral("2.0")},
+		{QStringLiteral("method"), method},
+		{QStringLiteral("params"), params},
+	});
+}
+
+void LspClient::sendRequest(qint64 id, const QString& method, const QJsonObject& params, const QString& key) {
+	if (!m_running) return;
+	m_inFlight.insert(id, key);
+	send({
+		{QStringLiteral("jsonrpc"), QStringLiteral("2.0")},
+		{QStringLiteral("id"), id},
+		{QStringLiteral("method"), method},
+		{QStringLiteral("params"), params},
+	});
+}
+
+void LspClient::send(const QJsonObject& message) {
+	if (m_initialized) {
+		write(message);
+	} else {
+		m_waiting.push_back(message);
+	}
+}
+
+void LspClient::write(const QJsonObject& message) {
+	const QByteArray bytes = LspMessageReader::frame(QJsonDocument(message).toJson(QJsonDocument::Compact));
+	State* state = m_state.get();
+	QMetaObject::invokeMethod(m_worker, [state, bytes] {
+		if (state->process) state->process->write(bytes);
+	}, Qt::QueuedConnection);
+}
+
+void LspClient::onMessage(const QJsonObject& message) {
+	const QString method = message.value(QStringLiteral("method")).toString();
+	if (!method.isEmpty()) {
+		if (message.contains(QStringLiteral("id"))) {
+			answerServer(message);
+		} else {
+			emit notified(method, message.value(QStringLiteral("params")));
+		}
+		return;
+	}
+	const qint64 id = message.value(QStringLiteral("id")).toInteger(-1);
+	const bool isError = message.contains(QStringLiteral("error"));
+	if (id == m_initializeId) {
+		if (isError) {
+			emit serverError(message.value(QStringLiteral("error")).toObject().value(QStringLiteral("message")).toString());
+			stop();
+			return;
+		}
+		m_capabilities = message.value(QStringLiteral("result")).toObject().value(QStringLiteral("capabilities")).toObject();
+		m_initialized = true;
+		write({
+			{QStringLiteral("jsonrpc"), QStringLiteral("2.0")},
+			{QStringLiteral("method"), QStringLiteral("initialized")},
+			{QStringLiteral("params"), QJsonObject{}},
+		});
+		for (const QJsonObject& waiting : std::exchange(m_waiting, {})) {
+			write(waiting);
+		}
+		emit initialized(m_capabilities);
+		return;
+	}
+	const auto it = m_inFlight.constFind(id);
+	// Cancelled, superseded or never ours.
+	if (it == m_inFlight.constEnd()) return;
+	const QString key = it.value();
+	m_inFlight.erase(it);
+	if (!key.isEmpty() && m_latestByKey.value(key) == id) {
+		m_latestByKey.remove(key);
+	}
+	if (isError) {
+		emit failed(id, message.value(QStringLiteral("error")).toObject());
+	} else {
+		emit responded(id, message.value(QStringLiteral("result")));
+	}
+}
+
+void LspClient::answerServer(const QJsonObject& message) {
+	const QString method = message.value(QStringLiteral("method")).toString();
+	QJsonObject reply{
+		{QStringLiteral("jsonrpc"), QStringLiteral("2.0")},
+		{QStringLiteral("id"), message.value(QStringLiteral("id"))},
+	};
+	if (method == QLatin1StringView("workspace/configuration")) {
+		// No settings of our own: null for each item asked about.
+		const QJsonArray items = message.value(QStringLiteral("params")).toObject().value(QStringLiteral("items")).toArray();
+		QJsonArray result;
+		for (qsizetype i = 0; i < items.size(); ++i) {
+			result.append(QJsonValue::Null);
+		}
+		reply.insert(QStringLiteral("result"), result);
+	} else if (method == QLatin1StringView("workspace/applyEdit")) {
+		reply.insert(QStringLiteral("result"), QJsonObject{{QStringLiteral("applied"), false}});
+	} else if (method == QLatin1StringView("client/registerCapability")
+		|| method == QLatin1StringView("client/unregisterCapability")
+		|| method == QLatin1StringView("window/workDoneProgress/create")
+		|| method == QLatin1StringView("window/showMessageRequest")) {
+		reply.insert(QStringLiteral("result"), QJsonValue::Null);
+	} else {
+		reply.insert(QStringLiteral("error"), QJsonObject{
+			{QStringLiteral("code"), kMethodNotFound},
+			{QStringLiteral("message"), QStringLiteral("Unsupported method %1").arg(method)},
+		});
+	}
+	// Answers may go out before initialize has been answered.
+	write(reply);
+}
+
+void LspClient::onExited() {
+	m_running = false;
+	m_initialized = false;
+	m_waiting.clear();
+	m_inFlight.clear();
+	m_latestByKey.clear();
+	m_debounced.clear();
+	for (QTimer* timer : std::as_const(m_debounceTimers)) {
+		timer->stop();
+	}
+	emit finished();
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QObject>
+#include <QStringList>
+#include <memory>
+#include <vector>
+
+class QThread;
+class QTimer;
+
+// JSON-RPC over a language server's stdin and stdout. The process, the
+// framing and the JSON parsing live on a worker thread; the GUI thread only
+// sees whole messages. Messages sent before the server has answered
+// initialize wait for it.
+//
+// Requests given a key are superseded by the next one with the same key: one
+// still being debounced is dropped without being sent, and one already sent is
+// cancelled and its answer ignored.
+class LspClient : public QObject {
+	Q_OBJECT
+public:
+	explicit LspClient(QObject* parent = nullptr);
+	~LspClient() override;
+
+	void start(const QString& program, const QStringList& args, const QString& rootPath);
+	// Asks the server to shut down and exit.
+	void stop();
+	bool isRunning() const { return m_running; }
+	bool isInitialized() const { return m_initialized; }
+	const QJsonObject& serverCapabilities() const { return m_capabilities; }
+
+	// Returns the request's id.
+	qint64 request(const QString& method, const QJsonObject& params, const QString& key = QString(), int debounceMs = 0);
+	void cancel(qint64 id);
+	void notify(const QString& method, const QJsonObject& params);
+
+signals:
+	void initialized(const QJsonObject& capabilities);
+	void responded(qint64 id, const QJsonValue& result);
+	// An error answer; cancelled requests don't get one.
+	void failed(qint64 id, const QJsonObject& error);
+	void notified(const QString& method, const QJsonValue& params);
+	void serverError(const QString& message);
+	void finished();
+
+private:
+	struct State;
+	struct Debounced {
+		qint64 id = 0;
+		QString method;
+		QJsonObject params;
+	};
+
+	void send(const QJsonObject& message);
+	void write(const QJsonObject& message);
+	void sendRequest(qint64 id, const QString& method, const QJsonObject& params, const QString& key);
+	void onMessage(const QJsonObject& message);
+	void answerServer(const QJsonObject& message);
+	void onExited();
+
+	QThread* m_thread = nullptr;
+	QObject* m_worker = nullptr;
+	std::unique_ptr<State> m_state;
+	bool m_running = false;
+	bool m_initialized = false;
+	QJsonObject m_capabilities;
+	qint64 m_nextId = 0;
+	qint64 m_initializeId = -1;
+	std::vector<QJsonObject> m_waiting;
+	// Sent and not answered yet, with the key each was sent under.
+	QHash<qint64, QString> m_inFlight;
+	QHash<QString, qint64> m_latestByKey;
+	QHash<QString, Debounced> m_debounced;
+	QHash<QString, QTimer*> m_debounceTimers;
+};
@@ -0,0 +1,159 @@
+#include "lsp_document_sync.h"
+#include "lsp_client.h"
+#include "lsp_positions.h"
+#include "../buffer/document.h"
+#include "../util/trace.h"
+#include <QFileInfo>
+#include <QTimer>
+#include <QUrl>
+
+namespace {
+QJsonObject identifier(const QString& uri) {
+	return {{QStringLiteral("uri"), uri}};
+}
+}
+
+LspDocumentSync::LspDocumentSync(LspClient* client, QObject* parent) : QObject(parent), m_client(client) {
+	m_timer = new QTimer(this);
+	m_timer->setSingleShot(true);
+	connect(m_timer, &QTimer::timeout, this, [this] { flush(); });
+	// Changes made while the server was starting wait until its sync kind is known.
+	connect(m_client, &LspClient::initialized, this, [this] { flush(); });
+	connect(m_client, &LspClient::finished, this, [this] {
+		m_timer->stop();
+		m_entries.clear();
+	});
+}
+
+QString LspDocumentSync::languageId(const QString& path) {
+	const QString suffix = QFileInfo(path).suffix().toLower();
+	if (suffix == QLatin1StringView("c")) return QStringLiteral("c");
+	static const QStringList cpp{
+		QStringLiteral("cpp"), QStringLiteral("cc"), QStringLiteral("cxx"), QStringLiteral("c++"),
+		QStringLiteral("h"), QStringLiteral("hh"), QStringLiteral("hpp"), QStringLiteral("hxx"),
+		QStringLiteral("ipp"), QStringLiteral("inl"),
+	};
+	return cpp.contains(suffix) ? QStringLiteral("cpp") : QString();
+}
+
+QString LspDocumentSync::uri(const QString& path) {
+	return QUrl::fromLocalFile(path).toString();
+}
+
+QString LspDocumentSync::uriOf(const Document* document) const {
+	const auto it = m_entries.constFind(document);
+	return it == m_entries.constEnd() ? QString() : it.value().uri;
+}
+
+void LspDocumentSync::open(Document* document) {
+	if (!m_client->isRunning() || isOpen(document) || document->path().isEmpty()) return;
+	const QString language = languageId(document->path());
+	if (language.isEmpty()) return;
+	Entry& entry = m_entries[document];
+	entry.uri = uri(document->path());
+	m_client->notify(QStringLiteral("textDocument/didOpen"), {
+		{QStringLiteral("textDocument"), QJsonObject{
+			{QStringLiteral("uri"), entry.uri},
+			{QStringLiteral("languageId"), language},
+			{QStringLiteral("version"), entry.version},
+			{QStringLiteral("text"), document->text().toString()},
+		}},
+	});
+}
+
+void LspDocumentSync::close(Document* document) {
+	const auto it = m_entries.find(document);
+	if (it == m_entries.end()) return;
+	// The server forgets the text, so what it hasn't seen of it doesn't matter.
+	m_client->notify(QStringLiteral("textDocument/didClose"), {{QStringLiteral("textDocument"), identifier(it.value().uri)}});
+	m_entries.erase(it);
+}
+
+void LspDocumentSync::changed(Document* document, const TextDelta& delta) {
+	const auto it = m_entries.find(document);
+	if (it == m_entries.end()) return;
+	Entry& entry = it.value();
+	if (!entry.whole) {
+		if (m_client->isInitialized() && syncKind() != 2) {
+			entry.whole = true;
+			entry.changes = {};
+		} else {
+			IDE_TRACE_SPAN("LspDocumentSync::changed");
+			const GapBuffer& text = document->text();
+			entry.changes.append(QJsonObject{
+				{QStringLiteral("range"), LspPositions::replacedRange(text, delta)},
+				{QStringLiteral("text"), text.slice(delta.pos, delta.added)},
+			});
+		}
+	}
+	m_timer->start(kFlushMs);
+}
+
+void LspDocumentSync::reset(Document* document) {
+	const auto it = m_entries.find(document);
+	if (it == m_entries.end()) return;
+	it.value().whole = true;
+	it.value().changes = {};
+	m_timer->start(kFlushMs);
+}
+
+void LspDocumentSync::saved(Document* document) {
+	const auto it = m_entries.find(document);
+	if (it == m_entries.end()) return;
+	flushEntry(document, it.value());
+	m_client->notify(QStringLiteral("textDocument/didSave"), {{QStringLiteral("textDocument"), identifier(it.value().uri)}});
+}
+
+void LspDocumentSync::renamed(Document* document) {
+	const auto it = m_entries.constFind(document);
+	if (it != m_entries.constEnd() && it.value().uri == uri(document->path())) return;
+	close(document);
+	open(document);
+}
+
+void LspDocumentSync::flush(Document* document) {
+	if (!m_client->isInitialized()) return;
+	if (document) {
+		const auto it = m_entries.find(document);
+		if (it != m_entries.end()) flushEntry(document, it.value());
+		return;
+	}
+	m_timer->stop();
+	for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+		flushEntry(const_cast<Document*>(it.key()), it.value());
+	}
+}
+
+int LspDocumentSync::syncKind() const {
+	const QJsonValue sync = m_client->serverCapabilities().value(QStringLiteral("textDocumentSync"));
+	// Either the kind itself or TextDocumentSyncOptions holding it.
+	if (sync.isObject()) return sync.toObject().value(QStringLiteral("change")).toInt(0);
+	return sync.toInt(0);
+}
+
+void LspDocumentSync::flushEntry(Document* document, Entry& entry) {
+	if (!entry.whole && entry.changes.isEmpty()) return;
+	if (!m_client->isInitialized()) return;
+	const int kind = syncKind();
+	if (kind == 0) {
+		entry.whole = false;
+		entry.changes = {};
+		return;
+	}
+	QJsonArray changes;
+	if (entry.whole || kind != 2) {
+		changes.append(QJsonObject{{QStringLiteral("text"), document->text().toString()}});
+	} else {
+		changes = entry.changes;
+	}
+	entry.whole = false;
+	entry.changes = {};
+	++entry.version;
+	m_client->notify(QStringLiteral("textDocument/didChange"), {
+		{QStringLiteral("textDocument"), QJsonObject{
+			{QStringLiteral("uri"), entry.uri},
+			{QStringLiteral("version"), entry.version},
+		}},
+		{QStringLiteral("contentChanges"), changes},
+	});
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <QHash>
+#include <QJsonArray>
+#include <QObject>
+#include <QString>
+#include "../buffer/textBuffer.h"
+
+class Document;
+class LspClient;
+class QTimer;
+
+// Keeps a language server's copy of open documents in step with the editor.
+// Edits are turned into ranged changes as they happen, from the deltas views
+// report, and sent together once typing pauses; a server that only takes
+// whole documents gets the text as it is then.
+class LspDocumentSync : public QObject {
+	Q_OBJECT
+public:
+	static constexpr int kFlushMs = 50;
+
+	explicit LspDocumentSync(LspClient* client, QObject* parent = nullptr);
+
+	// Empty for files no server is run for.
+	static QString languageId(const QString& path);
+	static QString uri(const QString& path);
+
+	bool isOpen(const Document* document) const { return m_entries.contains(document); }
+	QString uriOf(const Document* document) const;
+	void open(Document* document);
+	void close(Document* document);
+	// An edit just applied to the document's text.
+	void changed(Document* document, const TextDelta& delta);
+	// The text was changed without deltas; the server is sent all of it.
+	void reset(Document* document);
+	void saved(Document* document);
+	// The document's path changed.
+	void renamed(Document* document);
+	// Sends pending changes now, for one document or all of them.
+	void flush(Document* document = nullptr);
+
+private:
+	struct Entry {
+		QString uri;
+		qint64 version = 0;
+		QJsonArray changes;
+		bool whole = false;
+	};
+
+	// The server's TextDocumentSyncKind: 0 none, 1 full, 2 incremental.
+	int syncKind() const;
+	void flushEntry(Document* document, Entry& entry);
+
+	LspClient* m_client = nullptr;
+	QTimer* m_timer = nullptr;
+	QHash<const Document*, Entry> m_entries;
+};
@@ -0,0 +1,60 @@
+#include "lsp_framing.h"
+#include <QList>
+#include <algorithm>
+
+namespace {
+constexpr QByteArrayView kHeaderEnd = "\r\n\r\n";
+// Consumed bytes are dropped once there are this many of them.
+constexpr qsizetype kCompactBytes = 64 * 1024;
+}
+
+void LspMessageReader::feed(QByteArrayView bytes) {
+	if (hasFailed()) return;
+	if (m_pos >= kCompactBytes && m_pos * 2 >= m_buffer.size()) {
+		m_buffer.remove(0, m_pos);
+		m_scanned -= m_pos;
+		m_pos = 0;
+	}
+	m_buffer.append(bytes);
+}
+
+bool LspMessageReader::next(QByteArray* body) {
+	if (hasFailed()) return false;
+	if (m_length < 0) {
+		// A terminator may straddle the previous scan's end.
+		const qsizetype from = std::max(m_pos, m_scanned - (kHeaderEnd.size() - 1));
+		const qsizetype end = m_buffer.indexOf(kHeaderEnd, from);
+		if (end < 0) {
+			m_scanned = m_buffer.size();
+			return false;
+		}
+		if (!parseHeader(end)) return false;
+		m_pos = end + kHeaderEnd.size();
+	}
+	if (m_buffer.size() - m_pos < m_length) return false;
+	*body = m_buffer.mid(m_pos, m_length);
+	m_pos += m_length;
+	m_scanned = m_pos;
+	m_length = -1;
+	return true;
+}
+
+bool LspMessageReader::parseHeader(qsizetype end) {
+	const QByteArrayView header = QByteArrayView(m_buffer).sliced(m_pos, end - m_pos);
+	for (QByteArrayView line : QByteArray(header.data(), header.size()).split('\n')) {
+		const qsizetype colon = line.indexOf(':');
+		if (colon < 0) continue;
+		if (line.first(colon).trimmed().compare("Content-Length", Qt::CaseInsensitive) != 0) continue;
+		bool ok = false;
+		const qlonglong length = line.sliced(colon + 1).trimmed().toLongLong(&ok);
+		if (!ok || length < 0) break;
+		m_length = qsizetype(length);
+		return true;
+	}
+	m_error = QStringLiteral("Message without a valid Content-Length header");
+	return false;
+}
+
+QByteArray LspMessageReader::frame(const QByteArray& body) {
+	return "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+}
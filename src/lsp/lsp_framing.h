@@ -0,0 +1,31 @@
+#pragma once
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+
+// Splits a byte stream into the bodies of LSP base protocol messages, each a
+// header block with a Content-Length followed by that many bytes. Bytes may
+// arrive in pieces of any size; each is scanned once, however a message is
+// split.
+class LspMessageReader {
+public:
+	void feed(QByteArrayView bytes);
+	// Takes the next complete body. False if there is none yet, or the stream
+	// is broken.
+	bool next(QByteArray* body);
+	bool hasFailed() const { return !m_error.isEmpty(); }
+	const QString& errorString() const { return m_error; }
+
+	static QByteArray frame(const QByteArray& body);
+
+private:
+	bool parseHeader(qsizetype end);
+
+	QByteArray m_buffer;
+	// Start of the unconsumed bytes, and how far the header search got.
+	qsizetype m_pos = 0;
+	qsizetype m_scanned = 0;
+	// Of the body whose header was read, or -1.
+	qsizetype m_length = -1;
+	QString m_error;
+};
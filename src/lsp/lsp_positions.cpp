@@ -0,0 +1,37 @@
+#include "lsp_positions.h"
+#include <algorithm>
+
+QJsonObject LspPositions::position(qsizetype line, qsizetype character) {
+	return {{QStringLiteral("line"), qint64(line)}, {QStringLiteral("character"), qint64(character)}};
+}
+
+QJsonObject LspPositions::range(const QJsonObject& start, const QJsonObject& end) {
+	return {{QStringLiteral("start"), start}, {QStringLiteral("end"), end}};
+}
+
+QJsonObject LspPositions::fromOffset(const ITextBuffer& buffer, qsizetype pos) {
+	const qsizetype line = buffer.lineFromPosition(pos);
+	return position(line, pos - buffer.lineStart(line));
+}
+
+qsizetype LspPositions::toOffset(const ITextBuffer& buffer, const QJsonObject& position) {
+	const qsizetype lines = buffer.lineCount();
+	const qsizetype line = qsizetype(position.value(QStringLiteral("line")).toInteger());
+	if (line < 0) return 0;
+	if (line >= lines) return buffer.size();
+	const qsizetype start = buffer.lineStart(line);
+	qsizetype end = line + 1 < lines ? buffer.lineStart(line + 1) - 1 : buffer.size();
+	if (end > start && line + 1 < lines && buffer.slice(end - 1, 1) == u"\r") {
+		--end;
+	}
+	const qsizetype character = qsizetype(position.value(QStringLiteral("character")).toInteger());
+	return std::clamp<qsizetype>(start + character, start, end);
+}
+
+QJsonObject LspPositions::replacedRange(const ITextBuffer& buffer, const TextDelta& delta) {
+	// Lines before the edit are untouched, so its start is where it was.
+	const qsizetype column = delta.pos - buffer.lineStart(delta.firstLine);
+	const qsizetype endLine = delta.firstLine + delta.removedLines;
+	const qsizetype endColumn = delta.removedLines == 0 ? column + delta.removed : delta.removedTail;
+	return range(position(delta.firstLine, column), position(endLine, endColumn));
+}
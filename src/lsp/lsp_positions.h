@@ -0,0 +1,16 @@
+#pragma once
+#include <QJsonObject>
+#include "../buffer/textBuffer.h"
+
+// LSP positions count UTF-16 code units within a line, which is what a QChar
+// is, so they map to buffer offsets through the buffer's line index alone.
+namespace LspPositions {
+	QJsonObject position(qsizetype line, qsizetype character);
+	QJsonObject range(const QJsonObject& start, const QJsonObject& end);
+	QJsonObject fromOffset(const ITextBuffer& buffer, qsizetype pos);
+	// Past the end of a line means its end, as the protocol asks.
+	qsizetype toOffset(const ITextBuffer& buffer, const QJsonObject& position);
+	// The range a delta replaced, in the text as it was before the edit. Only
+	// needs the buffer as it is after it.
+	QJsonObject replacedRange(const ITextBuffer& buffer, const TextDelta& delta);
+}
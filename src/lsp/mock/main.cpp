@@ -0,0 +1,24 @@
+#include "mock_lsp.h"
+#include <QByteArrayView>
+#include <QCoreApplication>
+#include <cstdio>
+
+// ide-lsp-mock serve [--full] | check
+int main(int argc, char** argv) {
+	const QString mode = argc > 1 ? QString::fromLocal8Bit(argv[1]) : QString();
+	if (mode == QLatin1StringView("serve")) {
+		return MockLsp::serve(argc > 2 && QByteArrayView(argv[2]) == "--full");
+	}
+	if (mode == QLatin1StringView("check")) {
+		QCoreApplication app(argc, argv);
+		const int failures = MockLsp::check(QCoreApplication::applicationFilePath());
+		if (failures == 0) {
+			std::printf("ok\n");
+		} else {
+			std::printf("%d failed\n", failures);
+		}
+		return failures == 0 ? 0 : 1;
+	}
+	std::fprintf(stderr, "usage: ide-lsp-mock serve [--full] | check\n");
+	return 2;
+}
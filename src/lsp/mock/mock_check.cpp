@@ -0,0 +1,206 @@
+#include "mock_lsp.h"
+#include "../lsp_client.h"
+#include "../lsp_document_sync.h"
+#include "../../buffer/document.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <cstdio>
+#include <functional>
+
+namespace {
+constexpr int kTimeoutMs = 5000;
+
+bool waitFor(const std::function<bool()>& done, int timeoutMs = kTimeoutMs) {
+	QElapsedTimer timer;
+	timer.start();
+	while (!done()) {
+		if (timer.elapsed() > timeoutMs) return false;
+		QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 10);
+	}
+	return true;
+}
+
+// Line breaks spelled out, so a lost \r shows in the report.
+QString visible(QString text) {
+	return text.replace(u'\r', QLatin1StringView("\\r")).replace(u'\n', QLatin1StringView("\\n"));
+}
+
+class Checker {
+public:
+	Checker(const QString& program, bool fullSync);
+	~Checker();
+
+	int run();
+
+private:
+	void fail(const QString& what);
+	// Makes the edit the way BufferView::applyEdit does and reports its delta.
+	void edit(Document& document, qsizetype pos, qsizetype length, const QString& text);
+	QJsonObject serverDocument(const Document& document);
+	void expectInStep(const QString& step, Document& document);
+	void checkDocument(const QString& name, const QString& initial,
+		const std::vector<std::pair<QString, std::function<void(Document&)>>>& steps);
+	void checkCancel(Document& document);
+
+	bool m_fullSync;
+	LspClient m_client;
+	LspDocumentSync m_sync{&m_client};
+	QHash<qint64, QJsonValue> m_results;
+	int m_failures = 0;
+};
+
+Checker::Checker(const QString& program, bool fullSync) : m_fullSync(fullSync) {
+	QObject::connect(&m_client, &LspClient::responded, &m_client, [this](qint64 id, const QJsonValue& result) {
+		m_results.insert(id, result);
+	});
+	QStringList args{QStringLiteral("serve")};
+	if (fullSync) args.append(QStringLiteral("--full"));
+	m_client.start(program, args, QDir::tempPath());
+}
+
+Checker::~Checker() {
+	m_client.stop();
+	waitFor([this] { return !m_client.isRunning(); });
+}
+
+void Checker::fail(const QString& what) {
+	++m_failures;
+	std::fprintf(stderr, "FAIL (%s sync) %s\n", m_fullSync ? "full" : "incremental", qPrintable(what));
+}
+
+void Checker::edit(Document& document, qsizetype pos, qsizetype length, const QString& text) {
+	GapBuffer& buffer = document.text();
+	TextDelta delta;
+	delta.pos = pos;
+	delta.removed = length;
+	delta.added = text.size();
+	delta.firstLine = buffer.lineFromPosition(pos);
+	if (length > 0) {
+		const QString removed = buffer.slice(pos, length);
+		delta.removedLines = removed.count(u'\n');
+		delta.removedTail = removed.size() - removed.lastIndexOf(u'\n') - 1;
+	}
+	delta.addedLines = text.count(u'\n');
+	document.replace(pos, length, text);
+	m_sync.changed(&document, delta);
+}
+
+QJsonObject Checker::serverDocument(const Document& document) {
+	const qint64 id = m_client.request(QStringLiteral("mock/document"), {{QStringLiteral("uri"), m_sync.uriOf(&document)}});
+	if (!waitFor([&] { return m_results.contains(id); })) {
+		fail(QStringLiteral("no answer to mock/document"));
+		return {};
+	}
+	return m_results.take(id).toObject();
+}
+
+void Checker::expectInStep(const QString& step, Document& document) {
+	m_sync.flush(&document);
+	const QJsonObject state = serverDocument(document);
+	for (const QJsonValue& error : state.value(QStringLiteral("errors")).toArray()) {
+		fail(step + QStringLiteral(": server: ") + error.toString());
+	}
+	const QString expected = document.text().toString();
+	const QString actual = state.value(QStringLiteral("text")).toString();
+	if (actual != expected) {
+		fail(step + QStringLiteral(": server has \"%1\" instead of \"%2\"").arg(visible(actual), visible(expected)));
+	}
+}
+
+void Checker::checkDocument(const QString& name, const QString& initial,
+	const std::vector<std::pair<QString, std::function<void(Document&)>>>& steps) {
+	Document document(QDir::temp().filePath(QStringLiteral("ide-lsp-mock/") + name));
+	document.text().setText(initial);
+	m_sync.open(&document);
+	expectInStep(name + QStringLiteral(", opened"), document);
+	for (const auto& [step, apply] : steps) {
+		apply(document);
+		expectInStep(name + QStringLiteral(", ") + step, document);
+	}
+	if (name.endsWith(QLatin1StringView(".cpp")) && !m_fullSync) checkCancel(document);
+	m_sync.close(&document);
+}
+
+// A keyed request superseded while the server holds it is cancelled, and its
+// answer never reaches the caller.
+void Checker::checkCancel(Document& document) {
+	const QJsonObject params{
+		{QStringLiteral("textDocument"), QJsonObject{{QStringLiteral("uri"), m_sync.uriOf(&document)}}},
+		{QStringLiteral("position"), QJsonObject{{QStringLiteral("line"), 0}, {QStringLiteral("character"), 0}}},
+	};
+	const qint64 first = m_client.request(QStringLiteral("textDocument/hover"), params, QStringLiteral("hover"));
+	const qint64 second = m_client.request(QStringLiteral("textDocument/hover"), params, QStringLiteral("hover"));
+	if (!waitFor([&] { return m_results.contains(second); })) {
+		fail(QStringLiteral("no answer to the second hover"));
+	}
+	// Long enough for the first to have been answered, had it not been cancelled.
+	waitFor([] { return false; }, 2 * MockLsp::kHoverDelayMs);
+	if (m_results.contains(first)) {
+		fail(QStringLiteral("the superseded hover was answered"));
+	}
+	const QJsonArray cancelled = serverDocument(document).value(QStringLiteral("cancelled")).toArray();
+	if (!cancelled.contains(QJsonValue(first))) {
+		fail(QStringLiteral("the server never saw $/cancelRequest for the superseded hover"));
+	}
+}
+
+int Checker::run() {
+	if (!waitFor([this] { return m_client.isInitialized() || !m_client.isRunning(); }) || !m_client.isInitialized()) {
+		fail(QStringLiteral("the server did not initialize"));
+		return m_failures;
+	}
+	auto at = [](Document& document, const QString& needle) { return document.text().toString().indexOf(needle); };
+	checkDocument(QStringLiteral("check.cpp"), QStringLiteral("int main() {\n\treturn 0;\n}\n"), {
+		{QStringLiteral("replace within a line"), [&](Document& d) { edit(d, at(d, QStringLiteral("0")), 1, QStringLiteral("1")); }},
+		{QStringLiteral("insert lines with surrogate pairs"), [&](Document& d) {
+			edit(d, at(d, QStringLiteral("{")) + 1, 0, QStringLiteral("\n\t// \U0001F600 one \U0001F600\n\t// two"));
+		}},
+		{QStringLiteral("erase across lines"), [&](Document& d) {
+			const qsizetype from = at(d, QStringLiteral("one"));
+			edit(d, from, at(d, QStringLiteral("two")) - from, QString());
+		}},
+		{QStringLiteral("erase a surrogate pair"), [&](Document& d) { edit(d, at(d, QStringLiteral("\U0001F600")), 2, QString()); }},
+		{QStringLiteral("several edits in one batch"), [&](Document& d) {
+			edit(d, 0, 0, QStringLiteral("// head\n"));
+			edit(d, d.text().size(), 0, QStringLiteral("// tail"));
+			const qsizetype pos = at(d, QStringLiteral("return"));
+			edit(d, pos, 6, QStringLiteral("co_return\n\t"));
+			edit(d, pos + 3, 7, QString());
+		}},
+		{QStringLiteral("replace across lines"), [&](Document& d) {
+			const qsizetype from = at(d, QStringLiteral("main"));
+			edit(d, from, at(d, QStringLiteral("two")) - from, QStringLiteral("f()\n{"));
+		}},
+		{QStringLiteral("erase to the end"), [&](Document& d) {
+			const qsizetype from = at(d, QStringLiteral("{"));
+			edit(d, from, d.text().size() - from, QString());
+		}},
+		{QStringLiteral("erase everything"), [&](Document& d) { edit(d, 0, d.text().size(), QString()); }},
+		{QStringLiteral("insert into an empty document"), [&](Document& d) { edit(d, 0, 0, QStringLiteral("x\ny")); }},
+	});
+	checkDocument(QStringLiteral("crlf.cpp"), QStringLiteral("alpha\r\nbeta\r\ngamma\r\n"), {
+		{QStringLiteral("insert at a line end"), [&](Document& d) { edit(d, at(d, QStringLiteral("\r\nbeta")), 0, QStringLiteral(";")); }},
+		{QStringLiteral("join two lines"), [&](Document& d) { edit(d, at(d, QStringLiteral("\r\nbeta")), 2, QString()); }},
+		{QStringLiteral("split a line"), [&](Document& d) { edit(d, at(d, QStringLiteral("beta")), 0, QStringLiteral("\r\n")); }},
+		{QStringLiteral("replace a line break"), [&](Document& d) {
+			edit(d, at(d, QStringLiteral("\r\ngamma")), 2, QStringLiteral(" \r\n\r\n"));
+		}},
+	});
+	return m_failures;
+}
+}
+
+int MockLsp::check(const QString& program) {
+	QDir::temp().mkpath(QStringLiteral("ide-lsp-mock"));
+	int failures = 0;
+	for (const bool fullSync : {false, true}) {
+		Checker checker(program, fullSync);
+		failures += checker.run();
+	}
+	return failures;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <QString>
+
+// ide-lsp-mock: a scripted language server for checking the client against.
+namespace MockLsp {
+	// Serves stdin and stdout. Keeps each open document's text by applying
+	// the changes it is sent, by the protocol's rules rather than the
+	// editor's, and answers mock/document with it. Hovers are answered after
+	// kHoverDelayMs, or with RequestCancelled if $/cancelRequest comes first.
+	// With fullSync it asks for whole documents instead of ranges.
+	int serve(bool fullSync);
+
+	// Runs this program as a server, drives LspClient and LspDocumentSync
+	// through a script of edits and cancellations, and checks that the
+	// server ends up with the editor's text. Returns the failure count.
+	int check(const QString& program);
+
+	constexpr int kHoverDelayMs = 200;
+}
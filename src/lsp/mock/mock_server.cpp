@@ -0,0 +1,277 @@
+#include "mock_lsp.h"
+#include "../lsp_framing.h"
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// JSON-RPC error codes.
+constexpr int kMethodNotFound = -32601;
+constexpr int kRequestCancelled = -32800;
+
+struct OpenDocument {
+	QString text;
+	qint64 version = 0;
+};
+
+struct Hover {
+	QJsonValue id;
+	Clock::time_point due;
+};
+
+// Message bodies from stdin, read on a thread of their own so that hovers can
+// be answered on time while nothing arrives.
+class Inbox {
+public:
+	void push(QByteArray body) {
+		const std::lock_guard lock(m_mutex);
+		m_bodies.push_back(std::move(body));
+		m_ready.notify_one();
+	}
+	void close() {
+		const std::lock_guard lock(m_mutex);
+		m_closed = true;
+		m_ready.notify_one();
+	}
+	// False once stdin is closed and drained, or when the deadline passes.
+	bool pop(QByteArray* body, Clock::time_point deadline, bool* closed) {
+		std::unique_lock lock(m_mutex);
+		m_ready.wait_until(lock, deadline, [this] { return !m_bodies.empty() || m_closed; });
+		*closed = m_closed && m_bodies.empty();
+		if (m_bodies.empty()) return false;
+		*body = std::move(m_bodies.front());
+		m_bodies.pop_front();
+		return true;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::deque<QByteArray> m_bodies;
+	bool m_closed = false;
+};
+
+class Server {
+public:
+	explicit Server(bool fullSync) : m_fullSync(fullSync) {
+		m_out.open(1, QIODevice::WriteOnly | QIODevice::Unbuffered);
+	}
+
+	// False once the client said exit.
+	bool handle(const QJsonObject& message);
+	void answerDueHovers(Clock::time_point now);
+	Clock::time_point nextDeadline() const;
+
+private:
+	void send(QJsonObject message);
+	void reply(const QJsonValue& id, const QJsonValue& result);
+	void fail(const QJsonValue& id, int code, const QString& text);
+	void applyChanges(const QJsonObject& params);
+	// The offset of an LSP position, whose lines end at "\r\n", '\n' or '\r'.
+	qsizetype offsetOf(const QString& text, const QJsonObject& position, const QString& uri);
+
+	bool m_fullSync;
+	QFile m_out;
+	QHash<QString, OpenDocument> m_documents;
+	std::vector<Hover> m_hovers;
+	QJsonArray m_cancelled;
+	QStringList m_errors;
+};
+
+bool Server::handle(const QJsonObject& message) {
+	const QString method = message.value(QStringLiteral("method")).toString();
+	const QJsonValue id = message.value(QStringLiteral("id"));
+	const QJsonObject params = message.value(QStringLiteral("params")).toObject();
+	if (method == QLatin1StringView("initialize")) {
+		reply(id, QJsonObject{{QStringLiteral("capabilities"), QJsonObject{
+			{QStringLiteral("textDocumentSync"), QJsonObject{
+				{QStringLiteral("openClose"), true},
+				{QStringLiteral("change"), m_fullSync ? 1 : 2},
+			}},
+			{QStringLiteral("hoverProvider"), true},
+		}}});
+	} else if (method == QLatin1StringView("textDocument/didOpen")) {
+		const QJsonObject document = params.value(QStringLiteral("textDocument")).toObject();
+		m_documents.insert(document.value(QStringLiteral("uri")).toString(), {
+			document.value(QStringLiteral("text")).toString(),
+			document.value(QStringLiteral("version")).toInteger(),
+		});
+	} else if (method == QLatin1StringView("textDocument/didChange")) {
+		applyChanges(params);
+	} else if (method == QLatin1StringView("textDocument/didClose")) {
+		m_documents.remove(params.value(QStringLiteral("textDocument")).toObject().value(QStringLiteral("uri")).toString());
+	} else if (method == QLatin1StringView("textDocument/hover")) {
+		m_hovers.push_back({id, Clock::now() + std::chrono::milliseconds(MockLsp::kHoverDelayMs)});
+	} else if (method == QLatin1StringView("$/cancelRequest")) {
+		const QJsonValue cancelled = params.value(QStringLiteral("id"));
+		for (auto it = m_hovers.begin(); it != m_hovers.end(); ++it) {
+			if (it->id != cancelled) continue;
+			m_cancelled.append(cancelled);
+			fail(cancelled, kRequestCancelled, QStringLiteral("cancelled"));
+			m_hovers.erase(it);
+			break;
+		}
+	} else if (method == QLatin1StringView("mock/document")) {
+		const QString uri = params.value(QStringLiteral("uri")).toString();
+		const OpenDocument document = m_documents.value(uri);
+		reply(id, QJsonObject{
+			{QStringLiteral("open"), m_documents.contains(uri)},
+			{QStringLiteral("text"), document.text},
+			{QStringLiteral("version"), document.version},
+			{QStringLiteral("cancelled"), m_cancelled},
+			{QStringLiteral("errors"), QJsonArray::fromStringList(m_errors)},
+		});
+	} else if (method == QLatin1StringView("shutdown")) {
+		reply(id, QJsonValue::Null);
+	} else if (method == QLatin1StringView("exit")) {
+		return false;
+	} else if (!id.isUndefined() && !method.isEmpty()) {
+		fail(id, kMethodNotFound, method);
+	}
+	return true;
+}
+
+void Server::applyChanges(const QJsonObject& params) {
+	const QJsonObject identifier = params.value(QStringLiteral("textDocument")).toObject();
+	const QString uri = identifier.value(QStringLiteral("uri")).toString();
+	const auto it = m_documents.find(uri);
+	if (it == m_documents.end()) {
+		m_errors.append(QStringLiteral("didChange for %1, which is not open").arg(uri));
+		return;
+	}
+	const qint64 version = identifier.value(QStringLiteral("version")).toInteger();
+	if (version <= it->version) {
+		m_errors.append(QStringLiteral("version %1 after %2").arg(version).arg(it->version));
+	}
+	it->version = version;
+	// In order, each against the text the previous one left.
+	for (const QJsonValue& value : params.value(QStringLiteral("contentChanges")).toArray()) {
+		const QJsonObject change = value.toObject();
+		const QString text = change.value(QStringLiteral("text")).toString();
+		if (!change.contains(QStringLiteral("range"))) {
+			it->text = text;
+			continue;
+		}
+		if (m_fullSync) {
+			m_errors.append(QStringLiteral("a ranged change under full sync"));
+		}
+		const QJsonObject range = change.value(QStringLiteral("range")).toObject();
+		const qsizetype start = offsetOf(it->text, range.value(QStringLiteral("start")).toObject(), uri);
+		const qsizetype end = offsetOf(it->text, range.value(QStringLiteral("end")).toObject(), uri);
+		if (start < 0 || end < start) {
+			m_errors.append(QStringLiteral("bad range %1").arg(QString::fromUtf8(QJsonDocument(range).toJson(QJsonDocument::Compact))));
+			continue;
+		}
+		it->text.replace(start, end - start, text);
+	}
+}
+
+qsizetype Server::offsetOf(const QString& text, const QJsonObject& position, const QString& uri) {
+	const qint64 line = position.value(QStringLiteral("line")).toInteger(-1);
+	const qint64 character = position.value(QStringLiteral("character")).toInteger(-1);
+	if (line < 0 || character < 0) return -1;
+	qsizetype start = 0;
+	for (qint64 i = 0; i < line; ++i) {
+		qsizetype next = start;
+		while (next < text.size() && text[next] != u'\n' && text[next] != u'\r') ++next;
+		if (next == text.size()) {
+			m_errors.append(QStringLiteral("line %1 past the end of %2").arg(line).arg(uri));
+			return -1;
+		}
+		start = next + (text[next] == u'\r' && next + 1 < text.size() && text[next + 1] == u'\n' ? 2 : 1);
+	}
+	qsizetype end = start;
+	while (end < text.size() && text[end] != u'\n' && text[end] != u'\r') ++end;
+	// Clients may not point inside a line break, nor split a surrogate pair.
+	if (character > end - start) {
+		m_errors.append(QStringLiteral("character %1 past the end of line %2").arg(character).arg(line));
+		return -1;
+	}
+	const qsizetype offset = start + qsizetype(character);
+	if (offset > 0 && offset < text.size() && text[offset].isLowSurrogate()) {
+		m_errors.append(QStringLiteral("line %1, character %2 splits a surrogate pair").arg(line).arg(character));
+	}
+	return offset;
+}
+
+void Server::answerDueHovers(Clock::time_point now) {
+	std::erase_if(m_hovers, [&](const Hover& hover) {
+		if (hover.due > now) return false;
+		reply(hover.id, QJsonObject{{QStringLiteral("contents"), QStringLiteral("mock hover")}});
+		return true;
+	});
+}
+
+Clock::time_point Server::nextDeadline() const {
+	Clock::time_point next = Clock::now() + std::chrono::seconds(1);
+	for (const Hover& hover : m_hovers) {
+		next = std::min(next, hover.due);
+	}
+	return next;
+}
+
+void Server::send(QJsonObject message) {
+	message.insert(QStringLiteral("jsonrpc"), QStringLiteral("2.0"));
+	m_out.write(LspMessageReader::frame(QJsonDocument(message).toJson(QJsonDocument::Compact)));
+}
+
+void Server::reply(const QJsonValue& id, const QJsonValue& result) {
+	send({{QStringLiteral("id"), id}, {QStringLiteral("result"), result}});
+}
+
+void Server::fail(const QJsonValue& id, int code, const QString& text) {
+	send({{QStringLiteral("id"), id}, {QStringLiteral("error"), QJsonObject{
+		{QStringLiteral("code"), code},
+		{QStringLiteral("message"), text},
+	}}});
+}
+}
+
+int MockLsp::serve(bool fullSync) {
+	// Shared, as the reader may outlive this function.
+	const auto inbox = std::make_shared<Inbox>();
+	std::thread reader([inbox] {
+		QFile in;
+		in.open(0, QIODevice::ReadOnly | QIODevice::Unbuffered);
+		LspMessageReader framing;
+		QByteArray chunk(64 * 1024, Qt::Uninitialized);
+		for (;;) {
+			const qint64 read = in.read(chunk.data(), chunk.size());
+			if (read <= 0) break;
+			framing.feed(QByteArrayView(chunk.constData(), read));
+			QByteArray body;
+			while (framing.next(&body)) {
+				inbox->push(std::move(body));
+			}
+			if (framing.hasFailed()) break;
+		}
+		inbox->close();
+	});
+	// The reader blocks on stdin, which the client may keep open after exit.
+	reader.detach();
+
+	Server server(fullSync);
+	for (;;) {
+		QByteArray body;
+		bool closed = false;
+		if (inbox->pop(&body, server.nextDeadline(), &closed)) {
+			const QJsonDocument json = QJsonDocument::fromJson(body);
+			if (json.isObject() && !server.handle(json.object())) return 0;
+		}
+		server.answerDueHovers(Clock::now());
+		if (closed) return 0;
+	}
+}
@@ -1,11 +1,12 @@
 #include <QtCore/QtCore>
+#include "pty_session.h"
 
-// PTY stub; platform-specific implementations will live here (openpty/ConPTY).
+// Platform-specific implementations live in pty_session.cpp (openpty; ConPTY to follow).
 bool pty_is_supported()
 {
 #if defined(_WIN32)
-    return true; // ConPTY on Win10+ (to be implemented)
+    return false; // ConPTY on Win10+ (to be implemented)
 #else
-    return true; // openpty on Unix (to be implemented)
+    return true; // forkpty on Unix
 #endif
 }
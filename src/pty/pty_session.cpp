@@ -0,0 +1,337 @@
+#include "pty_session.h"
+#include "spsc_ring.h"
+#include <QFile>
+#include <QTimer>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#if defined(__APPLE__)
+#include <util.h>
+#else
+#include <pty.h>
+#endif
+extern char** environ;
+#endif
+
+namespace {
+constexpr std::size_t kRingSize = std::size_t(4) << 20;
+// How long a child gets to exit after SIGHUP before it is killed.
+constexpr int kHangupGraceMs = 200;
+
+#if !defined(_WIN32)
+bool setFlags(int fd, bool nonBlocking) {
+	const int fdFlags = ::fcntl(fd, F_GETFD);
+	const int statusFlags = ::fcntl(fd, F_GETFL);
+	return fdFlags >= 0 && statusFlags >= 0 && ::fcntl(fd, F_SETFD, fdFlags | FD_CLOEXEC) == 0
+		&& (!nonBlocking || ::fcntl(fd, F_SETFL, statusFlags | O_NONBLOCK) == 0);
+}
+
+bool openPipe(int fds[2]) {
+#if defined(__APPLE__)
+	if (::pipe(fds) != 0) return false;
+	if (setFlags(fds[0], true) && setFlags(fds[1], true)) return true;
+	::close(fds[0]);
+	::close(fds[1]);
+	return false;
+#else
+	return ::pipe2(fds, O_CLOEXEC | O_NONBLOCK) == 0;
+#endif
+}
+#endif
+}
+
+PtySession::PtySession(QObject* parent) : QObject(parent) {
+	m_frameTimer = new QTimer(this);
+	m_frameTimer->setSingleShot(true);
+	m_frameTimer->setInterval(kFrameMs);
+	connect(m_frameTimer, &QTimer::timeout, this, &PtySession::drain);
+}
+
+PtySession::~PtySession() {
+	terminate();
+	stopReader();
+#if !defined(_WIN32)
+	if (m_pid > 0) {
+		// A child that ignores SIGHUP is killed, so none is left a zombie.
+		int status = 0;
+		pid_t rc = 0;
+		for (int waited = 0; waited < kHangupGraceMs; waited += 5) {
+			rc = ::waitpid(pid_t(m_pid), &status, WNOHANG);
+			if (rc != 0) break;
+			::usleep(5000);
+		}
+		if (rc == 0) {
+			::kill(pid_t(m_pid), SIGKILL);
+			while (::waitpid(pid_t(m_pid), &status, 0) < 0 && errno == EINTR) {
+			}
+		}
+	}
+#endif
+}
+
+bool PtySession::start(const QString& program, const QStringList& args, const QString& workingDir,
+	int cols, int rows, QString* error) {
+#if defined(_WIN32)
+	Q_UNUSED(program); Q_UNUSED(args); Q_UNUSED(workingDir); Q_UNUSED(cols); Q_UNUSED(rows);
+	if (error) {
+		*error = QStringLiteral("Pseudo terminals are not supported on this platform yet");
+	}
+	return false;
+#else
+	if (isRunning()) {
+		if (error) {
+			*error = QStringLiteral("A process is already running in this terminal");
+		}
+		return false;
+	}
+
+	// Everything the child needs is built before fork(); the child only calls
+	// async-signal-safe functions.
+	const QByteArray programName = QFile::encodeName(program);
+	std::vector<QByteArray> argBytes;
+	argBytes.push_back(programName);
+	for (const QString& arg : args) {
+		argBytes.push_back(arg.toLocal8Bit());
+	}
+	std::vector<char*> argv;
+	for (QByteArray& arg : argBytes) {
+		argv.push_back(arg.data());
+	}
+	argv.push_back(nullptr);
+
+	QByteArray term("TERM=xterm-256color");
+	std::vector<char*> envp;
+	for (char** env = environ; *env; ++env) {
+		if (std::strncmp(*env, "TERM=", 5) != 0) envp.push_back(*env);
+	}
+	envp.push_back(term.data());
+	envp.push_back(nullptr);
+	const QByteArray dir = QFile::encodeName(workingDir);
+
+	if (!openPipe(m_wakePipe)) {
+		if (error) {
+			*error = QString::fromLocal8Bit(std::strerror(errno));
+		}
+		return false;
+	}
+
+	struct winsize ws{};
+	ws.ws_col = static_cast<unsigned short>(cols);
+	ws.ws_row = static_cast<unsigned short>(rows);
+	int master = -1;
+	const pid_t pid = ::forkpty(&master, nullptr, nullptr, &ws);
+	if (pid < 0) {
+		if (error) {
+			*error = QString::fromLocal8Bit(std::strerror(errno));
+		}
+		::close(m_wakePipe[0]);
+		::close(m_wakePipe[1]);
+		m_wakePipe[0] = m_wakePipe[1] = -1;
+		return false;
+	}
+	if (pid == 0) {
+		if (!dir.isEmpty() && ::chdir(dir.constData()) != 0) {
+			::_exit(127);
+		}
+		environ = envp.data();
+		::execvp(argv[0], argv.data());
+		::_exit(127);
+	}
+
+	// Other children must not inherit the master, and writes must not block.
+	setFlags(master, true);
+	m_master = master;
+	m_pid = pid;
+	m_ring = std::make_unique<SpscByteRing>(kRingSize);
+	m_input.clear();
+	m_notifyPending = false;
+	m_readerDone = false;
+	m_stopping = false;
+	m_reader = std::thread([this] { readerLoop(); });
+	return true;
+#endif
+}
+
+void PtySession::readerLoop() {
+#if !defined(_WIN32)
+	auto notify = [this] {
+		if (!m_notifyPending.exchange(true)) {
+			QMetaObject::invokeMethod(this, [this] { scheduleDrain(); }, Qt::QueuedConnection);
+		}
+	};
+	char buf[64 * 1024];
+	pollfd fds[2] = {{m_master, POLLIN, 0}, {m_wakePipe[0], POLLIN, 0}};
+	for (;;) {
+		{
+			const std::lock_guard lock(m_writeMutex);
+			fds[0].events = m_input.isEmpty() ? POLLIN : POLLIN | POLLOUT;
+		}
+		if (::poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) continue;
+			break;
+		}
+		if (fds[1].revents) {
+			char wake[64];
+			while (::read(m_wakePipe[0], wake, sizeof(wake)) > 0) {
+			}
+			if (m_stopping) break;
+		}
+		if (fds[0].revents & POLLOUT) {
+			const std::lock_guard lock(m_writeMutex);
+			flushInput();
+		}
+		if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+		const ssize_t n = ::read(m_master, buf, sizeof(buf));
+		if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+		if (n <= 0) break;
+
+		std::size_t written = 0;
+		while (written < std::size_t(n)) {
+			written += m_ring->write(buf + written, std::size_t(n) - written);
+			if (written < std::size_t(n)) {
+				notify();
+				if (!m_ring->waitForSpace()) return;
+			}
+		}
+		notify();
+	}
+	m_readerDone = true;
+	m_notifyPending = true;
+	QMetaObject::invokeMethod(this, [this] { scheduleDrain(); }, Qt::QueuedConnection);
+#endif
+}
+
+void PtySession::scheduleDrain() {
+	if (!m_frameTimer->isActive()) {
+		m_frameTimer->start();
+	}
+}
+
+void PtySession::drain() {
+	if (!m_ring) return;
+	m_notifyPending = false;
+	const std::size_t available = m_ring->readable();
+	if (available > 0) {
+		QByteArray chunk;
+		chunk.resize(qsizetype(std::min<std::size_t>(available, std::size_t(kFrameBudget))));
+		const std::size_t n = m_ring->read(chunk.data(), std::size_t(chunk.size()));
+		chunk.truncate(qsizetype(n));
+		emit outputReady(chunk);
+	}
+	if (m_ring->readable() > 0) {
+		// More than a frame's worth is queued: yield to the event loop first.
+		m_frameTimer->start();
+		return;
+	}
+	if (m_readerDone) {
+		reap();
+	}
+}
+
+void PtySession::reap() {
+#if !defined(_WIN32)
+	if (m_pid <= 0) return;
+	int status = 0;
+	const pid_t rc = ::waitpid(pid_t(m_pid), &status, WNOHANG);
+	if (rc == 0) {
+		// The slave side closed before the process exited; poll until it does.
+		QTimer::singleShot(50, this, &PtySession::reap);
+		return;
+	}
+	stopReader();
+	m_pid = -1;
+	int exitCode = -1;
+	if (rc > 0) {
+		exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+	}
+	emit finished(exitCode);
+#endif
+}
+
+void PtySession::write(const QByteArray& data) {
+#if !defined(_WIN32)
+	if (m_master < 0 || data.isEmpty()) return;
+	const std::lock_guard lock(m_writeMutex);
+	// Behind queued input, so bytes keep their order.
+	const bool queued = !m_input.isEmpty();
+	m_input.append(data);
+	if (queued) return;
+	flushInput();
+	if (!m_input.isEmpty()) wakeReader();
+#else
+	Q_UNUSED(data);
+#endif
+}
+
+void PtySession::flushInput() {
+#if !defined(_WIN32)
+	qsizetype offset = 0;
+	while (offset < m_input.size()) {
+		const ssize_t n = ::write(m_master, m_input.constData() + offset, std::size_t(m_input.size() - offset));
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				// The child is gone; the reader sees the hangup.
+				offset = m_input.size();
+			}
+			break;
+		}
+		offset += n;
+	}
+	m_input.remove(0, offset);
+#endif
+}
+
+void PtySession::wakeReader() {
+#if !defined(_WIN32)
+	const char wake = 'x';
+	[[maybe_unused]] const ssize_t rc = ::write(m_wakePipe[1], &wake, 1);
+#endif
+}
+
+void PtySession::resize(int cols, int rows) {
+#if !defined(_WIN32)
+	if (m_master < 0) return;
+	struct winsize ws{};
+	ws.ws_col = static_cast<unsigned short>(cols);
+	ws.ws_row = static_cast<unsigned short>(rows);
+	::ioctl(m_master, TIOCSWINSZ, &ws);
+#else
+	Q_UNUSED(cols); Q_UNUSED(rows);
+#endif
+}
+
+void PtySession::terminate() {
+#if !defined(_WIN32)
+	if (m_pid > 0) {
+		::kill(pid_t(m_pid), SIGHUP);
+	}
+#endif
+}
+
+void PtySession::stopReader() {
+#if !defined(_WIN32)
+	if (m_reader.joinable()) {
+		m_stopping = true;
+		wakeReader();
+		m_ring->close();
+		m_reader.join();
+	}
+	for (int* fd : {&m_master, &m_wakePipe[0], &m_wakePipe[1]}) {
+		if (*fd >= 0) {
+			::close(*fd);
+			*fd = -1;
+		}
+	}
+#endif
+}
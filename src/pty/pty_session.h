@@ -0,0 +1,62 @@
+#pragma once
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class QTimer;
+class SpscByteRing;
+
+bool pty_is_supported();
+
+// A child process attached to a pseudo terminal. A dedicated reader thread
+// drains the master side into a lock-free ring; the GUI thread empties the
+// ring at most once per frame and emits the bytes as one chunk. Input the
+// child isn't reading yet is queued and written by the reader thread once the
+// terminal takes it, so typing or pasting never blocks the GUI.
+class PtySession : public QObject {
+	Q_OBJECT
+public:
+	explicit PtySession(QObject* parent = nullptr);
+	~PtySession() override;
+
+	bool start(const QString& program, const QStringList& args, const QString& workingDir,
+		int cols, int rows, QString* error = nullptr);
+	void write(const QByteArray& data);
+	void resize(int cols, int rows);
+	void terminate();
+	bool isRunning() const { return m_pid > 0; }
+
+	static constexpr int kFrameMs = 16;
+	static constexpr qsizetype kFrameBudget = 1 << 20;
+
+signals:
+	void outputReady(const QByteArray& data);
+	void finished(int exitCode);
+
+private:
+	void readerLoop();
+	void scheduleDrain();
+	void drain();
+	void reap();
+	void stopReader();
+	void wakeReader();
+	// Writes what the terminal takes of the queued input; the caller holds m_writeMutex.
+	void flushInput();
+
+	std::unique_ptr<SpscByteRing> m_ring;
+	std::thread m_reader;
+	std::atomic<bool> m_notifyPending{false};
+	std::atomic<bool> m_readerDone{false};
+	std::atomic<bool> m_stopping{false};
+	std::mutex m_writeMutex;
+	QByteArray m_input;
+	QTimer* m_frameTimer = nullptr;
+	int m_master = -1;
+	int m_wakePipe[2] = {-1, -1};
+	qint64 m_pid = -1;
+};
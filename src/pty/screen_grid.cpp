@@ -0,0 +1,337 @@
+#include "screen_grid.h"
+#include <algorithm>
+
+quint32 AttrTable::intern(const CellAttr& attr) {
+	const quint64 key = keyOf(attr);
+	auto range = m_index.equal_range(key);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (m_attrs[it->second] == attr) return it->second;
+	}
+	if (m_attrs.size() >= kMaxEntries) return kFull;
+	const quint32 index = quint32(m_attrs.size());
+	m_attrs.push_back(attr);
+	m_index.emplace(key, index);
+	return index;
+}
+
+void AttrTable::clear() {
+	m_attrs.assign(1, CellAttr{});
+	m_index.clear();
+	m_index.emplace(keyOf(CellAttr{}), 0);
+}
+
+ScreenGrid::ScreenGrid(int cols, int rows) {
+	resize(cols, rows);
+}
+
+void ScreenGrid::resize(int cols, int rows) {
+	cols = std::max(cols, 1);
+	rows = std::max(rows, 1);
+	if (cols == m_cols && rows == m_rows) return;
+
+	// Keep the cursor row on screen by dropping lines off the top when shrinking.
+	const int shift = std::max(0, m_cy - (rows - 1));
+	for (int y = 0; y < shift && !m_alt && onLineScrolledOut; ++y) {
+		onLineScrolledOut(rowPtr(y), m_cols);
+	}
+	auto reshape = [&](const std::vector<Cell>& old, const std::vector<std::size_t>& index, int skip) {
+		std::vector<Cell> cells(std::size_t(cols) * std::size_t(rows), kBlankCell);
+		const int copyRows = std::min(rows, m_rows - skip);
+		const int copyCols = std::min(cols, m_cols);
+		for (int y = 0; y < copyRows; ++y) {
+			const Cell* src = old.data() + index[std::size_t(y + skip)];
+			std::copy(src, src + copyCols, cells.data() + std::size_t(y) * std::size_t(cols));
+		}
+		return cells;
+	};
+	m_cells = reshape(m_cells, m_rowIndex, shift);
+	m_altCells = reshape(m_altCells, m_altRowIndex, 0);
+	m_rowIndex.resize(std::size_t(rows));
+	for (std::size_t y = 0; y < m_rowIndex.size(); ++y) {
+		m_rowIndex[y] = y * std::size_t(cols);
+	}
+	m_altRowIndex = m_rowIndex;
+	m_cols = cols;
+	m_rows = rows;
+	m_cy -= shift;
+	m_cx = std::clamp(m_cx, 0, m_cols - 1);
+	m_cy = std::clamp(m_cy, 0, m_rows - 1);
+	m_top = 0;
+	m_bottom = m_rows - 1;
+	m_wrapPending = false;
+	m_dirty.assign(std::size_t(m_rows), 1);
+	m_anyDirty = true;
+}
+
+void ScreenGrid::reset() {
+	m_attrTable.clear();
+	m_pen = CellAttr{};
+	m_penIndex = 0;
+	std::fill(m_cells.begin(), m_cells.end(), kBlankCell);
+	std::fill(m_altCells.begin(), m_altCells.end(), kBlankCell);
+	if (m_alt) {
+		std::swap(m_cells, m_altCells);
+		std::swap(m_rowIndex, m_altRowIndex);
+		m_alt = false;
+	}
+	m_cx = m_cy = 0;
+	m_savedX = m_savedY = 0;
+	m_savedPen = CellAttr{};
+	m_top = 0;
+	m_bottom = m_rows - 1;
+	m_wrapPending = false;
+	m_autoWrap = true;
+	m_cursorVisible = true;
+	markDirty(0, m_rows - 1);
+}
+
+void ScreenGrid::penChanged() {
+	m_penIndex = m_attrTable.intern(m_pen);
+	if (m_penIndex == AttrTable::kFull) {
+		compactAttrs();
+		m_penIndex = m_attrTable.intern(m_pen);
+		if (m_penIndex == AttrTable::kFull) m_penIndex = 0;
+	}
+}
+
+void ScreenGrid::compactAttrs() {
+	// Scrollback keeps copies of its attributes, so only the two screens
+	// refer to the table.
+	AttrTable compacted;
+	std::vector<quint32> remap(m_attrTable.size(), AttrTable::kFull);
+	for (std::vector<Cell>* cells : {&m_cells, &m_altCells}) {
+		for (Cell& cell : *cells) {
+			const quint32 old = cellAttr(cell);
+			if (remap[old] == AttrTable::kFull) {
+				const quint32 index = compacted.intern(m_attrTable.at(old));
+				// Only a screen with more attributes than the table holds gets here.
+				remap[old] = index == AttrTable::kFull ? 0 : index;
+			}
+			cell = makeCell(cellCodepoint(cell), remap[old]);
+		}
+	}
+	m_attrTable = std::move(compacted);
+	markDirty(0, m_rows - 1);
+}
+
+void ScreenGrid::markDirty(int y0, int y1) {
+	std::fill(m_dirty.begin() + y0, m_dirty.begin() + y1 + 1, quint8(1));
+	m_anyDirty = true;
+}
+
+void ScreenGrid::clearDirty() {
+	std::fill(m_dirty.begin(), m_dirty.end(), quint8(0));
+	m_anyDirty = false;
+}
+
+void ScreenGrid::wrapIfPending() {
+	if (m_wrapPending) {
+		m_cx = 0;
+		lineFeed();
+	}
+}
+
+void ScreenGrid::putAscii(const char* text, std::size_t len) {
+	while (len > 0) {
+		wrapIfPending();
+		Cell* row = rowPtr(m_cy);
+		const std::size_t n = std::min(len, std::size_t(m_cols - m_cx));
+		const Cell attr = Cell(m_penIndex) << 21;
+		Cell* out = row + m_cx;
+		for (std::size_t i = 0; i < n; ++i) {
+			out[i] = Cell(static_cast<unsigned char>(text[i])) | attr;
+		}
+		markDirty(m_cy);
+		text += n;
+		len -= n;
+		m_cx += int(n);
+		if (m_cx >= m_cols) {
+			m_cx = m_cols - 1;
+			m_wrapPending = m_autoWrap;
+		}
+	}
+}
+
+void ScreenGrid::putCodepoint(char32_t cp) {
+	wrapIfPending();
+	rowPtr(m_cy)[m_cx] = makeCell(cp, m_penIndex);
+	markDirty(m_cy);
+	if (m_cx + 1 >= m_cols) {
+		m_wrapPending = m_autoWrap;
+	} else {
+		++m_cx;
+	}
+}
+
+void ScreenGrid::lineFeed() {
+	m_wrapPending = false;
+	if (m_cy == m_bottom) {
+		scrollRegionUp(m_top, m_bottom, 1);
+	} else if (m_cy < m_rows - 1) {
+		++m_cy;
+	}
+}
+
+void ScreenGrid::reverseIndex() {
+	m_wrapPending = false;
+	if (m_cy == m_top) {
+		scrollRegionDown(m_top, m_bottom, 1);
+	} else if (m_cy > 0) {
+		--m_cy;
+	}
+}
+
+void ScreenGrid::backspace() {
+	m_wrapPending = false;
+	if (m_cx > 0) --m_cx;
+}
+
+void ScreenGrid::tab() {
+	m_cx = std::min(m_cols - 1, (m_cx / 8 + 1) * 8);
+}
+
+void ScreenGrid::moveCursor(int dx, int dy) {
+	setCursor(m_cx + dx, m_cy + dy);
+}
+
+void ScreenGrid::setCursor(int x, int y) {
+	m_cx = std::clamp(x, 0, m_cols - 1);
+	m_cy = std::clamp(y, 0, m_rows - 1);
+	m_wrapPending = false;
+}
+
+void ScreenGrid::saveCursor() {
+	m_savedX = m_cx;
+	m_savedY = m_cy;
+	m_savedPen = m_pen;
+}
+
+void ScreenGrid::restoreCursor() {
+	setCursor(m_savedX, m_savedY);
+	m_pen = m_savedPen;
+	penChanged();
+}
+
+void ScreenGrid::setCursorVisible(bool visible) {
+	if (m_cursorVisible != visible) {
+		m_cursorVisible = visible;
+		markDirty(m_cy);
+	}
+}
+
+void ScreenGrid::fill(int y, int x0, int x1) {
+	x0 = std::clamp(x0, 0, m_cols);
+	x1 = std::clamp(x1, 0, m_cols);
+	if (x0 >= x1) return;
+	Cell* row = rowPtr(y);
+	std::fill(row + x0, row + x1, blank());
+	markDirty(y);
+}
+
+void ScreenGrid::eraseInDisplay(int mode) {
+	switch (mode) {
+	case 0:
+		eraseInLine(0);
+		for (int y = m_cy + 1; y < m_rows; ++y) fill(y, 0, m_cols);
+		break;
+	case 1:
+		eraseInLine(1);
+		for (int y = 0; y < m_cy; ++y) fill(y, 0, m_cols);
+		break;
+	default:
+		for (int y = 0; y < m_rows; ++y) fill(y, 0, m_cols);
+		break;
+	}
+}
+
+void ScreenGrid::eraseInLine(int mode) {
+	switch (mode) {
+	case 0: fill(m_cy, m_cx, m_cols); break;
+	case 1: fill(m_cy, 0, m_cx + 1); break;
+	default: fill(m_cy, 0, m_cols); break;
+	}
+}
+
+void ScreenGrid::eraseChars(int count) {
+	fill(m_cy, m_cx, m_cx + std::max(count, 1));
+}
+
+void ScreenGrid::insertBlanks(int count) {
+	count = std::clamp(count, 1, m_cols - m_cx);
+	Cell* row = rowPtr(m_cy);
+	std::move_backward(row + m_cx, row + m_cols - count, row + m_cols);
+	fill(m_cy, m_cx, m_cx + count);
+}
+
+void ScreenGrid::deleteChars(int count) {
+	count = std::clamp(count, 1, m_cols - m_cx);
+	Cell* row = rowPtr(m_cy);
+	std::move(row + m_cx + count, row + m_cols, row + m_cx);
+	fill(m_cy, m_cols - count, m_cols);
+}
+
+void ScreenGrid::insertLines(int count) {
+	if (m_cy < m_top || m_cy > m_bottom) return;
+	scrollRegionDown(m_cy, m_bottom, std::max(count, 1));
+	m_cx = 0;
+}
+
+void ScreenGrid::deleteLines(int count) {
+	if (m_cy < m_top || m_cy > m_bottom) return;
+	scrollRegionUp(m_cy, m_bottom, std::max(count, 1));
+	m_cx = 0;
+}
+
+void ScreenGrid::scrollUp(int count) {
+	scrollRegionUp(m_top, m_bottom, std::max(count, 1));
+}
+
+void ScreenGrid::scrollDown(int count) {
+	scrollRegionDown(m_top, m_bottom, std::max(count, 1));
+}
+
+void ScreenGrid::scrollRegionUp(int top, int bottom, int count) {
+	count = std::min(count, bottom - top + 1);
+	if (top == 0 && !m_alt && onLineScrolledOut) {
+		for (int y = 0; y < count; ++y) {
+			onLineScrolledOut(rowPtr(y), m_cols);
+		}
+	}
+	std::rotate(m_rowIndex.begin() + top, m_rowIndex.begin() + top + count, m_rowIndex.begin() + bottom + 1);
+	for (int y = bottom - count + 1; y <= bottom; ++y) {
+		fill(y, 0, m_cols);
+	}
+	markDirty(top, bottom);
+}
+
+void ScreenGrid::scrollRegionDown(int top, int bottom, int count) {
+	count = std::min(count, bottom - top + 1);
+	std::rotate(m_rowIndex.begin() + top, m_rowIndex.begin() + bottom + 1 - count, m_rowIndex.begin() + bottom + 1);
+	for (int y = top; y < top + count; ++y) {
+		fill(y, 0, m_cols);
+	}
+	markDirty(top, bottom);
+}
+
+void ScreenGrid::setScrollRegion(int top, int bottom) {
+	top = std::clamp(top, 0, m_rows - 1);
+	bottom = std::clamp(bottom, 0, m_rows - 1);
+	if (top >= bottom) {
+		top = 0;
+		bottom = m_rows - 1;
+	}
+	m_top = top;
+	m_bottom = bottom;
+	setCursor(0, 0);
+}
+
+void ScreenGrid::setAltScreen(bool on) {
+	if (on == m_alt) return;
+	std::swap(m_cells, m_altCells);
+	std::swap(m_rowIndex, m_altRowIndex);
+	m_alt = on;
+	if (on) {
+		std::fill(m_cells.begin(), m_cells.end(), kBlankCell);
+	}
+	markDirty(0, m_rows - 1);
+}
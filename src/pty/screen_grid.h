@@ -0,0 +1,156 @@
+#pragma once
+#include <QtGlobal>
+#include <cstddef>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Colors: 0 is the default, kPaletteColor|index is one of the 256 palette
+// entries and kRgbColor|0xRRGGBB is a direct color.
+constexpr quint32 kPaletteColor = 0x01000000;
+constexpr quint32 kRgbColor = 0x02000000;
+
+enum CellFlag : quint16 {
+	CellBold = 1 << 0,
+	CellDim = 1 << 1,
+	CellItalic = 1 << 2,
+	CellUnderline = 1 << 3,
+	CellBlink = 1 << 4,
+	CellInverse = 1 << 5,
+	CellHidden = 1 << 6,
+	CellStrike = 1 << 7,
+};
+
+struct CellAttr {
+	quint32 fg = 0;
+	quint32 bg = 0;
+	quint16 flags = 0;
+	bool operator==(const CellAttr&) const = default;
+};
+
+// Deduplicated attribute table; cells refer to entries by an 11-bit index.
+class AttrTable {
+public:
+	static constexpr quint32 kMaxEntries = 1u << 11;
+	// Returned by intern() once the table is full.
+	static constexpr quint32 kFull = ~0u;
+
+	AttrTable() { clear(); }
+	quint32 intern(const CellAttr& attr);
+	const CellAttr& at(quint32 index) const { return m_attrs[index]; }
+	const CellAttr* data() const { return m_attrs.data(); }
+	std::size_t size() const { return m_attrs.size(); }
+	void clear();
+private:
+	static quint64 keyOf(const CellAttr& attr) {
+		return (quint64(attr.fg) << 32) ^ (quint64(attr.bg) << 8) ^ attr.flags;
+	}
+	std::vector<CellAttr> m_attrs;
+	std::unordered_multimap<quint64, quint32> m_index;
+};
+
+// A cell is a packed 32-bit value: 21 bits of codepoint and 11 bits of attribute index.
+using Cell = quint32;
+constexpr Cell kBlankCell = U' ';
+inline Cell makeCell(char32_t cp, quint32 attr) { return Cell(cp) | (attr << 21); }
+inline char32_t cellCodepoint(Cell cell) { return char32_t(cell & 0x1FFFFF); }
+inline quint32 cellAttr(Cell cell) { return cell >> 21; }
+
+class ScreenGrid {
+public:
+	ScreenGrid(int cols = 80, int rows = 24);
+
+	int cols() const { return m_cols; }
+	int rows() const { return m_rows; }
+	int cursorX() const { return m_cx; }
+	int cursorY() const { return m_cy; }
+	bool cursorVisible() const { return m_cursorVisible; }
+	const Cell* row(int y) const { return m_cells.data() + m_rowIndex[std::size_t(y)]; }
+	const AttrTable& attrs() const { return m_attrTable; }
+	bool isAltScreen() const { return m_alt; }
+
+	void resize(int cols, int rows);
+	void reset();
+
+	// Printing
+	void putAscii(const char* text, std::size_t len);
+	void putCodepoint(char32_t cp);
+
+	// Cursor and control functions
+	void carriageReturn() { m_cx = 0; m_wrapPending = false; }
+	void lineFeed();
+	void reverseIndex();
+	void backspace();
+	void tab();
+	void moveCursor(int dx, int dy);
+	void setCursor(int x, int y);
+	void setCursorX(int x) { setCursor(x, m_cy); }
+	void setCursorY(int y) { setCursor(m_cx, y); }
+	void saveCursor();
+	void restoreCursor();
+	void setCursorVisible(bool visible);
+	void setAutoWrap(bool on) { m_autoWrap = on; }
+
+	// Editing
+	void eraseInDisplay(int mode);
+	void eraseInLine(int mode);
+	void eraseChars(int count);
+	void insertBlanks(int count);
+	void deleteChars(int count);
+	void insertLines(int count);
+	void deleteLines(int count);
+	void scrollUp(int count);
+	void scrollDown(int count);
+	void setScrollRegion(int top, int bottom);
+	void setAltScreen(bool on);
+
+	// Attributes
+	CellAttr& pen() { return m_pen; }
+	void penChanged();
+
+	// Dirty tracking for partial repaints
+	bool isDirty() const { return m_anyDirty; }
+	bool isRowDirty(int y) const { return m_dirty[std::size_t(y)] != 0; }
+	void clearDirty();
+
+	// Called with each line that scrolls off the top of the main screen. The
+	// cells' attribute indices are only valid until the next penChanged().
+	std::function<void(const Cell* cells, int count)> onLineScrolledOut;
+
+private:
+	Cell* rowPtr(int y) { return m_cells.data() + m_rowIndex[std::size_t(y)]; }
+	Cell blank() const { return makeCell(U' ', m_penIndex); }
+	void fill(int y, int x0, int x1);
+	void markDirty(int y) { m_dirty[std::size_t(y)] = 1; m_anyDirty = true; }
+	void markDirty(int y0, int y1);
+	void wrapIfPending();
+	void scrollRegionUp(int top, int bottom, int count);
+	void scrollRegionDown(int top, int bottom, int count);
+	// Rebuilds the attribute table from the entries the screens still use.
+	void compactAttrs();
+
+	int m_cols = 0;
+	int m_rows = 0;
+	std::vector<Cell> m_cells;
+	std::vector<Cell> m_altCells;
+	// Logical row -> offset of its cells; scrolling rotates this instead of moving cells.
+	std::vector<std::size_t> m_rowIndex;
+	std::vector<std::size_t> m_altRowIndex;
+	std::vector<quint8> m_dirty;
+	bool m_anyDirty = true;
+	AttrTable m_attrTable;
+	CellAttr m_pen;
+	quint32 m_penIndex = 0;
+
+	int m_cx = 0;
+	int m_cy = 0;
+	int m_savedX = 0;
+	int m_savedY = 0;
+	CellAttr m_savedPen;
+	int m_top = 0;
+	int m_bottom = 0;
+	bool m_wrapPending = false;
+	bool m_autoWrap = true;
+	bool m_cursorVisible = true;
+	bool m_alt = false;
+};
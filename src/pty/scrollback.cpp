@@ -0,0 +1,488 @@
+#include "scrollback.h"
+#include <QDir>
+#include <QTemporaryFile>
+#include <algorithm>
+
+namespace {
+void putVarint(QByteArray& out, quint32 value) {
+	while (value >= 0x80) {
+		out.append(char((value & 0x7F) | 0x80));
+		value >>= 7;
+	}
+	out.append(char(value));
+}
+
+bool getVarint(const char*& p, const char* end, quint32& value) {
+	value = 0;
+	for (int shift = 0; p < end && shift < 35; shift += 7) {
+		const auto byte = static_cast<unsigned char>(*p++);
+		value |= quint32(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+void putUtf8(QByteArray& out, char32_t cp) {
+	if (cp < 0x80) {
+		out.append(char(cp));
+	} else if (cp < 0x800) {
+		out.append(char(0xC0 | (cp >> 6)));
+		out.append(char(0x80 | (cp & 0x3F)));
+	} else if (cp < 0x10000) {
+		out.append(char(0xE0 | (cp >> 12)));
+		out.append(char(0x80 | ((cp >> 6) & 0x3F)));
+		out.append(char(0x80 | (cp & 0x3F)));
+	} else {
+		out.append(char(0xF0 | (cp >> 18)));
+		out.append(char(0x80 | ((cp >> 12) & 0x3F)));
+		out.append(char(0x80 | ((cp >> 6) & 0x3F)));
+		out.append(char(0x80 | (cp & 0x3F)));
+	}
+}
+
+bool getUtf8(const char*& p, const char* end, char32_t& cp) {
+	if (p >= end) return false;
+	const auto lead = static_cast<unsigned char>(*p++);
+	int extra = 0;
+	if (lead < 0x80) {
+		cp = lead;
+	} else if (lead < 0xE0) {
+		cp = lead & 0x1F;
+		extra = 1;
+	} else if (lead < 0xF0) {
+		cp = lead & 0x0F;
+		extra = 2;
+	} else {
+		cp = lead & 0x07;
+		extra = 3;
+	}
+	if (end - p < extra) return false;
+	while (extra--) {
+		cp = (cp << 6) | (static_cast<unsigned char>(*p++) & 0x3F);
+	}
+	return true;
+}
+
+char32_t fold(char32_t cp) {
+	if (cp < 0x80) return cp >= 'A' && cp <= 'Z' ? cp + 32 : cp;
+	return QChar::toCaseFolded(cp);
+}
+
+quint32 trigramHash(char32_t a, char32_t b, char32_t c) {
+	quint32 h = quint32(a) * 0x9E3779B1u ^ quint32(b) * 0x85EBCA6Bu ^ quint32(c) * 0xC2B2AE35u;
+	h ^= h >> 15;
+	h *= 0x2C1B3C6Du;
+	h ^= h >> 12;
+	return h;
+}
+}
+
+Scrollback::Scrollback(QObject* parent) : QObject(parent) {
+}
+
+Scrollback::~Scrollback() {
+	m_tasks.stop();
+}
+
+void Scrollback::setOptions(const ScrollbackOptions& options) {
+	m_options = options;
+	coolPages();
+	enforceLimits();
+}
+
+void Scrollback::append(const Cell* cells, int count, const AttrTable& attrs) {
+	while (count > 0 && cells[count - 1] == kBlankCell) --count;
+	// Attributes are looked up once per run of cells that share them.
+	quint32 from = 0;
+	quint32 to = 0;
+	for (int i = 0; i < count; ++i) {
+		const quint32 attr = cellAttr(cells[i]);
+		if (i == 0 || attr != from) {
+			from = attr;
+			to = m_openAttrs.intern(attrs.at(attr));
+			if (to == AttrTable::kFull) {
+				to = 0;
+			} else if (to == m_open.attrs.size()) {
+				m_open.attrs.push_back(attrs.at(attr));
+			}
+		}
+		m_open.cells.push_back(makeCell(cellCodepoint(cells[i]), to));
+	}
+	m_open.offsets.push_back(quint32(m_open.cells.size()));
+	if (m_open.lineCount() >= kLinesPerPage) {
+		seal();
+	}
+}
+
+void Scrollback::clear() {
+	++m_generation;
+	m_pages.clear();
+	m_open = Block{};
+	m_openAttrs.clear();
+	m_firstPage = 0;
+	m_openPage = 0;
+	m_spilled = 0;
+	m_spill.reset();
+	m_diskLive = 0;
+	m_diskDead = 0;
+	m_memory = 0;
+	m_cache.clear();
+}
+
+qint64 Scrollback::memoryUsage() const {
+	qint64 total = m_memory + m_open.bytes();
+	for (const auto& entry : m_cache) {
+		total += entry.second->bytes();
+	}
+	return total;
+}
+
+qint64 Scrollback::pageMemory(const Page& page) const {
+	qint64 bytes = qint64(sizeof(Page)) + page.compressed.capacity();
+	if (page.block) bytes += page.block->bytes();
+	if (page.bloom) bytes += qint64(sizeof(Bloom));
+	return bytes;
+}
+
+void Scrollback::seal() {
+	auto block = std::make_shared<const Block>(std::move(m_open));
+	m_open = Block{};
+	m_open.cells.reserve(block->cells.size());
+	m_openAttrs.clear();
+
+	Page page;
+	page.block = block;
+	m_memory += pageMemory(page);
+	m_pages.push_back(std::move(page));
+	const qint64 number = m_openPage++;
+	const quint64 generation = m_generation;
+	m_tasks.submit([this, block, number, generation] {
+		Encoded encoded = encode(*block);
+		QMetaObject::invokeMethod(this, [this, number, generation, encoded = std::move(encoded)]() mutable {
+			onEncoded(number, generation, std::move(encoded));
+		}, Qt::QueuedConnection);
+	});
+	enforceLimits();
+}
+
+void Scrollback::onEncoded(qint64 pageNumber, quint64 generation, Encoded encoded) {
+	if (generation != m_generation || pageNumber < m_firstPage) return;
+	Page& page = m_pages[std::size_t(pageNumber - m_firstPage)];
+	m_memory -= pageMemory(page);
+	page.compressed = std::move(encoded.compressed);
+	page.bloom = std::move(encoded.bloom);
+	page.pending = false;
+	m_memory += pageMemory(page);
+	coolPages();
+	enforceLimits();
+}
+
+void Scrollback::coolPages() {
+	// Pages that left the hot window give up their uncompressed copy once the
+	// compressed one exists.
+	const qsizetype hotStart = qsizetype(m_pages.size()) - std::max(m_options.hotPages, 0);
+	for (qsizetype i = hotStart - 1; i >= m_spilled; --i) {
+		Page& page = m_pages[std::size_t(i)];
+		if (page.pending) continue;
+		if (!page.block) break;
+		m_memory -= pageMemory(page);
+		page.block.reset();
+		m_memory += pageMemory(page);
+	}
+}
+
+void Scrollback::enforceLimits() {
+	while (!m_pages.empty() && memoryUsage() > m_options.memoryLimit) {
+		if (m_options.diskLimit > 0 && m_spilled < qsizetype(m_pages.size())) {
+			Page& victim = m_pages[std::size_t(m_spilled)];
+			if (!victim.pending && !victim.block && spill(victim)) {
+				++m_spilled;
+				continue;
+			}
+		}
+		dropFront();
+	}
+	while (m_spilled > 0 && m_diskLive > m_options.diskLimit) {
+		dropFront();
+	}
+	if (m_diskDead > m_diskLive && m_diskDead > (qint64(8) << 20)) {
+		compactSpill();
+	}
+}
+
+bool Scrollback::spill(Page& page) {
+	if (!m_spill) {
+		m_spill = std::make_unique<QTemporaryFile>(QDir::tempPath() + QStringLiteral("/ide-scrollback-XXXXXX"));
+		if (!m_spill->open()) {
+			m_spill.reset();
+			return false;
+		}
+	}
+	const qint64 offset = m_spill->size();
+	if (!m_spill->seek(offset)
+		|| m_spill->write(reinterpret_cast<const char*>(page.bloom->data()), qint64(sizeof(Bloom))) != qint64(sizeof(Bloom))
+		|| m_spill->write(page.compressed) != page.compressed.size()) {
+		m_spill->resize(offset);
+		return false;
+	}
+	m_memory -= pageMemory(page);
+	page.fileOffset = offset;
+	page.fileSize = qint32(page.compressed.size());
+	page.compressed.clear();
+	page.bloom.reset();
+	m_memory += pageMemory(page);
+	m_diskLive += qint64(sizeof(Bloom)) + page.fileSize;
+	return true;
+}
+
+void Scrollback::dropFront() {
+	Page& front = m_pages.front();
+	m_memory -= pageMemory(front);
+	if (front.fileOffset >= 0) {
+		const qint64 record = qint64(sizeof(Bloom)) + front.fileSize;
+		m_diskLive -= record;
+		m_diskDead += record;
+		--m_spilled;
+	}
+	m_pages.pop_front();
+	++m_firstPage;
+	std::erase_if(m_cache, [this](const auto& entry) { return entry.first < m_firstPage; });
+	if (m_spilled == 0 && m_spill) {
+		m_spill.reset();
+		m_diskDead = 0;
+	}
+}
+
+void Scrollback::compactSpill() {
+	auto file = std::make_unique<QTemporaryFile>(QDir::tempPath() + QStringLiteral("/ide-scrollback-XXXXXX"));
+	if (!file->open()) return;
+	std::vector<qint64> offsets;
+	offsets.reserve(std::size_t(m_spilled));
+	for (qsizetype i = 0; i < m_spilled; ++i) {
+		const Page& page = m_pages[std::size_t(i)];
+		const qint64 record = qint64(sizeof(Bloom)) + page.fileSize;
+		if (!m_spill->seek(page.fileOffset)) return;
+		const QByteArray bytes = m_spill->read(record);
+		offsets.push_back(file->pos());
+		if (bytes.size() != record || file->write(bytes) != record) return;
+	}
+	for (qsizetype i = 0; i < m_spilled; ++i) {
+		m_pages[std::size_t(i)].fileOffset = offsets[std::size_t(i)];
+	}
+	m_spill = std::move(file);
+	m_diskDead = 0;
+}
+
+Scrollback::Encoded Scrollback::encode(const Block& block) {
+	// Lines are stored as attribute runs followed by UTF-8 text, which
+	// compresses far better than raw 32-bit cells.
+	QByteArray raw;
+	raw.reserve(qsizetype(block.cells.size()) + block.lineCount() * 4);
+	putVarint(raw, quint32(block.attrs.size()));
+	for (const CellAttr& attr : block.attrs) {
+		putVarint(raw, attr.fg);
+		putVarint(raw, attr.bg);
+		putVarint(raw, attr.flags);
+	}
+	putVarint(raw, quint32(block.lineCount()));
+	for (int line = 0; line < block.lineCount(); ++line) {
+		const Cell* cells = block.cells.data() + block.offsets[std::size_t(line)];
+		const quint32 count = block.offsets[std::size_t(line) + 1] - block.offsets[std::size_t(line)];
+		putVarint(raw, count);
+		for (quint32 i = 0; i < count;) {
+			const quint32 attr = cellAttr(cells[i]);
+			quint32 run = 1;
+			while (i + run < count && cellAttr(cells[i + run]) == attr) ++run;
+			putVarint(raw, run);
+			putVarint(raw, attr);
+			i += run;
+		}
+		for (quint32 i = 0; i < count; ++i) {
+			putUtf8(raw, cellCodepoint(cells[i]));
+		}
+	}
+	Encoded encoded;
+	encoded.compressed = qCompress(raw, 1);
+	encoded.compressed.squeeze();
+	encoded.bloom = std::make_shared<Bloom>();
+	encoded.bloom->fill(0);
+	addTrigrams(*encoded.bloom, block);
+	return encoded;
+}
+
+Scrollback::BlockPtr Scrollback::decode(const QByteArray& compressed) {
+	auto block = std::make_shared<Block>();
+	const QByteArray raw = qUncompress(compressed);
+	const char* p = raw.constData();
+	const char* end = p + raw.size();
+	quint32 attrCount = 0;
+	if (!getVarint(p, end, attrCount) || attrCount == 0 || attrCount > AttrTable::kMaxEntries) return block;
+	block->attrs.resize(attrCount);
+	for (CellAttr& attr : block->attrs) {
+		quint32 flags = 0;
+		if (!getVarint(p, end, attr.fg) || !getVarint(p, end, attr.bg) || !getVarint(p, end, flags)) return block;
+		attr.flags = quint16(flags);
+	}
+	quint32 lines = 0;
+	if (!getVarint(p, end, lines)) return block;
+	std::vector<std::pair<quint32, quint32>> runs;
+	for (quint32 line = 0; line < lines; ++line) {
+		quint32 count = 0;
+		if (!getVarint(p, end, count)) break;
+		runs.clear();
+		for (quint32 covered = 0; covered < count;) {
+			quint32 run = 0;
+			quint32 attr = 0;
+			if (!getVarint(p, end, run) || !getVarint(p, end, attr) || run == 0 || attr >= attrCount) return block;
+			runs.emplace_back(run, attr);
+			covered += run;
+		}
+		for (const auto& [run, attr] : runs) {
+			for (quint32 i = 0; i < run; ++i) {
+				char32_t cp = 0;
+				if (!getUtf8(p, end, cp)) return block;
+				block->cells.push_back(makeCell(cp, attr));
+			}
+		}
+		block->offsets.push_back(quint32(block->cells.size()));
+	}
+	return block;
+}
+
+void Scrollback::addTrigrams(Bloom& bloom, const Block& block) {
+	constexpr quint32 kMask = kBloomWords * 64 - 1;
+	for (int line = 0; line < block.lineCount(); ++line) {
+		const quint32 begin = block.offsets[std::size_t(line)];
+		const quint32 end = block.offsets[std::size_t(line) + 1];
+		if (end - begin < 3) continue;
+		char32_t a = fold(cellCodepoint(block.cells[begin]));
+		char32_t b = fold(cellCodepoint(block.cells[begin + 1]));
+		for (quint32 i = begin + 2; i < end; ++i) {
+			const char32_t c = fold(cellCodepoint(block.cells[i]));
+			const quint32 h = trigramHash(a, b, c);
+			bloom[(h & kMask) >> 6] |= quint64(1) << (h & 63);
+			bloom[((h >> 16) & kMask) >> 6] |= quint64(1) << ((h >> 16) & 63);
+			a = b;
+			b = c;
+		}
+	}
+}
+
+std::vector<quint32> Scrollback::trigramsOf(const QString& needle) {
+	std::vector<char32_t> folded;
+	for (const char32_t cp : needle.toUcs4()) {
+		folded.push_back(fold(cp));
+	}
+	std::vector<quint32> trigrams;
+	for (std::size_t i = 2; i < folded.size(); ++i) {
+		trigrams.push_back(trigramHash(folded[i - 2], folded[i - 1], folded[i]));
+	}
+	return trigrams;
+}
+
+bool Scrollback::mayContain(const Bloom& bloom, const std::vector<quint32>& trigrams) {
+	constexpr quint32 kMask = kBloomWords * 64 - 1;
+	for (const quint32 h : trigrams) {
+		if (!(bloom[(h & kMask) >> 6] & (quint64(1) << (h & 63)))) return false;
+		if (!(bloom[((h >> 16) & kMask) >> 6] & (quint64(1) << ((h >> 16) & 63)))) return false;
+	}
+	return true;
+}
+
+QByteArray Scrollback::loadCompressed(const Page& page) const {
+	if (page.fileOffset < 0) return page.compressed;
+	if (!m_spill->seek(page.fileOffset + qint64(sizeof(Bloom)))) return {};
+	return m_spill->read(page.fileSize);
+}
+
+bool Scrollback::loadBloom(const Page& page, Bloom& out) const {
+	if (page.bloom) {
+		out = *page.bloom;
+		return true;
+	}
+	if (page.fileOffset < 0 || !m_spill->seek(page.fileOffset)) return false;
+	return m_spill->read(reinterpret_cast<char*>(out.data()), qint64(sizeof(Bloom))) == qint64(sizeof(Bloom));
+}
+
+Scrollback::BlockPtr Scrollback::blockFor(qint64 pageNumber) const {
+	if (pageNumber == m_openPage) {
+		return BlockPtr(BlockPtr(), &m_open);
+	}
+	const Page& page = m_pages[std::size_t(pageNumber - m_firstPage)];
+	if (page.block) return page.block;
+
+	auto it = std::find_if(m_cache.begin(), m_cache.end(), [&](const auto& entry) { return entry.first == pageNumber; });
+	if (it != m_cache.end()) {
+		std::rotate(m_cache.begin(), it, it + 1);
+		return m_cache.front().second;
+	}
+	BlockPtr block = decode(loadCompressed(page));
+	m_cache.insert(m_cache.begin(), {pageNumber, block});
+	if (m_cache.size() > kCacheSize) m_cache.pop_back();
+	return block;
+}
+
+bool Scrollback::line(qint64 index, std::vector<Cell>& out, std::vector<CellAttr>& attrs) const {
+	if (index < firstLine() || index >= endLine()) return false;
+	const BlockPtr block = blockFor(index / kLinesPerPage);
+	const int slot = int(index % kLinesPerPage);
+	if (slot >= block->lineCount()) {
+		out.clear();
+		return false;
+	}
+	out.assign(block->cells.begin() + block->offsets[std::size_t(slot)],
+		block->cells.begin() + block->offsets[std::size_t(slot) + 1]);
+	attrs = block->attrs;
+	return true;
+}
+
+QString Scrollback::textOf(const Block& block, int line) {
+	QString text;
+	const quint32 begin = block.offsets[std::size_t(line)];
+	const quint32 end = block.offsets[std::size_t(line) + 1];
+	text.reserve(qsizetype(end - begin));
+	for (quint32 i = begin; i < end; ++i) {
+		const char32_t cp = cellCodepoint(block.cells[i]);
+		if (QChar::requiresSurrogates(cp)) {
+			text.append(QChar(QChar::highSurrogate(cp)));
+			text.append(QChar(QChar::lowSurrogate(cp)));
+		} else {
+			text.append(QChar(char16_t(cp)));
+		}
+	}
+	return text;
+}
+
+QString Scrollback::lineText(qint64 index) const {
+	if (index < firstLine() || index >= endLine()) return {};
+	const BlockPtr block = blockFor(index / kLinesPerPage);
+	const int slot = int(index % kLinesPerPage);
+	return slot < block->lineCount() ? textOf(*block, slot) : QString();
+}
+
+qint64 Scrollback::find(const QString& needle, qint64 from, bool backward, Qt::CaseSensitivity cs) const {
+	if (needle.isEmpty() || lineCount() == 0) return -1;
+	from = std::clamp(from, firstLine(), endLine() - 1);
+	const std::vector<quint32> trigrams = trigramsOf(needle);
+	const qint64 fromPage = from / kLinesPerPage;
+	const qint64 step = backward ? -1 : 1;
+	Bloom bloom;
+	for (qint64 number = fromPage; number >= m_firstPage && number <= m_openPage; number += step) {
+		if (number < m_openPage && !trigrams.empty()) {
+			const Page& page = m_pages[std::size_t(number - m_firstPage)];
+			if (loadBloom(page, bloom) && !mayContain(bloom, trigrams)) continue;
+		}
+		const BlockPtr block = blockFor(number);
+		int first = 0;
+		int last = block->lineCount() - 1;
+		if (number == fromPage) {
+			(backward ? last : first) = int(from % kLinesPerPage);
+		}
+		for (int i = backward ? last : first; i >= first && i <= last; i += int(step)) {
+			if (textOf(*block, i).contains(needle, cs)) {
+				return number * kLinesPerPage + i;
+			}
+		}
+	}
+	return -1;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "screen_grid.h"
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <array>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "../util/task_scheduler.h"
+
+class QTemporaryFile;
+
+struct ScrollbackOptions {
+	// Everything held in RAM: hot pages, compressed pages, blooms and page records.
+	qint64 memoryLimit = qint64(32) << 20;
+	// Compressed pages evicted from RAM go to a temp file up to this size; 0 drops them instead.
+	qint64 diskLimit = qint64(512) << 20;
+	// Number of most recent sealed pages kept uncompressed for scrolling.
+	int hotPages = 8;
+};
+
+// Terminal history with bounded memory. Lines are grouped into fixed-size
+// pages so a line number maps to its page arithmetically. The newest pages
+// stay uncompressed; older ones are compressed on the task scheduler and may
+// spill to a temp file. Each compressed page carries a trigram bloom filter
+// so searches can skip pages without decompressing them.
+class Scrollback : public QObject {
+	Q_OBJECT
+public:
+	static constexpr int kLinesPerPage = 256;
+
+	explicit Scrollback(QObject* parent = nullptr);
+	~Scrollback() override;
+
+	void setOptions(const ScrollbackOptions& options);
+	const ScrollbackOptions& options() const { return m_options; }
+
+	// Attribute indices are looked up in attrs; pages keep their own copies.
+	void append(const Cell* cells, int count, const AttrTable& attrs);
+	void clear();
+
+	// Absolute line numbers; lines below firstLine() have been discarded.
+	qint64 firstLine() const { return m_firstPage * kLinesPerPage; }
+	qint64 endLine() const { return m_openPage * kLinesPerPage + m_open.lineCount(); }
+	qint64 lineCount() const { return endLine() - firstLine(); }
+
+	// The cells' attribute indices refer to attrs.
+	bool line(qint64 index, std::vector<Cell>& out, std::vector<CellAttr>& attrs) const;
+	QString lineText(qint64 index) const;
+	// Returns the first line at or after (before, when backward) from containing needle, or -1.
+	qint64 find(const QString& needle, qint64 from, bool backward, Qt::CaseSensitivity cs = Qt::CaseInsensitive) const;
+
+	qint64 memoryUsage() const;
+	qint64 diskUsage() const { return m_diskLive; }
+
+private:
+	static constexpr int kBloomWords = 256;
+	using Bloom = std::array<quint64, kBloomWords>;
+
+	struct Block {
+		std::vector<Cell> cells;
+		std::vector<quint32> offsets{0};
+		// The page's own attribute table, which its cells index.
+		std::vector<CellAttr> attrs{CellAttr{}};
+		int lineCount() const { return int(offsets.size()) - 1; }
+		qint64 bytes() const {
+			return qint64(cells.capacity() * sizeof(Cell) + offsets.capacity() * sizeof(quint32)
+				+ attrs.capacity() * sizeof(CellAttr));
+		}
+	};
+	using BlockPtr = std::shared_ptr<const Block>;
+
+	struct Page {
+		BlockPtr block;
+		QByteArray compressed;
+		std::shared_ptr<Bloom> bloom;
+		qint64 fileOffset = -1;
+		qint32 fileSize = 0;
+		bool pending = true;
+	};
+
+	struct Encoded {
+		QByteArray compressed;
+		std::shared_ptr<Bloom> bloom;
+	};
+
+	static Encoded encode(const Block& block);
+	static BlockPtr decode(const QByteArray& compressed);
+	static void addTrigrams(Bloom& bloom, const Block& block);
+	static bool mayContain(const Bloom& bloom, const std::vector<quint32>& trigrams);
+	static std::vector<quint32> trigramsOf(const QString& needle);
+	static QString textOf(const Block& block, int line);
+
+	qint64 pageMemory(const Page& page) const;
+	void seal();
+	void onEncoded(qint64 pageNumber, quint64 generation, Encoded encoded);
+	void coolPages();
+	void enforceLimits();
+	bool spill(Page& page);
+	void dropFront();
+	void compactSpill();
+	BlockPtr blockFor(qint64 pageNumber) const;
+	bool loadBloom(const Page& page, Bloom& out) const;
+	QByteArray loadCompressed(const Page& page) const;
+
+	ScrollbackOptions m_options;
+	TaskSequence m_tasks{TaskPriority::Background};
+
+	std::deque<Page> m_pages;
+	Block m_open;
+	// Deduplicates m_open.attrs.
+	AttrTable m_openAttrs;
+	qint64 m_firstPage = 0;
+	qint64 m_openPage = 0;
+	qsizetype m_spilled = 0;
+	quint64 m_generation = 0;
+
+	std::unique_ptr<QTemporaryFile> m_spill;
+	qint64 m_diskLive = 0;
+	qint64 m_diskDead = 0;
+	qint64 m_memory = 0;
+
+	static constexpr std::size_t kCacheSize = 4;
+	mutable std::vector<std::pair<qint64, BlockPtr>> m_cache;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Lock-free single-producer/single-consumer byte ring. Capacity is rounded up
+// to a power of two; head and tail only ever grow and are masked on access.
+class SpscByteRing {
+public:
+	explicit SpscByteRing(std::size_t capacity) {
+		std::size_t cap = 1;
+		while (cap < capacity) cap <<= 1;
+		m_buf.resize(cap);
+		m_mask = cap - 1;
+	}
+
+	std::size_t capacity() const { return m_buf.size(); }
+
+	std::size_t readable() const {
+		return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed);
+	}
+
+	// Producer side.
+	std::size_t write(const char* data, std::size_t len) {
+		const std::size_t head = m_head.load(std::memory_order_relaxed);
+		const std::size_t tail = m_tail.load(std::memory_order_acquire);
+		const std::size_t n = std::min(len, capacity() - (head - tail));
+		copyIn(head, data, n);
+		m_head.store(head + n, std::memory_order_release);
+		return n;
+	}
+
+	// Blocks the producer until some space is free or close() was called.
+	bool waitForSpace() {
+		for (;;) {
+			const unsigned seq = m_wake.load(std::memory_order_acquire);
+			if (m_closed.load(std::memory_order_acquire)) return false;
+			const std::size_t tail = m_tail.load(std::memory_order_acquire);
+			if (m_head.load(std::memory_order_relaxed) - tail < capacity()) return true;
+			m_wake.wait(seq, std::memory_order_acquire);
+		}
+	}
+
+	// Consumer side.
+	std::size_t read(char* out, std::size_t len) {
+		const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+		const std::size_t head = m_head.load(std::memory_order_acquire);
+		const std::size_t n = std::min(len, head - tail);
+		copyOut(tail, out, n);
+		m_tail.store(tail + n, std::memory_order_release);
+		if (n) {
+			m_wake.fetch_add(1, std::memory_order_release);
+			m_wake.notify_one();
+		}
+		return n;
+	}
+
+	void close() {
+		m_closed.store(true, std::memory_order_release);
+		m_wake.fetch_add(1, std::memory_order_release);
+		m_wake.notify_all();
+	}
+
+private:
+	void copyIn(std::size_t pos, const char* data, std::size_t n) {
+		const std::size_t at = pos & m_mask;
+		const std::size_t first = std::min(n, capacity() - at);
+		std::memcpy(m_buf.data() + at, data, first);
+		std::memcpy(m_buf.data(), data + first, n - first);
+	}
+	void copyOut(std::size_t pos, char* out, std::size_t n) const {
+		const std::size_t at = pos & m_mask;
+		const std::size_t first = std::min(n, capacity() - at);
+		std::memcpy(out, m_buf.data() + at, first);
+		std::memcpy(out + first, m_buf.data(), n - first);
+	}
+
+	static constexpr std::size_t kLine = 64;
+	std::vector<char> m_buf;
+	std::size_t m_mask = 0;
+	alignas(kLine) std::atomic<std::size_t> m_head{0};
+	alignas(kLine) std::atomic<std::size_t> m_tail{0};
+	std::atomic<unsigned> m_wake{0};
+	std::atomic<bool> m_closed{false};
+};
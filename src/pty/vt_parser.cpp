@@ -0,0 +1,358 @@
+#include "vt_parser.h"
+#include <algorithm>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IDE_VT_SSE2 1
+#endif
+
+namespace {
+constexpr char32_t kReplacement = 0xFFFD;
+
+bool isPlain(unsigned char c) { return c >= 0x20 && c < 0x7F; }
+}
+
+std::size_t VtParser::plainRun(const char* data, std::size_t len) {
+	std::size_t i = 0;
+#if defined(IDE_VT_SSE2)
+	const __m128i space = _mm_set1_epi8(0x20);
+	const __m128i del = _mm_set1_epi8(0x7F);
+	for (; i + 16 <= len; i += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		// Signed compare: bytes >= 0x80 are negative, so a single compare
+		// catches both C0 controls and the start of UTF-8 sequences.
+		const __m128i special = _mm_or_si128(_mm_cmplt_epi8(v, space), _mm_cmpeq_epi8(v, del));
+		const unsigned mask = unsigned(_mm_movemask_epi8(special));
+		if (mask) return i + unsigned(std::countr_zero(mask));
+	}
+#endif
+	while (i < len && isPlain(static_cast<unsigned char>(data[i]))) ++i;
+	return i;
+}
+
+void VtParser::feed(const char* data, std::size_t len) {
+	const char* p = data;
+	const char* end = data + len;
+	while (p < end) {
+		if (m_state == State::Ground && m_utf8Need == 0) {
+			const std::size_t run = plainRun(p, std::size_t(end - p));
+			if (run > 0) {
+				m_grid.putAscii(p, run);
+				p += run;
+				continue;
+			}
+		}
+		step(static_cast<unsigned char>(*p++));
+	}
+}
+
+void VtParser::reset() {
+	m_state = State::Ground;
+	m_paramCount = 0;
+	m_private = 0;
+	m_intermediate = 0;
+	m_osc.clear();
+	m_utf8Need = 0;
+	m_appCursorKeys = false;
+	m_bracketedPaste = false;
+	m_grid.reset();
+}
+
+void VtParser::step(unsigned char c) {
+	// CAN and SUB abort any sequence; ESC restarts one, except inside strings
+	// where it may begin the ST terminator.
+	if (c == 0x18 || c == 0x1A) {
+		m_state = State::Ground;
+		return;
+	}
+	switch (m_state) {
+	case State::Ground:
+		ground(c);
+		break;
+	case State::Escape:
+		if (c == 0x1B) break;
+		if (c < 0x20) {
+			execute(c);
+		} else {
+			escDispatch(c);
+		}
+		break;
+	case State::EscapeCharset:
+		// Designated character sets are not emulated; drop the final byte.
+		m_state = c == 0x1B ? State::Escape : State::Ground;
+		break;
+	case State::Csi:
+		if (c == 0x1B) {
+			m_state = State::Escape;
+		} else if (c < 0x20) {
+			execute(c);
+		} else if (c >= 0x40 && c <= 0x7E) {
+			m_state = State::Ground;
+			csiDispatch(c);
+		} else {
+			csiParam(c);
+		}
+		break;
+	case State::Osc:
+		if (c == 0x07) {
+			m_state = State::Ground;
+			oscDispatch();
+		} else if (c == 0x1B) {
+			m_state = State::OscEscape;
+		} else if (m_osc.size() < kMaxOsc) {
+			m_osc.append(char(c));
+		}
+		break;
+	case State::OscEscape:
+		m_state = State::Ground;
+		oscDispatch();
+		if (c != '\\') step(c);
+		break;
+	case State::String:
+		if (c == 0x1B) m_state = State::StringEscape;
+		else if (c == 0x07) m_state = State::Ground;
+		break;
+	case State::StringEscape:
+		m_state = c == '\\' ? State::Ground : State::String;
+		break;
+	}
+}
+
+void VtParser::ground(unsigned char c) {
+	if (m_utf8Need > 0) {
+		if ((c & 0xC0) == 0x80) {
+			m_codepoint = (m_codepoint << 6) | (c & 0x3F);
+			if (--m_utf8Need == 0) {
+				m_grid.putCodepoint(m_codepoint);
+			}
+			return;
+		}
+		m_utf8Need = 0;
+		m_grid.putCodepoint(kReplacement);
+	}
+	if (c == 0x1B) {
+		m_state = State::Escape;
+	} else if (c < 0x20) {
+		execute(c);
+	} else if (c < 0x7F) {
+		m_grid.putAscii(reinterpret_cast<const char*>(&c), 1);
+	} else if (c == 0x7F) {
+		// DEL is ignored.
+	} else if (c >= 0xC2 && c <= 0xDF) {
+		m_codepoint = c & 0x1F;
+		m_utf8Need = 1;
+	} else if (c >= 0xE0 && c <= 0xEF) {
+		m_codepoint = c & 0x0F;
+		m_utf8Need = 2;
+	} else if (c >= 0xF0 && c <= 0xF4) {
+		m_codepoint = c & 0x07;
+		m_utf8Need = 3;
+	} else {
+		m_grid.putCodepoint(kReplacement);
+	}
+}
+
+void VtParser::execute(unsigned char c) {
+	switch (c) {
+	case 0x08: m_grid.backspace(); break;
+	case 0x09: m_grid.tab(); break;
+	case 0x0A:
+	case 0x0B:
+	case 0x0C: m_grid.lineFeed(); break;
+	case 0x0D: m_grid.carriageReturn(); break;
+	default: break;
+	}
+}
+
+void VtParser::escDispatch(unsigned char c) {
+	m_state = State::Ground;
+	switch (c) {
+	case '[': csiEnter(); break;
+	case ']': m_osc.clear(); m_state = State::Osc; break;
+	case 'P':
+	case 'X':
+	case '^':
+	case '_': m_state = State::String; break;
+	case '(':
+	case ')':
+	case '*':
+	case '+':
+	case '#':
+	case '%': m_state = State::EscapeCharset; break;
+	case '7': m_grid.saveCursor(); break;
+	case '8': m_grid.restoreCursor(); break;
+	case 'D': m_grid.lineFeed(); break;
+	case 'E': m_grid.carriageReturn(); m_grid.lineFeed(); break;
+	case 'M': m_grid.reverseIndex(); break;
+	case 'c': reset(); break;
+	default: break;
+	}
+}
+
+void VtParser::csiEnter() {
+	m_state = State::Csi;
+	m_params.fill(0);
+	m_paramCount = 0;
+	m_private = 0;
+	m_intermediate = 0;
+}
+
+void VtParser::csiParam(unsigned char c) {
+	if (c >= '0' && c <= '9') {
+		if (m_paramCount == 0) m_paramCount = 1;
+		int& value = m_params[std::size_t(m_paramCount - 1)];
+		value = std::min(value * 10 + (c - '0'), 65535);
+	} else if (c == ';' || c == ':') {
+		if (m_paramCount == 0) m_paramCount = 1;
+		if (m_paramCount < kMaxParams) ++m_paramCount;
+	} else if (c >= '<' && c <= '?') {
+		m_private = char(c);
+	} else if (c >= 0x20 && c <= 0x2F) {
+		m_intermediate = char(c);
+	}
+}
+
+int VtParser::param(int index, int fallback) const {
+	if (index >= m_paramCount) return fallback;
+	const int value = m_params[std::size_t(index)];
+	return value == 0 ? fallback : value;
+}
+
+void VtParser::csiDispatch(unsigned char final) {
+	if (m_private == '?') {
+		if (final == 'h' || final == 'l') setPrivateModes(final == 'h');
+		return;
+	}
+	if (m_private || m_intermediate) return;
+
+	const int n = param(0, 1);
+	switch (final) {
+	case '@': m_grid.insertBlanks(n); break;
+	case 'A': m_grid.moveCursor(0, -n); break;
+	case 'B':
+	case 'e': m_grid.moveCursor(0, n); break;
+	case 'C':
+	case 'a': m_grid.moveCursor(n, 0); break;
+	case 'D': m_grid.moveCursor(-n, 0); break;
+	case 'E': m_grid.moveCursor(0, n); m_grid.carriageReturn(); break;
+	case 'F': m_grid.moveCursor(0, -n); m_grid.carriageReturn(); break;
+	case 'G':
+	case '`': m_grid.setCursorX(n - 1); break;
+	case 'd': m_grid.setCursorY(n - 1); break;
+	case 'H':
+	case 'f': m_grid.setCursor(param(1, 1) - 1, n - 1); break;
+	case 'J': m_grid.eraseInDisplay(param(0, 0)); break;
+	case 'K': m_grid.eraseInLine(param(0, 0)); break;
+	case 'L': m_grid.insertLines(n); break;
+	case 'M': m_grid.deleteLines(n); break;
+	case 'P': m_grid.deleteChars(n); break;
+	case 'X': m_grid.eraseChars(n); break;
+	case 'S': m_grid.scrollUp(n); break;
+	case 'T': m_grid.scrollDown(n); break;
+	case 'm': selectGraphicRendition(); break;
+	case 'r': m_grid.setScrollRegion(n - 1, param(1, m_grid.rows()) - 1); break;
+	case 's': m_grid.saveCursor(); break;
+	case 'u': m_grid.restoreCursor(); break;
+	case 'c':
+		if (onReply) onReply(QByteArrayLiteral("\x1b[?62;22c"));
+		break;
+	case 'n':
+		if (!onReply) break;
+		if (param(0, 0) == 5) {
+			onReply(QByteArrayLiteral("\x1b[0n"));
+		} else if (param(0, 0) == 6) {
+			onReply("\x1b[" + QByteArray::number(m_grid.cursorY() + 1) + ';'
+				+ QByteArray::number(m_grid.cursorX() + 1) + 'R');
+		}
+		break;
+	default: break;
+	}
+}
+
+void VtParser::setPrivateModes(bool on) {
+	for (int i = 0; i < std::max(m_paramCount, 1); ++i) {
+		switch (m_params[std::size_t(i)]) {
+		case 1: m_appCursorKeys = on; break;
+		case 7: m_grid.setAutoWrap(on); break;
+		case 25: m_grid.setCursorVisible(on); break;
+		case 47:
+		case 1047: m_grid.setAltScreen(on); break;
+		case 1049:
+			if (on) {
+				m_grid.saveCursor();
+				m_grid.setAltScreen(true);
+			} else {
+				m_grid.setAltScreen(false);
+				m_grid.restoreCursor();
+			}
+			break;
+		case 2004: m_bracketedPaste = on; break;
+		default: break;
+		}
+	}
+}
+
+void VtParser::selectGraphicRendition() {
+	CellAttr& pen = m_grid.pen();
+	const int count = std::max(m_paramCount, 1);
+	for (int i = 0; i < count; ++i) {
+		const int p = m_params[std::size_t(i)];
+		switch (p) {
+		case 0: pen = CellAttr{}; break;
+		case 1: pen.flags |= CellBold; break;
+		case 2: pen.flags |= CellDim; break;
+		case 3: pen.flags |= CellItalic; break;
+		case 4: pen.flags |= CellUnderline; break;
+		case 5: pen.flags |= CellBlink; break;
+		case 7: pen.flags |= CellInverse; break;
+		case 8: pen.flags |= CellHidden; break;
+		case 9: pen.flags |= CellStrike; break;
+		case 22: pen.flags &= quint16(~(CellBold | CellDim)); break;
+		case 23: pen.flags &= quint16(~CellItalic); break;
+		case 24: pen.flags &= quint16(~CellUnderline); break;
+		case 25: pen.flags &= quint16(~CellBlink); break;
+		case 27: pen.flags &= quint16(~CellInverse); break;
+		case 28: pen.flags &= quint16(~CellHidden); break;
+		case 29: pen.flags &= quint16(~CellStrike); break;
+		case 39: pen.fg = 0; break;
+		case 49: pen.bg = 0; break;
+		case 38:
+		case 48: {
+			quint32 color = 0;
+			if (i + 2 < count && m_params[std::size_t(i + 1)] == 5) {
+				color = kPaletteColor | quint32(m_params[std::size_t(i + 2)] & 0xFF);
+				i += 2;
+			} else if (i + 4 < count && m_params[std::size_t(i + 1)] == 2) {
+				color = kRgbColor
+					| quint32(m_params[std::size_t(i + 2)] & 0xFF) << 16
+					| quint32(m_params[std::size_t(i + 3)] & 0xFF) << 8
+					| quint32(m_params[std::size_t(i + 4)] & 0xFF);
+				i += 4;
+			} else {
+				i = count;
+				break;
+			}
+			(p == 38 ? pen.fg : pen.bg) = color;
+			break;
+		}
+		default:
+			if (p >= 30 && p <= 37) pen.fg = kPaletteColor | quint32(p - 30);
+			else if (p >= 40 && p <= 47) pen.bg = kPaletteColor | quint32(p - 40);
+			else if (p >= 90 && p <= 97) pen.fg = kPaletteColor | quint32(p - 90 + 8);
+			else if (p >= 100 && p <= 107) pen.bg = kPaletteColor | quint32(p - 100 + 8);
+			break;
+		}
+	}
+	m_grid.penChanged();
+}
+
+void VtParser::oscDispatch() {
+	const qsizetype sep = m_osc.indexOf(';');
+	if (sep < 0) return;
+	const int code = m_osc.left(sep).toInt();
+	if ((code == 0 || code == 2) && onTitle) {
+		onTitle(QString::fromUtf8(m_osc.mid(sep + 1)));
+	}
+	m_osc.clear();
+}
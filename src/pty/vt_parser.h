@@ -0,0 +1,62 @@
+#pragma once
+#include "screen_grid.h"
+#include <QByteArray>
+#include <QString>
+#include <array>
+#include <cstddef>
+#include <functional>
+
+// Escape sequence state machine for an xterm-compatible subset. Printable
+// ASCII runs are located with a vectorized scan and copied into the grid in
+// bulk; only control bytes, escapes and non-ASCII text go through the
+// per-byte state machine.
+class VtParser {
+public:
+	explicit VtParser(ScreenGrid& grid) : m_grid(grid) {}
+
+	void feed(const char* data, std::size_t len);
+	void feed(const QByteArray& data) { feed(data.constData(), std::size_t(data.size())); }
+	void reset();
+
+	bool appCursorKeys() const { return m_appCursorKeys; }
+	bool bracketedPaste() const { return m_bracketedPaste; }
+
+	// Bytes the terminal must send back to the program (status reports).
+	std::function<void(const QByteArray&)> onReply;
+	std::function<void(const QString&)> onTitle;
+
+	// Length of the leading run of printable ASCII in [data, data + len).
+	static std::size_t plainRun(const char* data, std::size_t len);
+
+private:
+	enum class State : quint8 { Ground, Escape, EscapeCharset, Csi, Osc, OscEscape, String, StringEscape };
+	static constexpr int kMaxParams = 16;
+	static constexpr qsizetype kMaxOsc = 4096;
+
+	void step(unsigned char c);
+	void ground(unsigned char c);
+	void execute(unsigned char c);
+	void escDispatch(unsigned char c);
+	void csiEnter();
+	void csiParam(unsigned char c);
+	void csiDispatch(unsigned char final);
+	void setPrivateModes(bool on);
+	void selectGraphicRendition();
+	void oscDispatch();
+	int param(int index, int fallback) const;
+
+	ScreenGrid& m_grid;
+	State m_state = State::Ground;
+
+	std::array<int, kMaxParams> m_params{};
+	int m_paramCount = 0;
+	char m_private = 0;
+	char m_intermediate = 0;
+	QByteArray m_osc;
+
+	char32_t m_codepoint = 0;
+	int m_utf8Need = 0;
+
+	bool m_appCursorKeys = false;
+	bool m_bracketedPaste = false;
+};
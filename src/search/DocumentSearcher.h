@@ -1,23 +1,45 @@
 #pragma once
-struct SearchResult {
-    int start;
-    int length;
-};
+#include <QString>
+#include <QStringView>
+#include "SearchMatches.h"
+#include "../util/trace.h"
+#include <algorithm>
 
+// Literal search over text kept in two pieces, as a gap buffer keeps it, so
+// the document is searched where it is rather than from a copy.
 class DocumentSearcher {
-	QString m_text;
 public:
-	void setText(const QString& text) {
-		m_text = text;
+	static SearchMatchesPtr findAll(QStringView text, const QString& search, Qt::CaseSensitivity cs) {
+		return findAll(text, {}, search, cs);
 	}
-	QVector<SearchResult> findAll(const QString& search, Qt::CaseSensitivity cs) {
-		QVector<SearchResult> results;
-		if (search.isEmpty()) return results;
-		int pos = 0;
-		while ((pos = m_text.indexOf(search, pos , cs)) != -1) {
-			results.push_back({pos, search.length()});
-			pos += search.length();
+
+	// Matches across first followed by second; only the few characters
+	// around the seam are copied, for matches that straddle it.
+	static SearchMatchesPtr findAll(QStringView first, QStringView second, const QString& search, Qt::CaseSensitivity cs) {
+		IDE_TRACE_SPAN("DocumentSearcher::findAll");
+		const qsizetype n = search.length();
+		SearchMatches::Builder results(n);
+		if (n == 0) return results.finish();
+		// Where the next match may start, counted across both pieces.
+		qsizetype next = 0;
+		for (qsizetype pos = 0; (pos = first.indexOf(search, pos, cs)) != -1; pos += n) {
+			results.append(pos, n);
+			next = pos + n;
 		}
-		return results;
+		if (!second.isEmpty()) {
+			// A tail shorter than the needle, so whatever matches here ends in second.
+			const qsizetype from = std::max(next, first.size() - (n - 1));
+			if (from < first.size()) {
+				const QString seam = first.sliced(from) + second.first(std::min(n - 1, second.size()));
+				for (qsizetype pos = 0; (pos = seam.indexOf(search, pos, cs)) != -1; pos += n) {
+					results.append(from + pos, n);
+					next = from + pos + n;
+				}
+			}
+			for (qsizetype pos = std::max<qsizetype>(0, next - first.size()); (pos = second.indexOf(search, pos, cs)) != -1; pos += n) {
+				results.append(first.size() + pos, n);
+			}
+		}
+		return results.finish();
 	}
-};
\ No newline at end of file
+};
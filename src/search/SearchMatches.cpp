@@ -0,0 +1,105 @@
+#include "SearchMatches.h"
+#include <algorithm>
+
+SearchMatches::Builder::Builder(qint64 fixedLength) : m_set(new SearchMatches) {
+	m_set->m_fixedLength = fixedLength;
+}
+
+void SearchMatches::Builder::append(qint64 start, qint64 length) {
+	SearchMatches& set = *m_set;
+	Q_ASSERT(set.m_count == 0 || start >= m_last);
+	if (set.m_count % kBlock == 0) {
+		set.m_checkpoints.push_back({start, quint64(set.m_deltas.size())});
+	} else {
+		quint64 delta = quint64(start - m_last);
+		while (delta >= 0x80) {
+			set.m_deltas.push_back(quint8(delta | 0x80));
+			delta >>= 7;
+		}
+		set.m_deltas.push_back(quint8(delta));
+	}
+	if (set.m_fixedLength >= 0 && length != set.m_fixedLength) {
+		set.m_lengths.assign(std::size_t(set.m_count), quint32(set.m_fixedLength));
+		set.m_fixedLength = -1;
+	}
+	if (set.m_fixedLength < 0) {
+		set.m_lengths.push_back(quint32(length));
+	}
+	m_last = start;
+	++set.m_count;
+}
+
+std::shared_ptr<const SearchMatches> SearchMatches::Builder::finish() {
+	m_set->m_checkpoints.shrink_to_fit();
+	m_set->m_deltas.shrink_to_fit();
+	m_set->m_lengths.shrink_to_fit();
+	std::shared_ptr<const SearchMatches> out(m_set.release());
+	m_set.reset(new SearchMatches);
+	m_last = 0;
+	return out;
+}
+
+qint64 SearchMatches::decodeFromBlock(qsizetype block, qsizetype steps) const {
+	const Checkpoint& cp = m_checkpoints[std::size_t(block)];
+	qint64 offset = cp.offset;
+	const quint8* p = m_deltas.data() + cp.bytePos;
+	for (qsizetype i = 0; i < steps; ++i) {
+		offset += readVarint(p);
+	}
+	return offset;
+}
+
+SearchResult SearchMatches::at(qsizetype index) const {
+	Q_ASSERT(index >= 0 && index < m_count);
+	const qint64 start = decodeFromBlock(index / kBlock, index % kBlock);
+	return {start, lengthAt(index)};
+}
+
+qsizetype SearchMatches::blockFor(qint64 offset) const {
+	auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), offset,
+		[](qint64 value, const Checkpoint& cp) { return value < cp.offset; });
+	return qsizetype(it - m_checkpoints.begin()) - 1;
+}
+
+qsizetype SearchMatches::firstAtOrAfter(qint64 offset) const {
+	const qsizetype block = blockFor(offset);
+	if (block < 0) return 0;
+	const Checkpoint& cp = m_checkpoints[std::size_t(block)];
+	if (cp.offset >= offset) return block * kBlock;
+
+	const qsizetype blockEnd = std::min(m_count, (block + 1) * kBlock);
+	qint64 value = cp.offset;
+	const quint8* p = m_deltas.data() + cp.bytePos;
+	for (qsizetype i = block * kBlock + 1; i < blockEnd; ++i) {
+		value += readVarint(p);
+		if (value >= offset) return i;
+	}
+	return blockEnd;
+}
+
+qsizetype SearchMatches::lastBefore(qint64 offset) const {
+	return firstAtOrAfter(offset) - 1;
+}
+
+qsizetype SearchMatches::nearest(qint64 offset) const {
+	if (m_count == 0) return -1;
+	const qsizetype after = firstAtOrAfter(offset);
+	if (after >= m_count) return m_count - 1;
+	if (after == 0) return 0;
+	const qint64 distAfter = at(after).start - offset;
+	const qint64 distBefore = offset - at(after - 1).start;
+	return distBefore < distAfter ? after - 1 : after;
+}
+
+qsizetype SearchMatches::indexOf(qint64 start) const {
+	const qsizetype i = firstAtOrAfter(start);
+	if (i < m_count && at(i).start == start) return i;
+	return -1;
+}
+
+std::size_t SearchMatches::memoryUsage() const {
+	return sizeof(*this)
+		+ m_checkpoints.capacity() * sizeof(Checkpoint)
+		+ m_deltas.capacity()
+		+ m_lengths.capacity() * sizeof(quint32);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <QtGlobal>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct SearchResult {
+	qint64 start;
+	qint64 length;
+};
+
+// Immutable, shared set of search matches sorted by offset.
+// Offsets are stored as varint deltas with an absolute checkpoint every
+// kBlock matches, so index/offset lookups are a binary search plus a short
+// decode. Literal searches store their length once instead of per match.
+class SearchMatches {
+public:
+	static constexpr qsizetype kBlock = 64;
+
+	class Builder {
+	public:
+		explicit Builder(qint64 fixedLength = -1);
+		void append(qint64 start, qint64 length);
+		std::shared_ptr<const SearchMatches> finish();
+	private:
+		std::unique_ptr<SearchMatches> m_set;
+		qint64 m_last = 0;
+	};
+
+	qsizetype size() const { return m_count; }
+	bool isEmpty() const { return m_count == 0; }
+	SearchResult at(qsizetype index) const;
+
+	qsizetype firstAtOrAfter(qint64 offset) const;
+	qsizetype lastBefore(qint64 offset) const;
+	qsizetype nearest(qint64 offset) const;
+	qsizetype indexOf(qint64 start) const;
+
+	// Seeks to the first match's checkpoint once, then walks the deltas.
+	template <typename Fn>
+	void forEachInRange(qint64 from, qint64 to, Fn&& fn) const {
+		qsizetype i = firstAtOrAfter(from);
+		if (i < 0 || i >= m_count) return;
+		const Checkpoint& cp = m_checkpoints[std::size_t(i / kBlock)];
+		qint64 start = cp.offset;
+		const quint8* p = m_deltas.data() + cp.bytePos;
+		for (qsizetype steps = i % kBlock; steps > 0; --steps) {
+			start += readVarint(p);
+		}
+		while (start < to) {
+			fn(i, SearchResult{start, lengthAt(i)});
+			if (++i >= m_count) break;
+			// A block's deltas follow the previous block's, so only the offset restarts.
+			start = i % kBlock == 0 ? m_checkpoints[std::size_t(i / kBlock)].offset : start + readVarint(p);
+		}
+	}
+
+	std::size_t memoryUsage() const;
+
+private:
+	SearchMatches() = default;
+	static qint64 readVarint(const quint8*& p) {
+		quint64 value = 0;
+		int shift = 0;
+		while (*p & 0x80) {
+			value |= quint64(*p++ & 0x7f) << shift;
+			shift += 7;
+		}
+		value |= quint64(*p++) << shift;
+		return qint64(value);
+	}
+	qint64 lengthAt(qsizetype index) const {
+		return m_fixedLength >= 0 ? m_fixedLength : qint64(m_lengths[std::size_t(index)]);
+	}
+	qint64 decodeFromBlock(qsizetype block, qsizetype steps) const;
+	qsizetype blockFor(qint64 offset) const;
+
+	struct Checkpoint {
+		qint64 offset;
+		quint64 bytePos;
+	};
+
+	std::vector<Checkpoint> m_checkpoints;
+	std::vector<quint8> m_deltas;
+	std::vector<quint32> m_lengths;
+	qint64 m_fixedLength = -1;
+	qsizetype m_count = 0;
+};
+
+using SearchMatchesPtr = std::shared_ptr<const SearchMatches>;
@@ -0,0 +1,288 @@
+#include "syntax_highlighter.h"
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+// Lines lexed per worker task, so newer edits never wait behind a whole file.
+constexpr qsizetype kChunkLines = 50000;
+
+// Moves a window's lines to where an edit put them. The edited line keeps its
+// old tokens until the worker catches up, so typing doesn't flash plain text.
+void shiftWindow(HighlightWindow& window, const TextDelta& delta) {
+	const qsizetype size = qsizetype(window.lines.size());
+	if (delta.firstLine + delta.removedLines < window.first) {
+		window.first += delta.addedLines - delta.removedLines;
+		return;
+	}
+	if (delta.firstLine >= window.first + size) return;
+	if (delta.firstLine < window.first) {
+		window.lines.clear();
+		return;
+	}
+	const qsizetype at = delta.firstLine - window.first + 1;
+	window.lines.erase(window.lines.begin() + std::min(at, size),
+		window.lines.begin() + std::min(at + delta.removedLines, size));
+	window.lines.insert(window.lines.begin() + std::min(at, qsizetype(window.lines.size())),
+		std::size_t(delta.addedLines), LineTokens{});
+}
+}
+
+struct SyntaxHighlighter::State {
+	const SyntaxDefinition* syntax = nullptr;
+	quint64 generation = 0;
+	quint64 edits = 0;
+	BufferMirror text;
+	// Entry state of every line; entry[0, valid) are known to be right.
+	std::vector<quint32> entry;
+	qsizetype valid = 1;
+	// entry[0, staleEnd) were right before the edits since, except for the
+	// lines up to editEnd that the edits touched.
+	qsizetype staleEnd = 1;
+	qsizetype editEnd = -1;
+	qsizetype first = 0;
+	qsizetype last = -1;
+	bool propagating = false;
+
+	qsizetype lineCount() const { return qsizetype(entry.size()); }
+	bool done() const { return !syntax || valid >= lineCount(); }
+	void reset(const SyntaxDefinition* next);
+	void setText(const TextSnapshot& snapshot);
+	void applyEdit(const LinePatch& patch);
+	void setVisible(qsizetype from, qsizetype to);
+	bool advance(qsizetype until, qsizetype budget);
+	HighlightWindow window() const;
+};
+
+void SyntaxHighlighter::State::reset(const SyntaxDefinition* next) {
+	syntax = next;
+	text.clear();
+	entry.clear();
+	valid = staleEnd = 1;
+	editEnd = -1;
+}
+
+void SyntaxHighlighter::State::setText(const TextSnapshot& snapshot) {
+	text.reset(snapshot);
+	entry.assign(std::size_t(text.lineCount()), 0);
+	valid = staleEnd = 1;
+	editEnd = -1;
+}
+
+void SyntaxHighlighter::State::applyEdit(const LinePatch& patch) {
+	const qsizetype count = lineCount();
+	if (count == 0) return;
+	const TextDelta& delta = patch.delta;
+	const qsizetype at = std::clamp<qsizetype>(delta.firstLine, 0, count - 1);
+	const qsizetype removed = std::clamp<qsizetype>(delta.removedLines, 0, count - 1 - at);
+	const qsizetype added = std::max<qsizetype>(delta.addedLines, 0);
+	const qsizetype shift = added - removed;
+	text.apply(patch);
+
+	const quint32 state = entry[std::size_t(at)];
+	entry.erase(entry.begin() + at + 1, entry.begin() + at + 1 + removed);
+	entry.insert(entry.begin() + at + 1, std::size_t(added), state);
+	if (lineCount() != text.lineCount()) {
+		// The delta didn't describe the edit; the cached states can't be trusted.
+		entry.assign(std::size_t(text.lineCount()), 0);
+		valid = staleEnd = 1;
+		editEnd = -1;
+		return;
+	}
+
+	staleEnd = staleEnd > at + removed + 1 ? staleEnd + shift : std::min(staleEnd, at + 1);
+	if (editEnd > at + removed) {
+		editEnd += shift;
+	}
+	editEnd = std::max(editEnd, at + added);
+	valid = std::min(valid, at + 1);
+}
+
+void SyntaxHighlighter::State::setVisible(qsizetype from, qsizetype to) {
+	// A page either side, so short scrolls find their lines already lexed.
+	const qsizetype page = std::max<qsizetype>(to - from + 1, 1);
+	first = std::max<qsizetype>(from - page, 0);
+	last = to + page;
+}
+
+// Re-lexes from the first line whose entry state is unknown, returning
+// whether a state inside the window changed.
+bool SyntaxHighlighter::State::advance(qsizetype until, qsizetype budget) {
+	bool changed = false;
+	LineTokens scratch;
+	const qsizetype lines = lineCount();
+	for (qsizetype count = 0; valid < lines && valid <= until && count < budget; ++count) {
+		scratch.clear();
+		const QString content = text.line(valid - 1);
+		const quint32 exit = lexLine(*syntax, content, entry[std::size_t(valid - 1)], scratch);
+		quint32& next = entry[std::size_t(valid)];
+		if (valid > editEnd && valid < staleEnd && next == exit) {
+			// Past the edits and back in step with the cache.
+			valid = staleEnd;
+			editEnd = -1;
+			continue;
+		}
+		if (next != exit) {
+			next = exit;
+			changed |= valid >= first && valid <= last;
+		}
+		++valid;
+	}
+	staleEnd = std::max(staleEnd, valid);
+	if (valid >= lines) {
+		editEnd = -1;
+	}
+	return changed;
+}
+
+HighlightWindow SyntaxHighlighter::State::window() const {
+	HighlightWindow window;
+	window.generation = generation;
+	window.edits = edits;
+	if (!syntax) return window;
+	const qsizetype lines = lineCount();
+	window.first = std::min(first, lines);
+	const qsizetype end = std::min(last + 1, lines);
+	window.lines.resize(std::size_t(std::max<qsizetype>(end - window.first, 0)));
+	for (qsizetype i = window.first; i < end; ++i) {
+		const QString content = text.line(i);
+		lexLine(*syntax, content, entry[std::size_t(i)], window.lines[std::size_t(i - window.first)]);
+	}
+	return window;
+}
+
+SyntaxHighlighter::SyntaxHighlighter(QObject* parent) : QObject(parent), m_state(new State) {}
+
+SyntaxHighlighter::~SyntaxHighlighter() {
+	m_tasks.stop();
+}
+
+void SyntaxHighlighter::setDocument(const SyntaxDefinition* syntax, const ITextBuffer* buffer) {
+	m_syntax = buffer ? syntax : nullptr;
+	m_buffer = buffer;
+	++m_generation;
+	m_window = HighlightWindow{};
+	m_window.generation = m_generation;
+	m_unconfirmed.clear();
+	std::optional<TextSnapshot> snapshot;
+	if (m_syntax) {
+		snapshot = m_buffer->snapshot();
+	}
+	{
+		std::lock_guard lock(m_pendingMutex);
+		m_pending = Pending{};
+		m_pending.syntax = m_syntax;
+		m_pending.generation = m_generation;
+		m_pending.snapshot = std::move(snapshot);
+		m_pending.editCount = m_edits;
+		if (m_visibleFirst >= 0) {
+			m_pending.visible = std::pair(m_visibleFirst, m_visibleLast);
+		}
+	}
+	schedule();
+	emit highlighted(0, std::numeric_limits<qsizetype>::max());
+}
+
+void SyntaxHighlighter::applyDelta(const TextDelta& delta) {
+	if (!m_syntax) return;
+	++m_edits;
+	shiftWindow(m_window, delta);
+	m_unconfirmed.emplace_back(m_edits, delta);
+	LinePatch patch = BufferMirror::capture(*m_buffer, delta);
+	{
+		std::lock_guard lock(m_pendingMutex);
+		m_pending.edits.push_back(std::move(patch));
+		m_pending.editCount = m_edits;
+	}
+	schedule();
+}
+
+void SyntaxHighlighter::setVisibleLines(qsizetype first, qsizetype last) {
+	if (first == m_visibleFirst && last == m_visibleLast) return;
+	m_visibleFirst = first;
+	m_visibleLast = last;
+	if (!m_syntax) return;
+	{
+		std::lock_guard lock(m_pendingMutex);
+		m_pending.visible = std::pair(first, last);
+	}
+	schedule();
+}
+
+const LineTokens* SyntaxHighlighter::tokens(qsizetype line) const {
+	const qsizetype index = line - m_window.first;
+	if (index < 0 || index >= qsizetype(m_window.lines.size())) return nullptr;
+	return &m_window.lines[std::size_t(index)];
+}
+
+void SyntaxHighlighter::schedule() {
+	std::lock_guard lock(m_pendingMutex);
+	if (m_queued) return;
+	m_queued = true;
+	m_tasks.submit([this] { runPending(); });
+}
+
+void SyntaxHighlighter::runPending() {
+	Pending pending;
+	{
+		std::lock_guard lock(m_pendingMutex);
+		pending = std::exchange(m_pending, Pending{});
+		m_queued = false;
+	}
+	State& state = *m_state;
+	if (pending.syntax) {
+		state.reset(*pending.syntax);
+		state.generation = pending.generation;
+	}
+	if (pending.snapshot) {
+		state.setText(*pending.snapshot);
+	}
+	for (const LinePatch& patch : pending.edits) {
+		state.applyEdit(patch);
+	}
+	if (pending.syntax || !pending.edits.empty()) {
+		state.edits = pending.editCount;
+	}
+	if (pending.visible) {
+		state.setVisible(pending.visible->first, pending.visible->second);
+	}
+	if (!state.syntax) return;
+
+	state.advance(state.last, kChunkLines);
+	publish(state.window());
+	if (!state.done() && !state.propagating) {
+		state.propagating = true;
+		m_tasks.submit(TaskPriority::Background, [this] { propagate(); });
+	}
+}
+
+// Carries the states through the rest of the file in the background.
+void SyntaxHighlighter::propagate() {
+	State& state = *m_state;
+	state.propagating = false;
+	if (state.done()) return;
+	if (state.advance(state.lineCount(), kChunkLines)) {
+		publish(state.window());
+	}
+	if (!state.done()) {
+		state.propagating = true;
+		m_tasks.submit(TaskPriority::Background, [this] { propagate(); });
+	}
+}
+
+void SyntaxHighlighter::publish(HighlightWindow window) {
+	QMetaObject::invokeMethod(this, [this, window = std::move(window)]() mutable {
+		if (window.generation != m_generation) return;
+		while (!m_unconfirmed.empty() && m_unconfirmed.front().first <= window.edits) {
+			m_unconfirmed.pop_front();
+		}
+		// Edits made while the worker was busy move the lines it returned.
+		for (const auto& [edit, delta] : m_unconfirmed) {
+			shiftWindow(window, delta);
+		}
+		m_window = std::move(window);
+		if (!m_window.lines.empty()) {
+			emit highlighted(m_window.first, m_window.first + qsizetype(m_window.lines.size()) - 1);
+		}
+	}, Qt::QueuedConnection);
+}
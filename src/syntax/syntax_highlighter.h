@@ -0,0 +1,81 @@
+#pragma once
+#include <QObject>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include "syntax_lexer.h"
+#include "../buffer/bufferMirror.h"
+#include "../util/task_scheduler.h"
+
+using LineTokens = std::vector<SyntaxToken>;
+
+// Tokens for the lines around the viewport.
+struct HighlightWindow {
+	quint64 generation = 0;
+	// Number of edits the tokens account for.
+	quint64 edits = 0;
+	qsizetype first = 0;
+	std::vector<LineTokens> lines;
+};
+
+// Lexes one document on the task scheduler. The entry state of every line is
+// cached, so an edit re-lexes from the edited line only until the states
+// match the cache again; the lines around the viewport are lexed first and
+// the rest of the file follows in chunks at background priority.
+//
+// The worker starts from a snapshot of the buffer and keeps its own copy in
+// step with the lines each edit touched, so an edit costs its own size.
+class SyntaxHighlighter : public QObject {
+	Q_OBJECT
+public:
+	explicit SyntaxHighlighter(QObject* parent = nullptr);
+	~SyntaxHighlighter() override;
+
+	// Starts over on a new document; a null syntax turns highlighting off.
+	// The buffer is not owned and must report every edit to applyDelta()
+	// right after making it.
+	void setDocument(const SyntaxDefinition* syntax, const ITextBuffer* buffer);
+	const SyntaxDefinition* syntax() const { return m_syntax; }
+	void applyDelta(const TextDelta& delta);
+	void setVisibleLines(qsizetype first, qsizetype last);
+
+	// Tokens of the line, or nullptr until the worker has lexed it.
+	const LineTokens* tokens(qsizetype line) const;
+
+signals:
+	void highlighted(qsizetype first, qsizetype last);
+
+private:
+	struct State;
+
+	void schedule();
+	void runPending();
+	void propagate();
+	void publish(HighlightWindow window);
+
+	std::unique_ptr<State> m_state;
+	TaskSequence m_tasks{TaskPriority::Visible};
+
+	// GUI side.
+	const SyntaxDefinition* m_syntax = nullptr;
+	const ITextBuffer* m_buffer = nullptr;
+	quint64 m_generation = 0;
+	quint64 m_edits = 0;
+	std::deque<std::pair<quint64, TextDelta>> m_unconfirmed;
+	qsizetype m_visibleFirst = -1;
+	qsizetype m_visibleLast = -1;
+	HighlightWindow m_window;
+
+	struct Pending {
+		std::optional<const SyntaxDefinition*> syntax;
+		quint64 generation = 0;
+		std::optional<TextSnapshot> snapshot;
+		std::vector<LinePatch> edits;
+		quint64 editCount = 0;
+		std::optional<std::pair<qsizetype, qsizetype>> visible;
+	};
+	std::mutex m_pendingMutex;
+	Pending m_pending;
+	bool m_queued = false;
+};
@@ -0,0 +1,521 @@
+#include "syntax_lexer.h"
+#include <QFileInfo>
+#include <QStringList>
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace {
+// Keyword tables must stay sorted; lookups are binary searches.
+constexpr std::u16string_view kCppKeywords[] = {
+	u"alignas", u"alignof", u"asm", u"break", u"case", u"catch", u"class", u"co_await", u"co_return",
+	u"co_yield", u"concept", u"const", u"const_cast", u"consteval", u"constexpr", u"constinit",
+	u"continue", u"decltype", u"default", u"delete", u"do", u"dynamic_cast", u"else", u"enum",
+	u"explicit", u"export", u"extern", u"false", u"final", u"for", u"friend", u"goto", u"if", u"import",
+	u"inline", u"module", u"mutable", u"namespace", u"new", u"noexcept", u"nullptr", u"operator",
+	u"override", u"private", u"protected", u"public", u"register", u"reinterpret_cast", u"requires",
+	u"return", u"sizeof", u"static", u"static_assert", u"static_cast", u"struct", u"switch",
+	u"template", u"this", u"thread_local", u"throw", u"true", u"try", u"typedef", u"typeid",
+	u"typename", u"union", u"using", u"virtual", u"volatile", u"while",
+};
+constexpr std::u16string_view kCppTypes[] = {
+	u"auto", u"bool", u"char", u"char16_t", u"char32_t", u"char8_t", u"double", u"float", u"int",
+	u"int16_t", u"int32_t", u"int64_t", u"int8_t", u"long", u"ptrdiff_t", u"short", u"signed",
+	u"size_t", u"uint16_t", u"uint32_t", u"uint64_t", u"uint8_t", u"unsigned", u"void", u"wchar_t",
+};
+
+// Commands, matched case-insensitively.
+constexpr std::u16string_view kCMakeCommands[] = {
+	u"add_compile_definitions", u"add_compile_options", u"add_custom_command", u"add_custom_target",
+	u"add_definitions", u"add_dependencies", u"add_executable", u"add_library", u"add_link_options",
+	u"add_subdirectory", u"add_test", u"break", u"cmake_minimum_required", u"cmake_parse_arguments",
+	u"cmake_path", u"cmake_policy", u"configure_file", u"continue", u"else", u"elseif",
+	u"enable_language", u"enable_testing", u"endforeach", u"endfunction", u"endif", u"endmacro",
+	u"endwhile", u"execute_process", u"file", u"find_file", u"find_library", u"find_package",
+	u"find_path", u"find_program", u"foreach", u"function", u"get_filename_component",
+	u"get_property", u"get_target_property", u"if", u"include", u"include_directories", u"install",
+	u"link_directories", u"link_libraries", u"list", u"macro", u"math", u"message", u"option",
+	u"project", u"return", u"set", u"set_property", u"set_target_properties", u"source_group",
+	u"string", u"target_compile_definitions", u"target_compile_features", u"target_compile_options",
+	u"target_include_directories", u"target_link_libraries", u"target_link_options",
+	u"target_sources", u"unset", u"while",
+};
+constexpr std::u16string_view kCMakeArguments[] = {
+	u"AND", u"CACHE", u"COMMAND", u"COMPONENTS", u"CONFIGURE_DEPENDS", u"DEPENDS", u"DESTINATION",
+	u"EXISTS", u"FALSE", u"GLOB", u"GLOB_RECURSE", u"INTERFACE", u"NOT", u"OFF", u"ON", u"OR",
+	u"OUTPUT", u"PARENT_SCOPE", u"PRIVATE", u"PROPERTIES", u"PUBLIC", u"REQUIRED", u"SHARED",
+	u"STATIC", u"STREQUAL", u"TARGETS", u"TRUE", u"VERSION", u"WORKING_DIRECTORY",
+};
+
+constexpr std::u16string_view kPythonKeywords[] = {
+	u"False", u"None", u"True", u"and", u"as", u"assert", u"async", u"await", u"break", u"class",
+	u"continue", u"def", u"del", u"elif", u"else", u"except", u"finally", u"for", u"from", u"global",
+	u"if", u"import", u"in", u"is", u"lambda", u"nonlocal", u"not", u"or", u"pass", u"raise",
+	u"return", u"try", u"while", u"with", u"yield",
+};
+constexpr std::u16string_view kPythonBuiltins[] = {
+	u"bool", u"bytes", u"dict", u"float", u"frozenset", u"int", u"len", u"list", u"object", u"print",
+	u"range", u"self", u"set", u"str", u"super", u"tuple", u"type",
+};
+
+constexpr std::u16string_view kJsonKeywords[] = {u"false", u"null", u"true"};
+
+constexpr std::u16string_view kShellKeywords[] = {
+	u"case", u"do", u"done", u"elif", u"else", u"esac", u"export", u"fi", u"for", u"function", u"if",
+	u"in", u"local", u"readonly", u"return", u"select", u"then", u"until", u"while",
+};
+constexpr std::u16string_view kShellBuiltins[] = {
+	u"alias", u"cd", u"echo", u"eval", u"exec", u"exit", u"printf", u"read", u"set", u"shift",
+	u"source", u"test", u"trap", u"unset",
+};
+
+static_assert(std::ranges::is_sorted(kCppKeywords) && std::ranges::is_sorted(kCppTypes));
+static_assert(std::ranges::is_sorted(kCMakeCommands) && std::ranges::is_sorted(kCMakeArguments));
+static_assert(std::ranges::is_sorted(kPythonKeywords) && std::ranges::is_sorted(kPythonBuiltins));
+static_assert(std::ranges::is_sorted(kJsonKeywords));
+static_assert(std::ranges::is_sorted(kShellKeywords) && std::ranges::is_sorted(kShellBuiltins));
+
+const SyntaxDefinition kCpp{"C++", kCppKeywords, kCppTypes, u"//", u"/*", u"*/",
+	SyntaxPreprocessor | SyntaxCharLiterals | SyntaxRawStrings | SyntaxStringPrefixes};
+const SyntaxDefinition kCMake{"CMake", kCMakeCommands, kCMakeArguments, u"#", {}, {},
+	SyntaxBracketArguments | SyntaxMultilineStrings | SyntaxVariables | SyntaxNoCaseKeywords};
+const SyntaxDefinition kPython{"Python", kPythonKeywords, kPythonBuiltins, u"#", {}, {},
+	SyntaxSingleQuotes | SyntaxTripleQuotes | SyntaxDecorators | SyntaxStringPrefixes};
+const SyntaxDefinition kJson{"JSON", kJsonKeywords, {}, {}, {}, {}, 0};
+const SyntaxDefinition kShell{"Shell", kShellKeywords, kShellBuiltins, u"#", {}, {},
+	SyntaxSingleQuotes | SyntaxMultilineStrings | SyntaxVariables | SyntaxWordComments};
+
+enum Mode : quint32 {
+	Normal,
+	BlockComment,
+	String,
+	RawString,
+	Bracket,
+	BracketComment,
+};
+
+// The low byte is the mode; the rest carries what the mode needs to find its
+// end: the quote, the bracket level or a hash of the raw string delimiter.
+constexpr quint32 makeState(Mode mode, quint32 extra = 0) {
+	return quint32(mode) | (extra << 8);
+}
+
+constexpr quint32 kTripleQuote = 0x10000;
+
+enum CharClass : quint8 {
+	ClassSpace = 1,
+	ClassIdent = 2,
+	ClassDigit = 4,
+};
+
+constexpr std::array<quint8, 128> kClasses = [] {
+	std::array<quint8, 128> table{};
+	for (char16_t c = u'a'; c <= u'z'; ++c) table[c] = ClassIdent;
+	for (char16_t c = u'A'; c <= u'Z'; ++c) table[c] = ClassIdent;
+	for (char16_t c = u'0'; c <= u'9'; ++c) table[c] = ClassDigit;
+	table[u'_'] = ClassIdent;
+	table[u' '] = table[u'\t'] = table[u'\f'] = table[u'\v'] = ClassSpace;
+	return table;
+}();
+
+bool isSpace(char16_t c) {
+	return c < 128 ? (kClasses[c] & ClassSpace) != 0 : QChar(c).isSpace();
+}
+
+bool isDigit(char16_t c) {
+	return c < 128 && (kClasses[c] & ClassDigit) != 0;
+}
+
+bool isIdentStart(char16_t c) {
+	return c < 128 ? (kClasses[c] & ClassIdent) != 0 : QChar(c).isLetter();
+}
+
+bool isIdentPart(char16_t c) {
+	return c < 128 ? (kClasses[c] & (ClassIdent | ClassDigit)) != 0 : QChar(c).isLetterOrNumber();
+}
+
+quint32 delimiterHash(std::u16string_view delimiter) {
+	quint32 hash = 2166136261u;
+	for (char16_t c : delimiter) {
+		hash = (hash ^ c) * 16777619u;
+	}
+	return hash & 0xFFFFFF;
+}
+
+bool contains(std::span<const std::u16string_view> table, std::u16string_view word) {
+	return std::binary_search(table.begin(), table.end(), word);
+}
+
+class Scanner {
+public:
+	Scanner(const SyntaxDefinition& syntax, QStringView line, std::vector<SyntaxToken>& out)
+		: m_syntax(syntax), m_text(reinterpret_cast<const char16_t*>(line.utf16()), std::size_t(line.size())),
+		  m_size(line.size()), m_out(out) {}
+
+	quint32 run(quint32 state);
+
+private:
+	bool has(quint32 flag) const { return (m_syntax.flags & flag) != 0; }
+	char16_t at(qsizetype pos) const { return pos < m_size ? m_text[std::size_t(pos)] : u'\0'; }
+	bool startsWith(qsizetype pos, std::u16string_view text) const {
+		return !text.empty() && m_text.substr(std::size_t(pos)).starts_with(text);
+	}
+	void push(qsizetype from, qsizetype to, SyntaxKind kind);
+
+	quint32 blockComment(qsizetype from);
+	quint32 quoted(qsizetype from);
+	quint32 string(qsizetype from, quint32 quote);
+	quint32 rawString(qsizetype from, quint32 hash);
+	quint32 bracket(qsizetype from, int level, bool comment);
+	int bracketLevel(qsizetype pos) const;
+	void variable();
+	void number();
+	quint32 identifier();
+	void preprocessor();
+
+	const SyntaxDefinition& m_syntax;
+	std::u16string_view m_text;
+	qsizetype m_size;
+	qsizetype m_pos = 0;
+	std::vector<SyntaxToken>& m_out;
+};
+
+void Scanner::push(qsizetype from, qsizetype to, SyntaxKind kind) {
+	if (to <= from) return;
+	if (!m_out.empty()) {
+		SyntaxToken& last = m_out.back();
+		if (last.kind == kind && qsizetype(last.start + last.length) == from) {
+			last.length = quint32(to - last.start);
+			return;
+		}
+	}
+	m_out.push_back({quint32(from), quint32(to - from), kind});
+}
+
+quint32 Scanner::blockComment(qsizetype from) {
+	const std::size_t end = m_text.find(m_syntax.blockClose, std::size_t(m_pos));
+	if (end == std::u16string_view::npos) {
+		push(from, m_size, SyntaxKind::Comment);
+		m_pos = m_size;
+		return makeState(BlockComment);
+	}
+	m_pos = qsizetype(end + m_syntax.blockClose.size());
+	push(from, m_pos, SyntaxKind::Comment);
+	return makeState(Normal);
+}
+
+// Opens the string whose quote is at m_pos; `from` may include a prefix.
+quint32 Scanner::quoted(qsizetype from) {
+	const char16_t c = m_text[std::size_t(m_pos)];
+	quint32 quote = c;
+	if (has(SyntaxTripleQuotes) && at(m_pos + 1) == c && at(m_pos + 2) == c) {
+		quote |= kTripleQuote;
+		m_pos += 3;
+	} else {
+		++m_pos;
+	}
+	return string(from, quote);
+}
+
+// Scans up to and including the closing quote. In languages with variables,
+// ${...} inside double quotes is split out, and single quotes take no escapes.
+quint32 Scanner::string(qsizetype from, quint32 quote) {
+	const auto q = char16_t(quote & 0xFFFF);
+	const bool triple = (quote & kTripleQuote) != 0;
+	const bool literal = q == u'\'' && has(SyntaxVariables);
+	while (m_pos < m_size) {
+		const char16_t c = m_text[std::size_t(m_pos)];
+		if (c == u'\\' && !literal) {
+			m_pos += 2;
+			continue;
+		}
+		if (c == u'$' && q == u'"' && has(SyntaxVariables)) {
+			push(from, m_pos, SyntaxKind::String);
+			variable();
+			from = m_pos;
+			continue;
+		}
+		if (c == q && (!triple || (at(m_pos + 1) == q && at(m_pos + 2) == q))) {
+			m_pos += triple ? 3 : 1;
+			push(from, m_pos, SyntaxKind::String);
+			return makeState(Normal);
+		}
+		++m_pos;
+	}
+	// An escape at the end of the line leaves m_pos one past it.
+	const bool continued = m_pos > m_size;
+	m_pos = m_size;
+	push(from, m_size, SyntaxKind::String);
+	if (triple || continued || has(SyntaxMultilineStrings)) {
+		return makeState(String, quote);
+	}
+	return makeState(Normal);
+}
+
+quint32 Scanner::rawString(qsizetype from, quint32 hash) {
+	for (qsizetype close = m_pos; close < m_size; ++close) {
+		if (m_text[std::size_t(close)] != u')') continue;
+		const std::size_t quote = m_text.find(u'"', std::size_t(close + 1));
+		if (quote == std::u16string_view::npos) break;
+		const std::size_t length = quote - std::size_t(close + 1);
+		if (length <= 16 && delimiterHash(m_text.substr(std::size_t(close + 1), length)) == hash) {
+			m_pos = qsizetype(quote + 1);
+			push(from, m_pos, SyntaxKind::String);
+			return makeState(Normal);
+		}
+	}
+	push(from, m_size, SyntaxKind::String);
+	m_pos = m_size;
+	return makeState(RawString, hash);
+}
+
+// Returns the '=' count of a bracket opening "[==[" at pos, or -1.
+int Scanner::bracketLevel(qsizetype pos) const {
+	if (at(pos) != u'[') return -1;
+	qsizetype end = pos + 1;
+	while (at(end) == u'=') ++end;
+	return at(end) == u'[' ? int(end - pos - 1) : -1;
+}
+
+quint32 Scanner::bracket(qsizetype from, int level, bool comment) {
+	std::u16string close(std::size_t(level) + 2, u'=');
+	close.front() = close.back() = u']';
+	const std::size_t end = m_text.find(close, std::size_t(m_pos));
+	const SyntaxKind kind = comment ? SyntaxKind::Comment : SyntaxKind::String;
+	if (end == std::u16string_view::npos) {
+		push(from, m_size, kind);
+		m_pos = m_size;
+		return makeState(comment ? BracketComment : Bracket, quint32(level));
+	}
+	m_pos = qsizetype(end + close.size());
+	push(from, m_pos, kind);
+	return makeState(Normal);
+}
+
+// $name, $1, ${...}, $<...> and $ENV{...}; braces and angle brackets nest.
+void Scanner::variable() {
+	const qsizetype from = m_pos++;
+	auto scanNested = [this](char16_t open, char16_t close) {
+		int depth = 0;
+		while (m_pos < m_size) {
+			const char16_t c = m_text[std::size_t(m_pos++)];
+			if (c == open) {
+				++depth;
+			} else if (c == close && --depth == 0) {
+				return;
+			}
+		}
+	};
+	const char16_t c = at(m_pos);
+	if (c == u'{' || c == u'<') {
+		scanNested(c, c == u'{' ? u'}' : u'>');
+	} else if (isIdentStart(c)) {
+		while (isIdentPart(at(m_pos))) ++m_pos;
+		if (at(m_pos) == u'{') scanNested(u'{', u'}');
+	} else if (c != u'\0' && std::u16string_view(u"?@#$!*-0123456789").find(c) != std::u16string_view::npos) {
+		++m_pos;
+	}
+	push(from, m_pos, SyntaxKind::Variable);
+}
+
+void Scanner::number() {
+	const qsizetype from = m_pos++;
+	while (m_pos < m_size) {
+		const char16_t c = m_text[std::size_t(m_pos)];
+		const char16_t prev = m_text[std::size_t(m_pos - 1)];
+		if (isIdentPart(c) || c == u'.') {
+			++m_pos;
+		} else if ((c == u'+' || c == u'-') && (prev == u'e' || prev == u'E' || prev == u'p' || prev == u'P')) {
+			++m_pos;
+		} else if (c == u'\'' && has(SyntaxCharLiterals) && isIdentPart(at(m_pos + 1))) {
+			++m_pos;
+		} else {
+			break;
+		}
+	}
+	push(from, m_pos, SyntaxKind::Number);
+}
+
+quint32 Scanner::identifier() {
+	const qsizetype from = m_pos;
+	while (isIdentPart(at(m_pos))) ++m_pos;
+	const std::u16string_view word = m_text.substr(std::size_t(from), std::size_t(m_pos - from));
+	const char16_t next = at(m_pos);
+
+	if (has(SyntaxRawStrings) && next == u'"' && word.ends_with(u'R')
+		&& (word == u"R" || word == u"u8R" || word == u"uR" || word == u"UR" || word == u"LR")) {
+		const std::size_t open = m_text.find(u'(', std::size_t(m_pos + 1));
+		const std::size_t length = open == std::u16string_view::npos ? 0 : open - std::size_t(m_pos + 1);
+		if (open != std::u16string_view::npos && length <= 16) {
+			const std::u16string_view delimiter = m_text.substr(std::size_t(m_pos + 1), length);
+			if (std::ranges::none_of(delimiter, [](char16_t c) { return c == u')' || c == u'\\' || isSpace(c); })) {
+				m_pos = qsizetype(open + 1);
+				return rawString(from, delimiterHash(delimiter));
+			}
+		}
+	}
+	if (has(SyntaxStringPrefixes) && (next == u'"' || next == u'\'') && word.size() <= 2) {
+		const bool prefix = has(SyntaxCharLiterals)
+			? (word == u"u8" || word == u"u" || word == u"U" || word == u"L")
+			: std::ranges::all_of(word, [](char16_t c) { return std::u16string_view(u"rRbBfFuU").find(c) != std::u16string_view::npos; });
+		if (prefix) {
+			return quoted(from);
+		}
+	}
+
+	SyntaxKind kind = SyntaxKind::Text;
+	if (has(SyntaxNoCaseKeywords) && word.size() <= 32) {
+		std::array<char16_t, 32> lower{};
+		std::ranges::transform(word, lower.begin(), [](char16_t c) { return c >= u'A' && c <= u'Z' ? char16_t(c + 32) : c; });
+		if (contains(m_syntax.keywords, std::u16string_view(lower.data(), word.size()))) kind = SyntaxKind::Keyword;
+	} else if (contains(m_syntax.keywords, word)) {
+		kind = SyntaxKind::Keyword;
+	}
+	if (kind == SyntaxKind::Text && contains(m_syntax.types, word)) {
+		kind = SyntaxKind::Type;
+	}
+	if (kind == SyntaxKind::Text) {
+		qsizetype after = m_pos;
+		while (isSpace(at(after))) ++after;
+		if (at(after) == u'(') kind = SyntaxKind::Function;
+	}
+	if (kind != SyntaxKind::Text) {
+		push(from, m_pos, kind);
+	}
+	return makeState(Normal);
+}
+
+void Scanner::preprocessor() {
+	const qsizetype from = m_pos++;
+	while (isSpace(at(m_pos))) ++m_pos;
+	const qsizetype word = m_pos;
+	while (isIdentPart(at(m_pos))) ++m_pos;
+	push(from, m_pos, SyntaxKind::Preprocessor);
+	const std::u16string_view directive = m_text.substr(std::size_t(word), std::size_t(m_pos - word));
+	if (directive != u"include" && directive != u"import" && directive != u"include_next") return;
+	while (isSpace(at(m_pos))) ++m_pos;
+	if (at(m_pos) != u'<') return;
+	const std::size_t close = m_text.find(u'>', std::size_t(m_pos));
+	const qsizetype end = close == std::u16string_view::npos ? m_size : qsizetype(close + 1);
+	push(m_pos, end, SyntaxKind::String);
+	m_pos = end;
+}
+
+quint32 Scanner::run(quint32 state) {
+	const quint32 extra = state >> 8;
+	switch (Mode(state & 0xFF)) {
+	case BlockComment:
+		state = blockComment(0);
+		break;
+	case String:
+		state = string(0, extra);
+		break;
+	case RawString:
+		state = rawString(0, extra);
+		break;
+	case Bracket:
+	case BracketComment:
+		state = bracket(0, int(extra), (state & 0xFF) == BracketComment);
+		break;
+	case Normal:
+		break;
+	}
+	if (state != makeState(Normal)) return state;
+
+	bool lineStart = true;
+	while (m_pos < m_size) {
+		const char16_t c = m_text[std::size_t(m_pos)];
+		if (isSpace(c)) {
+			++m_pos;
+			continue;
+		}
+		const bool first = std::exchange(lineStart, false);
+		const qsizetype from = m_pos;
+
+		if (startsWith(m_pos, m_syntax.lineComment)
+			&& (!has(SyntaxWordComments) || m_pos == 0 || isSpace(at(m_pos - 1)))) {
+			const int level = has(SyntaxBracketArguments) ? bracketLevel(m_pos + 1) : -1;
+			if (level >= 0) {
+				m_pos += level + 3;
+				state = bracket(from, level, true);
+				if (state != makeState(Normal)) return state;
+				continue;
+			}
+			push(from, m_size, SyntaxKind::Comment);
+			return makeState(Normal);
+		}
+		if (startsWith(m_pos, m_syntax.blockOpen)) {
+			m_pos += qsizetype(m_syntax.blockOpen.size());
+			state = blockComment(from);
+			if (state != makeState(Normal)) return state;
+			continue;
+		}
+		if (c == u'#' && has(SyntaxPreprocessor) && first) {
+			preprocessor();
+			continue;
+		}
+		if (c == u'"' || (c == u'\'' && has(SyntaxCharLiterals | SyntaxSingleQuotes))) {
+			state = quoted(from);
+			if (state != makeState(Normal)) return state;
+			continue;
+		}
+		if (c == u'[' && has(SyntaxBracketArguments)) {
+			const int level = bracketLevel(m_pos);
+			if (level >= 0) {
+				m_pos += level + 2;
+				state = bracket(from, level, false);
+				if (state != makeState(Normal)) return state;
+				continue;
+			}
+		}
+		if (c == u'$' && has(SyntaxVariables)) {
+			variable();
+			continue;
+		}
+		if (c == u'@' && has(SyntaxDecorators) && isIdentStart(at(m_pos + 1))) {
+			++m_pos;
+			while (isIdentPart(at(m_pos)) || (at(m_pos) == u'.' && isIdentStart(at(m_pos + 1)))) ++m_pos;
+			push(from, m_pos, SyntaxKind::Preprocessor);
+			continue;
+		}
+		if (isDigit(c) || (c == u'.' && isDigit(at(m_pos + 1)))) {
+			number();
+			continue;
+		}
+		if (isIdentStart(c)) {
+			state = identifier();
+			if (state != makeState(Normal)) return state;
+			continue;
+		}
+		++m_pos;
+	}
+	return makeState(Normal);
+}
+}
+
+const SyntaxDefinition* syntaxForFile(const QString& path) {
+	const QFileInfo info(path);
+	const QString name = info.fileName();
+	const QString suffix = info.suffix().toLower();
+	if (name == QLatin1String("CMakeLists.txt") || suffix == QLatin1String("cmake")) {
+		return &kCMake;
+	}
+	static const QStringList cpp{"c", "cc", "cpp", "cxx", "c++", "h", "hh", "hpp", "hxx", "inl", "ipp", "ixx", "cppm"};
+	if (cpp.contains(suffix)) {
+		return &kCpp;
+	}
+	if (suffix == QLatin1String("py") || suffix == QLatin1String("pyw")) {
+		return &kPython;
+	}
+	if (suffix == QLatin1String("json")) {
+		return &kJson;
+	}
+	if (suffix == QLatin1String("sh") || suffix == QLatin1String("bash") || suffix == QLatin1String("zsh")) {
+		return &kShell;
+	}
+	return nullptr;
+}
+
+quint32 lexLine(const SyntaxDefinition& syntax, QStringView line, quint32 state, std::vector<SyntaxToken>& out) {
+	return Scanner(syntax, line, out).run(state);
+}
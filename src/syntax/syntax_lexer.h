@@ -0,0 +1,59 @@
+#pragma once
+#include <QString>
+#include <QStringView>
+#include <span>
+#include <string_view>
+#include <vector>
+
+enum class SyntaxKind : quint8 {
+	Text,
+	Keyword,
+	Type,
+	Number,
+	String,
+	Comment,
+	Preprocessor,
+	Function,
+	Variable,
+};
+
+struct SyntaxToken {
+	quint32 start = 0;
+	quint32 length = 0;
+	SyntaxKind kind = SyntaxKind::Text;
+};
+
+enum SyntaxFlag : quint32 {
+	SyntaxPreprocessor = 1 << 0,      // '#' directives at the start of a line
+	SyntaxCharLiterals = 1 << 1,      // 'x' is a character, and ' separates digits
+	SyntaxSingleQuotes = 1 << 2,      // 'x' is a string
+	SyntaxRawStrings = 1 << 3,        // R"delim(...)delim"
+	SyntaxBracketArguments = 1 << 4,  // [==[...]==] and #[==[...]==]
+	SyntaxTripleQuotes = 1 << 5,      // """...""" and '''...'''
+	SyntaxMultilineStrings = 1 << 6,  // quoted strings may span lines
+	SyntaxVariables = 1 << 7,         // $name, ${...}, $<...>
+	SyntaxDecorators = 1 << 8,        // @name
+	SyntaxWordComments = 1 << 9,      // the line comment only starts a word
+	SyntaxNoCaseKeywords = 1 << 10,
+	SyntaxStringPrefixes = 1 << 11,   // u8"", L"", r'', b'', f''
+};
+
+// A language is a set of sorted keyword tables plus flags selecting which
+// lexical forms the shared scanner recognises.
+struct SyntaxDefinition {
+	const char* name;
+	std::span<const std::u16string_view> keywords;
+	std::span<const std::u16string_view> types;
+	std::u16string_view lineComment;
+	std::u16string_view blockOpen;
+	std::u16string_view blockClose;
+	quint32 flags = 0;
+};
+
+// Picks the definition by file name; nullptr when the file isn't recognised.
+const SyntaxDefinition* syntaxForFile(const QString& path);
+
+// Lexes one line without its line break. `state` is the line's entry state,
+// 0 at the start of the file; the return value is the entry state of the
+// next line. Plain text between tokens is not emitted.
+quint32 lexLine(const SyntaxDefinition& syntax, QStringView line, quint32 state, std::vector<SyntaxToken>& out);
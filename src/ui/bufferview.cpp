@@ -0,0 +1,1117 @@
+#include "bufferview.h"
+#include "syntaxformats.h"
+#include "../buffer/undoStack.h"
+#include "../util/trace.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QContextMenuEvent>
+#include <QFontDatabase>
+#include <QInputMethodEvent>
+#include <QInputMethod>
+#include <QKeyEvent>
+#include <QMenu>
+#include <QPainter>
+#include <QScrollBar>
+#include <QTimer>
+#include <algorithm>
+#include <utility>
+
+namespace {
+constexpr int kTextMargin = 4;
+constexpr int kMarkerWidth = 4;
+// Text either side of the cursor shaped for steps within a long line.
+constexpr qsizetype kStepWindow = 256;
+}
+
+BufferView::BufferView(QWidget* parent) : QAbstractScrollArea(parent) {
+	setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+	setFocusPolicy(Qt::StrongFocus);
+	setAttribute(Qt::WA_InputMethodEnabled);
+	viewport()->setCursor(Qt::IBeamCursor);
+	viewport()->setAttribute(Qt::WA_OpaquePaintEvent);
+	setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+	setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
+
+	m_blink = new QTimer(this);
+	m_blink->setInterval(QApplication::cursorFlashTime() > 0 ? QApplication::cursorFlashTime() / 2 : 500);
+	connect(m_blink, &QTimer::timeout, this, [this] {
+		m_cursorVisible = !m_cursorVisible;
+		if (m_buffer) viewport()->update(lineRect(lineOf(m_cursor)));
+	});
+	updateFontMetrics();
+}
+
+void BufferView::setBuffer(ITextBuffer* buffer, UndoStack* undo) {
+	m_buffer = buffer;
+	m_undo = undo;
+	m_cursor = m_anchor = 0;
+	m_desiredX = -1;
+	m_maxWidth = 0;
+	m_modified = false;
+	m_lineChanges.reset();
+	m_results.reset();
+	m_keyHandledNs = -1;
+	m_preedit.clear();
+	m_preeditFormats.clear();
+	findLongLines();
+	verticalScrollBar()->setValue(0);
+	horizontalScrollBar()->setValue(0);
+	updateScrollBars();
+	viewport()->update();
+	emitCursor();
+}
+
+void BufferView::bufferReset() {
+	const qsizetype size = m_buffer ? m_buffer->size() : 0;
+	m_cursor = std::min(m_cursor, size);
+	m_anchor = std::min(m_anchor, size);
+	m_desiredX = -1;
+	findLongLines();
+	updateScrollBars();
+	viewport()->update();
+	emitCursor();
+}
+
+qsizetype BufferView::lineLength(qsizetype line) const {
+	const qsizetype start = m_buffer->lineStart(line);
+	qsizetype end = line + 1 < m_buffer->lineCount() ? m_buffer->lineStart(line + 1) : m_buffer->size();
+	while (end > start) {
+		const QChar last = m_buffer->slice(end - 1, 1).at(0);
+		if (last != u'\n' && last != u'\r') break;
+		--end;
+	}
+	return end - start;
+}
+
+qsizetype BufferView::lineOf(qsizetype pos) const {
+	return m_buffer ? m_buffer->lineFromPosition(pos) : 0;
+}
+
+const BufferView::WrappedLine* BufferView::wrappedAt(qsizetype line) const {
+	auto it = std::lower_bound(m_wrapped.begin(), m_wrapped.end(), line,
+		[](const WrappedLine& wrapped, qsizetype value) { return wrapped.line < value; });
+	return it != m_wrapped.end() && it->line == line ? &*it : nullptr;
+}
+
+qsizetype BufferView::rowCount() const {
+	const qsizetype lines = m_buffer ? m_buffer->lineCount() : 0;
+	return m_wrapped.empty() ? lines : lines + m_wrapped.back().extraBefore + m_wrapped.back().rows - 1;
+}
+
+qsizetype BufferView::rowOfLine(qsizetype line) const {
+	auto it = std::lower_bound(m_wrapped.begin(), m_wrapped.end(), line,
+		[](const WrappedLine& wrapped, qsizetype value) { return wrapped.line < value; });
+	if (it == m_wrapped.begin()) return line;
+	const WrappedLine& before = *std::prev(it);
+	return line + before.extraBefore + before.rows - 1;
+}
+
+qsizetype BufferView::rowOfPosition(qsizetype pos) const {
+	const qsizetype line = lineOf(pos);
+	const WrappedLine* wrapped = wrappedAt(line);
+	if (!wrapped) return rowOfLine(line);
+	return rowOfLine(line) + std::min(wrapped->rows - 1, m_buffer->cellColumn(pos) / m_wrapCells);
+}
+
+qsizetype BufferView::lineAtRow(qsizetype row, qsizetype* sub) const {
+	if (sub) *sub = 0;
+	// The last wrapped line starting at or above the row.
+	auto it = std::upper_bound(m_wrapped.begin(), m_wrapped.end(), row,
+		[](qsizetype value, const WrappedLine& wrapped) { return value < wrapped.line + wrapped.extraBefore; });
+	qsizetype line = row;
+	if (it != m_wrapped.begin()) {
+		const WrappedLine& wrapped = *std::prev(it);
+		const qsizetype first = wrapped.line + wrapped.extraBefore;
+		if (row < first + wrapped.rows) {
+			if (sub) *sub = row - first;
+			return wrapped.line;
+		}
+		line = row - wrapped.extraBefore - (wrapped.rows - 1);
+	}
+	const qsizetype lines = m_buffer ? m_buffer->lineCount() : 1;
+	return std::clamp<qsizetype>(line, 0, std::max<qsizetype>(lines - 1, 0));
+}
+
+qsizetype BufferView::firstVisibleRow() const {
+	return verticalScrollBar()->value();
+}
+
+void BufferView::setFirstVisibleRow(qsizetype row) {
+	verticalScrollBar()->setValue(int(std::clamp<qsizetype>(row, 0, verticalScrollBar()->maximum())));
+}
+
+qsizetype BufferView::firstVisibleLine() const {
+	return lineAtRow(firstVisibleRow());
+}
+
+void BufferView::setFirstVisibleLine(qsizetype line) {
+	setFirstVisibleRow(rowOfLine(line));
+}
+
+const QTextLayout& BufferView::rowLayout(qsizetype line, qsizetype sub, qsizetype* from, qsizetype* to, QString* text) {
+	const qsizetype start = m_buffer->lineStart(line);
+	const WrappedLine* wrapped = wrappedAt(line);
+	*from = wrapped ? m_buffer->positionFromCell(line, sub * m_wrapCells) : start;
+	if (wrapped && sub + 1 < wrapped->rows) {
+		*to = m_buffer->positionFromCell(line, (sub + 1) * m_wrapCells);
+	} else {
+		*to = start + lineLength(line);
+	}
+	const QString content = m_buffer->slice(*from, *to - *from);
+	if (text) *text = content;
+	return m_layouts.layout(content);
+}
+
+const QTextLayout& BufferView::layoutAround(qsizetype pos, qsizetype* from, QString* text) {
+	const qsizetype line = lineOf(pos);
+	const qsizetype start = m_buffer->lineStart(line);
+	const qsizetype end = start + lineLength(line);
+	*from = start;
+	qsizetype to = end;
+	if (end - start > kLongLineChars) {
+		*from = std::max(start, pos - kStepWindow);
+		to = std::min(end, pos + kStepWindow);
+		// Surrogate pairs stay whole at the edges.
+		if (*from > start && m_buffer->slice(*from, 1).at(0).isLowSurrogate()) --*from;
+		if (to < end && m_buffer->slice(to, 1).at(0).isLowSurrogate()) ++to;
+	}
+	const QString content = m_buffer->slice(*from, to - *from);
+	if (text) *text = content;
+	return m_layouts.layout(content);
+}
+
+void BufferView::findLongLines() {
+	const bool had = hasLongLines();
+	m_wrapped.clear();
+	if (m_buffer) {
+		const qsizetype lines = m_buffer->lineCount();
+		for (qsizetype line = 0; line < lines; ++line) {
+			const qsizetype next = line + 1 < lines ? m_buffer->lineStart(line + 1) : m_buffer->size();
+			if (next - m_buffer->lineStart(line) > kLongLineChars) {
+				m_wrapped.push_back({line});
+			}
+		}
+	}
+	countWrappedRows();
+	if (had != hasLongLines()) emit longLinesChanged(hasLongLines());
+}
+
+void BufferView::updateLongLines(const TextDelta& delta) {
+	const bool had = hasLongLines();
+	const qsizetype lastRemoved = delta.firstLine + delta.removedLines;
+	const qsizetype shift = delta.addedLines - delta.removedLines;
+	// The lines the edit left behind are measured again; those past it move.
+	std::erase_if(m_wrapped, [&](const WrappedLine& wrapped) {
+		return wrapped.line >= delta.firstLine && wrapped.line <= lastRemoved;
+	});
+	for (WrappedLine& wrapped : m_wrapped) {
+		if (wrapped.line > lastRemoved) wrapped.line += shift;
+	}
+	const qsizetype lines = m_buffer->lineCount();
+	std::vector<WrappedLine> touched;
+	for (qsizetype line = delta.firstLine; line <= delta.firstLine + delta.addedLines && line < lines; ++line) {
+		const qsizetype next = line + 1 < lines ? m_buffer->lineStart(line + 1) : m_buffer->size();
+		if (next - m_buffer->lineStart(line) > kLongLineChars) {
+			touched.push_back({line});
+		}
+	}
+	auto at = std::lower_bound(m_wrapped.begin(), m_wrapped.end(), delta.firstLine,
+		[](const WrappedLine& wrapped, qsizetype value) { return wrapped.line < value; });
+	m_wrapped.insert(at, touched.begin(), touched.end());
+	countWrappedRows();
+	if (had != hasLongLines()) emit longLinesChanged(hasLongLines());
+}
+
+void BufferView::countWrappedRows() {
+	qsizetype extra = 0;
+	for (WrappedLine& wrapped : m_wrapped) {
+		const qsizetype cells = m_buffer->cellColumn(m_buffer->lineStart(wrapped.line) + lineLength(wrapped.line));
+		wrapped.rows = std::max<qsizetype>(1, (cells + m_wrapCells - 1) / m_wrapCells);
+		wrapped.extraBefore = extra;
+		extra += wrapped.rows - 1;
+	}
+}
+
+int BufferView::visibleLineCount() const {
+	return std::max(1, viewport()->height() / m_lineHeight);
+}
+
+int BufferView::gutterWidth() const {
+	const qsizetype lines = m_buffer ? m_buffer->lineCount() : 1;
+	int digits = 1;
+	for (qsizetype n = lines; n >= 10; n /= 10) {
+		++digits;
+	}
+	return kMarkerWidth + kTextMargin + std::max(digits, 3) * m_charWidth + kTextMargin;
+}
+
+int BufferView::textOffset() const {
+	return gutterWidth() + kTextMargin - horizontalScrollBar()->value();
+}
+
+// Wrapped rows fit across the viewport and don't scroll sideways.
+int BufferView::wrappedOffset() const {
+	return gutterWidth() + kTextMargin;
+}
+
+QRect BufferView::lineRect(qsizetype line) const {
+	const qsizetype first = rowOfLine(line) - firstVisibleRow();
+	const WrappedLine* wrapped = wrappedAt(line);
+	const qsizetype visible = visibleLineCount() + 1;
+	const qsizetype top = std::clamp<qsizetype>(first, -1, visible);
+	const qsizetype bottom = std::clamp<qsizetype>(first + (wrapped ? wrapped->rows : 1), -1, visible);
+	return QRect(0, int(top) * m_lineHeight, viewport()->width(), int(bottom - top) * m_lineHeight);
+}
+
+void BufferView::updateFontMetrics() {
+	const QFontMetrics metrics(font());
+	m_lineHeight = std::max(1, metrics.lineSpacing());
+	m_charWidth = std::max(1, metrics.horizontalAdvance(u'0'));
+	m_layouts.setFont(font(), metrics.horizontalAdvance(u' ') * 4);
+	m_maxWidth = 0;
+	updateScrollBars();
+	viewport()->update();
+}
+
+void BufferView::updateScrollBars() {
+	const int textWidth = std::max(0, viewport()->width() - gutterWidth() - 2 * kTextMargin);
+	const qsizetype wrapCells = std::max<qsizetype>(textWidth / m_charWidth, 2 * ITextBuffer::kTabCells);
+	const bool rewrap = wrapCells != m_wrapCells && hasLongLines();
+	const qsizetype top = rewrap ? firstVisibleLine() : 0;
+	m_wrapCells = wrapCells;
+	if (rewrap) countWrappedRows();
+
+	const int visible = visibleLineCount();
+	QScrollBar* vertical = verticalScrollBar();
+	vertical->setRange(0, int(std::max<qsizetype>(0, rowCount() - visible)));
+	vertical->setPageStep(visible);
+	vertical->setSingleStep(1);
+	if (rewrap) setFirstVisibleLine(top);
+
+	QScrollBar* horizontal = horizontalScrollBar();
+	horizontal->setRange(0, std::max(0, m_maxWidth - textWidth + m_charWidth));
+	horizontal->setPageStep(textWidth);
+	horizontal->setSingleStep(m_charWidth);
+}
+
+void BufferView::paintEvent(QPaintEvent* event) {
+	IDE_TRACE_SPAN("BufferView::paintEvent");
+	QPainter painter(viewport());
+	const QRect rect = event->rect();
+	painter.fillRect(rect, palette().base());
+	if (!m_buffer) {
+		return;
+	}
+	const qsizetype firstRow = firstVisibleRow();
+	const qsizetype rows = rowCount();
+	const qsizetype lines = m_buffer->lineCount();
+	const int gutter = gutterWidth();
+	const qsizetype selStart = selectionStart();
+	const qsizetype selEnd = selectionEnd();
+	const qsizetype cursorRow = rowOfPosition(m_cursor);
+
+	QTextCharFormat selectionFormat;
+	selectionFormat.setBackground(palette().highlight());
+	selectionFormat.setForeground(palette().highlightedText());
+	QTextCharFormat matchFormat;
+	matchFormat.setBackground(QColor(255, 230, 150));
+
+	painter.save();
+	painter.setClipRect(QRect(gutter, rect.top(), viewport()->width() - gutter, rect.height()));
+	int widest = m_maxWidth;
+	const int top = rect.top() / m_lineHeight;
+	const int bottom = rect.bottom() / m_lineHeight;
+	for (int row = top; row <= bottom; ++row) {
+		if (firstRow + row >= rows) break;
+		qsizetype sub = 0;
+		const qsizetype line = lineAtRow(firstRow + row, &sub);
+		const WrappedLine* wrapped = wrappedAt(line);
+		const bool endsLine = !wrapped || sub + 1 == wrapped->rows;
+		const bool cursorHere = firstRow + row == cursorRow;
+		qsizetype start = 0;
+		qsizetype end = 0;
+		QString text;
+		const QTextLayout& layout = rowLayout(line, sub, &start, &end, &text);
+		const int x = wrapped ? wrappedOffset() : textOffset();
+
+		QList<QTextLayout::FormatRange> ranges;
+		// Long lines are not highlighted.
+		if (m_highlighter && !wrapped) {
+			if (const LineTokens* tokens = m_highlighter->tokens(line)) {
+				ranges = syntaxRanges(*tokens, text.size());
+			}
+		}
+		if (m_results) {
+			auto addMatch = [&](qsizetype, const SearchResult& match) {
+				const qsizetype from = std::max<qsizetype>(match.start, start);
+				const qsizetype to = std::min<qsizetype>(match.start + match.length, end);
+				if (to > from) ranges.append({int(from - start), int(to - from), matchFormat});
+			};
+			// A match can run on from the row before.
+			if (const qsizetype before = m_results->lastBefore(start); wrapped && before >= 0) {
+				addMatch(before, m_results->at(before));
+			}
+			m_results->forEachInRange(start, end, addMatch);
+		}
+		if (selEnd > start && selStart <= end) {
+			const qsizetype from = std::max(selStart, start);
+			const qsizetype to = std::min(selEnd, end);
+			if (to > from) ranges.append({int(from - start), int(to - from), selectionFormat});
+			// A selected line break shows as a one-character block past the text.
+			if (endsLine && selEnd > end && line + 1 < lines) {
+				const qreal right = layout.lineCount() > 0 ? layout.lineAt(0).naturalTextWidth() : 0;
+				painter.fillRect(QRectF(x + right, row * m_lineHeight, m_charWidth, m_lineHeight), palette().highlight());
+			}
+		}
+		if (cursorHere && !hasSelection()) {
+			painter.fillRect(QRect(gutter, row * m_lineHeight, viewport()->width() - gutter, m_lineHeight),
+				palette().alternateBase());
+		}
+		const QPointF origin(x, row * m_lineHeight);
+		const QTextLayout* shown = &layout;
+		int cursorAt = int(m_cursor - start);
+		// The text being composed goes in at the cursor, underlined.
+		if (cursorHere && !m_preedit.isEmpty()) {
+			const int length = int(m_preedit.size());
+			QList<QTextLayout::FormatRange> shifted;
+			for (const QTextLayout::FormatRange& range : std::as_const(ranges)) {
+				if (range.start >= cursorAt) {
+					shifted.append({range.start + length, range.length, range.format});
+				} else if (range.start + range.length > cursorAt) {
+					shifted.append({range.start, cursorAt - range.start, range.format});
+					shifted.append({cursorAt + length, range.start + range.length - cursorAt, range.format});
+				} else {
+					shifted.append(range);
+				}
+			}
+			QTextCharFormat underline;
+			underline.setUnderlineStyle(QTextCharFormat::SingleUnderline);
+			shifted.append({cursorAt, length, underline});
+			for (const QTextLayout::FormatRange& range : std::as_const(m_preeditFormats)) {
+				shifted.append({cursorAt + range.start, range.length, range.format});
+			}
+			ranges = std::move(shifted);
+			shown = &m_layouts.layout(text.left(cursorAt) + m_preedit + text.mid(cursorAt));
+			cursorAt = m_preeditCursor >= 0 ? cursorAt + m_preeditCursor : -1;
+		}
+		shown->draw(&painter, origin, ranges);
+		if (shown->lineCount() > 0 && !wrapped) {
+			widest = std::max(widest, int(shown->lineAt(0).naturalTextWidth()));
+		}
+		if (cursorHere && cursorAt >= 0 && shown->lineCount() > 0) {
+			const int cursorX = x + int(shown->lineAt(0).cursorToX(cursorAt));
+			if (cursorX != m_cursorX) {
+				m_cursorX = cursorX;
+				QGuiApplication::inputMethod()->update(Qt::ImCursorRectangle);
+			}
+			if (m_cursorVisible && hasFocus()) {
+				shown->drawCursor(&painter, origin, cursorAt, 2);
+			}
+		}
+	}
+	painter.restore();
+	paintGutter(painter, rect, firstRow);
+
+	// Widths are only known once lines are shaped; grow the range lazily.
+	if (widest > m_maxWidth) {
+		m_maxWidth = widest;
+		QMetaObject::invokeMethod(this, &BufferView::updateScrollBars, Qt::QueuedConnection);
+	}
+	if (m_keyHandledNs >= 0) {
+		emit inputLatency(std::exchange(m_keyHandledNs, -1), m_keyClock.nsecsElapsed());
+	}
+}
+
+void BufferView::paintGutter(QPainter& painter, const QRect& rect, qsizetype firstRow) {
+	const int width = gutterWidth();
+	painter.fillRect(QRect(0, rect.top(), width, rect.height()), palette().window());
+	painter.setPen(palette().color(QPalette::Disabled, QPalette::Text));
+	const qsizetype rows = rowCount();
+	const qsizetype cursorLine = lineOf(m_cursor);
+	const int first = rect.top() / m_lineHeight;
+	const int last = rect.bottom() / m_lineHeight;
+	const std::vector<DiffHunk>* hunks = m_lineChanges ? m_lineChanges.get() : nullptr;
+	for (int row = first; row <= last; ++row) {
+		if (firstRow + row >= rows) break;
+		qsizetype sub = 0;
+		const qsizetype line = lineAtRow(firstRow + row, &sub);
+		const int top = row * m_lineHeight;
+		// Rows a long line wraps onto go unnumbered.
+		if (sub == 0) {
+			const QRect number(kMarkerWidth, top, width - kMarkerWidth - kTextMargin, m_lineHeight);
+			if (line == cursorLine) painter.setPen(palette().color(QPalette::Text));
+			painter.drawText(number, Qt::AlignRight | Qt::AlignVCenter, QString::number(line + 1));
+			if (line == cursorLine) painter.setPen(palette().color(QPalette::Disabled, QPalette::Text));
+		}
+		if (!hunks || hunks->empty()) continue;
+
+		auto it = std::upper_bound(hunks->begin(), hunks->end(), line,
+			[](qsizetype value, const DiffHunk& h) { return value < h.newStart; });
+		// A deletion sits between lines; mark it at the top of the following line.
+		for (auto h = it; h != hunks->begin();) {
+			--h;
+			if (h->isDelete() && h->newStart == line) {
+				if (sub == 0) painter.fillRect(QRect(0, top - 2, kMarkerWidth, 4), QColor(220, 80, 80));
+				continue;
+			}
+			if (line < h->newStart + h->newCount) {
+				const QColor color = h->isAdd() ? QColor(90, 180, 90) : QColor(90, 140, 220);
+				painter.fillRect(QRect(0, top, kMarkerWidth - 1, m_lineHeight), color);
+			}
+			break;
+		}
+	}
+}
+
+void BufferView::resizeEvent(QResizeEvent* event) {
+	QAbstractScrollArea::resizeEvent(event);
+	updateScrollBars();
+	reportVisibleLines();
+}
+
+void BufferView::changeEvent(QEvent* event) {
+	QAbstractScrollArea::changeEvent(event);
+	if (event->type() == QEvent::FontChange) {
+		updateFontMetrics();
+	}
+}
+
+void BufferView::scrollContentsBy(int dx, int dy) {
+	// Line-sized vertical steps can blit; the gutter stays put horizontally.
+	if (dx == 0 && std::abs(dy) < visibleLineCount()) {
+		viewport()->scroll(0, dy * m_lineHeight);
+	} else {
+		viewport()->update();
+	}
+	if (dy != 0) {
+		reportVisibleLines();
+		emit firstVisibleLineChanged(firstVisibleLine());
+	}
+}
+
+qsizetype BufferView::positionInRow(qsizetype row, qreal x) {
+	qsizetype sub = 0;
+	const qsizetype line = lineAtRow(row, &sub);
+	const WrappedLine* wrapped = wrappedAt(line);
+	qsizetype from = 0;
+	qsizetype to = 0;
+	const QTextLayout& layout = rowLayout(line, sub, &from, &to);
+	if (layout.lineCount() == 0) return from;
+	int column = std::clamp<int>(layout.lineAt(0).xToCursor(x), 0, int(to - from));
+	// The end of a wrapped row is the start of the next one.
+	if (wrapped && sub + 1 < wrapped->rows && column == to - from && column > 0) {
+		column = layout.previousCursorPosition(column);
+	}
+	return from + column;
+}
+
+qsizetype BufferView::positionAt(const QPoint& point) {
+	if (!m_buffer) return 0;
+	const qsizetype row = std::min<qsizetype>(firstVisibleRow() + std::max(0, point.y()) / m_lineHeight, rowCount() - 1);
+	const int x = wrappedAt(lineAtRow(row)) ? wrappedOffset() : textOffset();
+	return positionInRow(row, point.x() - x);
+}
+
+qreal BufferView::cursorX(qsizetype pos) {
+	qsizetype sub = 0;
+	const qsizetype line = lineAtRow(rowOfPosition(pos), &sub);
+	qsizetype from = 0;
+	qsizetype to = 0;
+	const QTextLayout& layout = rowLayout(line, sub, &from, &to);
+	if (layout.lineCount() == 0) return 0;
+	return layout.lineAt(0).cursorToX(int(pos - from));
+}
+
+void BufferView::setCursorPosition(qsizetype pos, bool keepAnchor) {
+	moveCursor(pos, keepAnchor);
+}
+
+void BufferView::moveCursor(qsizetype pos, bool keepAnchor, bool keepColumn) {
+	if (!m_buffer) return;
+	pos = std::clamp<qsizetype>(pos, 0, m_buffer->size());
+	const qsizetype oldLine = lineOf(m_cursor);
+	const bool hadSelection = hasSelection();
+	m_cursor = pos;
+	if (!keepAnchor) {
+		m_anchor = pos;
+	}
+	if (!keepColumn) {
+		m_desiredX = -1;
+	}
+	ensureCursorVisible();
+	if (hadSelection || hasSelection()) {
+		viewport()->update();
+	} else {
+		viewport()->update(lineRect(oldLine));
+		viewport()->update(lineRect(lineOf(m_cursor)));
+	}
+	restartBlink();
+	emitCursor();
+}
+
+void BufferView::moveVertically(qsizetype rows, bool keepAnchor) {
+	if (m_desiredX < 0) {
+		m_desiredX = cursorX(m_cursor);
+	}
+	const qsizetype target = std::clamp<qsizetype>(rowOfPosition(m_cursor) + rows, 0, rowCount() - 1);
+	moveCursor(positionInRow(target, m_desiredX), keepAnchor, true);
+}
+
+void BufferView::ensureCursorVisible() {
+	const qsizetype row = rowOfPosition(m_cursor);
+	const qsizetype first = firstVisibleRow();
+	const int visible = visibleLineCount();
+	if (row < first) {
+		setFirstVisibleRow(row);
+	} else if (row >= first + visible) {
+		setFirstVisibleRow(row - visible + 1);
+	}
+	if (wrappedAt(lineOf(m_cursor))) return;
+
+	const int x = int(cursorX(m_cursor));
+	const int textWidth = std::max(0, viewport()->width() - gutterWidth() - 2 * kTextMargin);
+	QScrollBar* horizontal = horizontalScrollBar();
+	if (x > m_maxWidth) {
+		m_maxWidth = x;
+		updateScrollBars();
+	}
+	if (x < horizontal->value()) {
+		horizontal->setValue(x);
+	} else if (x > horizontal->value() + textWidth - m_charWidth) {
+		horizontal->setValue(x - textWidth + m_charWidth);
+	}
+}
+
+void BufferView::goToLine(int line, int column) {
+	if (!m_buffer) return;
+	const qsizetype index = std::clamp<qsizetype>(line - 1, 0, m_buffer->lineCount() - 1);
+	const qsizetype length = lineLength(index);
+	const qsizetype pos = m_buffer->lineStart(index) + std::clamp<qsizetype>(column - 1, 0, length);
+	moveCursor(pos, false);
+	// Center the target row in the viewport.
+	setFirstVisibleRow(rowOfPosition(pos) - visibleLineCount() / 2);
+}
+
+void BufferView::selectAll() {
+	if (!m_buffer) return;
+	m_anchor = 0;
+	moveCursor(m_buffer->size(), true);
+}
+
+QString BufferView::selectedText() const {
+	if (!m_buffer || !hasSelection()) return {};
+	return m_buffer->slice(selectionStart(), selectionEnd() - selectionStart());
+}
+
+void BufferView::setModified(bool modified) {
+	if (m_modified == modified) return;
+	m_modified = modified;
+	emit modificationChanged(modified);
+}
+
+void BufferView::setLineChanges(DiffHunksPtr hunks) {
+	m_lineChanges = std::move(hunks);
+	viewport()->update(QRect(0, 0, gutterWidth(), viewport()->height()));
+}
+
+void BufferView::setHighlighter(SyntaxHighlighter* highlighter) {
+	if (m_highlighter == highlighter) return;
+	if (m_highlighter) {
+		disconnect(m_highlighter, nullptr, this, nullptr);
+	}
+	m_highlighter = highlighter;
+	if (m_highlighter) {
+		connect(m_highlighter, &SyntaxHighlighter::highlighted, this, [this](qsizetype first, qsizetype last) {
+			const qsizetype top = firstVisibleLine();
+			if (last >= top && first <= top + visibleLineCount()) {
+				viewport()->update();
+			}
+		});
+		reportVisibleLines();
+	}
+	viewport()->update();
+}
+
+void BufferView::reportVisibleLines() {
+	if (m_highlighter) {
+		const qsizetype first = firstVisibleLine();
+		m_highlighter->setVisibleLines(first, first + visibleLineCount());
+	}
+}
+
+void BufferView::setSearchResults(SearchMatchesPtr results) {
+	m_results = std::move(results);
+	viewport()->update();
+}
+
+void BufferView::selectSearchResult(qsizetype index) {
+	if (!m_results || index < 0 || index >= m_results->size()) return;
+	const SearchResult result = m_results->at(index);
+	m_anchor = result.start;
+	moveCursor(result.start + result.length, true);
+	setFirstVisibleRow(rowOfPosition(m_cursor) - visibleLineCount() / 2);
+}
+
+void BufferView::clearSearchHighlights() {
+	m_results.reset();
+	viewport()->update();
+}
+
+void BufferView::insertText(const QString& text) {
+	if (!m_buffer || m_readOnly) return;
+	applyEdit(selectionStart(), selectionEnd() - selectionStart(), text);
+}
+
+void BufferView::replaceRange(qsizetype pos, qsizetype length, const QString& text) {
+	if (!m_buffer) return;
+	const qsizetype end = pos + length;
+	// A cursor at the end of the text follows text added there, like tail -f.
+	const bool follow = end == m_buffer->size();
+	auto map = [&](qsizetype p) {
+		if (p < pos || (p == pos && !follow)) return p;
+		return p >= end ? p + text.size() - length : pos;
+	};
+	const qsizetype cursor = map(m_cursor);
+	const qsizetype anchor = map(m_anchor);
+	const qsizetype top = firstVisibleLine();
+	const bool atBottom = firstVisibleRow() >= verticalScrollBar()->maximum();
+	const int left = horizontalScrollBar()->value();
+	const qsizetype firstLine = m_buffer->lineFromPosition(pos);
+	const qsizetype lines = m_buffer->lineCount();
+
+	applyEdit(pos, length, text);
+	m_cursor = cursor;
+	m_anchor = anchor;
+	if (follow && atBottom) {
+		setFirstVisibleRow(verticalScrollBar()->maximum());
+	} else if (firstLine < top) {
+		setFirstVisibleLine(top + m_buffer->lineCount() - lines);
+	} else {
+		setFirstVisibleLine(top);
+	}
+	horizontalScrollBar()->setValue(left);
+	viewport()->update();
+	emitCursor();
+}
+
+void BufferView::applyEdit(qsizetype pos, qsizetype length, const QString& text) {
+	if (length == 0 && text.isEmpty()) return;
+	IDE_TRACE_SPAN("BufferView::applyEdit");
+	TextDelta delta;
+	delta.pos = pos;
+	delta.removed = length;
+	delta.added = text.size();
+	delta.firstLine = m_buffer->lineFromPosition(pos);
+	QString removed;
+	m_buffer->beginEdit();
+	if (length > 0) {
+		removed = m_buffer->slice(pos, length);
+		delta.removedLines = removed.count(u'\n');
+		delta.removedTail = removed.size() - removed.lastIndexOf(u'\n') - 1;
+		m_buffer->erase(pos, length);
+	}
+	if (!text.isEmpty()) {
+		delta.addedLines = text.count(u'\n');
+		m_buffer->insert(pos, text);
+	}
+	m_buffer->endEdit();
+	if (m_undo) {
+		if (removed.isEmpty()) {
+			m_undo->push({Edit::Insert, pos, text, pos + text.size()});
+		} else if (text.isEmpty()) {
+			m_undo->push({Edit::Erase, pos, removed, pos});
+		} else {
+			m_undo->push({Edit::Replace, pos, text, pos + text.size(), removed});
+		}
+	}
+	afterEdit(delta, pos + text.size());
+}
+
+void BufferView::applyUndo(bool redo) {
+	if (!m_buffer || !m_undo || m_readOnly) return;
+	const Edit* edit = redo ? m_undo->nextRedo() : m_undo->nextUndo();
+	if (!edit) return;
+	// Undoing an insert erases it, redoing it inserts again; erases the other
+	// way round, and a replace swaps its two texts.
+	QString added;
+	QString removed;
+	if (edit->type == Edit::Replace) {
+		added = redo ? edit->text : edit->removed;
+		removed = redo ? edit->removed : edit->text;
+	} else if ((edit->type == Edit::Insert) == redo) {
+		added = edit->text;
+	} else {
+		removed = edit->text;
+	}
+	TextDelta delta;
+	delta.pos = edit->pos;
+	delta.firstLine = m_buffer->lineFromPosition(edit->pos);
+	delta.added = added.size();
+	delta.addedLines = added.count(u'\n');
+	if (!removed.isEmpty()) {
+		delta.removed = removed.size();
+		delta.removedLines = removed.count(u'\n');
+		delta.removedTail = removed.size() - removed.lastIndexOf(u'\n') - 1;
+	}
+	const qsizetype cursor = redo ? m_undo->redo(*m_buffer) : m_undo->undo(*m_buffer);
+	afterEdit(delta, cursor);
+}
+
+void BufferView::undo() {
+	applyUndo(false);
+}
+
+void BufferView::redo() {
+	applyUndo(true);
+}
+
+void BufferView::afterEdit(const TextDelta& delta, qsizetype cursor) {
+	if (m_highlighter) {
+		m_highlighter->applyDelta(delta);
+	}
+	m_cursor = m_anchor = std::clamp<qsizetype>(cursor, 0, m_buffer->size());
+	m_desiredX = -1;
+	updateLongLines(delta);
+	updateScrollBars();
+	ensureCursorVisible();
+	// Edits within one unwrapped line only repaint that line.
+	if (delta.removedLines == 0 && delta.addedLines == 0 && !wrappedAt(delta.firstLine)) {
+		viewport()->update(lineRect(delta.firstLine));
+	} else {
+		viewport()->update();
+	}
+	restartBlink();
+	setModified(!m_undo || !m_undo->isClean());
+	emit textEdited(delta);
+	emitCursor();
+}
+
+void BufferView::deleteBackward(bool word) {
+	if (hasSelection()) {
+		insertText(QString());
+		return;
+	}
+	if (m_cursor == 0) return;
+	const qsizetype line = lineOf(m_cursor);
+	const qsizetype start = m_buffer->lineStart(line);
+	qsizetype from = m_cursor - 1;
+	if (m_cursor > start) {
+		qsizetype base = 0;
+		const QTextLayout& layout = layoutAround(m_cursor, &base);
+		from = base + layout.previousCursorPosition(int(m_cursor - base),
+			word ? QTextLayout::SkipWords : QTextLayout::SkipCharacters);
+	} else if (from > 0 && m_buffer->slice(from - 1, 2) == QLatin1String("\r\n")) {
+		--from;
+	}
+	applyEdit(from, m_cursor - from, QString());
+}
+
+void BufferView::deleteForward(bool word) {
+	if (hasSelection()) {
+		insertText(QString());
+		return;
+	}
+	if (m_cursor >= m_buffer->size()) return;
+	const qsizetype line = lineOf(m_cursor);
+	const qsizetype start = m_buffer->lineStart(line);
+	qsizetype to = m_cursor + 1;
+	if (m_cursor < start + lineLength(line)) {
+		qsizetype base = 0;
+		const QTextLayout& layout = layoutAround(m_cursor, &base);
+		to = base + layout.nextCursorPosition(int(m_cursor - base),
+			word ? QTextLayout::SkipWords : QTextLayout::SkipCharacters);
+	} else if (m_buffer->slice(m_cursor, std::min<qsizetype>(2, m_buffer->size() - m_cursor)) == QLatin1String("\r\n")) {
+		to = m_cursor + 2;
+	}
+	applyEdit(m_cursor, to - m_cursor, QString());
+}
+
+void BufferView::copy() const {
+	if (hasSelection()) {
+		QApplication::clipboard()->setText(selectedText());
+	}
+}
+
+void BufferView::cut() {
+	if (!hasSelection() || m_readOnly) return;
+	copy();
+	insertText(QString());
+}
+
+void BufferView::paste() {
+	QString text = QApplication::clipboard()->text();
+	// Pasted lines take the document's line break, as typed ones do.
+	text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+	if (m_lineBreak != QLatin1String("\n")) {
+		text.replace(u'\n', m_lineBreak);
+	}
+	if (!text.isEmpty()) {
+		insertText(text);
+	}
+}
+
+void BufferView::keyPressEvent(QKeyEvent* event) {
+	if (!m_buffer) {
+		QAbstractScrollArea::keyPressEvent(event);
+		return;
+	}
+	const bool pending = m_keyHandledNs >= 0;
+	if (!pending) m_keyClock.start();
+	const qsizetype cursor = m_cursor;
+	const qsizetype anchor = m_anchor;
+	const qsizetype first = firstVisibleLine();
+	const qsizetype size = m_buffer->size();
+	handleKey(event);
+	if (!pending && (m_cursor != cursor || m_anchor != anchor || firstVisibleLine() != first || m_buffer->size() != size)) {
+		m_keyHandledNs = m_keyClock.nsecsElapsed();
+	}
+}
+
+void BufferView::handleKey(QKeyEvent* event) {
+	if (event->matches(QKeySequence::Copy)) { copy(); return; }
+	if (event->matches(QKeySequence::Cut)) { cut(); return; }
+	if (event->matches(QKeySequence::Paste)) { paste(); return; }
+	if (event->matches(QKeySequence::Undo)) { undo(); return; }
+	if (event->matches(QKeySequence::Redo)) { redo(); return; }
+	if (event->matches(QKeySequence::SelectAll)) { selectAll(); return; }
+
+	const bool shift = event->modifiers() & Qt::ShiftModifier;
+	const bool ctrl = event->modifiers() & Qt::ControlModifier;
+	const qsizetype line = lineOf(m_cursor);
+	const qsizetype start = m_buffer->lineStart(line);
+	switch (event->key()) {
+	case Qt::Key_Left:
+	case Qt::Key_Right: {
+		const bool left = event->key() == Qt::Key_Left;
+		if (hasSelection() && !shift) {
+			moveCursor(left ? selectionStart() : selectionEnd(), false);
+			return;
+		}
+		qsizetype base = 0;
+		const QTextLayout& layout = layoutAround(m_cursor, &base);
+		const int column = int(m_cursor - base);
+		const qsizetype end = start + lineLength(line);
+		const QTextLayout::CursorMode mode = ctrl ? QTextLayout::SkipWords : QTextLayout::SkipCharacters;
+		// Line breaks are stepped over whole, including a preceding '\r'.
+		if (left && m_cursor > start) {
+			moveCursor(base + layout.previousCursorPosition(column, mode), shift);
+		} else if (left && line > 0) {
+			moveCursor(m_buffer->lineStart(line - 1) + lineLength(line - 1), shift);
+		} else if (!left && m_cursor < end) {
+			moveCursor(base + layout.nextCursorPosition(column, mode), shift);
+		} else if (!left && line + 1 < m_buffer->lineCount()) {
+			moveCursor(m_buffer->lineStart(line + 1), shift);
+		}
+		return;
+	}
+	case Qt::Key_Up:
+		moveVertically(-1, shift);
+		return;
+	case Qt::Key_Down:
+		moveVertically(1, shift);
+		return;
+	case Qt::Key_PageUp:
+		setFirstVisibleRow(firstVisibleRow() - visibleLineCount());
+		moveVertically(-visibleLineCount(), shift);
+		return;
+	case Qt::Key_PageDown:
+		setFirstVisibleRow(firstVisibleRow() + visibleLineCount());
+		moveVertically(visibleLineCount(), shift);
+		return;
+	case Qt::Key_Home: {
+		if (ctrl) {
+			moveCursor(0, shift);
+			return;
+		}
+		// Toggle between the first non-blank character and column 0.
+		const QString text = m_buffer->slice(start, std::min(lineLength(line), kStepWindow));
+		qsizetype indent = 0;
+		while (indent < text.size() && text[indent].isSpace()) {
+			++indent;
+		}
+		moveCursor(m_cursor == start + indent ? start : start + indent, shift);
+		return;
+	}
+	case Qt::Key_End:
+		moveCursor(ctrl ? m_buffer->size() : start + lineLength(line), shift);
+		return;
+	case Qt::Key_Backspace:
+		if (!m_readOnly) deleteBackward(ctrl);
+		return;
+	case Qt::Key_Delete:
+		if (!m_readOnly) deleteForward(ctrl);
+		return;
+	case Qt::Key_Return:
+	case Qt::Key_Enter: {
+		// Keep the indentation of the current line.
+		const QString text = m_buffer->slice(start, std::min(lineLength(line), kStepWindow));
+		qsizetype indent = 0;
+		while (indent < text.size() && (text[indent] == u' ' || text[indent] == u'\t')) {
+			++indent;
+		}
+		insertText(m_lineBreak + text.left(std::min(indent, m_cursor - start)));
+		return;
+	}
+	case Qt::Key_Tab:
+		insertText(QStringLiteral("\t"));
+		return;
+	default:
+		break;
+	}
+	const QString text = event->text();
+	if (!text.isEmpty() && !ctrl && text.at(0).isPrint()) {
+		insertText(text);
+		return;
+	}
+	QAbstractScrollArea::keyPressEvent(event);
+}
+
+void BufferView::inputMethodEvent(QInputMethodEvent* event) {
+	if (!m_buffer || m_readOnly) {
+		event->ignore();
+		return;
+	}
+	// The input method may replace text around the cursor, e.g. to reconvert it.
+	if (event->replacementLength() > 0) {
+		const qsizetype from = std::clamp<qsizetype>(m_cursor + event->replacementStart(), 0, m_buffer->size());
+		moveCursor(from, false);
+		moveCursor(from + event->replacementLength(), true);
+	}
+	if (!event->commitString().isEmpty() || event->replacementLength() > 0) {
+		insertText(event->commitString());
+	}
+	m_preedit = event->preeditString();
+	m_preeditFormats.clear();
+	m_preeditCursor = int(m_preedit.size());
+	for (const QInputMethodEvent::Attribute& attribute : event->attributes()) {
+		if (attribute.type == QInputMethodEvent::Cursor) {
+			m_preeditCursor = attribute.length > 0 ? attribute.start : -1;
+		} else if (attribute.type == QInputMethodEvent::TextFormat) {
+			const QTextCharFormat format = qvariant_cast<QTextFormat>(attribute.value).toCharFormat();
+			if (format.isValid()) m_preeditFormats.append({attribute.start, attribute.length, format});
+		}
+	}
+	if (!m_preedit.isEmpty()) ensureCursorVisible();
+	viewport()->update(lineRect(lineOf(m_cursor)));
+	event->accept();
+}
+
+QVariant BufferView::inputMethodQuery(Qt::InputMethodQuery query) const {
+	if (!m_buffer) return QAbstractScrollArea::inputMethodQuery(query);
+	switch (query) {
+	case Qt::ImEnabled:
+		return !m_readOnly;
+	case Qt::ImCursorRectangle: {
+		const qsizetype row = std::clamp<qsizetype>(rowOfPosition(m_cursor) - firstVisibleRow(), -1, visibleLineCount());
+		return QRect(m_cursorX, int(row) * m_lineHeight, 1, m_lineHeight).translated(viewport()->pos());
+	}
+	case Qt::ImFont:
+		return font();
+	case Qt::ImSurroundingText:
+	case Qt::ImCursorPosition:
+	case Qt::ImAnchorPosition: {
+		// The cursor's line, or the text around the cursor on a long one.
+		const qsizetype line = lineOf(m_cursor);
+		const qsizetype start = m_buffer->lineStart(line);
+		const qsizetype end = start + lineLength(line);
+		qsizetype from = std::max(start, m_cursor - kStepWindow);
+		qsizetype to = std::min(end, m_cursor + kStepWindow);
+		if (from > start && m_buffer->slice(from, 1).at(0).isLowSurrogate()) --from;
+		if (to < end && m_buffer->slice(to, 1).at(0).isLowSurrogate()) ++to;
+		if (query == Qt::ImSurroundingText) return m_buffer->slice(from, to - from);
+		const qsizetype pos = query == Qt::ImCursorPosition ? m_cursor : m_anchor;
+		return int(std::clamp(pos, from, to) - from);
+	}
+	case Qt::ImCurrentSelection:
+		return hasSelection() && selectionEnd() - selectionStart() <= kStepWindow ? selectedText() : QString();
+	default:
+		return QAbstractScrollArea::inputMethodQuery(query);
+	}
+}
+
+void BufferView::contextMenuEvent(QContextMenuEvent* event) {
+	if (!m_buffer) return;
+	// A click outside the selection moves the cursor there first.
+	const qsizetype pos = positionAt(event->pos());
+	if (event->reason() == QContextMenuEvent::Mouse && (pos < selectionStart() || pos > selectionEnd())) {
+		moveCursor(pos, false);
+	}
+	QMenu menu(this);
+	QAction* cutAction = menu.addAction("Cu&t", QKeySequence::Cut, this, &BufferView::cut);
+	cutAction->setEnabled(hasSelection() && !m_readOnly);
+	QAction* copyAction = menu.addAction("&Copy", QKeySequence::Copy, this, [this] { copy(); });
+	copyAction->setEnabled(hasSelection());
+	QAction* pasteAction = menu.addAction("&Paste", QKeySequence::Paste, this, &BufferView::paste);
+	pasteAction->setEnabled(!m_readOnly && !QApplication::clipboard()->text().isEmpty());
+	menu.addSeparator();
+	QAction* selectAllAction = menu.addAction("Select &All", QKeySequence::SelectAll, this, &BufferView::selectAll);
+	selectAllAction->setEnabled(m_buffer->size() > 0);
+	menu.exec(event->globalPos());
+}
+
+void BufferView::mousePressEvent(QMouseEvent* event) {
+	// Whatever is being composed is kept before the cursor moves away from it.
+	if (!m_preedit.isEmpty()) {
+		QGuiApplication::inputMethod()->commit();
+	}
+	if (event->button() != Qt::LeftButton || !m_buffer) {
+		QAbstractScrollArea::mousePressEvent(event);
+		return;
+	}
+	moveCursor(positionAt(event->position().toPoint()), event->modifiers() & Qt::ShiftModifier);
+}
+
+void BufferView::mouseMoveEvent(QMouseEvent* event) {
+	if (!(event->buttons() & Qt::LeftButton) || !m_buffer) return;
+	moveCursor(positionAt(event->position().toPoint()), true);
+}
+
+void BufferView::mouseDoubleClickEvent(QMouseEvent* event) {
+	if (event->button() != Qt::LeftButton || !m_buffer) return;
+	const qsizetype pos = positionAt(event->position().toPoint());
+	qsizetype start = 0;
+	QString text;
+	const QTextLayout& layout = layoutAround(pos, &start, &text);
+	const int column = int(pos - start);
+	int from = column;
+	while (from > 0 && (text[from - 1].isLetterOrNumber() || text[from - 1] == u'_')) {
+		--from;
+	}
+	int to = column;
+	while (to < text.size() && (text[to].isLetterOrNumber() || text[to] == u'_')) {
+		++to;
+	}
+	if (from == to && to < text.size()) {
+		to = layout.nextCursorPosition(to);
+	}
+	m_anchor = start + from;
+	moveCursor(start + to, true);
+}
+
+void BufferView::focusInEvent(QFocusEvent* event) {
+	QAbstractScrollArea::focusInEvent(event);
+	restartBlink();
+}
+
+void BufferView::focusOutEvent(QFocusEvent* event) {
+	QAbstractScrollArea::focusOutEvent(event);
+	m_blink->stop();
+	if (m_buffer) viewport()->update(lineRect(lineOf(m_cursor)));
+}
+
+bool BufferView::focusNextPrevChild(bool) {
+	return false;
+}
+
+void BufferView::restartBlink() {
+	m_cursorVisible = true;
+	if (hasFocus()) {
+		m_blink->start();
+	}
+}
+
+void BufferView::emitCursor() {
+	if (!m_buffer) return;
+	const qsizetype line = lineOf(m_cursor);
+	emit cursorPosChanged(int(line + 1), int(m_cursor - m_buffer->lineStart(line) + 1));
+}
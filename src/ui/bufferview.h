@@ -0,0 +1,187 @@
+#pragma once
+#include <QAbstractScrollArea>
+#include <QElapsedTimer>
+#include "linelayoutcache.h"
+#include "../buffer/textBuffer.h"
+#include "../buffer/lineDiff.h"
+#include "../search/SearchMatches.h"
+#include <algorithm>
+#include <vector>
+
+class UndoStack;
+class QTimer;
+class SyntaxHighlighter;
+
+// Editor view that paints straight from an ITextBuffer. Only the rows in the
+// viewport are fetched and shaped, and the vertical scroll bar counts rows,
+// so paint and scroll cost depend on the viewport rather than the file.
+//
+// A line longer than kLongLineChars is never shaped whole: it wraps into rows
+// of as many cells as fit the viewport, found through the buffer's cell
+// checkpoints, and only the rows in view are sliced out and laid out. Every
+// other line is one row.
+class BufferView : public QAbstractScrollArea {
+	Q_OBJECT
+public:
+	static constexpr qsizetype kLongLineChars = 16 * 1024;
+
+	explicit BufferView(QWidget* parent = nullptr);
+
+	// Neither is owned. Without an undo stack edits are not recorded.
+	void setBuffer(ITextBuffer* buffer, UndoStack* undo = nullptr);
+	ITextBuffer* buffer() const { return m_buffer; }
+	// Call after the buffer was replaced behind the view, e.g. on reload.
+	void bufferReset();
+
+	qsizetype cursorPosition() const { return m_cursor; }
+	qsizetype anchorPosition() const { return m_anchor; }
+	void setCursorPosition(qsizetype pos, bool keepAnchor = false);
+	qsizetype selectionStart() const { return std::min(m_cursor, m_anchor); }
+	qsizetype selectionEnd() const { return std::max(m_cursor, m_anchor); }
+	bool hasSelection() const { return m_cursor != m_anchor; }
+	QString selectedText() const;
+	void selectAll();
+	// 1-based; a column of 0 puts the cursor at the start of the line.
+	void goToLine(int line, int column = 0);
+
+	qsizetype firstVisibleLine() const;
+	void setFirstVisibleLine(qsizetype line);
+	// In rows.
+	int visibleLineCount() const;
+	bool hasLongLines() const { return !m_wrapped.empty(); }
+
+	bool isModified() const { return m_modified; }
+	void setModified(bool modified);
+	bool isReadOnly() const { return m_readOnly; }
+	void setReadOnly(bool readOnly) { m_readOnly = readOnly; }
+	// What Enter inserts; "\n" unless the file uses "\r\n".
+	void setLineBreak(const QString& lineBreak) { m_lineBreak = lineBreak; }
+
+	void setLineChanges(DiffHunksPtr hunks);
+	// Not owned. Edits are reported to it and its tokens color the text.
+	void setHighlighter(SyntaxHighlighter* highlighter);
+	void setSearchResults(SearchMatchesPtr results);
+	void selectSearchResult(qsizetype index);
+	void clearSearchHighlights();
+
+	void insertText(const QString& text);
+	// An edit made elsewhere, e.g. by a reload. The cursor, selection and the
+	// lines in view stay on the text around it.
+	void replaceRange(qsizetype pos, qsizetype length, const QString& text);
+	void undo();
+	void redo();
+	void copy() const;
+	void cut();
+	void paste();
+
+signals:
+	void cursorPosChanged(int line, int col);
+	void textEdited(const TextDelta& delta);
+	void modificationChanged(bool modified);
+	void firstVisibleLineChanged(qsizetype line);
+	void longLinesChanged(bool any);
+	// For a key press that changed the text, cursor or scroll position: the time
+	// it took to handle and until its effect was painted, from the oldest key
+	// not painted yet.
+	void inputLatency(qint64 handledNs, qint64 paintedNs);
+
+protected:
+	void paintEvent(QPaintEvent* event) override;
+	void resizeEvent(QResizeEvent* event) override;
+	void changeEvent(QEvent* event) override;
+	void keyPressEvent(QKeyEvent* event) override;
+	void inputMethodEvent(QInputMethodEvent* event) override;
+	QVariant inputMethodQuery(Qt::InputMethodQuery query) const override;
+	void contextMenuEvent(QContextMenuEvent* event) override;
+	void mousePressEvent(QMouseEvent* event) override;
+	void mouseMoveEvent(QMouseEvent* event) override;
+	void mouseDoubleClickEvent(QMouseEvent* event) override;
+	void focusInEvent(QFocusEvent* event) override;
+	void focusOutEvent(QFocusEvent* event) override;
+	void scrollContentsBy(int dx, int dy) override;
+	bool focusNextPrevChild(bool next) override;
+
+private:
+	struct WrappedLine {
+		qsizetype line = 0;
+		qsizetype rows = 1;
+		// Rows past one per line taken by the wrapped lines before this one.
+		qsizetype extraBefore = 0;
+	};
+
+	// Without the line break.
+	qsizetype lineLength(qsizetype line) const;
+	qsizetype lineOf(qsizetype pos) const;
+	const WrappedLine* wrappedAt(qsizetype line) const;
+	qsizetype rowCount() const;
+	qsizetype rowOfLine(qsizetype line) const;
+	qsizetype rowOfPosition(qsizetype pos) const;
+	qsizetype lineAtRow(qsizetype row, qsizetype* sub = nullptr) const;
+	qsizetype firstVisibleRow() const;
+	void setFirstVisibleRow(qsizetype row);
+	// The text of a row, from *from to *to, and its layout.
+	const QTextLayout& rowLayout(qsizetype line, qsizetype sub, qsizetype* from, qsizetype* to, QString* text = nullptr);
+	// The line's layout for stepping the cursor from pos; for a long line only
+	// the text around pos, starting at *from.
+	const QTextLayout& layoutAround(qsizetype pos, qsizetype* from, QString* text = nullptr);
+	qsizetype positionInRow(qsizetype row, qreal x);
+	qsizetype positionAt(const QPoint& point);
+	qreal cursorX(qsizetype pos);
+	int gutterWidth() const;
+	int textOffset() const;
+	int wrappedOffset() const;
+	// The rows of the line, clipped to the viewport.
+	QRect lineRect(qsizetype line) const;
+	void paintGutter(QPainter& painter, const QRect& rect, qsizetype firstRow);
+
+	void findLongLines();
+	void updateLongLines(const TextDelta& delta);
+	void countWrappedRows();
+
+	void updateFontMetrics();
+	void updateScrollBars();
+	void ensureCursorVisible();
+	void moveCursor(qsizetype pos, bool keepAnchor, bool keepColumn = false);
+	void moveVertically(qsizetype rows, bool keepAnchor);
+	void applyEdit(qsizetype pos, qsizetype length, const QString& text);
+	void applyUndo(bool redo);
+	void afterEdit(const TextDelta& delta, qsizetype cursor);
+	void deleteBackward(bool word);
+	void deleteForward(bool word);
+	void emitCursor();
+	void restartBlink();
+	void reportVisibleLines();
+	void handleKey(QKeyEvent* event);
+
+	ITextBuffer* m_buffer = nullptr;
+	UndoStack* m_undo = nullptr;
+	LineLayoutCache m_layouts;
+	// Sorted by line.
+	std::vector<WrappedLine> m_wrapped;
+	qsizetype m_wrapCells = 80;
+	qsizetype m_cursor = 0;
+	qsizetype m_anchor = 0;
+	// Column x kept across vertical moves through shorter lines.
+	qreal m_desiredX = -1;
+	int m_lineHeight = 1;
+	int m_charWidth = 1;
+	int m_maxWidth = 0;
+	bool m_modified = false;
+	bool m_readOnly = false;
+	QString m_lineBreak = QStringLiteral("\n");
+	bool m_cursorVisible = true;
+	QTimer* m_blink = nullptr;
+	DiffHunksPtr m_lineChanges;
+	SearchMatchesPtr m_results;
+	SyntaxHighlighter* m_highlighter = nullptr;
+	// Text the input method is composing, shown at the cursor until committed.
+	QString m_preedit;
+	QList<QTextLayout::FormatRange> m_preeditFormats;
+	// Within the preedit text; -1 hides the cursor.
+	int m_preeditCursor = 0;
+	// Where the cursor was last painted, for placing the input method's window.
+	int m_cursorX = 0;
+	QElapsedTimer m_keyClock;
+	// -1 when no handled key is waiting to be painted.
+	qint64 m_keyHandledNs = -1;
+};
@@ -0,0 +1,81 @@
+#include "buildoutputview.h"
+#include "../build/build_output.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QFontDatabase>
+#include <QKeyEvent>
+#include <QScrollBar>
+#include <algorithm>
+
+BuildOutputModel::BuildOutputModel(BuildOutput* output, QObject* parent) : QAbstractListModel(parent), m_output(output) {
+	connect(output, &BuildOutput::aboutToReset, this, [this] { beginResetModel(); });
+	connect(output, &BuildOutput::reset, this, [this] { endResetModel(); });
+	connect(output, &BuildOutput::linesAboutToBeRemoved, this, [this](qsizetype count) {
+		beginRemoveRows({}, 0, int(count) - 1);
+	});
+	connect(output, &BuildOutput::linesRemoved, this, [this] { endRemoveRows(); });
+	connect(output, &BuildOutput::linesAboutToBeAppended, this, [this](qsizetype count) {
+		const int first = rowCount();
+		beginInsertRows({}, first, first + int(count) - 1);
+	});
+	connect(output, &BuildOutput::linesAppended, this, [this] { endInsertRows(); });
+}
+
+int BuildOutputModel::rowCount(const QModelIndex& parent) const {
+	return parent.isValid() ? 0 : int(m_output->lines().size());
+}
+
+QVariant BuildOutputModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid() || role != Qt::DisplayRole) return {};
+	return m_output->lines().at(index.row());
+}
+
+BuildOutputView::BuildOutputView(BuildOutput* output, QWidget* parent) : QListView(parent), m_output(output) {
+	m_model = new BuildOutputModel(output, this);
+	setModel(m_model);
+	setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+	setUniformItemSizes(true);
+	setSelectionMode(QAbstractItemView::ExtendedSelection);
+	setEditTriggers(QAbstractItemView::NoEditTriggers);
+	setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+
+	// Stick to the end while the user has not scrolled away from it.
+	connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) {
+		m_followTail = value == verticalScrollBar()->maximum();
+	});
+	connect(output, &BuildOutput::linesAboutToBeAppended, this, [this] {
+		m_followTail = verticalScrollBar()->value() == verticalScrollBar()->maximum();
+	});
+	connect(output, &BuildOutput::linesAppended, this, [this] {
+		if (m_followTail) scrollToBottom();
+	});
+	connect(output, &BuildOutput::reset, this, [this] { m_followTail = true; });
+}
+
+void BuildOutputView::showLine(qint64 line) {
+	const qint64 row = line - m_output->lines().firstLine();
+	if (row < 0 || row >= m_output->lines().size()) return;
+	const QModelIndex index = m_model->index(int(row));
+	m_followTail = false;
+	scrollTo(index, QAbstractItemView::PositionAtCenter);
+	setCurrentIndex(index);
+}
+
+void BuildOutputView::keyPressEvent(QKeyEvent* event) {
+	if (event->matches(QKeySequence::Copy)) {
+		copySelection();
+		return;
+	}
+	QListView::keyPressEvent(event);
+}
+
+void BuildOutputView::copySelection() {
+	QModelIndexList rows = selectionModel()->selectedRows();
+	std::sort(rows.begin(), rows.end(), [](const QModelIndex& a, const QModelIndex& b) { return a.row() < b.row(); });
+	QStringList lines;
+	lines.reserve(rows.size());
+	for (const QModelIndex& index : rows) {
+		lines.append(index.data().toString());
+	}
+	QApplication::clipboard()->setText(lines.join(u'\n'));
+}
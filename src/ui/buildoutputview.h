@@ -0,0 +1,38 @@
+#pragma once
+#include <QAbstractListModel>
+#include <QListView>
+
+class BuildOutput;
+
+class BuildOutputModel : public QAbstractListModel {
+	Q_OBJECT
+public:
+	explicit BuildOutputModel(BuildOutput* output, QObject* parent = nullptr);
+
+	int rowCount(const QModelIndex& parent = {}) const override;
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+private:
+	BuildOutput* m_output;
+};
+
+// Only the visible rows are ever laid out, so the cost of a frame does not
+// depend on how much output the ring holds.
+class BuildOutputView : public QListView {
+	Q_OBJECT
+public:
+	explicit BuildOutputView(BuildOutput* output, QWidget* parent = nullptr);
+
+	// Scrolls to an absolute output line if it is still held.
+	void showLine(qint64 line);
+
+protected:
+	void keyPressEvent(QKeyEvent* event) override;
+
+private:
+	void copySelection();
+
+	BuildOutput* m_output;
+	BuildOutputModel* m_model = nullptr;
+	bool m_followTail = true;
+};
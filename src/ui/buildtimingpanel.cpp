@@ -0,0 +1,135 @@
+#include "buildtimingpanel.h"
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QTabWidget>
+#include <QTableView>
+#include <QVBoxLayout>
+#include <algorithm>
+
+TimingModel::TimingModel(const QString& countLabel, QObject* parent) : QAbstractTableModel(parent), m_countLabel(countLabel) {}
+
+void TimingModel::setEntries(std::vector<TimingEntry> entries) {
+	beginResetModel();
+	m_entries = std::move(entries);
+	endResetModel();
+	sort(m_sortColumn, m_sortOrder);
+}
+
+int TimingModel::rowCount(const QModelIndex& parent) const {
+	return parent.isValid() ? 0 : int(m_entries.size());
+}
+
+int TimingModel::columnCount(const QModelIndex& parent) const {
+	return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant TimingModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid()) return {};
+	const TimingEntry& row = entry(index.row());
+	if (role == Qt::TextAlignmentRole && (index.column() == Time || index.column() == Count)) {
+		return QVariant(Qt::AlignRight | Qt::AlignVCenter);
+	}
+	if (role == Qt::ToolTipRole) return row.path;
+	if (role != Qt::DisplayRole) return {};
+	switch (index.column()) {
+	case Name: return row.name;
+	case Time: return QString::number(double(row.ms) / 1000.0, 'f', 2);
+	case Count: return row.count;
+	case Path: return row.path;
+	default: return {};
+	}
+}
+
+QVariant TimingModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return {};
+	switch (section) {
+	case Name: return QStringLiteral("Name");
+	case Time: return QStringLiteral("Time (s)");
+	case Count: return m_countLabel;
+	case Path: return QStringLiteral("Path");
+	default: return {};
+	}
+}
+
+void TimingModel::sort(int column, Qt::SortOrder order) {
+	m_sortColumn = column;
+	m_sortOrder = order;
+	auto less = [column](const TimingEntry& a, const TimingEntry& b) {
+		switch (column) {
+		case Name: return a.name < b.name;
+		case Count: return a.count < b.count;
+		case Path: return a.path < b.path;
+		default: return a.ms < b.ms;
+		}
+	};
+	emit layoutAboutToBeChanged();
+	if (order == Qt::AscendingOrder) {
+		std::stable_sort(m_entries.begin(), m_entries.end(), less);
+	} else {
+		std::stable_sort(m_entries.begin(), m_entries.end(), [&less](const TimingEntry& a, const TimingEntry& b) { return less(b, a); });
+	}
+	emit layoutChanged();
+}
+
+BuildTimingPanel::BuildTimingPanel(BuildTimingService* timing, QWidget* parent) : QDockWidget("Build Timing", parent), m_timing(timing) {
+	setObjectName("BuildTimingPanel");
+	auto* content = new QWidget(this);
+	auto* layout = new QVBoxLayout(content);
+	layout->setContentsMargins(0, 0, 0, 0);
+
+	auto* header = new QHBoxLayout;
+	m_summary = new QLabel("Build with Ninja to collect timing; add -ftime-trace (clang) for header costs.", content);
+	header->addWidget(m_summary, 1);
+	auto* refresh = new QPushButton("Refresh", content);
+	header->addWidget(refresh);
+	layout->addLayout(header);
+
+	auto* tabs = new QTabWidget(content);
+	m_targets = new TimingModel("Steps", this);
+	m_units = new TimingModel("Count", this);
+	m_headers = new TimingModel("Included by", this);
+	addTable(tabs, m_targets, "Targets");
+	addTable(tabs, m_units, "Translation Units");
+	QTableView* headers = addTable(tabs, m_headers, "Headers");
+	layout->addWidget(tabs);
+	setWidget(content);
+
+	connect(refresh, &QPushButton::clicked, this, &BuildTimingPanel::refreshRequested);
+	connect(headers, &QTableView::activated, this, [this](const QModelIndex& index) {
+		emit fileActivated(m_headers->entry(index.row()).path);
+	});
+	connect(m_timing, &BuildTimingService::ready, this, &BuildTimingPanel::updateReport);
+}
+
+QTableView* BuildTimingPanel::addTable(QTabWidget* tabs, TimingModel* model, const QString& title) {
+	auto* view = new QTableView(tabs);
+	view->setModel(model);
+	view->setSortingEnabled(true);
+	view->sortByColumn(TimingModel::Time, Qt::DescendingOrder);
+	view->setSelectionBehavior(QAbstractItemView::SelectRows);
+	view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	view->setShowGrid(false);
+	view->setWordWrap(false);
+	view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+	view->verticalHeader()->setDefaultSectionSize(view->fontMetrics().height() + 4);
+	view->verticalHeader()->hide();
+	view->horizontalHeader()->setSectionResizeMode(TimingModel::Path, QHeaderView::Stretch);
+	tabs->addTab(view, title);
+	return view;
+}
+
+void BuildTimingPanel::updateReport() {
+	const BuildTimingReport& report = m_timing->report();
+	if (!report.error.isEmpty()) {
+		m_summary->setText(report.error);
+	} else {
+		m_summary->setText(QString("%1: %2 translation units, %3 s wall time, %4 headers traced")
+			.arg(m_timing->buildDir()).arg(report.units.size()).arg(double(report.wallMs) / 1000.0, 0, 'f', 1)
+			.arg(report.headers.size()));
+	}
+	m_targets->setEntries(report.targets);
+	m_units->setEntries(report.units);
+	m_headers->setEntries(report.headers);
+}
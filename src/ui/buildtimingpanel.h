@@ -0,0 +1,52 @@
+#pragma once
+#include <QAbstractTableModel>
+#include <QDockWidget>
+#include "../build/build_timing.h"
+
+class QLabel;
+class QTabWidget;
+class QTableView;
+
+class TimingModel : public QAbstractTableModel {
+	Q_OBJECT
+public:
+	enum Column { Name, Time, Count, Path, ColumnCount };
+
+	TimingModel(const QString& countLabel, QObject* parent = nullptr);
+
+	void setEntries(std::vector<TimingEntry> entries);
+	const TimingEntry& entry(int row) const { return m_entries[std::size_t(row)]; }
+
+	int rowCount(const QModelIndex& parent = {}) const override;
+	int columnCount(const QModelIndex& parent = {}) const override;
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+	void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+private:
+	QString m_countLabel;
+	std::vector<TimingEntry> m_entries;
+	int m_sortColumn = Time;
+	Qt::SortOrder m_sortOrder = Qt::DescendingOrder;
+};
+
+// Slowest targets, translation units and headers of the last Ninja build.
+class BuildTimingPanel : public QDockWidget {
+	Q_OBJECT
+public:
+	explicit BuildTimingPanel(BuildTimingService* timing, QWidget* parent = nullptr);
+
+signals:
+	void refreshRequested();
+	void fileActivated(const QString& path);
+
+private:
+	QTableView* addTable(QTabWidget* tabs, TimingModel* model, const QString& title);
+	void updateReport();
+
+	BuildTimingService* m_timing;
+	QLabel* m_summary = nullptr;
+	TimingModel* m_targets = nullptr;
+	TimingModel* m_units = nullptr;
+	TimingModel* m_headers = nullptr;
+};
@@ -0,0 +1,136 @@
+#include "buildtoolbar.h"
+#include <QAction>
+#include <QComboBox>
+#include <QFileDialog>
+#include <QSettings>
+#include <QSignalBlocker>
+#include <QSpinBox>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+enum TargetKind { Directory, Preset, Browse };
+constexpr int kKindRole = Qt::UserRole;
+constexpr int kValueRole = Qt::UserRole + 1;
+}
+
+BuildToolBar::BuildToolBar(BuildJobManager* jobs, QWidget* parent) : QToolBar("Build", parent), m_jobs(jobs) {
+	setObjectName("BuildToolBar");
+
+	m_target = new QComboBox(this);
+	m_target->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+	m_target->setToolTip("Build directory or preset");
+	addWidget(m_target);
+
+	m_config = new QComboBox(this);
+	m_config->addItem("Default", QString());
+	for (const char* config : {"Debug", "Release", "RelWithDebInfo", "MinSizeRel"}) {
+		m_config->addItem(config, QString(config));
+	}
+	m_config->setToolTip("Configuration (multi-config generators)");
+	addWidget(m_config);
+
+	m_parallel = new QSpinBox(this);
+	m_parallel->setRange(0, std::max(QThread::idealThreadCount() * 2, 2));
+	m_parallel->setSpecialValueText("Auto jobs");
+	m_parallel->setSuffix(" jobs");
+	m_parallel->setToolTip("Parallel build jobs");
+	addWidget(m_parallel);
+
+	QSettings settings;
+	m_config->setCurrentIndex(std::max(0, m_config->findData(settings.value("build/config").toString())));
+	m_parallel->setValue(settings.value("build/parallel", 0).toInt());
+	connect(m_config, &QComboBox::currentIndexChanged, this, [this] {
+		QSettings().setValue("build/config", m_config->currentData());
+	});
+	connect(m_parallel, &QSpinBox::valueChanged, this, [](int value) {
+		QSettings().setValue("build/parallel", value);
+	});
+
+	m_build = addAction("Build", this, &BuildToolBar::build);
+	m_cancel = addAction("Cancel", m_jobs, &BuildJobManager::cancel);
+	m_restart = addAction("Restart", m_jobs, &BuildJobManager::restart);
+
+	rebuildTargets();
+	connect(m_target, &QComboBox::activated, this, [this](int index) {
+		if (m_target->itemData(index, kKindRole).toInt() == Browse) {
+			browse();
+		}
+	});
+	connect(m_jobs, &BuildJobManager::directoriesChanged, this, &BuildToolBar::rebuildTargets);
+	connect(m_jobs, &BuildJobManager::runningChanged, this, &BuildToolBar::updateActions);
+	updateActions();
+}
+
+void BuildToolBar::setSourceDir(const QString& dir) {
+	if (dir == m_sourceDir) return;
+	m_sourceDir = dir;
+	m_presets = dir.isEmpty() ? std::vector<BuildPreset>() : readBuildPresets(dir);
+	rebuildTargets();
+}
+
+void BuildToolBar::rebuildTargets() {
+	const QSignalBlocker blocker(m_target);
+	const QString selected = m_target->currentData(kValueRole).toString();
+	m_target->clear();
+	for (const QString& dir : m_jobs->directories()) {
+		m_target->addItem(dir, Directory);
+		m_target->setItemData(m_target->count() - 1, dir, kValueRole);
+	}
+	for (const BuildPreset& preset : m_presets) {
+		m_target->addItem(QString("Preset: %1").arg(preset.name), Preset);
+		m_target->setItemData(m_target->count() - 1, preset.name, kValueRole);
+	}
+	m_target->addItem("Browse…", Browse);
+	const int index = selected.isEmpty() ? -1 : m_target->findData(selected, kValueRole);
+	m_target->setCurrentIndex(std::max(index, 0));
+}
+
+void BuildToolBar::browse() {
+	const QString dir = QFileDialog::getExistingDirectory(this, "Select Build Directory");
+	if (dir.isEmpty()) {
+		rebuildTargets();
+		return;
+	}
+	// directoriesChanged rebuilds the list with dir at the top.
+	m_jobs->rememberDirectory(dir);
+	m_target->setCurrentIndex(0);
+}
+
+BuildRequest BuildToolBar::request() const {
+	BuildRequest request;
+	const int kind = m_target->currentData(kKindRole).toInt();
+	const QString value = m_target->currentData(kValueRole).toString();
+	if (kind == Directory) {
+		request.buildDir = value;
+	} else if (kind == Preset) {
+		request.preset = value;
+		request.sourceDir = m_sourceDir;
+		for (const BuildPreset& preset : m_presets) {
+			if (preset.name == value) request.buildDir = preset.binaryDir;
+		}
+	}
+	request.config = m_config->currentData().toString();
+	request.parallel = m_parallel->value();
+	return request;
+}
+
+QString BuildToolBar::buildDir() const {
+	return request().buildDir;
+}
+
+void BuildToolBar::build() {
+	BuildRequest next = request();
+	if (!next.isValid()) {
+		browse();
+		next = request();
+		if (!next.isValid()) return;
+	}
+	m_jobs->start(next);
+}
+
+void BuildToolBar::updateActions() {
+	const bool running = m_jobs->isRunning();
+	m_cancel->setEnabled(running);
+	m_restart->setEnabled(running || m_jobs->hasLastRequest());
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <QToolBar>
+#include "../build/build_jobs.h"
+
+class QComboBox;
+class QSpinBox;
+
+// Build target, configuration and job count, with build/cancel/restart
+// actions. The target list holds the remembered build directories followed
+// by the build presets of the current source tree.
+class BuildToolBar : public QToolBar {
+	Q_OBJECT
+public:
+	explicit BuildToolBar(BuildJobManager* jobs, QWidget* parent = nullptr);
+
+	void setSourceDir(const QString& dir);
+	BuildRequest request() const;
+	// Build tree of the selected entry, for timing data.
+	QString buildDir() const;
+
+	void build();
+
+private:
+	void rebuildTargets();
+	void browse();
+	void updateActions();
+
+	BuildJobManager* m_jobs;
+	QString m_sourceDir;
+	std::vector<BuildPreset> m_presets;
+	QComboBox* m_target = nullptr;
+	QComboBox* m_config = nullptr;
+	QSpinBox* m_parallel = nullptr;
+	QAction* m_build = nullptr;
+	QAction* m_cancel = nullptr;
+	QAction* m_restart = nullptr;
+};
@@ -0,0 +1,71 @@
+#include "historypanel.h"
+#include "../git/git_history.h"
+#include <QDateTime>
+#include <QHeaderView>
+#include <QTableView>
+
+HistoryModel::HistoryModel(HistoryProvider* provider, QObject* parent) : QAbstractTableModel(parent), m_provider(provider) {
+	connect(provider, &HistoryProvider::aboutToReset, this, [this] { beginResetModel(); });
+	connect(provider, &HistoryProvider::reset, this, [this] { endResetModel(); });
+	connect(provider, &HistoryProvider::rowsAboutToBeAppended, this, [this](qsizetype first, qsizetype last) {
+		beginInsertRows({}, int(first), int(last));
+	});
+	connect(provider, &HistoryProvider::rowsAppended, this, [this] { endInsertRows(); });
+}
+
+int HistoryModel::rowCount(const QModelIndex& parent) const {
+	return parent.isValid() ? 0 : int(m_provider->rowCount());
+}
+
+int HistoryModel::columnCount(const QModelIndex& parent) const {
+	return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant HistoryModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid() || role != Qt::DisplayRole) return {};
+	const CommitRow& row = m_provider->row(index.row());
+	switch (index.column()) {
+	case Summary: return m_provider->string(row.summary);
+	case Author: return m_provider->string(row.author);
+	case Date: return QDateTime::fromSecsSinceEpoch(row.time).toString("yyyy-MM-dd HH:mm");
+	case Commit: return row.shortId();
+	default: return {};
+	}
+}
+
+QVariant HistoryModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return {};
+	switch (section) {
+	case Summary: return QStringLiteral("Summary");
+	case Author: return QStringLiteral("Author");
+	case Date: return QStringLiteral("Date");
+	case Commit: return QStringLiteral("Commit");
+	default: return {};
+	}
+}
+
+bool HistoryModel::canFetchMore(const QModelIndex& parent) const {
+	return !parent.isValid() && !m_provider->atEnd();
+}
+
+void HistoryModel::fetchMore(const QModelIndex& parent) {
+	if (!parent.isValid()) {
+		m_provider->fetchMore();
+	}
+}
+
+HistoryPanel::HistoryPanel(HistoryProvider* provider, QWidget* parent) : QDockWidget("Commit History", parent) {
+	setObjectName("HistoryPanel");
+	m_model = new HistoryModel(provider, this);
+	m_view = new QTableView(this);
+	m_view->setModel(m_model);
+	m_view->setSelectionBehavior(QAbstractItemView::SelectRows);
+	m_view->setShowGrid(false);
+	m_view->setWordWrap(false);
+	// Fixed row heights keep the view from measuring rows it never shows.
+	m_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+	m_view->verticalHeader()->setDefaultSectionSize(m_view->fontMetrics().height() + 4);
+	m_view->verticalHeader()->hide();
+	m_view->horizontalHeader()->setSectionResizeMode(HistoryModel::Summary, QHeaderView::Stretch);
+	setWidget(m_view);
+}
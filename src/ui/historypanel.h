@@ -0,0 +1,33 @@
+#pragma once
+#include <QAbstractTableModel>
+#include <QDockWidget>
+
+class HistoryProvider;
+class QTableView;
+
+class HistoryModel : public QAbstractTableModel {
+	Q_OBJECT
+public:
+	enum Column { Summary, Author, Date, Commit, ColumnCount };
+
+	explicit HistoryModel(HistoryProvider* provider, QObject* parent = nullptr);
+
+	int rowCount(const QModelIndex& parent = {}) const override;
+	int columnCount(const QModelIndex& parent = {}) const override;
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+	bool canFetchMore(const QModelIndex& parent) const override;
+	void fetchMore(const QModelIndex& parent) override;
+
+private:
+	HistoryProvider* m_provider;
+};
+
+class HistoryPanel : public QDockWidget {
+	Q_OBJECT
+public:
+	explicit HistoryPanel(HistoryProvider* provider, QWidget* parent = nullptr);
+private:
+	HistoryModel* m_model = nullptr;
+	QTableView* m_view = nullptr;
+};
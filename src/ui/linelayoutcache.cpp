@@ -0,0 +1,51 @@
+#include "linelayoutcache.h"
+#include <climits>
+
+LineLayoutCache::LineLayoutCache(qsizetype capacity) : m_capacity(capacity) {
+	m_option.setWrapMode(QTextOption::NoWrap);
+}
+
+void LineLayoutCache::setFont(const QFont& font, qreal tabStop) {
+	m_font = font;
+	m_option.setTabStopDistance(tabStop);
+	clear();
+}
+
+void LineLayoutCache::clear() {
+	m_index.clear();
+	m_lru.clear();
+}
+
+const QTextLayout& LineLayoutCache::layout(const QString& text) {
+	const size_t key = qHash(text);
+	auto found = m_index.constFind(key);
+	if (found != m_index.constEnd()) {
+		auto it = *found;
+		// Hash collisions are rare; the text comparison keeps them harmless.
+		if (it->layout->text() == text) {
+			m_lru.splice(m_lru.begin(), m_lru, it);
+			return *it->layout;
+		}
+		m_lru.erase(it);
+		m_index.remove(key);
+	}
+
+	auto layout = std::make_unique<QTextLayout>(text, m_font);
+	layout->setTextOption(m_option);
+	layout->setCacheEnabled(true);
+	layout->beginLayout();
+	QTextLine line = layout->createLine();
+	if (line.isValid()) {
+		line.setLineWidth(qreal(INT_MAX));
+		line.setPosition(QPointF(0, 0));
+	}
+	layout->endLayout();
+
+	m_lru.push_front({key, std::move(layout)});
+	m_index.insert(key, m_lru.begin());
+	while (qsizetype(m_lru.size()) > m_capacity) {
+		m_index.remove(m_lru.back().key);
+		m_lru.pop_back();
+	}
+	return *m_lru.front().layout;
+}
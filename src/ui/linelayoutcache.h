@@ -0,0 +1,34 @@
+#pragma once
+#include <QFont>
+#include <QHash>
+#include <QTextLayout>
+#include <list>
+#include <memory>
+
+// Shaped single-line layouts keyed by line content rather than line number,
+// so scrolling back, or edits that only shift lines, reuse the glyph runs.
+class LineLayoutCache {
+public:
+	explicit LineLayoutCache(qsizetype capacity = 4096);
+
+	void setFont(const QFont& font, qreal tabStop);
+	const QFont& font() const { return m_font; }
+	// The returned layout stays valid until the next call.
+	const QTextLayout& layout(const QString& text);
+	void clear();
+
+	qsizetype size() const { return qsizetype(m_lru.size()); }
+	qsizetype capacity() const { return m_capacity; }
+
+private:
+	struct Entry {
+		size_t key;
+		std::unique_ptr<QTextLayout> layout;
+	};
+
+	std::list<Entry> m_lru;
+	QHash<size_t, std::list<Entry>::iterator> m_index;
+	qsizetype m_capacity;
+	QFont m_font;
+	QTextOption m_option;
+};
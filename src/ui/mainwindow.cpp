@@ -1,5 +1,11 @@
 #include "mainwindow.h"
-#include "editorwidget.h"
+#include "bufferview.h"
+#include "minimap.h"
+#include "perfhud.h"
+#include "workspace.h"
+#include "../util/session_file.h"
+#include "../util/startup_timing.h"
+#include "../util/trace.h"
 
 #include <QMenuBar>
 #include <QStatusBar>
@@ -8,14 +14,178 @@
 #include <QCloseEvent>
 #include <QAction>
 #include <QMenu>
-#include <QProcess>
 #include <QToolBar>
 #include <QVBoxLayout>
+#include <QLabel>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTimer>
+#include <QDateTime>
+#include <QStackedWidget>
+#include <QHBoxLayout>
+#include <QTabBar>
+#include <QSignalBlocker>
+#include <QClipboard>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QProcess>
+#include <QStandardPaths>
 #include "searchbar.h"
+#include "historypanel.h"
+#include "terminalwidget.h"
+#include "buildoutputview.h"
+#include "problemspanel.h"
+#include "buildtoolbar.h"
+#include "buildtimingpanel.h"
+#include "symbolpalette.h"
+#include "../build/build_output.h"
+#include "../build/build_jobs.h"
+#include "../build/build_timing.h"
+#include "../git/git_history.h"
+#include "../pty/pty_session.h"
+#include "../syntax/syntax_highlighter.h"
+#include "../lsp/lsp_client.h"
+#include "../lsp/lsp_document_sync.h"
+#include "../lsp/lsp_positions.h"
 
 MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
-    m_editor = new EditorWidget(this);
-    setCentralWidget(m_editor);
+	m_fsWatcher = new FsWatcher(this);
+	m_workspace = new Workspace(m_fsWatcher, this);
+	m_tabs = new QTabBar(this);
+	m_tabs->setTabsClosable(true);
+	m_tabs->setDocumentMode(true);
+	m_tabs->setExpanding(false);
+	m_views = new QStackedWidget(this);
+	for (int i = 0; i < kViewPool; ++i) {
+		auto* view = new BufferView(this);
+		m_views->addWidget(view);
+		m_pool.push_back({view, nullptr, 0});
+		connect(view, &BufferView::cursorPosChanged, this, [this, view](int line, int col) {
+			if (view != activeView()) return;
+			updateStatusLineCol(line, col);
+			requestHover();
+		});
+		connect(view, &BufferView::modificationChanged, this, [this, view](bool modified) {
+			Document* document = documentOf(view);
+			if (!document) return;
+			document->setModified(modified);
+			updateTab(document);
+			if (view == activeView()) updateWindowModified(modified);
+		});
+		connect(view, &BufferView::textEdited, this, [this, view](const TextDelta& delta) {
+			// Reloads edit documents in views that aren't showing.
+			if (Document* document = documentOf(view)) m_lspSync->changed(document, delta);
+			if (view == activeView()) onTextEdited(delta);
+		});
+		connect(view, &BufferView::firstVisibleLineChanged, this, [this, view] {
+			if (view == activeView()) updateMinimapRange();
+		});
+		// Queued, so the edit that changed it reaches the highlighter and minimap
+		// under the old attachment.
+		connect(view, &BufferView::longLinesChanged, this, [this, view] {
+			Document* document = documentOf(view);
+			if (document && view == activeView()) attachDocument(document);
+		}, Qt::QueuedConnection);
+		connect(view, &BufferView::inputLatency, this, [this](qint64 handledNs, qint64 paintedNs) {
+			m_perfHud->recordInput(handledNs, paintedNs);
+		});
+	}
+	m_minimap = new Minimap(this);
+	auto* central = new QWidget(this);
+	auto* centralLayout = new QVBoxLayout(central);
+	centralLayout->setContentsMargins(0, 0, 0, 0);
+	centralLayout->setSpacing(0);
+	auto* editorLayout = new QHBoxLayout;
+	editorLayout->setSpacing(0);
+	editorLayout->addWidget(m_views, 1);
+	editorLayout->addWidget(m_minimap);
+	centralLayout->addWidget(m_tabs);
+	centralLayout->addLayout(editorLayout, 1);
+    setCentralWidget(central);
+	m_perfHud = new PerfHud(m_workspace, central);
+	m_syntax = new SyntaxHighlighter(this);
+
+	connect(m_minimap, &Minimap::lineActivated, this, [this](qsizetype line) {
+		activeView()->setFirstVisibleLine(line);
+	});
+	m_sessionTimer = new QTimer(this);
+	m_sessionTimer->setSingleShot(true);
+	m_sessionTimer->setInterval(2000);
+	connect(m_sessionTimer, &QTimer::timeout, this, &MainWindow::saveSession);
+	connect(m_tabs, &QTabBar::currentChanged, this, [this](int index) {
+		if (index >= 0 && index < m_workspace->count()) showDocument(m_workspace->at(index));
+		scheduleSessionSave();
+	});
+	connect(m_tabs, &QTabBar::tabCloseRequested, this, [this](int index) {
+		closeDocument(m_workspace->at(index));
+	});
+	connect(m_workspace, &Workspace::hibernated, this, [this](Document* document) {
+		for (PooledView& slot : m_pool) {
+			if (slot.document == document) detachView(slot);
+		}
+		m_lspSync->flush(document);
+	});
+	connect(m_workspace, &Workspace::changedOnDisk, this, &MainWindow::reloadDocument);
+	connect(m_workspace, &Workspace::reloaded, this, &MainWindow::applyReload);
+	connect(m_workspace, &Workspace::reloadFailed, this, [this](Document*, const QString& error) {
+		QMessageBox::warning(this, "Reload failed", error);
+	});
+	connect(m_workspace, &Workspace::saved, this, [this](Document* document, const QString& previousPath) {
+		documentSaved(document, previousPath);
+		if (document->path() != previousPath) {
+			addToRecent(document->path());
+		}
+	});
+	connect(m_workspace, &Workspace::saveFailed, this, [this](Document*, const QString& error) {
+		QMessageBox::warning(this, "Save failed", error);
+	});
+	connect(m_workspace, &Workspace::renamed, this, [this](Document* document) {
+		updateTab(document);
+		m_lspSync->renamed(document);
+		if (document == activeDocument()) {
+			setWindowTitle(QString("%1[*] - IDE").arg(document->displayName()));
+			trackGitPath(document->path());
+		}
+	});
+
+	m_lsp = new LspClient(this);
+	m_lspSync = new LspDocumentSync(m_lsp, this);
+	m_formatLabel = new QLabel(this);
+	statusBar()->addPermanentWidget(m_formatLabel);
+	m_lspLabel = new QLabel(this);
+	statusBar()->addPermanentWidget(m_lspLabel);
+	connect(m_lsp, &LspClient::serverError, this, [this](const QString& message) {
+		statusBar()->showMessage(QString("Language server: %1").arg(message), 5000);
+	});
+	connect(m_lsp, &LspClient::finished, this, [this] {
+		m_hoverId = 0;
+		m_hover.clear();
+		m_diagnostics.clear();
+		updateLspLabel();
+	});
+	connect(m_lsp, &LspClient::responded, this, [this](qint64 id, const QJsonValue& result) {
+		if (id != m_hoverId) return;
+		m_hoverId = 0;
+		// MarkupContent, or the deprecated MarkedString forms.
+		QJsonValue contents = result.toObject().value(QStringLiteral("contents"));
+		if (contents.isArray()) contents = contents.toArray().at(0);
+		const QString text = contents.isObject() ? contents.toObject().value(QStringLiteral("value")).toString() : contents.toString();
+		m_hover = text.trimmed().section(QLatin1Char('\n'), 0, 0);
+		updateLspLabel();
+	});
+	connect(m_lsp, &LspClient::notified, this, [this](const QString& method, const QJsonValue& params) {
+		if (method != QLatin1StringView("textDocument/publishDiagnostics")) return;
+		const QJsonObject object = params.toObject();
+		const QString uri = object.value(QStringLiteral("uri")).toString();
+		const qsizetype count = object.value(QStringLiteral("diagnostics")).toArray().size();
+		if (count > 0) {
+			m_diagnostics.insert(uri, count);
+		} else {
+			m_diagnostics.remove(uri);
+		}
+		updateLspLabel();
+	});
 
     auto fileMenu = menuBar()->addMenu("&File");
     fileMenu->addAction("&New", QKeySequence::New, this, &MainWindow::newFile);
@@ -23,6 +193,7 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     fileMenu->addSeparator();
     fileMenu->addAction("&Save", QKeySequence::Save, this, &MainWindow::saveFile);
     fileMenu->addAction("Save &As…", QKeySequence::SaveAs, this, &MainWindow::saveFileAs);
+    fileMenu->addAction("&Close", QKeySequence::Close, this, &MainWindow::closeFile);
 
     m_recentMenu = fileMenu->addMenu("Open &Recent");
     rebuildRecentMenu();
@@ -30,21 +201,215 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
     fileMenu->addAction("&Exit", QKeySequence::Quit, this, &QWidget::close);
 
 	auto editMenu = menuBar()->addMenu("&Edit");
-	editMenu->addAction("&Undo",  m_editor, &EditorWidget::doUndo,  QKeySequence::Undo);
-	editMenu->addAction("&Redo",  m_editor, &EditorWidget::doRedo,  QKeySequence::Redo);
+	editMenu->addAction("&Undo", QKeySequence::Undo, this, [this] {
+		activeView()->undo();
+	});
+	editMenu->addAction("&Redo", QKeySequence::Redo, this, [this] {
+		activeView()->redo();
+	});
 
-	auto buildBar = addToolBar("Build");
-	buildBar->addAction("Build (Default)", this, &MainWindow::buildDefault);
-	buildBar->addAction("Build Debug", this, &MainWindow::buildDebug);
-	buildBar->addAction("Build Release", this, &MainWindow::buildRelease);
-	buildBar->addAction("Build RelWithDebInfo", this, &MainWindow::buildRelWithDebInfo);
+	m_gitStatus = new GitStatusService(this);
+	m_gitStatus->setWatcher(m_fsWatcher);
+	connect(m_fsWatcher, &FsWatcher::error, this, [this](const QString& message) {
+		statusBar()->showMessage(message, 5000);
+	});
+	m_gitLabel = new QLabel(this);
+	statusBar()->addPermanentWidget(m_gitLabel);
+	connect(m_gitStatus, &GitStatusService::statusChanged, this, &MainWindow::updateGitStatus);
+	m_gutterDiff = new GutterDiffService(this);
+	m_gutterTimer = new QTimer(this);
+	m_gutterTimer->setSingleShot(true);
+	m_gutterTimer->setInterval(100);
+	connect(m_gutterTimer, &QTimer::timeout, this, [this] {
+		Document* document = activeDocument();
+		if (!document || m_gutterPath.isEmpty()) return;
+		m_gutterDiff->update(document->text().snapshot());
+	});
+	connect(m_gutterDiff, &GutterDiffService::hunksChanged, this,
+		[this](const QString& path, DiffHunksPtr hunks, qsizetype version) {
+			// Hunks for a file no longer shown, or for a snapshot edits have
+			// since overtaken; the next update brings the right ones.
+			Document* document = activeDocument();
+			if (!document || path != m_gutterPath) return;
+			if (version >= 0 && version != document->text().version()) return;
+			activeView()->setLineChanges(std::move(hunks));
+		});
+	connect(m_gitStatus, &GitStatusService::statusChanged, m_gutterDiff, &GutterDiffService::reloadBase);
 
+	m_blame = new BlameService(this);
+	m_blameLabel = new QLabel(this);
+	statusBar()->addPermanentWidget(m_blameLabel);
+	m_blameTimer = new QTimer(this);
+	m_blameTimer->setSingleShot(true);
+	m_blameTimer->setInterval(1000);
+	connect(m_blameTimer, &QTimer::timeout, this, [this] {
+		Document* document = activeDocument();
+		if (!document || m_gutterPath.isEmpty()) return;
+		const qsizetype version = document->text().version();
+		if (version == m_blameVersion) return;
+		m_blameVersion = version;
+		m_blame->updateBuffer(document->text().toString());
+	});
+	connect(m_blame, &BlameService::blameChanged, this, &MainWindow::updateBlameLabel);
+	connect(m_blame, &BlameService::headChanged, this, [this] {
+		m_blameVersion = -1;
+		m_blameTimer->start();
+	});
+	connect(m_gitStatus, &GitStatusService::statusChanged, m_blame, &BlameService::reloadHead);
+	connect(m_blame, &BlameService::lineBlameReady, this, [this](qsizetype line, const BlameCommit& commit) {
+		if (line == m_cursorLine) {
+			m_blameLabel->setText(QString("%1, %2 • %3").arg(commit.author,
+				QDateTime::fromSecsSinceEpoch(commit.time).date().toString(Qt::ISODate), commit.summary));
+		}
+	});
+	connect(m_gitStatus, &GitStatusService::repositoryError, this, [this] {
+		m_gitLabel->clear();
+	});
+
+    statusBar()->showMessage("Ready");
+    resize(1000, 700);
+    setWindowTitle("IDE");
+
+	restoreSession();
+	// Docks, tool bars and the search bar wait until the editor is on screen.
+	for (const PooledView& slot : m_pool) {
+		slot.view->viewport()->installEventFilter(this);
+	}
+}
+
+bool MainWindow::eventFilter(QObject* watched, QEvent* event) {
+	if (event->type() == QEvent::Paint && !m_started) {
+		m_started = true;
+		for (const PooledView& slot : m_pool) {
+			slot.view->viewport()->removeEventFilter(this);
+		}
+		// Runs once the frame being painted is out.
+		QTimer::singleShot(0, this, &MainWindow::finishStartup);
+	}
+	return QMainWindow::eventFilter(watched, event);
+}
+
+void MainWindow::finishStartup() {
+	StartupTiming::mark("first paint");
+	createSecondaryWidgets();
+	StartupTiming::mark("ready");
+	statusBar()->showMessage(QString("Started: %1").arg(StartupTiming::summary()), 5000);
+}
+
+void MainWindow::createSecondaryWidgets() {
 	m_buildDock = new QDockWidget("Build Output", this);
-	m_buildOutput = new QPlainTextEdit(m_buildDock);
-	m_buildOutput->setReadOnly(true);
+	m_build = new BuildOutput(this);
+	m_buildOutput = new BuildOutputView(m_build, m_buildDock);
 	m_buildDock->setWidget(m_buildOutput);
 	addDockWidget(Qt::BottomDockWidgetArea, m_buildDock);
 
+	m_jobs = new BuildJobManager(m_build, this);
+	m_buildBar = new BuildToolBar(m_jobs, this);
+	addToolBar(m_buildBar);
+	connect(m_jobs, &BuildJobManager::runningChanged, this, [this](bool running) {
+		if (running) {
+			m_buildDock->show();
+		}
+	});
+
+	m_timing = new BuildTimingService(this);
+	m_timingPanel = new BuildTimingPanel(m_timing, this);
+	addDockWidget(Qt::BottomDockWidgetArea, m_timingPanel);
+	m_timingPanel->hide();
+	connect(m_jobs, &BuildJobManager::jobFinished, this, [this] {
+		const QString buildDir = m_jobs->lastRequest().buildDir;
+		if (!buildDir.isEmpty()) {
+			m_timing->collect(buildDir);
+		}
+	});
+	connect(m_timingPanel, &BuildTimingPanel::refreshRequested, this, [this] {
+		const QString buildDir = m_buildBar->buildDir();
+		if (!buildDir.isEmpty()) {
+			m_timing->collect(buildDir);
+		}
+	});
+	connect(m_timingPanel, &BuildTimingPanel::fileActivated, this, [this](const QString& path) {
+		openLocation(path, 0, 0);
+	});
+
+	m_problems = new ProblemsPanel(m_build, this);
+	addDockWidget(Qt::BottomDockWidgetArea, m_problems);
+	tabifyDockWidget(m_buildDock, m_problems);
+	tabifyDockWidget(m_buildDock, m_timingPanel);
+	m_problems->hide();
+	connect(m_problems, &ProblemsPanel::locationActivated, this,
+		[this](const QString& file, int line, int column, qint64 outputLine) {
+			m_buildOutput->showLine(outputLine);
+			if (!file.isEmpty()) {
+				openLocation(file, line, column);
+			}
+		});
+
+	m_history = new HistoryProvider(this);
+	m_historyPanel = new HistoryPanel(m_history, this);
+	addDockWidget(Qt::RightDockWidgetArea, m_historyPanel);
+	m_historyPanel->hide();
+
+	m_terminalDock = new QDockWidget("Terminal", this);
+	m_terminal = new TerminalWidget(m_terminalDock);
+	m_terminalDock->setWidget(m_terminal);
+	addDockWidget(Qt::BottomDockWidgetArea, m_terminalDock);
+	tabifyDockWidget(m_buildDock, m_terminalDock);
+	m_terminalDock->hide();
+	// The shell is only spawned the first time the terminal is shown.
+	connect(m_terminalDock, &QDockWidget::visibilityChanged, this, [this](bool visible) {
+		if (visible && !m_terminal->isRunning()) {
+			startTerminal();
+		}
+	});
+	connect(m_terminal, &TerminalWidget::titleChanged, this, [this](const QString& title) {
+		m_terminalDock->setWindowTitle(title.isEmpty() ? QStringLiteral("Terminal") : QString("Terminal - %1").arg(title));
+	});
+	connect(m_terminal, &TerminalWidget::finished, this, [this](int exitCode) {
+		statusBar()->showMessage(QString("Terminal exited with code %1").arg(exitCode), 3000);
+		m_terminalDock->setWindowTitle("Terminal");
+	});
+
+	auto viewMenu = menuBar()->addMenu("&View");
+	viewMenu->addAction(m_buildDock->toggleViewAction());
+	viewMenu->addAction(m_problems->toggleViewAction());
+	viewMenu->addAction(m_timingPanel->toggleViewAction());
+	viewMenu->addAction(m_historyPanel->toggleViewAction());
+	viewMenu->addAction(m_terminalDock->toggleViewAction());
+	viewMenu->addSeparator();
+	auto* hudAction = viewMenu->addAction("&Performance Overlay");
+	hudAction->setCheckable(true);
+	connect(hudAction, &QAction::toggled, m_perfHud, &QWidget::setVisible);
+	viewMenu->addAction("Copy Performance Snapshot", this, [this] {
+		QGuiApplication::clipboard()->setText(m_perfHud->snapshot());
+		statusBar()->showMessage("Performance snapshot copied", 3000);
+	});
+	viewMenu->addAction("Reset Performance Counters", m_perfHud, &PerfHud::reset);
+#if defined(IDE_TRACING)
+	auto* startTracing = viewMenu->addAction("Start &Tracing");
+	auto* stopTracing = viewMenu->addAction("Stop Tracing and Save…");
+	startTracing->setEnabled(!Trace::isEnabled());
+	stopTracing->setEnabled(Trace::isEnabled());
+	connect(startTracing, &QAction::triggered, this, [startTracing, stopTracing] {
+		Trace::start();
+		startTracing->setEnabled(false);
+		stopTracing->setEnabled(true);
+	});
+	connect(stopTracing, &QAction::triggered, this, [this, startTracing, stopTracing] {
+		Trace::stop();
+		startTracing->setEnabled(true);
+		stopTracing->setEnabled(false);
+		const QString path = QFileDialog::getSaveFileName(this, "Save Trace", "trace.json", "Chrome trace (*.json)");
+		if (path.isEmpty()) return;
+		QString error;
+		if (!Trace::exportChromeJson(path, &error)) {
+			QMessageBox::warning(this, "Failed to save trace", error);
+			return;
+		}
+		statusBar()->showMessage(QString("Trace saved to %1").arg(path), 3000);
+	});
+#endif
+
 	m_searchBar = new SearchBar(this);
 	m_searchBar->hide();
 	layout()->addWidget(m_searchBar);
@@ -52,8 +417,7 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
 	auto* findAction = new QAction("Find", this);
 	findAction->setShortcut(QKeySequence::Find);
 	connect(findAction, &QAction::triggered, [this] {
-		auto cursor = m_editor->textCursor();
-		QString selectedText = cursor.selectedText();
+		const QString selectedText = activeView()->selectedText();
 		m_searchBar->show();
 		m_searchBar->setFocus();
 		if (!selectedText.isEmpty()) {
@@ -63,65 +427,379 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
 	addAction(findAction);
 
 	connect(m_searchBar, &SearchBar::searchChanged, this, [this](const QString& text) {
-		m_searcher.setText(m_editor->toPlainText());
-		m_results = m_searcher.findAll(text, Qt::CaseInsensitive);
-		m_editor->setSearchResults(m_results);
-
-		m_currentResult = m_results.isEmpty() ? -1 : 0;
-		m_editor->selectSearchResult(m_currentResult);
+		const quint64 ticket = ++m_searchTicket;
+		Document* document = activeDocument();
+		// The worker gets its own copy of the text, dropped once the search is done.
+		m_searchTask.submit([this, ticket, document, text, contents = document->text().toString()](const CancelToken&) {
+			SearchMatchesPtr results = DocumentSearcher::findAll(contents, text, Qt::CaseInsensitive);
+			TaskScheduler::postTo(this, [this, ticket, document, results] {
+				if (ticket != m_searchTicket || document != activeDocument()) return;
+				showSearchResults(results);
+			});
+		});
 	});
 
 	connect(m_searchBar, &SearchBar::next, this, [this] {
-		if (m_results.isEmpty()) return;
-		m_currentResult = (m_currentResult + 1) % m_results.size();
-		m_editor->selectSearchResult(m_currentResult);
+		if (!m_results || m_results->isEmpty()) return;
+		m_currentResult = m_results->firstAtOrAfter(activeView()->selectionStart() + 1);
+		if (m_currentResult >= m_results->size()) m_currentResult = 0;
+		activeView()->selectSearchResult(m_currentResult);
 	});
 	connect(m_searchBar, &SearchBar::previous, this, [this] {
-		if (m_results.isEmpty()) return;
-		m_currentResult = (m_currentResult - 1 + m_results.size()) % m_results.size();
-		m_editor->selectSearchResult(m_currentResult);
+		if (!m_results || m_results->isEmpty()) return;
+		m_currentResult = m_results->lastBefore(activeView()->selectionStart());
+		if (m_currentResult < 0) m_currentResult = m_results->size() - 1;
+		activeView()->selectSearchResult(m_currentResult);
+	});
+	connect(m_searchBar, &SearchBar::searchClosed, this, [this] {
+		activeView()->clearSearchHighlights();
 	});
-	connect(m_searchBar, &SearchBar::searchClosed, m_editor, &EditorWidget::clearSearchHighlights); 
 
-    statusBar()->showMessage("Ready");
-    resize(1000, 700);
-    setWindowTitle("IDE");
+	m_symbols = new SymbolIndex(this);
+	m_symbols->setWatcher(m_fsWatcher);
+	connect(m_symbols, &SymbolIndex::indexError, this, [this](const QString& message) {
+		statusBar()->showMessage(QString("Symbol index: %1").arg(message), 5000);
+	});
+	m_symbolPalette = new SymbolPalette(m_symbols, this);
+	m_symbolPalette->hide();
+	connect(m_symbolPalette, &SymbolPalette::locationActivated, this, &MainWindow::openLocation);
+
+	auto* symbolAction = new QAction("Go to Symbol…", this);
+	symbolAction->setShortcut(QKeySequence(Qt::CTRL | Qt::Key_T));
+	connect(symbolAction, &QAction::triggered, this, [this] {
+		m_symbolPalette->popup(activeView()->selectedText());
+	});
+	addAction(symbolAction);
+
+	connect(m_gitStatus, &GitStatusService::repositoryOpened, m_history, &HistoryProvider::open);
+	connect(m_gitStatus, &GitStatusService::repositoryOpened, m_buildBar, &BuildToolBar::setSourceDir);
+	connect(m_gitStatus, &GitStatusService::repositoryOpened, m_symbols, &SymbolIndex::open);
+	// The repository of a restored document may have opened already.
+	if (!m_gitStatus->workdir().isEmpty()) {
+		m_history->open(m_gitStatus->workdir());
+		m_buildBar->setSourceDir(m_gitStatus->workdir());
+		m_symbols->open(m_gitStatus->workdir());
+	}
+}
+
+BufferView* MainWindow::activeView() const {
+	return static_cast<BufferView*>(m_views->currentWidget());
+}
+
+Document* MainWindow::activeDocument() const {
+	return m_workspace->active();
+}
+
+Document* MainWindow::documentOf(const BufferView* view) const {
+	for (const PooledView& slot : m_pool) {
+		if (slot.view == view) return slot.document;
+	}
+	return nullptr;
+}
+
+BufferView* MainWindow::viewOf(const Document* document) const {
+	for (const PooledView& slot : m_pool) {
+		if (slot.document == document) return slot.view;
+	}
+	return nullptr;
+}
+
+QString MainWindow::currentPath() const {
+	return activeDocument() ? activeDocument()->path() : QString();
+}
+
+void MainWindow::detachView(PooledView& slot) {
+	if (!slot.document) return;
+	slot.document->viewState = {slot.view->cursorPosition(), slot.view->anchorPosition(), slot.view->firstVisibleLine()};
+	slot.view->setHighlighter(nullptr);
+	slot.view->setBuffer(nullptr);
+	slot.document = nullptr;
+}
+
+void MainWindow::showDocument(Document* document) {
+	BufferView* previous = activeView();
+	auto slot = std::find_if(m_pool.begin(), m_pool.end(), [&](const PooledView& s) { return s.document == document; });
+	if (slot != m_pool.end() && slot->view == previous && document == activeDocument()) {
+		return;
+	}
+	m_workspace->activate(document);
+	if (slot == m_pool.end()) {
+		slot = std::min_element(m_pool.begin(), m_pool.end(),
+			[](const PooledView& a, const PooledView& b) { return a.used < b.used; });
+		detachView(*slot);
+	}
+	slot->used = ++m_poolClock;
+	m_views->setCurrentWidget(slot->view);
+	if (!slot->document) {
+		slot->document = document;
+		const Document::ViewState state = document->viewState;
+		slot->view->setBuffer(&document->text(), &document->undo());
+		slot->view->setModified(document->isModified());
+		slot->view->setCursorPosition(state.anchor);
+		slot->view->setCursorPosition(state.cursor, true);
+		slot->view->setFirstVisibleLine(state.firstLine);
+	}
+	if (previous && previous != slot->view) {
+		previous->setHighlighter(nullptr);
+		previous->clearSearchHighlights();
+	}
+	m_results.reset();
+	m_currentResult = -1;
+	++m_searchTicket;
+	m_searchTask.cancel();
+	updateSearchMemory();
+
+	const qsizetype index = m_workspace->indexOf(document);
+	if (m_tabs->currentIndex() != index) {
+		m_tabs->setCurrentIndex(int(index));
+	}
+	attachDocument(document);
+	updateWindowModified(document->isModified());
+	setWindowTitle(QString("%1[*] - IDE").arg(document->displayName()));
+	trackGitPath(document->path());
+	updateGitStatus();
+	openWithLanguageServer(document);
+	if (m_hoverId) {
+		m_lsp->cancel(m_hoverId);
+		m_hoverId = 0;
+	}
+	m_hover.clear();
+	updateLspLabel();
+}
+
+void MainWindow::attachDocument(Document* document) {
+	activeView()->setHighlighter(m_syntax);
+	// Both copy each edited line whole, which a long line makes too slow.
+	const bool plain = activeView()->hasLongLines();
+	m_syntax->setDocument(plain ? nullptr : syntaxForFile(document->path()), &document->text());
+	m_minimap->setDocument(plain ? nullptr : &document->text());
+	updateMinimapRange();
+	updateTextFormat();
+}
+
+void MainWindow::updateMinimapRange() {
+	m_minimap->setVisibleRange(activeView()->firstVisibleLine(), activeView()->visibleLineCount());
+}
+
+void MainWindow::updateTextFormat() {
+	const Document* document = activeDocument();
+	if (!document) return;
+	const TextEncoding::Format& format = document->diskState().format;
+	activeView()->setLineBreak(format.lineBreak());
+	m_formatLabel->setText(format.description());
+}
+
+void MainWindow::onTextEdited(const TextDelta& delta) {
+	m_minimap->applyDelta(delta);
+	if (m_gutterPath.isEmpty()) return;
+	m_gutterDiff->applyDelta(delta);
+	m_gutterTimer->start();
+	m_blame->applyDelta(delta);
+	m_blameTimer->start();
+}
+
+void MainWindow::updateTab(Document* document) {
+	const qsizetype index = m_workspace->indexOf(document);
+	if (index < 0) return;
+	m_tabs->setTabText(int(index), document->displayName() + (document->isModified() ? "*" : ""));
+	m_tabs->setTabToolTip(int(index), document->path());
+}
+
+bool MainWindow::openPath(const QString& path, QString* error) {
+	Document* document = m_workspace->find(path);
+	if (!document) {
+		document = m_workspace->open(path, error);
+		if (!document) {
+			return false;
+		}
+		m_tabs->addTab(document->displayName());
+		updateTab(document);
+	}
+	showDocument(document);
+	return true;
+}
+
+bool MainWindow::saveDocument(Document* document, const QString& path) {
+	const QString previousPath = document->path();
+	QString error;
+	if (!m_workspace->save(document, path, &error)) {
+		QMessageBox::warning(this, "Save failed", error);
+		return false;
+	}
+	documentSaved(document, previousPath);
+	return true;
+}
 
-    connect(m_editor, &EditorWidget::cursorPosChanged, this, &MainWindow::updateStatusLineCol);
-    connect(m_editor, &EditorWidget::dirtyChanged, this, &MainWindow::updateWindowModified);
+void MainWindow::documentSaved(Document* document, const QString& previousPath) {
+	const QString path = document->path();
+	// The view's flag drives the tab and the window; it updates the document
+	// too. Edits made while a background save was writing keep it set.
+	if (BufferView* view = viewOf(document); view && !document->isModified()) {
+		view->setModified(false);
+	}
+	updateTab(document);
+	// A new path is a new document to the server, opened with the text as saved.
+	m_lspSync->renamed(document);
+	m_lspSync->saved(document);
+	if (document == activeDocument()) {
+		openWithLanguageServer(document);
+		setWindowTitle(QString("%1[*] - IDE").arg(document->displayName()));
+		if (syntaxForFile(path) != syntaxForFile(previousPath)) {
+			attachDocument(document);
+		}
+		updateTextFormat();
+		trackGitPath(path);
+	}
 }
 
-bool MainWindow::maybeSave() {
-    if (!isWindowModified()) {
+void MainWindow::reloadDocument(Document* document) {
+	if (document->isModified()) {
+		auto ret = QMessageBox::question(this, "File changed",
+			QString("The file \"%1\" has changed on disk.\nReload it?").arg(document->displayName()),
+			QMessageBox::Yes | QMessageBox::No,
+			QMessageBox::Yes);
+		if (ret != QMessageBox::Yes) {
+			return;
+		}
+	}
+	m_workspace->reload(document);
+}
+
+void MainWindow::applyReload(Document* document, const std::vector<TextPatch>& patches) {
+	// As edits, so the view, highlighter and minimap only redo what changed.
+	BufferView* view = viewOf(document);
+	for (const TextPatch& patch : patches) {
+		if (view) {
+			view->replaceRange(patch.pos, patch.removed, patch.text);
+		} else {
+			document->replace(patch.pos, patch.removed, patch.text);
+		}
+	}
+	if (!view) {
+		m_lspSync->reset(document);
+	}
+	if (view) {
+		view->setModified(false);
+	} else {
+		document->setModified(false);
+	}
+	updateTab(document);
+	if (document == activeDocument()) updateTextFormat();
+}
+
+bool MainWindow::closeDocument(Document* document) {
+	if (!maybeSave(document)) {
+		return false;
+	}
+	for (PooledView& slot : m_pool) {
+		if (slot.document == document) detachView(slot);
+	}
+	m_lspSync->close(document);
+	const qsizetype index = m_workspace->indexOf(document);
+	m_workspace->close(document);
+	// Removing the current tab selects a neighbour, which shows its document.
+	m_tabs->removeTab(int(index));
+	if (m_workspace->count() == 0) {
+		newFile();
+	}
+	scheduleSessionSave();
+	return true;
+}
+
+bool MainWindow::maybeSave(Document* document) {
+    if (!document->isModified()) {
 	return true;
     }
+	showDocument(document);
     auto decision = QMessageBox::question(this, "Unsaved changes",
-        "Save changes before closing?",
+        QString("Save changes to \"%1\" before closing?").arg(document->displayName()),
         QMessageBox::Yes|QMessageBox::No|QMessageBox::Cancel,
         QMessageBox::Yes);
     if (decision == QMessageBox::Cancel) {
 	return false;
     }
     if (decision == QMessageBox::Yes) {
-        if (m_editor->filePath().isEmpty()) {
-            return doSaveAs(nullptr);
-	}
-        QString error;
-        if (!m_editor->saveToFile(m_editor->filePath(), &error)) {
-            QMessageBox::warning(this, "Save failed", error);
-            return false;
-        }
+        if (document->path().isEmpty()) {
+            return doSaveAs(document, nullptr);
+	}
+        return saveDocument(document, document->path());
     }
     return true;
 }
 
 void MainWindow::closeEvent(QCloseEvent* ev) {
-    if (maybeSave()) {
+	for (qsizetype i = 0; i < m_workspace->count(); ++i) {
+		if (!maybeSave(m_workspace->at(i))) {
+			ev->ignore();
+			return;
+		}
+	}
+	m_sessionTimer->stop();
+	saveSession();
+	m_lsp->stop();
 	ev->accept();
-    }
-    else {
-	ev->ignore();
-    }
+}
+
+void MainWindow::restoreSession() {
+	IDE_TRACE_SPAN("MainWindow::restoreSession");
+	Session session;
+	// No session yet is the usual first run; a damaged one is started over.
+	if (!SessionFile::read(SessionFile::defaultPath(), &session)) {
+		newFile();
+		StartupTiming::mark("session");
+		return;
+	}
+	m_recent = session.recent;
+	rebuildRecentMenu();
+	Document* active = nullptr;
+	{
+		// Adding the first tab would otherwise show, and read, that document.
+		const QSignalBlocker blocker(m_tabs);
+		for (qsizetype i = 0; i < qsizetype(session.documents.size()); ++i) {
+			const SessionDocument& entry = session.documents[std::size_t(i)];
+			if (!QFileInfo::exists(entry.path)) continue;
+			const bool shown = i == session.active;
+			Document* document = shown ? m_workspace->open(entry.path) : m_workspace->openDeferred(entry.path);
+			if (!document) continue;
+			document->viewState = {qsizetype(entry.cursor), qsizetype(entry.anchor), qsizetype(entry.firstLine)};
+			m_tabs->addTab(document->displayName());
+			updateTab(document);
+			if (shown) active = document;
+		}
+	}
+	if (m_workspace->count() == 0) {
+		newFile();
+	} else {
+		showDocument(active ? active : m_workspace->at(0));
+	}
+	StartupTiming::mark("session");
+}
+
+void MainWindow::saveSession() {
+	Session session;
+	for (qsizetype i = 0; i < m_workspace->count(); ++i) {
+		Document* document = m_workspace->at(i);
+		if (document->path().isEmpty()) continue;
+		Document::ViewState state = document->viewState;
+		if (const BufferView* view = viewOf(document)) {
+			state = {view->cursorPosition(), view->anchorPosition(), view->firstVisibleLine()};
+		}
+		if (document == activeDocument()) {
+			session.active = qint32(session.documents.size());
+		}
+		session.documents.push_back({document->path(), state.cursor, state.anchor, state.firstLine});
+	}
+	session.recent = m_recent;
+	QString error;
+	if (!SessionFile::write(SessionFile::defaultPath(), session, &error)) {
+		statusBar()->showMessage(QString("Failed to save session: %1").arg(error), 5000);
+	}
+}
+
+void MainWindow::scheduleSessionSave() {
+	if (!m_sessionTimer->isActive()) {
+		m_sessionTimer->start();
+	}
 }
 
 void MainWindow::addToRecent(const QString& path) {
@@ -131,6 +809,7 @@ void MainWindow::addToRecent(const QString& path) {
 	m_recent.removeLast();
     }
     rebuildRecentMenu();
+	scheduleSessionSave();
 }
 
 void MainWindow::rebuildRecentMenu() {
@@ -144,57 +823,204 @@ void MainWindow::rebuildRecentMenu() {
     }
 }
 
+void MainWindow::showSearchResults(SearchMatchesPtr results) {
+	m_results = std::move(results);
+	activeView()->setSearchResults(m_results);
+	updateSearchMemory();
+
+	if (m_results->isEmpty()) {
+		m_currentResult = -1;
+		return;
+	}
+	m_currentResult = m_results->firstAtOrAfter(activeView()->selectionStart());
+	if (m_currentResult >= m_results->size()) m_currentResult = 0;
+	activeView()->selectSearchResult(m_currentResult);
+}
+
+void MainWindow::updateSearchMemory() {
+	const qsizetype results = m_results ? qsizetype(m_results->memoryUsage()) : 0;
+	m_perfHud->setSearchMemory(results);
+}
+
 void MainWindow::updateStatusLineCol(int line, int col) {
     statusBar()->showMessage(QString("Ln %1, Col %2").arg(line).arg(col), 2000);
+	m_cursorLine = line - 1;
+	updateBlameLabel();
+}
+
+void MainWindow::updateBlameLabel() {
+	const BlameCommit* commit = m_blame->commitForLine(m_cursorLine);
+	if (!commit) {
+		m_blameLabel->clear();
+		if (!m_blame->isReady()) {
+			m_blame->requestLine(m_cursorLine);
+		}
+		return;
+	}
+	m_blameLabel->setText(QString("%1, %2 • %3").arg(commit->author,
+		QDateTime::fromSecsSinceEpoch(commit->time).date().toString(Qt::ISODate), commit->summary));
 }
 
 void MainWindow::updateWindowModified(bool dirty) {
     setWindowModified(dirty);
 }
 
+void MainWindow::trackGitPath(const QString& path) {
+	const QString absolute = path.isEmpty() ? QString() : QFileInfo(path).absoluteFilePath();
+	Document* document = activeDocument();
+	const bool large = !document || document->text().size() > kLargeDocumentChars;
+	const QString tracked = large ? QString() : absolute;
+	if (tracked != m_gutterPath) {
+		m_gutterPath = tracked;
+		m_gutterTimer->stop();
+		m_gutterDiff->setFile(tracked);
+		m_blame->setFile(tracked);
+		m_blameVersion = -1;
+		if (!tracked.isEmpty()) {
+			m_gutterDiff->update(document->text().snapshot());
+			m_blameTimer->start();
+		}
+	}
+	if (absolute.isEmpty()) {
+		return;
+	}
+	const QString workdir = m_gitStatus->workdir();
+	if (workdir.isEmpty() || !absolute.startsWith(workdir)) {
+		m_gitStatus->open(QFileInfo(absolute).absolutePath());
+		return;
+	}
+	m_gitStatus->pathsChanged({absolute});
+}
+
+void MainWindow::openWithLanguageServer(Document* document) {
+	if (m_lspSync->isOpen(document) || document->path().isEmpty()) return;
+	if (LspDocumentSync::languageId(document->path()).isEmpty()) return;
+	if (!m_lsp->isRunning()) {
+		if (m_lspUnavailable) return;
+		QStringList command = QProcess::splitCommand(qEnvironmentVariable("IDE_LSP_SERVER"));
+		if (command.isEmpty()) {
+			const QString clangd = QStandardPaths::findExecutable(QStringLiteral("clangd"));
+			if (clangd.isEmpty()) {
+				m_lspUnavailable = true;
+				return;
+			}
+			command = {clangd};
+		}
+		const QString fileDir = QFileInfo(document->path()).absolutePath();
+		const QString workdir = m_gitStatus->workdir();
+		const QString program = command.takeFirst();
+		m_lsp->start(program, command, !workdir.isEmpty() && fileDir.startsWith(workdir) ? workdir : fileDir);
+	}
+	m_lspSync->open(document);
+}
+
+void MainWindow::requestHover() {
+	Document* document = activeDocument();
+	if (!document || !m_lspSync->isOpen(document)) return;
+	// Pending changes go out well before the request does, so the server will
+	// have the text the position is in.
+	m_hover.clear();
+	updateLspLabel();
+	m_hoverId = m_lsp->request(QStringLiteral("textDocument/hover"), {
+		{QStringLiteral("textDocument"), QJsonObject{{QStringLiteral("uri"), m_lspSync->uriOf(document)}}},
+		{QStringLiteral("position"), LspPositions::fromOffset(document->text(), activeView()->cursorPosition())},
+	}, QStringLiteral("hover"), 300);
+}
+
+void MainWindow::updateLspLabel() {
+	QStringList parts;
+	if (Document* document = activeDocument()) {
+		if (const qsizetype count = m_diagnostics.value(m_lspSync->uriOf(document))) {
+			parts << QString("%1 diagnostic%2").arg(count).arg(count == 1 ? "" : "s");
+		}
+	}
+	if (!m_hover.isEmpty()) {
+		parts << m_hover;
+	}
+	m_lspLabel->setText(parts.join(" • "));
+}
+
+void MainWindow::startTerminal() {
+	if (!pty_is_supported()) {
+		statusBar()->showMessage("Terminal is not supported on this platform", 3000);
+		return;
+	}
+	QString shell = qEnvironmentVariable("SHELL");
+	if (shell.isEmpty()) {
+		shell = QStringLiteral("/bin/sh");
+	}
+	QString dir = m_gitStatus->workdir();
+	if (dir.isEmpty()) {
+		dir = QDir::currentPath();
+	}
+	QString error;
+	if (!m_terminal->start(shell, {}, dir, &error)) {
+		QMessageBox::warning(this, "Failed to start terminal", error);
+		return;
+	}
+	m_terminal->setFocus();
+}
+
+void MainWindow::updateGitStatus() {
+	const GitStatusSnapshotPtr snap = m_gitStatus->snapshot();
+	if (!snap) {
+		m_gitLabel->clear();
+		return;
+	}
+	QString text = QString("git: %1 changed").arg(snap->entries.size());
+	const QString path = currentPath();
+	if (!path.isEmpty()) {
+		const QString rel = QDir(snap->workdir).relativeFilePath(QFileInfo(path).absoluteFilePath());
+		const unsigned flags = snap->statusOf(rel);
+		if (flags & (GitStatusWorktreeNew | GitStatusIndexNew)) {
+			text.prepend("A  ");
+		} else if (flags & GitStatusConflicted) {
+			text.prepend("C  ");
+		} else if (flags != GitStatusCurrent) {
+			text.prepend("M  ");
+		}
+	}
+	m_gitLabel->setText(text);
+}
+
 void MainWindow::newFile() {
-    if (!maybeSave()) {
-	return;
-    }
-    m_editor->setPlainText({});
-    m_editor->setFilePath({});
+	Document* document = m_workspace->open({});
+	m_tabs->addTab(document->displayName());
+	showDocument(document);
 }
 
 void MainWindow::openFile() {
-    if (!maybeSave()) {
-	return;
-    }
     QString path = QFileDialog::getOpenFileName(this, "Open file");
     if (path.isEmpty()) {
 	return;
     }
     QString error;
-    if (!m_editor->loadFromFile(path, &error)) {
+    if (!openPath(path, &error)) {
         QMessageBox::warning(this, "Failed to open file", error);
         return;
     }
     addToRecent(path);
 }
 
+void MainWindow::closeFile() {
+	closeDocument(activeDocument());
+}
+
 void MainWindow::saveFile() {
-    if (m_editor->filePath().isEmpty()) {
+    const QString path = currentPath();
+    if (path.isEmpty()) {
         saveFileAs();
         return;
     }
-    QString error;
-    if (!m_editor->saveToFile(m_editor->filePath(), &error)) {
-        QMessageBox::warning(this, "Save failed", error);
-    }
+	m_workspace->saveInBackground(activeDocument(), path);
 }
 
-bool MainWindow::doSaveAs(QString* outPath) {
+bool MainWindow::doSaveAs(Document* document, QString* outPath) {
     QString path = QFileDialog::getSaveFileName(this, "Save As");
     if (path.isEmpty()) {
 	return false;
     }
-    QString error;
-    if (!m_editor->saveToFile(path, &error)) {
-        QMessageBox::warning(this, "Save failed", error);
+    if (!saveDocument(document, path)) {
         return false;
     }
     addToRecent(path);
@@ -205,7 +1031,11 @@ bool MainWindow::doSaveAs(QString* outPath) {
 }
 
 void MainWindow::saveFileAs() {
-    doSaveAs(nullptr);
+    const QString path = QFileDialog::getSaveFileName(this, "Save As");
+    if (path.isEmpty()) {
+	return;
+    }
+    m_workspace->saveInBackground(activeDocument(), path);
 }
 
 void MainWindow::openRecent() {
@@ -213,68 +1043,31 @@ void MainWindow::openRecent() {
     if (!action) {
 	return;
     }
-    if (!maybeSave()) {
-	return;
-    }
     QString path = action->data().toString();
     if (path.isEmpty()) {
 	return;
     }
     QString error;
-    if (!m_editor->loadFromFile(path, &error)) {
+    if (!openPath(path, &error)) {
         QMessageBox::warning(this, "Failed to open file", error);
+        return;
     }
+    addToRecent(path);
 }
 
-void MainWindow::buildDefault() {
-	runBuild(QString());
-}
-
-void MainWindow::buildDebug() {
-	runBuild("Debug");
-}
-
-void MainWindow::buildRelease() {
-	runBuild("Release");
-}
-
-void MainWindow::buildRelWithDebInfo() {
-	runBuild("RelWithDebInfo");
-}
-
-void MainWindow::runBuild(const QString& buildType) {
-    QString buildDir = QFileDialog::getExistingDirectory(this, "Select Build Directory");
-    QString program = "cmake";
-    QStringList args = {"--build", buildDir};
-
-    if (!buildType.isEmpty()) {
-        args << "--config" << buildType;
-    }
-	m_buildOutput->clear();
-    m_buildOutput->appendPlainText(QString("Running: %1 %2\n")
-                          .arg(program, args.join(' ')));
-
-    auto *proc = new QProcess(this);
-	proc->setWorkingDirectory(buildDir);
-    proc->setProcessChannelMode(QProcess::MergedChannels);
-    connect(proc, &QProcess::readyReadStandardOutput, this, [this, proc] {
-		m_buildOutput->moveCursor(QTextCursor::End);
-        m_buildOutput->insertPlainText(QString::fromLocal8Bit(proc->readAllStandardOutput()));
-        m_buildOutput->moveCursor(QTextCursor::End);
-    });
-    connect(proc, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, [this, proc](int code, QProcess::ExitStatus status) {
-        if (status == QProcess::NormalExit && code == 0) {
-            m_buildOutput->appendPlainText("\nBuild finished successfully.");
-        } else {
-            m_buildOutput->appendPlainText("\nBuild failed");
-        }
-		proc->deleteLater();
-    });
-
-    proc->start(program, args);
-    if (!proc->waitForStarted()) {
-        m_buildOutput->appendPlainText("Could not start cmake \n");
-        proc->deleteLater();
-    }
+void MainWindow::openLocation(const QString& path, int line, int column) {
+	if (!m_workspace->find(path)) {
+		QString error;
+		if (!openPath(path, &error)) {
+			QMessageBox::warning(this, "Failed to open file", error);
+			return;
+		}
+		addToRecent(path);
+	} else {
+		showDocument(m_workspace->find(path));
+	}
+	if (line > 0) {
+		activeView()->goToLine(line, column);
+	}
+	activeView()->setFocus();
 }
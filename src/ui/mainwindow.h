@@ -1,51 +1,184 @@
 #pragma once
 #include <QMainWindow>
 #include <QDockWidget>
-#include <QPlainTextEdit>
+#include <QHash>
+#include <vector>
 #include "../search/DocumentSearcher.h"
-class EditorWidget;
+#include "../git/git_status.h"
+#include "../git/gutter_diff.h"
+#include "../git/git_blame.h"
+#include "../buffer/document.h"
+class BufferView;
+class Workspace;
+class QStackedWidget;
+class QTabBar;
 class SearchBar;
+class HistoryProvider;
+class HistoryPanel;
+class TerminalWidget;
+class BuildOutput;
+class BuildOutputView;
+class ProblemsPanel;
+class BuildJobManager;
+class BuildToolBar;
+class BuildTimingService;
+class BuildTimingPanel;
+class SyntaxHighlighter;
+class Minimap;
+class PerfHud;
+class LspClient;
+class LspDocumentSync;
+class SymbolIndex;
+class SymbolPalette;
+class QLabel;
+class QTimer;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 private:
-    bool maybeSave();
-    bool doSaveAs(QString* outPath=nullptr);
+    bool maybeSave(Document* document);
+    bool doSaveAs(Document* document, QString* outPath=nullptr);
     void addToRecent(const QString& path);
     void rebuildRecentMenu();
+	// Reopens the last session's documents, reading only the active one now.
+	void restoreSession();
+	void saveSession();
+	// Saves the session once things settle, on a timer; closing saves at once.
+	void scheduleSessionSave();
+	QTimer* m_sessionTimer = nullptr;
+	void finishStartup();
+	// Everything not needed to show the editor, made after its first frame.
+	void createSecondaryWidgets();
+	bool m_started = false;
 
-    EditorWidget* m_editor = nullptr;
     QStringList m_recent;
     QMenu* m_recentMenu = nullptr;
 
-	void runBuild(const QString& buildType);
+	// Tabs show the workspace's documents in order. A few views are shared by
+	// all tabs; each keeps the document it showed last, so going back to a
+	// recent tab doesn't reshape its lines.
+	static constexpr int kViewPool = 3;
+	struct PooledView {
+		BufferView* view = nullptr;
+		Document* document = nullptr;
+		quint64 used = 0;
+	};
+	FsWatcher* m_fsWatcher = nullptr;
+	Workspace* m_workspace = nullptr;
+	QTabBar* m_tabs = nullptr;
+	QStackedWidget* m_views = nullptr;
+	std::vector<PooledView> m_pool;
+	quint64 m_poolClock = 0;
+
+	BufferView* activeView() const;
+	Document* activeDocument() const;
+	Document* documentOf(const BufferView* view) const;
+	BufferView* viewOf(const Document* document) const;
+	QString currentPath() const;
+	void detachView(PooledView& slot);
+	void showDocument(Document* document);
+	bool openPath(const QString& path, QString* error);
+	// Writes on the spot, for closing; saveFile() and saveFileAs() write on the
+	// task scheduler.
+	bool saveDocument(Document* document, const QString& path);
+	void documentSaved(Document* document, const QString& previousPath);
+	bool closeDocument(Document* document);
+	void reloadDocument(Document* document);
+	void applyReload(Document* document, const std::vector<TextPatch>& patches);
+	void updateTab(Document* document);
+	void onTextEdited(const TextDelta& delta);
+
+	SyntaxHighlighter* m_syntax = nullptr;
+	Minimap* m_minimap = nullptr;
+	QLabel* m_formatLabel = nullptr;
+	// Points the highlighter and the minimap at the active document.
+	void attachDocument(Document* document);
+	void updateMinimapRange();
+	// The encoding and line breaks of the active document.
+	void updateTextFormat();
+
+	PerfHud* m_perfHud = nullptr;
+	void updateSearchMemory();
 
 	QDockWidget* m_buildDock = nullptr;
-    QPlainTextEdit*   m_buildOutput = nullptr;
+	BuildOutput* m_build = nullptr;
+	BuildOutputView* m_buildOutput = nullptr;
+	ProblemsPanel* m_problems = nullptr;
+	BuildJobManager* m_jobs = nullptr;
+	BuildToolBar* m_buildBar = nullptr;
+	BuildTimingService* m_timing = nullptr;
+	BuildTimingPanel* m_timingPanel = nullptr;
 
-	DocumentSearcher m_searcher;
-	QVector<SearchResult> m_results;
-	int m_currentResult = -1;
+	void openLocation(const QString& path, int line, int column);
+
+	void showSearchResults(SearchMatchesPtr results);
+	SearchMatchesPtr m_results;
+	qsizetype m_currentResult = -1;
 	SearchBar* m_searchBar = nullptr;
+	// Searches as the query is typed, off the GUI thread; results of an older
+	// query or another document are dropped.
+	LatestTask m_searchTask{TaskPriority::Interactive};
+	quint64 m_searchTicket = 0;
+
+	SymbolIndex* m_symbols = nullptr;
+	SymbolPalette* m_symbolPalette = nullptr;
+
+	void trackGitPath(const QString& path);
+	// Gutter diff and blame work on full copies of the text, so larger documents go without.
+	static constexpr qsizetype kLargeDocumentChars = 8 * 1024 * 1024;
+
+	GitStatusService* m_gitStatus = nullptr;
+	QLabel* m_gitLabel = nullptr;
+	GutterDiffService* m_gutterDiff = nullptr;
+	QTimer* m_gutterTimer = nullptr;
+	QString m_gutterPath;
+	BlameService* m_blame = nullptr;
+	QLabel* m_blameLabel = nullptr;
+	QTimer* m_blameTimer = nullptr;
+	// The document version last sent to updateBuffer().
+	qsizetype m_blameVersion = -1;
+	qsizetype m_cursorLine = 0;
+	HistoryProvider* m_history = nullptr;
+	HistoryPanel* m_historyPanel = nullptr;
+
+	void startTerminal();
+
+	QDockWidget* m_terminalDock = nullptr;
+	TerminalWidget* m_terminal = nullptr;
+
+	// Starts the language server for the document's language, if there is one
+	// and it isn't running, and opens the document with it.
+	void openWithLanguageServer(Document* document);
+	void requestHover();
+	void updateLspLabel();
+
+	LspClient* m_lsp = nullptr;
+	LspDocumentSync* m_lspSync = nullptr;
+	// Set once no server could be found, so it isn't looked for on every tab switch.
+	bool m_lspUnavailable = false;
+	QLabel* m_lspLabel = nullptr;
+	qint64 m_hoverId = 0;
+	QString m_hover;
+	// Diagnostics per document URI, as last published.
+	QHash<QString, qsizetype> m_diagnostics;
 
 public:
     explicit MainWindow(QWidget* parent = nullptr);
 
 protected:
     void closeEvent(QCloseEvent* ev) override;
+	bool eventFilter(QObject* watched, QEvent* event) override;
 
 private slots:
     void newFile();
     void openFile();
+    void closeFile();
     void saveFile();
     void saveFileAs();
     void openRecent();
 
     void updateStatusLineCol(int line,int col);
     void updateWindowModified(bool dirty);
-
-	void buildDefault();
-    void buildDebug();
-    void buildRelease();
-    void buildRelWithDebInfo();
+	void updateGitStatus();
+	void updateBlameLabel();
 };
\ No newline at end of file
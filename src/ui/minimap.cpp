@@ -0,0 +1,265 @@
+#include "minimap.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <algorithm>
+
+namespace {
+constexpr int kWidth = 120;
+constexpr int kLinePixels = 2;
+constexpr int kTabWidth = 4;
+constexpr qsizetype kTileLines = 128;
+// 64 tiles of 120x256 ARGB pixels stay under 8 MiB.
+constexpr std::size_t kMaxTiles = 64;
+
+// One pixel per character on the first row of each line; the second row is
+// left empty so lines stay apart.
+QImage renderTile(const BufferMirror& text, qsizetype start, qsizetype count, QRgb ink) {
+	QImage image(kWidth, int(count) * kLinePixels, QImage::Format_ARGB32_Premultiplied);
+	image.fill(0);
+	const QRgb pixel = qPremultiply(ink);
+	for (qsizetype i = 0; i < count; ++i) {
+		auto* row = reinterpret_cast<QRgb*>(image.scanLine(int(i) * kLinePixels));
+		const QString line = text.line(start + i);
+		int x = 0;
+		for (const QChar c : line) {
+			if (x >= kWidth) break;
+			if (c == u'\t') {
+				x = (x / kTabWidth + 1) * kTabWidth;
+				continue;
+			}
+			if (!c.isSpace()) {
+				row[x] = pixel;
+			}
+			++x;
+		}
+	}
+	return image;
+}
+}
+
+struct Minimap::State {
+	quint64 generation = 0;
+	BufferMirror text;
+};
+
+Minimap::Minimap(QWidget* parent) : QWidget(parent), m_state(new State) {
+	setFixedWidth(kWidth);
+	setAttribute(Qt::WA_OpaquePaintEvent);
+	setCursor(Qt::PointingHandCursor);
+}
+
+Minimap::~Minimap() {
+	m_tasks.stop();
+}
+
+QSize Minimap::sizeHint() const {
+	return QSize(kWidth, 0);
+}
+
+void Minimap::setDocument(const ITextBuffer* buffer) {
+	m_buffer = buffer;
+	++m_generation;
+	m_tiles.clear();
+	m_requested.clear();
+	TextSnapshot snapshot = buffer ? buffer->snapshot() : TextSnapshot();
+	{
+		std::lock_guard lock(m_pendingMutex);
+		m_pending = Pending{};
+		m_pending.generation = m_generation;
+		m_pending.edits = m_edits;
+		m_pending.snapshot = std::move(snapshot);
+	}
+	schedule();
+	update();
+}
+
+void Minimap::applyDelta(const TextDelta& delta) {
+	if (!m_buffer) return;
+	++m_edits;
+	LinePatch patch = BufferMirror::capture(*m_buffer, delta);
+	{
+		std::lock_guard lock(m_pendingMutex);
+		m_pending.patches.push_back(std::move(patch));
+		m_pending.edits = m_edits;
+	}
+	schedule();
+
+	const qsizetype shift = delta.addedLines - delta.removedLines;
+	const qsizetype editEnd = delta.firstLine + delta.removedLines;
+	std::erase_if(m_tiles, [&](Tile& tile) {
+		if (tile.start + tile.count <= delta.firstLine) return false;
+		if (tile.start > editEnd) {
+			tile.start += shift;
+			return false;
+		}
+		// Same line count: the old picture is still in the right place.
+		if (shift != 0) return true;
+		tile.stale = true;
+		return false;
+	});
+	// Renders already asked for are for the old text and will be dropped.
+	m_requested.clear();
+	update();
+}
+
+void Minimap::setVisibleRange(qsizetype first, qsizetype count) {
+	if (first == m_first && count == m_visible) return;
+	m_first = first;
+	m_visible = count;
+	update();
+}
+
+qsizetype Minimap::lineCount() const {
+	return m_buffer ? m_buffer->lineCount() : 0;
+}
+
+// Files taller than the widget scroll proportionally with the editor.
+qsizetype Minimap::topPixel() const {
+	const qsizetype total = lineCount() * kLinePixels;
+	if (total <= height()) return 0;
+	const qsizetype scrollable = std::max<qsizetype>(lineCount() - m_visible, 1);
+	return (total - height()) * std::min(m_first, scrollable) / scrollable;
+}
+
+qsizetype Minimap::lineAt(int y) const {
+	return std::clamp<qsizetype>((topPixel() + y) / kLinePixels, 0, std::max<qsizetype>(lineCount() - 1, 0));
+}
+
+QRgb Minimap::ink() const {
+	QColor color = palette().color(QPalette::Text);
+	color.setAlpha(150);
+	return color.rgba();
+}
+
+void Minimap::paintEvent(QPaintEvent* event) {
+	QPainter painter(this);
+	painter.fillRect(event->rect(), palette().base());
+	const qsizetype lines = lineCount();
+	if (lines == 0) return;
+
+	const qsizetype top = topPixel();
+	const qsizetype firstLine = (top + event->rect().top()) / kLinePixels;
+	const qsizetype lastLine = std::min(lines - 1, (top + event->rect().bottom()) / kLinePixels);
+	const QRgb currentInk = ink();
+	bool requested = false;
+	for (qsizetype line = firstLine; line <= lastLine;) {
+		auto next = std::upper_bound(m_tiles.begin(), m_tiles.end(), line,
+			[](qsizetype value, const Tile& tile) { return value < tile.start; });
+		if (next != m_tiles.begin() && std::prev(next)->start + std::prev(next)->count > line) {
+			Tile& tile = *std::prev(next);
+			const qsizetype end = std::min(tile.start + tile.count, lastLine + 1);
+			painter.drawImage(QPoint(0, int(line * kLinePixels - top)), tile.image,
+				QRect(0, int((line - tile.start) * kLinePixels), kWidth, int((end - line) * kLinePixels)));
+			tile.used = ++m_clock;
+			if (tile.stale || tile.ink != currentInk) {
+				request(tile.start, tile.count);
+				requested = true;
+			}
+			line = end;
+			continue;
+		}
+		// A gap: ask for a tile on the kTileLines grid where the neighbours allow.
+		const qsizetype previousEnd = next == m_tiles.begin() ? 0 : std::prev(next)->start + std::prev(next)->count;
+		const qsizetype start = std::max(line / kTileLines * kTileLines, previousEnd);
+		const qsizetype end = std::min({start + kTileLines, next == m_tiles.end() ? lines : next->start, lines});
+		request(start, end - start);
+		requested = true;
+		line = end;
+	}
+	if (requested) {
+		schedule();
+	}
+
+	const qsizetype sliderTop = m_first * kLinePixels - top;
+	QColor slider = palette().color(QPalette::Text);
+	slider.setAlpha(30);
+	painter.fillRect(QRect(0, int(sliderTop), kWidth, int(std::max<qsizetype>(m_visible, 1) * kLinePixels)), slider);
+}
+
+void Minimap::request(qsizetype start, qsizetype count) {
+	if (count <= 0 || !m_requested.insert(start).second) return;
+	std::lock_guard lock(m_pendingMutex);
+	m_pending.requests.push_back({start, count});
+	m_pending.ink = ink();
+}
+
+void Minimap::schedule() {
+	std::lock_guard lock(m_pendingMutex);
+	if (m_queued) return;
+	m_queued = true;
+	m_tasks.submit([this] { runPending(); });
+}
+
+void Minimap::runPending() {
+	Pending pending;
+	{
+		std::lock_guard lock(m_pendingMutex);
+		pending = std::exchange(m_pending, Pending{});
+		m_queued = false;
+	}
+	State& state = *m_state;
+	if (pending.snapshot) {
+		state.text.reset(*pending.snapshot);
+		state.generation = pending.generation;
+	}
+	for (const LinePatch& patch : pending.patches) {
+		state.text.apply(patch);
+	}
+	// Newest first: the last requests come from the latest paint.
+	for (auto it = pending.requests.rbegin(); it != pending.requests.rend(); ++it) {
+		const qsizetype count = std::min(it->count, state.text.lineCount() - it->start);
+		if (count <= 0) continue;
+		Tile tile;
+		tile.start = it->start;
+		tile.count = count;
+		tile.ink = pending.ink;
+		tile.image = renderTile(state.text, tile.start, count, pending.ink);
+		QMetaObject::invokeMethod(this, [this, generation = state.generation, edits = pending.edits,
+			tile = std::move(tile)]() mutable {
+			addTile(generation, edits, std::move(tile));
+		}, Qt::QueuedConnection);
+	}
+}
+
+void Minimap::addTile(quint64 generation, quint64 edits, Tile tile) {
+	if (generation != m_generation) return;
+	m_requested.erase(tile.start);
+	// Rendered from text that has been edited since; the next paint asks again.
+	if (edits != m_edits) {
+		update();
+		return;
+	}
+	const qsizetype end = tile.start + tile.count;
+	std::erase_if(m_tiles, [&](const Tile& other) {
+		return other.start < end && other.start + other.count > tile.start;
+	});
+	tile.used = ++m_clock;
+	auto at = std::upper_bound(m_tiles.begin(), m_tiles.end(), tile.start,
+		[](qsizetype value, const Tile& other) { return value < other.start; });
+	m_tiles.insert(at, std::move(tile));
+	while (m_tiles.size() > kMaxTiles) {
+		m_tiles.erase(std::min_element(m_tiles.begin(), m_tiles.end(),
+			[](const Tile& a, const Tile& b) { return a.used < b.used; }));
+	}
+	update();
+}
+
+void Minimap::mousePressEvent(QMouseEvent* event) {
+	if (event->button() != Qt::LeftButton || lineCount() == 0) {
+		QWidget::mousePressEvent(event);
+		return;
+	}
+	emit lineActivated(std::max<qsizetype>(lineAt(event->position().toPoint().y()) - m_visible / 2, 0));
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent* event) {
+	if (!(event->buttons() & Qt::LeftButton) || lineCount() == 0) return;
+	emit lineActivated(std::max<qsizetype>(lineAt(event->position().toPoint().y()) - m_visible / 2, 0));
+}
+
+void Minimap::changeEvent(QEvent* event) {
+	QWidget::changeEvent(event);
+	if (event->type() == QEvent::PaletteChange) {
+		update();
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <QImage>
+#include <QWidget>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+#include "../buffer/bufferMirror.h"
+#include "../util/task_scheduler.h"
+
+// Overview of the whole document beside the editor. Line ranges are drawn
+// into fixed-size tiles on the task scheduler and kept in a capped LRU, so
+// scrolling only blits tiles and an edit re-renders just the tiles it
+// touched; tiles below an edit move with their lines instead of redrawing.
+class Minimap : public QWidget {
+	Q_OBJECT
+public:
+	explicit Minimap(QWidget* parent = nullptr);
+	~Minimap() override;
+
+	// Not owned. Every edit must be reported to applyDelta() right after it is made.
+	void setDocument(const ITextBuffer* buffer);
+	void applyDelta(const TextDelta& delta);
+	// The lines the editor shows, marked on the map and kept in view.
+	void setVisibleRange(qsizetype first, qsizetype count);
+
+	QSize sizeHint() const override;
+
+signals:
+	void lineActivated(qsizetype line);
+
+protected:
+	void paintEvent(QPaintEvent* event) override;
+	void mousePressEvent(QMouseEvent* event) override;
+	void mouseMoveEvent(QMouseEvent* event) override;
+	void changeEvent(QEvent* event) override;
+
+private:
+	struct Tile {
+		qsizetype start = 0;
+		qsizetype count = 0;
+		QImage image;
+		QRgb ink = 0;
+		quint64 used = 0;
+		// Its lines were edited in place; it is drawn until the new render arrives.
+		bool stale = false;
+	};
+	struct TileRequest {
+		qsizetype start = 0;
+		qsizetype count = 0;
+	};
+	struct State;
+
+	qsizetype lineCount() const;
+	qsizetype topPixel() const;
+	qsizetype lineAt(int y) const;
+	void request(qsizetype start, qsizetype count);
+	void schedule();
+	void runPending();
+	void addTile(quint64 generation, quint64 edits, Tile tile);
+	QRgb ink() const;
+
+	std::unique_ptr<State> m_state;
+	TaskSequence m_tasks{TaskPriority::Visible};
+
+	// GUI side.
+	const ITextBuffer* m_buffer = nullptr;
+	quint64 m_generation = 0;
+	quint64 m_edits = 0;
+	quint64 m_clock = 0;
+	// Sorted by start and never overlapping.
+	std::vector<Tile> m_tiles;
+	std::set<qsizetype> m_requested;
+	qsizetype m_first = 0;
+	qsizetype m_visible = 0;
+
+	struct Pending {
+		quint64 generation = 0;
+		quint64 edits = 0;
+		std::optional<TextSnapshot> snapshot;
+		std::vector<LinePatch> patches;
+		std::vector<TileRequest> requests;
+		QRgb ink = 0;
+	};
+	std::mutex m_pendingMutex;
+	Pending m_pending;
+	bool m_queued = false;
+};
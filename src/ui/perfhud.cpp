@@ -0,0 +1,148 @@
+#include "perfhud.h"
+#include "workspace.h"
+#include "../util/startup_timing.h"
+#include "../util/task_scheduler.h"
+#include <QEvent>
+#include <QFontDatabase>
+#include <QLabel>
+#include <QLocale>
+#include <QTimer>
+#include <QVBoxLayout>
+
+namespace {
+QString size(qsizetype bytes) {
+	return QLocale::system().formattedDataSize(bytes, 1);
+}
+
+QString millis(qint64 micros) {
+	return QString::number(double(micros) / 1000.0, 'f', 2);
+}
+
+QString latencyRow(const QString& name, const LatencyHistogram& histogram) {
+	return QStringLiteral("  %1 %2 %3 %4 %5 %6\n")
+		.arg(name, -10)
+		.arg(histogram.count(), 7)
+		.arg(millis(histogram.percentile(50)), 7)
+		.arg(millis(histogram.percentile(90)), 7)
+		.arg(millis(histogram.percentile(99)), 7)
+		.arg(millis(histogram.max()), 7);
+}
+}
+
+PerfHud::PerfHud(Workspace* workspace, QWidget* parent) : QFrame(parent), m_workspace(workspace) {
+	setFrameShape(QFrame::StyledPanel);
+	setAutoFillBackground(true);
+	setBackgroundRole(QPalette::ToolTipBase);
+	setAttribute(Qt::WA_TransparentForMouseEvents);
+	m_text = new QLabel(this);
+	m_text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+	m_text->setForegroundRole(QPalette::ToolTipText);
+	m_text->setTextFormat(Qt::PlainText);
+	auto* layout = new QVBoxLayout(this);
+	layout->setContentsMargins(6, 4, 6, 4);
+	layout->addWidget(m_text);
+
+	m_heartbeat = new QTimer(this);
+	m_heartbeat->setTimerType(Qt::PreciseTimer);
+	m_heartbeat->setInterval(kHeartbeatMs);
+	connect(m_heartbeat, &QTimer::timeout, this, &PerfHud::heartbeat);
+	m_refresh = new QTimer(this);
+	m_refresh->setInterval(500);
+	connect(m_refresh, &QTimer::timeout, this, &PerfHud::refresh);
+	parent->installEventFilter(this);
+	hide();
+}
+
+void PerfHud::recordInput(qint64 handledNs, qint64 paintedNs) {
+	m_handled.record(handledNs / 1000);
+	m_painted.record(paintedNs / 1000);
+}
+
+void PerfHud::setSearchMemory(qsizetype resultBytes) {
+	m_resultBytes = resultBytes;
+}
+
+void PerfHud::reset() {
+	m_handled.clear();
+	m_painted.clear();
+	m_stalls.clear();
+	TaskScheduler::shared().resetStats();
+	if (isVisible()) refresh();
+}
+
+QString PerfHud::snapshot() const {
+	QString out = QStringLiteral("Key latency (ms)   count     p50     p90     p99     max\n");
+	out += latencyRow(QStringLiteral("handled"), m_handled);
+	out += latencyRow(QStringLiteral("painted"), m_painted);
+	out += QStringLiteral("Stalls over %1 ms: %2").arg(kStallMs).arg(m_stalls.count());
+	if (m_stalls.count() > 0) {
+		out += QStringLiteral(", p90 %1 ms, longest %2 ms").arg(m_stalls.percentile(90)).arg(m_stalls.max());
+	}
+	out += QStringLiteral("\nTask wait (ms)     count     p50     p90     p99     max\n");
+	const TaskScheduler& tasks = TaskScheduler::shared();
+	out += latencyRow(QStringLiteral("input"), tasks.waitTimes(TaskPriority::Interactive));
+	out += latencyRow(QStringLiteral("visible"), tasks.waitTimes(TaskPriority::Visible));
+	out += latencyRow(QStringLiteral("background"), tasks.waitTimes(TaskPriority::Background));
+	out += latencyRow(QStringLiteral("idle"), tasks.waitTimes(TaskPriority::Idle));
+	out += QStringLiteral("Startup: %1").arg(StartupTiming::summary());
+	out += QStringLiteral("\nMemory\n");
+	qsizetype total = 0;
+	for (qsizetype i = 0; i < m_workspace->count(); ++i) {
+		const Document* document = m_workspace->at(i);
+		const Document::MemoryUsage usage = document->memoryUsage();
+		QString line = QStringLiteral("  %1 ").arg(document->displayName(), -24);
+		if (document->isHibernating()) {
+			line += QStringLiteral("compressed %1").arg(size(usage.compressedBytes));
+		} else {
+			line += QStringLiteral("text %1, gap %2, lines %3")
+				.arg(size(usage.textBytes), size(usage.gapBytes), size(usage.lineIndexBytes));
+		}
+		out += line + QStringLiteral(", undo %1\n").arg(size(usage.undoBytes));
+		total += usage.textBytes + usage.gapBytes + usage.lineIndexBytes + usage.compressedBytes + usage.undoBytes;
+	}
+	out += QStringLiteral("  %1 results %2\n").arg(QStringLiteral("search"), -24).arg(size(m_resultBytes));
+	total += m_resultBytes;
+	out += QStringLiteral("  %1 %2").arg(QStringLiteral("total"), -24).arg(size(total));
+	return out;
+}
+
+bool PerfHud::eventFilter(QObject* watched, QEvent* event) {
+	if (watched == parent() && event->type() == QEvent::Resize && isVisible()) {
+		place();
+	}
+	return QFrame::eventFilter(watched, event);
+}
+
+void PerfHud::showEvent(QShowEvent* event) {
+	QFrame::showEvent(event);
+	m_beatClock.start();
+	m_heartbeat->start();
+	m_refresh->start();
+	refresh();
+	raise();
+}
+
+void PerfHud::hideEvent(QHideEvent* event) {
+	QFrame::hideEvent(event);
+	m_heartbeat->stop();
+	m_refresh->stop();
+}
+
+void PerfHud::heartbeat() {
+	const qint64 late = m_beatClock.restart() - kHeartbeatMs;
+	if (late >= kStallMs) {
+		m_stalls.record(late);
+	}
+}
+
+void PerfHud::refresh() {
+	m_text->setText(snapshot());
+	adjustSize();
+	place();
+}
+
+void PerfHud::place() {
+	const QWidget* area = parentWidget();
+	constexpr int kMargin = 8;
+	move(area->width() - width() - kMargin, area->height() - height() - kMargin);
+}
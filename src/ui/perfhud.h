@@ -0,0 +1,52 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QFrame>
+#include "../util/latency_histogram.h"
+
+class QLabel;
+class QTimer;
+class Workspace;
+
+// Overlay in the corner of the editor with key latency percentiles, event
+// loop stalls, how long background tasks wait for a thread and the memory
+// each document holds. Latencies are recorded
+// whether or not it is shown; stalls are watched for only while it is. The
+// same report as text can be copied into a bug report.
+class PerfHud : public QFrame {
+	Q_OBJECT
+public:
+	static constexpr int kHeartbeatMs = 50;
+	// A heartbeat this late counts as a stall.
+	static constexpr int kStallMs = 100;
+
+	// The workspace is not owned. It keeps to the parent's bottom right corner.
+	PerfHud(Workspace* workspace, QWidget* parent);
+
+	void recordInput(qint64 handledNs, qint64 paintedNs);
+	// The search results shown.
+	void setSearchMemory(qsizetype resultBytes);
+	void reset();
+	QString snapshot() const;
+
+protected:
+	bool eventFilter(QObject* watched, QEvent* event) override;
+	void showEvent(QShowEvent* event) override;
+	void hideEvent(QHideEvent* event) override;
+
+private:
+	void heartbeat();
+	void refresh();
+	void place();
+
+	Workspace* m_workspace;
+	QLabel* m_text = nullptr;
+	QTimer* m_heartbeat = nullptr;
+	QTimer* m_refresh = nullptr;
+	QElapsedTimer m_beatClock;
+	// Microseconds.
+	LatencyHistogram m_handled;
+	LatencyHistogram m_painted;
+	// Milliseconds.
+	LatencyHistogram m_stalls;
+	qsizetype m_resultBytes = 0;
+};
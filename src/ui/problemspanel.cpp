@@ -0,0 +1,121 @@
+#include "problemspanel.h"
+#include "../build/build_output.h"
+#include <QApplication>
+#include <QFileInfo>
+#include <QHeaderView>
+#include <QStyle>
+#include <QTableView>
+
+ProblemsModel::ProblemsModel(BuildOutput* output, QObject* parent) : QAbstractTableModel(parent), m_output(output) {
+	connect(output, &BuildOutput::aboutToReset, this, [this] { beginResetModel(); });
+	connect(output, &BuildOutput::reset, this, [this] {
+		endResetModel();
+		m_errors = 0;
+		m_warnings = 0;
+		recount(0);
+	});
+	connect(output, &BuildOutput::diagnosticsAboutToBeAppended, this, [this](qsizetype count) {
+		const int first = rowCount();
+		beginInsertRows({}, first, first + int(count) - 1);
+	});
+	connect(output, &BuildOutput::diagnosticsAppended, this, [this] {
+		const int first = m_errors + m_warnings;
+		endInsertRows();
+		recount(first);
+	});
+	connect(output, &BuildOutput::diagnosticChanged, this, [this](qsizetype row) {
+		emit dataChanged(index(int(row), Message), index(int(row), Message));
+	});
+}
+
+void ProblemsModel::recount(qsizetype first) {
+	const std::vector<Diagnostic>& diagnostics = m_output->diagnostics();
+	for (auto it = diagnostics.begin() + first; it != diagnostics.end(); ++it) {
+		if (it->severity == Diagnostic::Error) {
+			++m_errors;
+		} else {
+			++m_warnings;
+		}
+	}
+	emit countsChanged();
+}
+
+const Diagnostic& ProblemsModel::diagnostic(int row) const {
+	return m_output->diagnostics()[std::size_t(row)];
+}
+
+int ProblemsModel::rowCount(const QModelIndex& parent) const {
+	return parent.isValid() ? 0 : int(m_output->diagnostics().size());
+}
+
+int ProblemsModel::columnCount(const QModelIndex& parent) const {
+	return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant ProblemsModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid()) return {};
+	const Diagnostic& diag = diagnostic(index.row());
+	if (role == Qt::DecorationRole && index.column() == Severity) {
+		const QStyle::StandardPixmap icon = diag.severity == Diagnostic::Error
+			? QStyle::SP_MessageBoxCritical : QStyle::SP_MessageBoxWarning;
+		return QApplication::style()->standardIcon(icon);
+	}
+	if (role == Qt::ToolTipRole && index.column() == File) return diag.file;
+	if (role != Qt::DisplayRole) return {};
+	switch (index.column()) {
+	case Severity: return diag.severity == Diagnostic::Error ? QStringLiteral("Error") : QStringLiteral("Warning");
+	case Message:
+		if (diag.notes == 0) return diag.message;
+		return QStringLiteral("%1 (+%2 notes)").arg(diag.message).arg(diag.notes);
+	case File: return QFileInfo(diag.file).fileName();
+	case Line:
+		if (diag.line <= 0) return {};
+		if (diag.column <= 0) return diag.line;
+		return QStringLiteral("%1:%2").arg(diag.line).arg(diag.column);
+	default: return {};
+	}
+}
+
+QVariant ProblemsModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return {};
+	switch (section) {
+	case Severity: return QStringLiteral("Severity");
+	case Message: return QStringLiteral("Message");
+	case File: return QStringLiteral("File");
+	case Line: return QStringLiteral("Line");
+	default: return {};
+	}
+}
+
+ProblemsPanel::ProblemsPanel(BuildOutput* output, QWidget* parent) : QDockWidget("Problems", parent) {
+	setObjectName("ProblemsPanel");
+	m_model = new ProblemsModel(output, this);
+	m_view = new QTableView(this);
+	m_view->setModel(m_model);
+	m_view->setSelectionBehavior(QAbstractItemView::SelectRows);
+	m_view->setSelectionMode(QAbstractItemView::SingleSelection);
+	m_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	m_view->setShowGrid(false);
+	m_view->setWordWrap(false);
+	m_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+	m_view->verticalHeader()->setDefaultSectionSize(m_view->fontMetrics().height() + 4);
+	m_view->verticalHeader()->hide();
+	m_view->horizontalHeader()->setSectionResizeMode(ProblemsModel::Message, QHeaderView::Stretch);
+	setWidget(m_view);
+
+	connect(m_view, &QTableView::activated, this, [this](const QModelIndex& index) {
+		const Diagnostic& diag = m_model->diagnostic(index.row());
+		emit locationActivated(diag.file, diag.line, diag.column, diag.outputLine);
+	});
+	connect(m_model, &ProblemsModel::countsChanged, this, &ProblemsPanel::updateTitle);
+}
+
+void ProblemsPanel::updateTitle() {
+	const int errors = m_model->errorCount();
+	const int warnings = m_model->warningCount();
+	if (errors == 0 && warnings == 0) {
+		setWindowTitle(QStringLiteral("Problems"));
+	} else {
+		setWindowTitle(QStringLiteral("Problems (%1 errors, %2 warnings)").arg(errors).arg(warnings));
+	}
+}
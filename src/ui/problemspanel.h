@@ -0,0 +1,50 @@
+#pragma once
+#include <QAbstractTableModel>
+#include <QDockWidget>
+
+class BuildOutput;
+class QTableView;
+struct Diagnostic;
+
+class ProblemsModel : public QAbstractTableModel {
+	Q_OBJECT
+public:
+	enum Column { Severity, Message, File, Line, ColumnCount };
+
+	explicit ProblemsModel(BuildOutput* output, QObject* parent = nullptr);
+
+	const Diagnostic& diagnostic(int row) const;
+	int errorCount() const { return m_errors; }
+	int warningCount() const { return m_warnings; }
+
+	int rowCount(const QModelIndex& parent = {}) const override;
+	int columnCount(const QModelIndex& parent = {}) const override;
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+signals:
+	void countsChanged();
+
+private:
+	void recount(qsizetype first);
+
+	BuildOutput* m_output;
+	int m_errors = 0;
+	int m_warnings = 0;
+};
+
+class ProblemsPanel : public QDockWidget {
+	Q_OBJECT
+public:
+	explicit ProblemsPanel(BuildOutput* output, QWidget* parent = nullptr);
+
+signals:
+	// line and column are 1-based; column is 0 when the compiler gave none.
+	void locationActivated(const QString& file, int line, int column, qint64 outputLine);
+
+private:
+	void updateTitle();
+
+	ProblemsModel* m_model = nullptr;
+	QTableView* m_view = nullptr;
+};
@@ -0,0 +1,86 @@
+#include "symbolpalette.h"
+#include <algorithm>
+#include <QCoreApplication>
+#include <QDir>
+#include <QKeyEvent>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QVBoxLayout>
+
+SymbolPalette::SymbolPalette(SymbolIndex* index, QWidget* parent) : QWidget(parent), m_index(index) {
+	setWindowFlags(Qt::Popup);
+
+	m_input = new QLineEdit(this);
+	m_input->setPlaceholderText("Symbol name");
+	m_input->installEventFilter(this);
+	m_list = new QListWidget(this);
+	m_list->setUniformItemSizes(true);
+
+	auto* layout = new QVBoxLayout(this);
+	layout->setContentsMargins(4, 4, 4, 4);
+	layout->addWidget(m_input);
+	layout->addWidget(m_list);
+
+	connect(m_input, &QLineEdit::textChanged, this, &SymbolPalette::refresh);
+	connect(m_input, &QLineEdit::returnPressed, this, [this] { activate(m_list->currentItem()); });
+	connect(m_list, &QListWidget::itemActivated, this, &SymbolPalette::activate);
+	connect(m_index, &SymbolIndex::updated, this, [this] {
+		if (isVisible()) refresh();
+	});
+}
+
+void SymbolPalette::popup(const QString& text) {
+	if (QWidget* owner = parentWidget()) {
+		const int width = std::min(owner->width() - 40, 640);
+		resize(width, 360);
+		move(owner->mapToGlobal(QPoint((owner->width() - width) / 2, 40)));
+	}
+	show();
+	m_input->setText(text);
+	m_input->selectAll();
+	m_input->setFocus();
+	refresh();
+}
+
+void SymbolPalette::refresh() {
+	m_list->clear();
+	m_results.clear();
+	const SymbolIndexSnapshotPtr snapshot = m_index->snapshot();
+	const QString text = m_input->text().trimmed();
+	if (!snapshot) {
+		m_list->addItem(m_index->root().isEmpty() ? "No folder is indexed" : "Indexing…");
+		return;
+	}
+	if (text.isEmpty()) return;
+	m_results = snapshot->find(text, kMaxResults);
+	const QDir root(snapshot->root);
+	for (const SymbolLocation& location : m_results) {
+		const QString name = location.scope.isEmpty() ? location.name : location.scope + "::" + location.name;
+		m_list->addItem(QString("%1  %2  %3:%4").arg(name, QString::fromLatin1(SymbolExtractor::kindName(location.kind)),
+			root.relativeFilePath(location.path)).arg(location.line));
+	}
+	m_list->setCurrentRow(0);
+}
+
+void SymbolPalette::activate(QListWidgetItem* item) {
+	const int row = item ? m_list->row(item) : -1;
+	if (row < 0 || row >= int(m_results.size())) return;
+	const SymbolLocation location = m_results[std::size_t(row)];
+	hide();
+	emit locationActivated(location.path, location.line, location.column);
+}
+
+bool SymbolPalette::eventFilter(QObject* watched, QEvent* event) {
+	if (watched == m_input && event->type() == QEvent::KeyPress) {
+		const int key = static_cast<QKeyEvent*>(event)->key();
+		if (key == Qt::Key_Up || key == Qt::Key_Down || key == Qt::Key_PageUp || key == Qt::Key_PageDown) {
+			QCoreApplication::sendEvent(m_list, event);
+			return true;
+		}
+		if (key == Qt::Key_Escape) {
+			hide();
+			return true;
+		}
+	}
+	return QWidget::eventFilter(watched, event);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <QWidget>
+#include <vector>
+#include "../index/symbol_index.h"
+
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
+
+// Go to Symbol: lists the workspace symbols starting with what is typed,
+// straight from the latest index snapshot.
+class SymbolPalette : public QWidget {
+	Q_OBJECT
+public:
+	static constexpr qsizetype kMaxResults = 200;
+
+	explicit SymbolPalette(SymbolIndex* index, QWidget* parent = nullptr);
+	void popup(const QString& text);
+
+signals:
+	void locationActivated(const QString& path, int line, int column);
+
+protected:
+	bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+	void refresh();
+	void activate(QListWidgetItem* item);
+
+	SymbolIndex* m_index;
+	QLineEdit* m_input;
+	QListWidget* m_list;
+	std::vector<SymbolLocation> m_results;
+};
@@ -0,0 +1,30 @@
+#include "syntaxformats.h"
+#include <array>
+
+QTextCharFormat syntaxFormat(SyntaxKind kind) {
+	static const std::array<QTextCharFormat, 9> formats = [] {
+		std::array<QTextCharFormat, 9> result;
+		auto color = [&](SyntaxKind k, QColor c) { result[std::size_t(k)].setForeground(c); };
+		color(SyntaxKind::Keyword, QColor(0, 0, 160));
+		color(SyntaxKind::Type, QColor(30, 110, 140));
+		color(SyntaxKind::Number, QColor(150, 80, 0));
+		color(SyntaxKind::String, QColor(160, 20, 20));
+		color(SyntaxKind::Comment, QColor(0, 120, 0));
+		color(SyntaxKind::Preprocessor, QColor(130, 60, 150));
+		color(SyntaxKind::Function, QColor(110, 80, 20));
+		color(SyntaxKind::Variable, QColor(20, 90, 160));
+		return result;
+	}();
+	return formats[std::size_t(kind)];
+}
+
+QList<QTextLayout::FormatRange> syntaxRanges(const LineTokens& tokens, qsizetype length) {
+	QList<QTextLayout::FormatRange> ranges;
+	ranges.reserve(qsizetype(tokens.size()));
+	for (const SyntaxToken& token : tokens) {
+		if (token.kind == SyntaxKind::Text || token.start >= length) continue;
+		const qsizetype end = std::min<qsizetype>(qsizetype(token.start) + token.length, length);
+		ranges.append({int(token.start), int(end - token.start), syntaxFormat(token.kind)});
+	}
+	return ranges;
+}
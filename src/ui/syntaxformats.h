@@ -0,0 +1,8 @@
+#pragma once
+#include <QTextLayout>
+#include "../syntax/syntax_highlighter.h"
+
+QTextCharFormat syntaxFormat(SyntaxKind kind);
+// Format ranges for a line's tokens, clipped to the line's length since the
+// tokens of a line being edited may lag behind its text.
+QList<QTextLayout::FormatRange> syntaxRanges(const LineTokens& tokens, qsizetype length);
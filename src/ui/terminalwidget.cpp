@@ -0,0 +1,283 @@
+#include "terminalwidget.h"
+#include "../pty/pty_session.h"
+#include "../pty/scrollback.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QFontDatabase>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QPaintEvent>
+#include <QWheelEvent>
+#include <algorithm>
+
+namespace {
+QRgb paletteColor(quint32 index) {
+	static const QRgb base[16] = {
+		0x000000, 0xcd3131, 0x0dbc79, 0xe5e510, 0x2472c8, 0xbc3fbc, 0x11a8cd, 0xe5e5e5,
+		0x666666, 0xf14c4c, 0x23d18b, 0xf5f543, 0x3b8eea, 0xd670d6, 0x29b8db, 0xffffff,
+	};
+	if (index < 16) return base[index];
+	if (index < 232) {
+		index -= 16;
+		auto level = [](quint32 v) { return v == 0 ? 0 : 55 + v * 40; };
+		return qRgb(int(level(index / 36)), int(level(index / 6 % 6)), int(level(index % 6)));
+	}
+	const int gray = int(8 + (index - 232) * 10);
+	return qRgb(gray, gray, gray);
+}
+}
+
+TerminalWidget::TerminalWidget(QWidget* parent) : QWidget(parent), m_parser(m_grid) {
+	setFocusPolicy(Qt::StrongFocus);
+	setAttribute(Qt::WA_OpaquePaintEvent);
+	setAttribute(Qt::WA_InputMethodEnabled);
+
+	m_font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+	m_boldFont = m_font;
+	m_boldFont.setBold(true);
+	const QFontMetrics metrics(m_font);
+	m_cellWidth = std::max(1, metrics.horizontalAdvance(QLatin1Char('M')));
+	m_cellHeight = std::max(1, metrics.height());
+	m_ascent = metrics.ascent();
+
+	m_pty = new PtySession(this);
+	connect(m_pty, &PtySession::outputReady, this, &TerminalWidget::onOutput);
+	connect(m_pty, &PtySession::finished, this, &TerminalWidget::finished);
+	m_parser.onReply = [this](const QByteArray& reply) { m_pty->write(reply); };
+	m_parser.onTitle = [this](const QString& title) { emit titleChanged(title); };
+
+	m_scrollback = new Scrollback(this);
+	m_grid.onLineScrolledOut = [this](const Cell* cells, int count) {
+		m_scrollback->append(cells, count, m_grid.attrs());
+		// Keep the view anchored while the user is reading history.
+		if (m_scrollOffset > 0) ++m_scrollOffset;
+	};
+}
+
+TerminalWidget::~TerminalWidget() = default;
+
+bool TerminalWidget::start(const QString& program, const QStringList& args, const QString& workingDir, QString* error) {
+	updateGridSize();
+	m_parser.reset();
+	m_scrollback->clear();
+	m_scrollOffset = 0;
+	return m_pty->start(program, args, workingDir, m_grid.cols(), m_grid.rows(), error);
+}
+
+bool TerminalWidget::isRunning() const {
+	return m_pty->isRunning();
+}
+
+void TerminalWidget::onOutput(const QByteArray& data) {
+	m_parser.feed(data);
+	if (!m_grid.isDirty() && m_grid.cursorY() == m_lastCursorY) return;
+	if (m_scrollOffset > 0) {
+		m_scrollOffset = std::min(m_scrollOffset, m_scrollback->lineCount());
+		m_lastCursorY = m_grid.cursorY();
+		m_grid.clearDirty();
+		update();
+		return;
+	}
+
+	// Repaint only the rows that changed plus the old and new cursor rows.
+	QRegion region = rowRect(m_lastCursorY);
+	for (int y = 0; y < m_grid.rows(); ++y) {
+		if (m_grid.isRowDirty(y)) region += rowRect(y);
+	}
+	region += rowRect(m_grid.cursorY());
+	m_lastCursorY = m_grid.cursorY();
+	m_grid.clearDirty();
+	update(region);
+}
+
+QRect TerminalWidget::rowRect(int y) const {
+	return QRect(0, y * m_cellHeight, width(), m_cellHeight);
+}
+
+QColor TerminalWidget::color(quint32 value, bool foreground) const {
+	if (value & kRgbColor) return QColor::fromRgb(value & 0xFFFFFF);
+	if (value & kPaletteColor) return QColor::fromRgb(paletteColor(value & 0xFF));
+	return foreground ? palette().color(QPalette::Text) : palette().color(QPalette::Base);
+}
+
+void TerminalWidget::paintRow(QPainter& painter, int y, const Cell* cells, int count, const CellAttr* attrs,
+	const QColor& background) {
+	const int top = y * m_cellHeight;
+	QString run;
+	int x = 0;
+	// Draw maximal runs of cells that share an attribute index.
+	while (x < count) {
+		const quint32 attrIndex = cellAttr(cells[x]);
+		const int start = x;
+		run.clear();
+		while (x < count && cellAttr(cells[x]) == attrIndex) {
+			const char32_t cp = cellCodepoint(cells[x]);
+			if (QChar::requiresSurrogates(cp)) {
+				run.append(QChar(QChar::highSurrogate(cp)));
+				run.append(QChar(QChar::lowSurrogate(cp)));
+			} else {
+				run.append(QChar(char16_t(cp)));
+			}
+			++x;
+		}
+		const CellAttr& attr = attrs[attrIndex];
+		QColor fg = color(attr.fg, true);
+		QColor bg = color(attr.bg, false);
+		if (attr.flags & CellInverse) std::swap(fg, bg);
+		if (attr.flags & CellDim) fg.setAlphaF(0.6f);
+		const QRect rect(start * m_cellWidth, top, (x - start) * m_cellWidth, m_cellHeight);
+		if (bg != background) painter.fillRect(rect, bg);
+		if (attr.flags & CellHidden) continue;
+		if (run.trimmed().isEmpty() && !(attr.flags & (CellUnderline | CellStrike))) continue;
+
+		QFont font = (attr.flags & CellBold) ? m_boldFont : m_font;
+		font.setItalic(attr.flags & CellItalic);
+		font.setUnderline(attr.flags & CellUnderline);
+		font.setStrikeOut(attr.flags & CellStrike);
+		painter.setFont(font);
+		painter.setPen(fg);
+		painter.drawText(rect.left(), top + m_ascent, run);
+	}
+}
+
+void TerminalWidget::paintEvent(QPaintEvent* event) {
+	QPainter painter(this);
+	const QColor background = palette().color(QPalette::Base);
+	painter.fillRect(event->rect(), background);
+
+	const int firstRow = std::max(0, event->rect().top() / m_cellHeight);
+	const int lastRow = std::min(m_grid.rows() - 1, event->rect().bottom() / m_cellHeight);
+	// With a scroll offset the top rows come from history and the grid is shifted down.
+	const int offset = int(std::min({m_scrollOffset, m_scrollback->lineCount(), qint64(m_grid.rows())}));
+	for (int y = firstRow; y <= lastRow; ++y) {
+		if (y < offset) {
+			m_scrollback->line(m_scrollback->endLine() - m_scrollOffset + y, m_lineBuffer, m_lineAttrs);
+			paintRow(painter, y, m_lineBuffer.data(), int(m_lineBuffer.size()), m_lineAttrs.data(), background);
+		} else {
+			paintRow(painter, y, m_grid.row(y - offset), m_grid.cols(), m_grid.attrs().data(), background);
+		}
+	}
+
+	const int cursorRow = m_grid.cursorY() + offset;
+	if (m_grid.cursorVisible() && cursorRow >= firstRow && cursorRow <= lastRow) {
+		const QRect cursor(m_grid.cursorX() * m_cellWidth, cursorRow * m_cellHeight, m_cellWidth, m_cellHeight);
+		if (hasFocus()) {
+			painter.setCompositionMode(QPainter::RasterOp_SourceXorDestination);
+			painter.fillRect(cursor, Qt::white);
+		} else {
+			painter.setPen(palette().color(QPalette::Text));
+			painter.drawRect(cursor.adjusted(0, 0, -1, -1));
+		}
+	}
+}
+
+void TerminalWidget::resizeEvent(QResizeEvent* event) {
+	QWidget::resizeEvent(event);
+	updateGridSize();
+}
+
+void TerminalWidget::updateGridSize() {
+	const int cols = std::max(2, width() / m_cellWidth);
+	const int rows = std::max(1, height() / m_cellHeight);
+	if (cols == m_grid.cols() && rows == m_grid.rows()) return;
+	m_grid.resize(cols, rows);
+	m_pty->resize(cols, rows);
+	m_lastCursorY = m_grid.cursorY();
+	update();
+}
+
+bool TerminalWidget::focusNextPrevChild(bool next) {
+	Q_UNUSED(next);
+	// Tab and Backtab belong to the shell.
+	return false;
+}
+
+void TerminalWidget::scrollBy(qint64 lines) {
+	const qint64 offset = std::clamp(m_scrollOffset + lines, qint64(0), m_scrollback->lineCount());
+	if (offset != m_scrollOffset) {
+		m_scrollOffset = offset;
+		update();
+	}
+}
+
+void TerminalWidget::wheelEvent(QWheelEvent* event) {
+	if (m_grid.isAltScreen()) {
+		QWidget::wheelEvent(event);
+		return;
+	}
+	scrollBy(event->angleDelta().y() / 40);
+	event->accept();
+}
+
+void TerminalWidget::paste() {
+	QString clip = QApplication::clipboard()->text();
+	// Pasted text must not carry escape sequences: one could end a bracketed
+	// paste early and have the rest run as typed commands.
+	clip.remove(QChar(0x1b));
+	clip.remove(QChar(0x9b));
+	QByteArray text = clip.toUtf8();
+	text.replace("\r\n", "\r");
+	text.replace('\n', '\r');
+	if (m_parser.bracketedPaste()) {
+		text = "\x1b[200~" + text + "\x1b[201~";
+	}
+	m_pty->write(text);
+}
+
+void TerminalWidget::keyPressEvent(QKeyEvent* event) {
+	if (!m_pty->isRunning()) {
+		QWidget::keyPressEvent(event);
+		return;
+	}
+	const Qt::KeyboardModifiers mods = event->modifiers();
+	if (mods == (Qt::ControlModifier | Qt::ShiftModifier) && event->key() == Qt::Key_V) {
+		paste();
+		return;
+	}
+	if (mods == Qt::ShiftModifier && (event->key() == Qt::Key_PageUp || event->key() == Qt::Key_PageDown)) {
+		const int page = std::max(1, m_grid.rows() - 1);
+		scrollBy(event->key() == Qt::Key_PageUp ? page : -page);
+		return;
+	}
+	scrollBy(-m_scrollOffset);
+
+	const bool app = m_parser.appCursorKeys();
+	QByteArray seq;
+	switch (event->key()) {
+	case Qt::Key_Up: seq = app ? "\x1bOA" : "\x1b[A"; break;
+	case Qt::Key_Down: seq = app ? "\x1bOB" : "\x1b[B"; break;
+	case Qt::Key_Right: seq = app ? "\x1bOC" : "\x1b[C"; break;
+	case Qt::Key_Left: seq = app ? "\x1bOD" : "\x1b[D"; break;
+	case Qt::Key_Home: seq = app ? "\x1bOH" : "\x1b[H"; break;
+	case Qt::Key_End: seq = app ? "\x1bOF" : "\x1b[F"; break;
+	case Qt::Key_Insert: seq = "\x1b[2~"; break;
+	case Qt::Key_Delete: seq = "\x1b[3~"; break;
+	case Qt::Key_PageUp: seq = "\x1b[5~"; break;
+	case Qt::Key_PageDown: seq = "\x1b[6~"; break;
+	case Qt::Key_F1: seq = "\x1bOP"; break;
+	case Qt::Key_F2: seq = "\x1bOQ"; break;
+	case Qt::Key_F3: seq = "\x1bOR"; break;
+	case Qt::Key_F4: seq = "\x1bOS"; break;
+	case Qt::Key_Return:
+	case Qt::Key_Enter: seq = "\r"; break;
+	case Qt::Key_Backspace: seq = "\x7f"; break;
+	case Qt::Key_Tab: seq = "\t"; break;
+	case Qt::Key_Backtab: seq = "\x1b[Z"; break;
+	case Qt::Key_Escape: seq = "\x1b"; break;
+	default:
+		if ((mods & Qt::ControlModifier) && event->key() >= Qt::Key_A && event->key() <= Qt::Key_Z) {
+			seq = QByteArray(1, static_cast<char>(event->key() - Qt::Key_A + 1));
+		} else {
+			seq = event->text().toUtf8();
+		}
+		break;
+	}
+	if (seq.isEmpty()) {
+		QWidget::keyPressEvent(event);
+		return;
+	}
+	if (mods & Qt::AltModifier) {
+		seq.prepend('\x1b');
+	}
+	m_pty->write(seq);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <QFont>
+#include <QWidget>
+#include "../pty/screen_grid.h"
+#include "../pty/vt_parser.h"
+#include <vector>
+
+class PtySession;
+class Scrollback;
+class QPainter;
+
+class TerminalWidget : public QWidget {
+	Q_OBJECT
+public:
+	explicit TerminalWidget(QWidget* parent = nullptr);
+	~TerminalWidget() override;
+
+	bool start(const QString& program, const QStringList& args, const QString& workingDir, QString* error = nullptr);
+	bool isRunning() const;
+
+signals:
+	void titleChanged(const QString& title);
+	void finished(int exitCode);
+
+protected:
+	void paintEvent(QPaintEvent* event) override;
+	void resizeEvent(QResizeEvent* event) override;
+	void keyPressEvent(QKeyEvent* event) override;
+	void wheelEvent(QWheelEvent* event) override;
+	bool focusNextPrevChild(bool next) override;
+
+private:
+	void onOutput(const QByteArray& data);
+	void updateGridSize();
+	void paste();
+	void scrollBy(qint64 lines);
+	void paintRow(QPainter& painter, int y, const Cell* cells, int count, const CellAttr* attrs, const QColor& background);
+	QRect rowRect(int y) const;
+	QColor color(quint32 value, bool foreground) const;
+
+	PtySession* m_pty = nullptr;
+	Scrollback* m_scrollback = nullptr;
+	qint64 m_scrollOffset = 0;
+	std::vector<Cell> m_lineBuffer;
+	std::vector<CellAttr> m_lineAttrs;
+	ScreenGrid m_grid;
+	VtParser m_parser;
+	QFont m_font;
+	QFont m_boldFont;
+	int m_cellWidth = 1;
+	int m_cellHeight = 1;
+	int m_ascent = 0;
+	int m_lastCursorY = 0;
+};
@@ -0,0 +1,301 @@
+#include "workspace.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+// Documents not shown for this long hibernate even under the budget.
+constexpr qint64 kIdleMs = 5 * 60 * 1000;
+constexpr int kIdleCheckMs = 30 * 1000;
+}
+
+Workspace::Workspace(FsWatcher* watcher, QObject* parent) : QObject(parent), m_watcher(watcher) {
+	m_clock.start();
+	if (m_watcher) {
+		connect(m_watcher, &FsWatcher::changed, this, &Workspace::onFilesChanged);
+	}
+	m_idleTimer = new QTimer(this);
+	m_idleTimer->setInterval(kIdleCheckMs);
+	connect(m_idleTimer, &QTimer::timeout, this, &Workspace::enforceBudget);
+	m_idleTimer->start();
+}
+
+Workspace::~Workspace() {
+	m_tasks.stop();
+}
+
+qsizetype Workspace::indexOf(const Document* document) const {
+	auto it = std::find_if(m_entries.begin(), m_entries.end(),
+		[&](const Entry& entry) { return entry.document.get() == document; });
+	return it == m_entries.end() ? -1 : qsizetype(it - m_entries.begin());
+}
+
+Document* Workspace::find(const QString& path) const {
+	if (path.isEmpty()) return nullptr;
+	const QFileInfo info(path);
+	for (const Entry& entry : m_entries) {
+		if (!entry.document->path().isEmpty() && QFileInfo(entry.document->path()) == info) {
+			return entry.document.get();
+		}
+	}
+	return nullptr;
+}
+
+Document* Workspace::open(const QString& path, QString* error) {
+	auto document = std::make_unique<Document>(path);
+	if (!path.isEmpty() && !document->load(error)) {
+		return nullptr;
+	}
+	watch(path);
+	m_entries.push_back({std::move(document), m_clock.elapsed()});
+	return m_entries.back().document.get();
+}
+
+Document* Workspace::openDeferred(const QString& path) {
+	auto document = std::make_unique<Document>(path);
+	document->defer();
+	watch(path);
+	m_entries.push_back({std::move(document), m_clock.elapsed()});
+	Document* added = m_entries.back().document.get();
+	loadDeferred(added);
+	return added;
+}
+
+void Workspace::loadDeferred(Document* document) {
+	const quint64 ticket = ++m_reloadTicket;
+	m_reloads.insert(document, ticket);
+	const QString path = document->path();
+	m_tasks.submit([this, document, ticket, path] {
+		QString text;
+		Document::DiskState state;
+		const bool read = Document::readFile(path, &text, &state);
+		const QByteArray compressed = read ? Document::compress(text) : QByteArray();
+		QMetaObject::invokeMethod(this, [this, document, ticket, read, state, compressed] {
+			if (m_reloads.value(document) != ticket) return;
+			m_reloads.remove(document);
+			// Otherwise it is read when shown.
+			if (read) document->setCompressed(compressed, state);
+		}, Qt::QueuedConnection);
+	});
+}
+
+bool Workspace::save(Document* document, const QString& path, QString* error) {
+	const QString previous = document->path();
+	if (!document->save(path, error)) {
+		return false;
+	}
+	// What is saved is newer than what changed on disk.
+	m_stale.remove(document);
+	if (previous != path) {
+		unwatch(previous);
+		watch(path);
+	}
+	return true;
+}
+
+void Workspace::saveInBackground(Document* document, const QString& path) {
+	++m_saves[document];
+	auto job = std::make_shared<const Document::SaveJob>(document->prepareSave(path));
+	m_tasks.submit(TaskPriority::Interactive, [this, document, job] {
+		Document::DiskState state;
+		QString error;
+		const bool written = Document::writeFile(*job, &state, &error);
+		QMetaObject::invokeMethod(this, [this, document, job, written, state, error] {
+			const auto it = m_saves.find(document);
+			// Closed meanwhile.
+			if (it == m_saves.end()) return;
+			if (--*it == 0) m_saves.erase(it);
+			if (!written) {
+				emit saveFailed(document, error);
+				return;
+			}
+			const QString previous = document->path();
+			document->finishSave(*job, state);
+			// What is saved is newer than what changed on disk, or a reload read.
+			m_stale.remove(document);
+			m_reloads.remove(document);
+			if (previous != job->path) {
+				unwatch(previous);
+				watch(job->path);
+			}
+			emit saved(document, previous);
+			if (!m_saves.contains(document) && document->isChangedOnDisk()) {
+				emit changedOnDisk(document);
+			}
+		}, Qt::QueuedConnection);
+	});
+}
+
+void Workspace::reload(Document* document) {
+	if (document->isHibernating() && document->isLoaded()) {
+		m_stale.insert(document);
+		return;
+	}
+	QString appended;
+	if (!document->isModified() && !m_reloads.contains(document) && document->readAppended(&appended)) {
+		std::vector<TextPatch> patches;
+		if (!appended.isEmpty()) {
+			patches.push_back({document->text().size(), 0, appended});
+		}
+		emit reloaded(document, patches);
+		return;
+	}
+	const quint64 ticket = ++m_reloadTicket;
+	m_reloads.insert(document, ticket);
+	const QString path = document->path();
+	const QString text = document->text().toString();
+	const qsizetype version = document->text().version();
+	m_tasks.submit(TaskPriority::Visible, [this, document, ticket, path, text, version] {
+		QString contents;
+		Document::DiskState state;
+		QString error;
+		const bool read = Document::readFile(path, &contents, &state, &error);
+		std::vector<TextPatch> patches;
+		if (read) {
+			patches = LineDiff::patches(text, contents);
+		}
+		QMetaObject::invokeMethod(this, [this, document, ticket, version, read, state, error, patches = std::move(patches)] {
+			if (m_reloads.value(document) != ticket) return;
+			m_reloads.remove(document);
+			if (!read) {
+				emit reloadFailed(document, error);
+				return;
+			}
+			if (document->text().version() != version) {
+				// Edited while the diff ran; let the usual check decide again.
+				emit changedOnDisk(document);
+				return;
+			}
+			document->setDiskState(state);
+			emit reloaded(document, patches);
+		}, Qt::QueuedConnection);
+	});
+}
+
+void Workspace::close(Document* document) {
+	const qsizetype index = indexOf(document);
+	if (index < 0) return;
+	if (m_active == document) {
+		m_active = nullptr;
+	}
+	unwatch(document->path());
+	m_reloads.remove(document);
+	m_saves.remove(document);
+	m_stale.remove(document);
+	m_entries.erase(m_entries.begin() + index);
+}
+
+void Workspace::activate(Document* document) {
+	const qsizetype index = indexOf(document);
+	if (index < 0) return;
+	m_active = document;
+	document->wake();
+	m_entries[std::size_t(index)].shownAt = m_clock.elapsed();
+	if (m_stale.remove(document)) {
+		// Once the view is attached, so the patches show as edits.
+		QMetaObject::invokeMethod(this, [this, document] {
+			if (indexOf(document) >= 0) reload(document);
+		}, Qt::QueuedConnection);
+	}
+	enforceBudget();
+}
+
+void Workspace::setMemoryBudget(qsizetype bytes) {
+	m_budget = bytes;
+	enforceBudget();
+}
+
+qsizetype Workspace::residentBytes() const {
+	qsizetype total = 0;
+	for (const Entry& entry : m_entries) {
+		total += entry.document->residentBytes();
+	}
+	return total;
+}
+
+void Workspace::enforceBudget() {
+	const qint64 now = m_clock.elapsed();
+	for (Entry& entry : m_entries) {
+		Document* document = entry.document.get();
+		if (document != m_active && !document->isHibernating() && !m_reloads.contains(document)
+			&& !m_saves.contains(document) && now - entry.shownAt > kIdleMs) {
+			emit hibernated(document);
+			document->hibernate();
+		}
+	}
+	qsizetype resident = residentBytes();
+	while (resident > m_budget) {
+		Entry* oldest = nullptr;
+		for (Entry& entry : m_entries) {
+			if (entry.document.get() != m_active && !entry.document->isHibernating()
+				&& !m_reloads.contains(entry.document.get()) && !m_saves.contains(entry.document.get())
+				&& (!oldest || entry.shownAt < oldest->shownAt)) {
+				oldest = &entry;
+			}
+		}
+		if (!oldest) break;
+		Document* document = oldest->document.get();
+		const qsizetype before = document->residentBytes();
+		emit hibernated(document);
+		document->hibernate();
+		resident += document->residentBytes() - before;
+	}
+}
+
+void Workspace::watch(const QString& path) {
+	if (m_watcher && !path.isEmpty()) {
+		m_watcher->addDirectory(QFileInfo(path).absolutePath(), false);
+	}
+}
+
+void Workspace::unwatch(const QString& path) {
+	if (m_watcher && !path.isEmpty()) {
+		m_watcher->removeDirectory(QFileInfo(path).absolutePath(), false);
+	}
+}
+
+void Workspace::onFilesChanged(const FsChangeBatch& batch) {
+	QHash<QString, Document*> byPath;
+	for (const Entry& entry : m_entries) {
+		if (!entry.document->path().isEmpty()) {
+			byPath.insert(QDir::cleanPath(QFileInfo(entry.document->path()).absoluteFilePath()), entry.document.get());
+		}
+	}
+	if (byPath.isEmpty()) return;
+	// Stamps filter out our own saves and changes that cancelled out.
+	auto check = [this](Document* document) {
+		if (m_saves.contains(document)) return;
+		if (!document->isLoaded()) {
+			// The read in flight may predate the change.
+			loadDeferred(document);
+			return;
+		}
+		if (document->isChangedOnDisk() && QFileInfo::exists(document->path())) {
+			emit changedOnDisk(document);
+		}
+	};
+	for (const FsChange& change : batch) {
+		if (change.kinds & FsChange::Rescan) {
+			const QString dir = change.path + QLatin1Char('/');
+			for (auto it = byPath.cbegin(); it != byPath.cend(); ++it) {
+				if (it.key().startsWith(dir)) check(it.value());
+			}
+			continue;
+		}
+		if (!change.from.isEmpty() && !QFileInfo::exists(change.from)) {
+			if (Document* document = byPath.take(change.from); document && !byPath.contains(change.path)) {
+				unwatch(document->path());
+				document->setPath(change.path);
+				watch(change.path);
+				byPath.insert(change.path, document);
+				emit renamed(document);
+				continue;
+			}
+		}
+		if (Document* document = byPath.value(change.path)) {
+			check(document);
+		}
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <memory>
+#include <vector>
+#include "../buffer/document.h"
+#include "../buffer/lineDiff.h"
+#include "../util/fs_watcher.h"
+#include "../util/task_scheduler.h"
+
+class QTimer;
+
+// The open documents, in tab order. Documents that have not been shown for a
+// while, or the least recently shown ones once the text held in memory passes
+// the budget, hibernate; showing one again wakes it.
+class Workspace : public QObject {
+	Q_OBJECT
+public:
+	static constexpr qsizetype kDefaultBudget = 256 * 1024 * 1024;
+
+	// The watcher is not owned; each file is watched through its directory.
+	explicit Workspace(FsWatcher* watcher, QObject* parent = nullptr);
+	~Workspace() override;
+
+	qsizetype count() const { return qsizetype(m_entries.size()); }
+	Document* at(qsizetype index) const { return m_entries[std::size_t(index)].document.get(); }
+	qsizetype indexOf(const Document* document) const;
+	Document* find(const QString& path) const;
+
+	// An empty path adds an untitled document.
+	Document* open(const QString& path, QString* error = nullptr);
+	// Adds a document without reading it. The file is read and compressed on
+	// the task scheduler, or read on the spot if the document is shown first.
+	Document* openDeferred(const QString& path);
+	bool save(Document* document, const QString& path, QString* error = nullptr);
+	// Copies the text and writes it on the task scheduler; saved() or
+	// saveFailed() follows. Until then the document's file isn't checked for
+	// changes, as the write itself would show up as one.
+	void saveInBackground(Document* document, const QString& path);
+	// Brings the document in line with its file. Text appended to the file is
+	// read on the spot; anything else is diffed against the text on the task
+	// scheduler. A hibernating document is left asleep and reloaded when it is
+	// next shown.
+	void reload(Document* document);
+	void close(Document* document);
+
+	// Wakes the document, reloads it if it went stale asleep, and marks it as
+	// the one being shown.
+	void activate(Document* document);
+	Document* active() const { return m_active; }
+
+	void setMemoryBudget(qsizetype bytes);
+	qsizetype memoryBudget() const { return m_budget; }
+	qsizetype residentBytes() const;
+
+signals:
+	// Views must let go of the document's text before it is touched again.
+	void hibernated(Document* document);
+	void changedOnDisk(Document* document);
+	// Patches, last first, that turn the text into the file's. Whoever shows the
+	// document applies them; its disk state already matches the file.
+	void reloaded(Document* document, const std::vector<TextPatch>& patches);
+	void reloadFailed(Document* document, const QString& error);
+	void saved(Document* document, const QString& previousPath);
+	void saveFailed(Document* document, const QString& error);
+	// The file was moved on disk and the document followed it.
+	void renamed(Document* document);
+
+private:
+	struct Entry {
+		std::unique_ptr<Document> document;
+		qint64 shownAt = 0;
+	};
+
+	void enforceBudget();
+	void loadDeferred(Document* document);
+	void watch(const QString& path);
+	void unwatch(const QString& path);
+	void onFilesChanged(const FsChangeBatch& batch);
+
+	std::vector<Entry> m_entries;
+	Document* m_active = nullptr;
+	FsWatcher* m_watcher = nullptr;
+	QTimer* m_idleTimer = nullptr;
+	// Deferred loads in the background, reloads for the screen, and saves
+	// ahead of both.
+	TaskSequence m_tasks{TaskPriority::Background};
+	// Saves in flight per document.
+	QHash<Document*, int> m_saves;
+	// The latest reload or deferred load per document; results of older ones are dropped.
+	QHash<Document*, quint64> m_reloads;
+	quint64 m_reloadTicket = 0;
+	// Hibernating documents whose file changed since they went to sleep.
+	QSet<Document*> m_stale;
+	QElapsedTimer m_clock;
+	qsizetype m_budget = kDefaultBudget;
+};
@@ -0,0 +1,464 @@
+#include "fs_watcher.h"
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QThread>
+#include <QTimer>
+#include <algorithm>
+
+#if defined(__linux__)
+#include <QSocketNotifier>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <QFileSystemWatcher>
+#endif
+
+namespace {
+bool isUnder(const QString& path, const QString& dir) {
+	if (!path.startsWith(dir)) return false;
+	return path.size() == dir.size() || dir.endsWith(QLatin1Char('/')) || path.at(dir.size()) == QLatin1Char('/');
+}
+
+QString join(const QString& dir, const QString& name) {
+	return dir.endsWith(QLatin1Char('/')) ? dir + name : dir + QLatin1Char('/') + name;
+}
+
+#if defined(__linux__)
+constexpr uint32_t kMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO
+	| IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+// Object stores churn on every git command; git status watches the git dir itself.
+bool isSkipped(const char* name) {
+	return std::strcmp(name, ".git") == 0;
+}
+#endif
+}
+
+struct FsWatcher::State {
+	struct Pending {
+		unsigned kinds = 0;
+		QString from;
+		bool isDir = false;
+		qint64 first = 0;
+		qint64 last = 0;
+	};
+	struct RootEntry {
+		QString path;
+		bool recursive = false;
+	};
+
+	FsWatcher* owner = nullptr;
+	QObject* worker = nullptr;
+	QTimer* flushTimer = nullptr;
+	QElapsedTimer clock;
+	std::vector<RootEntry> roots;
+	QHash<QString, Pending> pending;
+	bool overflowed = false;
+#if defined(__linux__)
+	struct Move {
+		QString path;
+		bool isDir = false;
+		qint64 at = 0;
+	};
+	int fd = -1;
+	QSocketNotifier* notifier = nullptr;
+	QHash<int, QString> dirs;
+	QHash<QString, int> wds;
+	// MOVED_FROM halves waiting for the MOVED_TO with the same cookie.
+	QHash<quint32, Move> moves;
+	bool limitReported = false;
+#else
+	QFileSystemWatcher* fallback = nullptr;
+#endif
+
+	void start();
+	void stop();
+	void addRoot(const QString& path, bool recursive);
+	void removeRoot(const QString& path, bool recursive);
+	bool recursiveAt(const QString& dir) const;
+	bool covered(const QString& dir) const;
+	void queue(const QString& path, unsigned kind, bool isDir);
+	void rename(const QString& from, const QString& to, bool isDir);
+	void flush();
+	void fail(const QString& message);
+#if defined(__linux__)
+	bool addWatch(const QString& dir);
+	void addTree(const QString& dir, bool recursive, bool report);
+	// Directories below dir that a root still covers keep their watch unless
+	// the tree has left the watched area.
+	void dropWatches(const QString& dir, bool keepCovered = true);
+	void remap(const QString& from, const QString& to);
+	void readEvents();
+	void handle(const inotify_event& event);
+#endif
+};
+
+void FsWatcher::State::start() {
+	clock.start();
+	flushTimer = new QTimer(worker);
+	flushTimer->setInterval(kQuietMs / 2);
+	QObject::connect(flushTimer, &QTimer::timeout, worker, [this] { flush(); });
+#if defined(__linux__)
+	fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0) {
+		fail(QString::fromLocal8Bit(std::strerror(errno)));
+		return;
+	}
+	notifier = new QSocketNotifier(fd, QSocketNotifier::Read, worker);
+	QObject::connect(notifier, &QSocketNotifier::activated, worker, [this] { readEvents(); });
+#else
+	// Without inotify only directories are watched, each change reported as a rescan of it.
+	fallback = new QFileSystemWatcher(worker);
+	QObject::connect(fallback, &QFileSystemWatcher::directoryChanged, worker, [this](const QString& dir) {
+		queue(dir, FsChange::Rescan, true);
+	});
+#endif
+}
+
+void FsWatcher::State::stop() {
+	delete flushTimer;
+	flushTimer = nullptr;
+#if defined(__linux__)
+	delete notifier;
+	notifier = nullptr;
+	if (fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+#else
+	delete fallback;
+	fallback = nullptr;
+#endif
+}
+
+void FsWatcher::State::addRoot(const QString& path, bool recursive) {
+	roots.push_back({path, recursive});
+#if defined(__linux__)
+	if (fd >= 0) {
+		addTree(path, recursive, false);
+	}
+#else
+	if (fallback && !fallback->directories().contains(path)) {
+		fallback->addPath(path);
+	}
+#endif
+}
+
+void FsWatcher::State::removeRoot(const QString& path, bool recursive) {
+	auto it = std::find_if(roots.begin(), roots.end(),
+		[&](const RootEntry& root) { return root.path == path && root.recursive == recursive; });
+	if (it == roots.end()) return;
+	roots.erase(it);
+#if defined(__linux__)
+	dropWatches(path);
+#else
+	if (fallback && !covered(path)) {
+		fallback->removePath(path);
+	}
+#endif
+}
+
+bool FsWatcher::State::recursiveAt(const QString& dir) const {
+	return std::any_of(roots.begin(), roots.end(),
+		[&](const RootEntry& root) { return root.recursive && isUnder(dir, root.path); });
+}
+
+bool FsWatcher::State::covered(const QString& dir) const {
+	return std::any_of(roots.begin(), roots.end(),
+		[&](const RootEntry& root) { return root.path == dir || (root.recursive && isUnder(dir, root.path)); });
+}
+
+void FsWatcher::State::queue(const QString& path, unsigned kind, bool isDir) {
+	const qint64 now = clock.elapsed();
+	auto it = pending.find(path);
+	if (it == pending.end()) {
+		it = pending.insert(path, {0, {}, isDir, now, now});
+	}
+	// Created and removed between two batches: nobody needs to hear about it.
+	if (kind == FsChange::Removed && (it->kinds & FsChange::Created)
+		&& !(it->kinds & (FsChange::Removed | FsChange::Renamed))) {
+		pending.erase(it);
+		return;
+	}
+	it->kinds |= kind;
+	it->isDir = isDir;
+	it->last = now;
+	if (!flushTimer->isActive()) {
+		flushTimer->start();
+	}
+}
+
+void FsWatcher::State::rename(const QString& from, const QString& to, bool isDir) {
+	queue(from, FsChange::Removed, isDir);
+	queue(to, FsChange::Renamed, isDir);
+	pending[to].from = from;
+}
+
+void FsWatcher::State::flush() {
+	const qint64 now = clock.elapsed();
+#if defined(__linux__)
+	for (auto it = moves.begin(); it != moves.end();) {
+		if (now - it->at < kQuietMs) {
+			++it;
+			continue;
+		}
+		// Never paired up, so it was moved out of everything watched.
+		const Move move = *it;
+		it = moves.erase(it);
+		queue(move.path, FsChange::Removed, move.isDir);
+		if (move.isDir) {
+			dropWatches(move.path, false);
+		}
+	}
+#endif
+	FsChangeBatch batch;
+	if (overflowed) {
+		overflowed = false;
+		pending.clear();
+#if defined(__linux__)
+		moves.clear();
+#endif
+		for (const RootEntry& root : roots) {
+			batch.push_back({root.path, {}, FsChange::Rescan, true});
+#if defined(__linux__)
+			// Directories created while events were lost have no watch yet.
+			addTree(root.path, root.recursive, false);
+#endif
+		}
+	}
+	for (auto it = pending.begin(); it != pending.end();) {
+		if (now - it->last < kQuietMs && now - it->first < kMaxDelayMs) {
+			++it;
+			continue;
+		}
+		batch.push_back({it.key(), it->from, it->kinds, it->isDir});
+		it = pending.erase(it);
+	}
+#if defined(__linux__)
+	const bool idle = pending.isEmpty() && moves.isEmpty();
+#else
+	const bool idle = pending.isEmpty();
+#endif
+	if (idle) {
+		flushTimer->stop();
+	}
+	if (batch.empty()) return;
+	FsWatcher* target = owner;
+	QMetaObject::invokeMethod(owner, [target, batch = std::move(batch)] {
+		emit target->changed(batch);
+	}, Qt::QueuedConnection);
+}
+
+void FsWatcher::State::fail(const QString& message) {
+	FsWatcher* target = owner;
+	QMetaObject::invokeMethod(owner, [target, message] { emit target->error(message); }, Qt::QueuedConnection);
+}
+
+#if defined(__linux__)
+bool FsWatcher::State::addWatch(const QString& dir) {
+	const int wd = ::inotify_add_watch(fd, QFile::encodeName(dir).constData(), kMask);
+	if (wd < 0) {
+		if (errno == ENOSPC && !limitReported) {
+			limitReported = true;
+			fail(QStringLiteral("Out of inotify watches; raise fs.inotify.max_user_watches to watch the whole tree"));
+		}
+		return false;
+	}
+	// The same directory reached under a new path, e.g. through a rename we missed.
+	auto old = dirs.find(wd);
+	if (old != dirs.end() && *old != dir) {
+		wds.remove(*old);
+	}
+	dirs.insert(wd, dir);
+	wds.insert(dir, wd);
+	return true;
+}
+
+void FsWatcher::State::addTree(const QString& dir, bool recursive, bool report) {
+	std::vector<QString> stack{dir};
+	while (!stack.empty()) {
+		const QString path = std::move(stack.back());
+		stack.pop_back();
+		if (!addWatch(path) || (!recursive && !report)) continue;
+		DIR* handle = ::opendir(QFile::encodeName(path).constData());
+		if (!handle) continue;
+		while (const dirent* entry = ::readdir(handle)) {
+			const char* name = entry->d_name;
+			if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+			bool isDir = entry->d_type == DT_DIR;
+			if (entry->d_type == DT_UNKNOWN) {
+				struct stat st{};
+				isDir = ::fstatat(::dirfd(handle), name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+			}
+			const QString child = join(path, QFile::decodeName(name));
+			// Entries made before the watch existed produced no events of their own.
+			if (report) {
+				queue(child, FsChange::Created, isDir);
+			}
+			if (isDir && recursive && !isSkipped(name)) {
+				stack.push_back(child);
+			}
+		}
+		::closedir(handle);
+	}
+}
+
+void FsWatcher::State::dropWatches(const QString& dir, bool keepCovered) {
+	std::vector<int> dropped;
+	for (auto it = wds.cbegin(); it != wds.cend(); ++it) {
+		if (isUnder(it.key(), dir) && !(keepCovered && covered(it.key()))) {
+			dropped.push_back(it.value());
+		}
+	}
+	for (int wd : dropped) {
+		::inotify_rm_watch(fd, wd);
+		wds.remove(dirs.take(wd));
+	}
+}
+
+void FsWatcher::State::remap(const QString& from, const QString& to) {
+	QStringList moved;
+	for (auto it = wds.cbegin(); it != wds.cend(); ++it) {
+		if (isUnder(it.key(), from)) {
+			moved.append(it.key());
+		}
+	}
+	for (const QString& path : moved) {
+		const int wd = wds.take(path);
+		const QString renamed = to + path.mid(from.size());
+		dirs.insert(wd, renamed);
+		wds.insert(renamed, wd);
+	}
+}
+
+void FsWatcher::State::readEvents() {
+	alignas(inotify_event) char buffer[64 * 1024];
+	for (;;) {
+		const ssize_t n = ::read(fd, buffer, sizeof(buffer));
+		if (n <= 0) break;
+		for (const char* p = buffer; p < buffer + n;) {
+			const auto* event = reinterpret_cast<const inotify_event*>(p);
+			handle(*event);
+			p += sizeof(inotify_event) + event->len;
+		}
+	}
+	if (!moves.isEmpty() && !flushTimer->isActive()) {
+		flushTimer->start();
+	}
+}
+
+void FsWatcher::State::handle(const inotify_event& event) {
+	if (event.mask & IN_Q_OVERFLOW) {
+		overflowed = true;
+		if (!flushTimer->isActive()) {
+			flushTimer->start();
+		}
+		return;
+	}
+	if (event.mask & IN_IGNORED) {
+		const QString dir = dirs.take(event.wd);
+		if (!dir.isEmpty() && wds.value(dir, -1) == event.wd) {
+			wds.remove(dir);
+		}
+		return;
+	}
+	auto it = dirs.constFind(event.wd);
+	// Events about the watched directory itself arrive again from its parent.
+	if (it == dirs.cend() || event.len == 0) return;
+	const QString dir = *it;
+	const QString path = join(dir, QFile::decodeName(event.name));
+	const bool isDir = event.mask & IN_ISDIR;
+	const bool descend = isDir && recursiveAt(dir) && !isSkipped(event.name);
+
+	if (event.mask & IN_CREATE) {
+		queue(path, FsChange::Created, isDir);
+		if (descend) {
+			addTree(path, true, true);
+		}
+	}
+	if (event.mask & (IN_MODIFY | IN_CLOSE_WRITE)) {
+		queue(path, FsChange::Modified, isDir);
+	}
+	if (event.mask & IN_DELETE) {
+		queue(path, FsChange::Removed, isDir);
+	}
+	if (event.mask & IN_MOVED_FROM) {
+		moves.insert(event.cookie, {path, isDir, clock.elapsed()});
+	}
+	if (event.mask & IN_MOVED_TO) {
+		auto move = moves.find(event.cookie);
+		if (move == moves.end()) {
+			queue(path, FsChange::Created, isDir);
+			if (descend) {
+				addTree(path, true, true);
+			}
+			return;
+		}
+		const QString from = move->path;
+		moves.erase(move);
+		rename(from, path, isDir);
+		if (isDir) {
+			remap(from, path);
+			if (descend) {
+				addTree(path, true, false);
+			} else {
+				dropWatches(path);
+			}
+		}
+	}
+}
+#endif
+
+FsWatcher::FsWatcher(QObject* parent) : QObject(parent), m_state(new State) {
+	m_thread = new QThread(this);
+	m_thread->setObjectName(QStringLiteral("fs-watcher"));
+	m_worker = new QObject;
+	m_worker->moveToThread(m_thread);
+	m_thread->start(QThread::LowPriority);
+
+	State* state = m_state.get();
+	state->owner = this;
+	state->worker = m_worker;
+	QMetaObject::invokeMethod(m_worker, [state] { state->start(); }, Qt::QueuedConnection);
+}
+
+FsWatcher::~FsWatcher() {
+	State* state = m_state.get();
+	QMetaObject::invokeMethod(m_worker, [state] { state->stop(); }, Qt::BlockingQueuedConnection);
+	m_thread->quit();
+	m_thread->wait();
+	delete m_worker;
+}
+
+void FsWatcher::addDirectory(const QString& dir, bool recursive) {
+	if (dir.isEmpty()) return;
+	const QString path = QDir::cleanPath(QFileInfo(dir).absoluteFilePath());
+	auto it = std::find_if(m_roots.begin(), m_roots.end(),
+		[&](const Root& root) { return root.path == path && root.recursive == recursive; });
+	if (it != m_roots.end()) {
+		++it->refs;
+		return;
+	}
+	m_roots.push_back({path, recursive, 1});
+	State* state = m_state.get();
+	QMetaObject::invokeMethod(m_worker, [state, path, recursive] { state->addRoot(path, recursive); }, Qt::QueuedConnection);
+}
+
+void FsWatcher::removeDirectory(const QString& dir, bool recursive) {
+	if (dir.isEmpty()) return;
+	const QString path = QDir::cleanPath(QFileInfo(dir).absoluteFilePath());
+	auto it = std::find_if(m_roots.begin(), m_roots.end(),
+		[&](const Root& root) { return root.path == path && root.recursive == recursive; });
+	if (it == m_roots.end() || --it->refs > 0) return;
+	m_roots.erase(it);
+	State* state = m_state.get();
+	QMetaObject::invokeMethod(m_worker, [state, path, recursive] { state->removeRoot(path, recursive); }, Qt::QueuedConnection);
+}
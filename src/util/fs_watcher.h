@@ -0,0 +1,63 @@
+#pragma once
+#include <QObject>
+#include <QString>
+#include <memory>
+#include <vector>
+
+class QThread;
+
+struct FsChange {
+	enum Kind : unsigned {
+		Modified = 1u << 0,
+		Created = 1u << 1,
+		Removed = 1u << 2,
+		// Moved here from `from`.
+		Renamed = 1u << 3,
+		// Events below path were lost; anything under it may have changed.
+		Rescan = 1u << 4,
+	};
+
+	QString path;
+	QString from;
+	unsigned kinds = 0;
+	bool isDir = false;
+};
+using FsChangeBatch = std::vector<FsChange>;
+
+// One watcher for every subscriber. On Linux a single inotify descriptor is
+// read on a worker thread, and watches are per directory, so the cost grows
+// with the number of directories rather than files. Events for a path are
+// merged until it has been quiet for a moment and then delivered together
+// with the other settled paths as one batch.
+class FsWatcher : public QObject {
+	Q_OBJECT
+public:
+	static constexpr int kQuietMs = 100;
+	// A path that keeps changing is still reported this often.
+	static constexpr int kMaxDelayMs = 1000;
+
+	explicit FsWatcher(QObject* parent = nullptr);
+	~FsWatcher() override;
+
+	// Reference counted. A single file is watched through its directory, which
+	// survives saves that replace the file. Recursive watches skip .git.
+	void addDirectory(const QString& dir, bool recursive);
+	void removeDirectory(const QString& dir, bool recursive);
+
+signals:
+	void changed(const FsChangeBatch& batch);
+	void error(const QString& message);
+
+private:
+	struct Root {
+		QString path;
+		bool recursive = false;
+		int refs = 0;
+	};
+	struct State;
+
+	QThread* m_thread = nullptr;
+	QObject* m_worker = nullptr;
+	std::unique_ptr<State> m_state;
+	std::vector<Root> m_roots;
+};
@@ -0,0 +1,44 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+int LatencyHistogram::bucketOf(quint64 value) {
+	if (value < quint64(2 * kSub)) return int(value);
+	value = std::min<quint64>(value, 0xffffffffu);
+	const int shift = std::bit_width(value) - 1 - kSubBits;
+	return (shift + 1) * kSub + int(value >> shift) - kSub;
+}
+
+qint64 LatencyHistogram::upperBound(int bucket) {
+	if (bucket < 2 * kSub) return bucket;
+	const int shift = bucket / kSub - 1;
+	const qint64 lower = qint64(kSub + bucket % kSub) << shift;
+	return lower + (qint64(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(qint64 value) {
+	value = std::max<qint64>(value, 0);
+	++m_counts[std::size_t(bucketOf(quint64(value)))];
+	++m_count;
+	m_sum += value;
+	m_max = std::max(m_max, value);
+}
+
+void LatencyHistogram::clear() {
+	m_counts.fill(0);
+	m_count = 0;
+	m_sum = 0;
+	m_max = 0;
+}
+
+qint64 LatencyHistogram::percentile(double p) const {
+	if (m_count == 0) return 0;
+	const qint64 rank = std::max<qint64>(1, qint64(std::ceil(std::clamp(p, 0.0, 100.0) / 100.0 * double(m_count))));
+	qint64 seen = 0;
+	for (int bucket = 0; bucket < kBuckets; ++bucket) {
+		seen += m_counts[std::size_t(bucket)];
+		if (seen >= rank) return std::min(upperBound(bucket), m_max);
+	}
+	return m_max;
+}
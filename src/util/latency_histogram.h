@@ -0,0 +1,34 @@
+#pragma once
+#include <QtGlobal>
+#include <array>
+
+// Fixed-size log-linear histogram in the manner of HdrHistogram: values below
+// 2 * kSub are counted exactly and every power of two above that is split
+// into kSub buckets, so any value is reported within about 3% and recording
+// is a couple of bit operations. Values are in whatever unit the caller uses;
+// anything past 2^32 lands in the last bucket.
+class LatencyHistogram {
+public:
+	static constexpr int kSubBits = 5;
+	static constexpr int kSub = 1 << kSubBits;
+	static constexpr int kBuckets = (32 - kSubBits + 1) * kSub;
+
+	void record(qint64 value);
+	void clear();
+
+	qint64 count() const { return m_count; }
+	qint64 max() const { return m_max; }
+	double mean() const { return m_count ? double(m_sum) / double(m_count) : 0.0; }
+	// The highest value equivalent to the one at the given percentile (0-100),
+	// never above the largest recorded.
+	qint64 percentile(double p) const;
+
+private:
+	static int bucketOf(quint64 value);
+	static qint64 upperBound(int bucket);
+
+	std::array<qint64, kBuckets> m_counts{};
+	qint64 m_count = 0;
+	qint64 m_sum = 0;
+	qint64 m_max = 0;
+};
@@ -0,0 +1,184 @@
+#include "session_file.h"
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <cstring>
+#include <utility>
+
+namespace {
+constexpr char kMagic[8] = {'I', 'D', 'E', 'S', 'E', 'S', 'S', '\0'};
+
+// Offsets into the header.
+enum : quint32 {
+	kMagicAt = 0,
+	kMajorAt = 8,
+	kMinorAt = 10,
+	kHeaderSizeAt = 12,
+	kDocumentCountAt = 16,
+	kDocumentSizeAt = 20,
+	kRecentCountAt = 24,
+	kRecentSizeAt = 28,
+	kActiveAt = 32,
+	kStringBytesAt = 36,
+	kChecksumAt = 40,
+	kHeaderSize = 44,
+};
+// Offsets into a document record.
+enum : quint32 {
+	kPathOffsetAt = 0,
+	kPathLengthAt = 4,
+	kCursorAt = 8,
+	kAnchorAt = 16,
+	kFirstLineAt = 24,
+	kDocumentSize = 32,
+};
+// A recent file record is a string's offset and length.
+constexpr quint32 kRecentSize = 8;
+
+template <typename T>
+T load(const uchar* data, quint32 at) {
+	return qFromLittleEndian<T>(data + at);
+}
+
+template <typename T>
+void store(QByteArray& out, qsizetype at, T value) {
+	qToLittleEndian<T>(value, out.data() + at);
+}
+
+bool fail(QString* error, const QString& message) {
+	if (error) {
+		*error = message;
+	}
+	return false;
+}
+}
+
+QString SessionFile::defaultPath() {
+	return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/session.bin");
+}
+
+bool SessionFile::read(const QString& path, Session* session, QString* error) {
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return fail(error, file.errorString());
+	}
+	const qint64 size = file.size();
+	if (size < kHeaderSize) {
+		return fail(error, QStringLiteral("Session file is truncated"));
+	}
+	const uchar* data = file.map(0, size);
+	if (!data) {
+		return fail(error, file.errorString());
+	}
+	if (std::memcmp(data + kMagicAt, kMagic, sizeof(kMagic)) != 0) {
+		return fail(error, QStringLiteral("Not a session file"));
+	}
+	if (load<quint16>(data, kMajorAt) != kMajor) {
+		return fail(error, QStringLiteral("Unsupported session file version %1").arg(load<quint16>(data, kMajorAt)));
+	}
+	const quint32 headerSize = load<quint32>(data, kHeaderSizeAt);
+	const quint32 documentCount = load<quint32>(data, kDocumentCountAt);
+	const quint32 documentSize = load<quint32>(data, kDocumentSizeAt);
+	const quint32 recentCount = load<quint32>(data, kRecentCountAt);
+	const quint32 recentSize = load<quint32>(data, kRecentSizeAt);
+	const quint32 stringBytes = load<quint32>(data, kStringBytesAt);
+	// 64-bit sums of 32-bit products can't overflow.
+	const quint64 documentsAt = headerSize;
+	const quint64 recentAt = documentsAt + quint64(documentCount) * documentSize;
+	const quint64 stringsAt = recentAt + quint64(recentCount) * recentSize;
+	if (headerSize < kHeaderSize || documentSize < kDocumentSize || recentSize < kRecentSize
+		|| stringsAt + stringBytes != quint64(size)) {
+		return fail(error, QStringLiteral("Session file is corrupt"));
+	}
+	const QByteArrayView body(reinterpret_cast<const char*>(data) + headerSize, size - headerSize);
+	if (qChecksum(body) != load<quint32>(data, kChecksumAt)) {
+		return fail(error, QStringLiteral("Session file is corrupt"));
+	}
+	const char* strings = reinterpret_cast<const char*>(data + stringsAt);
+	auto string = [&](const uchar* record, QString* out) {
+		const quint32 offset = load<quint32>(record, 0);
+		const quint32 length = load<quint32>(record, 4);
+		if (quint64(offset) + length > stringBytes) return false;
+		*out = QString::fromUtf8(strings + offset, length);
+		return true;
+	};
+
+	Session result;
+	result.documents.reserve(documentCount);
+	for (quint32 i = 0; i < documentCount; ++i) {
+		const uchar* record = data + documentsAt + quint64(i) * documentSize;
+		SessionDocument document;
+		if (!string(record + kPathOffsetAt, &document.path)) {
+			return fail(error, QStringLiteral("Session file is corrupt"));
+		}
+		document.cursor = load<qint64>(record, kCursorAt);
+		document.anchor = load<qint64>(record, kAnchorAt);
+		document.firstLine = load<qint64>(record, kFirstLineAt);
+		result.documents.push_back(std::move(document));
+	}
+	result.recent.reserve(recentCount);
+	for (quint32 i = 0; i < recentCount; ++i) {
+		QString recent;
+		if (!string(data + recentAt + quint64(i) * recentSize, &recent)) {
+			return fail(error, QStringLiteral("Session file is corrupt"));
+		}
+		result.recent.append(recent);
+	}
+	const qint32 active = load<qint32>(data, kActiveAt);
+	result.active = active >= 0 && quint32(active) < documentCount ? active : -1;
+	*session = std::move(result);
+	return true;
+}
+
+bool SessionFile::write(const QString& path, const Session& session, QString* error) {
+	QByteArray strings;
+	auto intern = [&strings](const QString& text) {
+		const quint32 offset = quint32(strings.size());
+		strings += text.toUtf8();
+		return std::pair(offset, quint32(strings.size()) - offset);
+	};
+	const qsizetype documentsAt = kHeaderSize;
+	const qsizetype recentAt = documentsAt + qsizetype(session.documents.size()) * kDocumentSize;
+	const qsizetype stringsAt = recentAt + session.recent.size() * kRecentSize;
+	QByteArray out(stringsAt, '\0');
+	for (std::size_t i = 0; i < session.documents.size(); ++i) {
+		const SessionDocument& document = session.documents[i];
+		const qsizetype at = documentsAt + qsizetype(i) * kDocumentSize;
+		const auto [offset, length] = intern(document.path);
+		store<quint32>(out, at + kPathOffsetAt, offset);
+		store<quint32>(out, at + kPathLengthAt, length);
+		store<qint64>(out, at + kCursorAt, document.cursor);
+		store<qint64>(out, at + kAnchorAt, document.anchor);
+		store<qint64>(out, at + kFirstLineAt, document.firstLine);
+	}
+	for (qsizetype i = 0; i < session.recent.size(); ++i) {
+		const qsizetype at = recentAt + i * kRecentSize;
+		const auto [offset, length] = intern(session.recent[i]);
+		store<quint32>(out, at, offset);
+		store<quint32>(out, at + 4, length);
+	}
+	out += strings;
+
+	std::memcpy(out.data() + kMagicAt, kMagic, sizeof(kMagic));
+	store<quint16>(out, kMajorAt, kMajor);
+	store<quint16>(out, kMinorAt, kMinor);
+	store<quint32>(out, kHeaderSizeAt, kHeaderSize);
+	store<quint32>(out, kDocumentCountAt, quint32(session.documents.size()));
+	store<quint32>(out, kDocumentSizeAt, kDocumentSize);
+	store<quint32>(out, kRecentCountAt, quint32(session.recent.size()));
+	store<quint32>(out, kRecentSizeAt, kRecentSize);
+	store<qint32>(out, kActiveAt, session.active);
+	store<quint32>(out, kStringBytesAt, quint32(strings.size()));
+	store<quint32>(out, kChecksumAt, qChecksum(QByteArrayView(out).sliced(kHeaderSize)));
+
+	QDir().mkpath(QFileInfo(path).absolutePath());
+	QSaveFile file(path);
+	if (!file.open(QIODevice::WriteOnly) || file.write(out) != out.size() || !file.commit()) {
+		return fail(error, file.errorString());
+	}
+	return true;
+}
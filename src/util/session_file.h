@@ -0,0 +1,33 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <vector>
+
+struct SessionDocument {
+	QString path;
+	qint64 cursor = 0;
+	qint64 anchor = 0;
+	qint64 firstLine = 0;
+};
+
+struct Session {
+	std::vector<SessionDocument> documents;
+	// Index into documents, or -1.
+	qint32 active = -1;
+	QStringList recent;
+};
+
+// Binary session file, parsed straight out of a memory map. A fixed header is
+// followed by fixed-size document and recent file records and a UTF-8 string
+// table they point into. Header and records carry their own sizes, so a newer
+// minor version can append fields older readers skip; a different major
+// version is refused.
+namespace SessionFile {
+	constexpr quint16 kMajor = 1;
+	constexpr quint16 kMinor = 0;
+
+	QString defaultPath();
+	bool read(const QString& path, Session* session, QString* error = nullptr);
+	// Replaces the file atomically.
+	bool write(const QString& path, const Session& session, QString* error = nullptr);
+}
@@ -0,0 +1,30 @@
+#include "startup_timing.h"
+#include <QElapsedTimer>
+#include <QStringList>
+
+namespace {
+QElapsedTimer g_clock;
+std::vector<StartupTiming::Mark> g_marks;
+}
+
+void StartupTiming::begin() {
+	g_clock.start();
+	g_marks.clear();
+}
+
+void StartupTiming::mark(const char* phase) {
+	if (!g_clock.isValid()) return;
+	g_marks.push_back({phase, g_clock.elapsed()});
+}
+
+const std::vector<StartupTiming::Mark>& StartupTiming::marks() {
+	return g_marks;
+}
+
+QString StartupTiming::summary() {
+	QStringList parts;
+	for (const Mark& mark : g_marks) {
+		parts.append(QStringLiteral("%1 %2 ms").arg(QLatin1StringView(mark.phase)).arg(mark.ms));
+	}
+	return parts.join(QStringLiteral(", "));
+}
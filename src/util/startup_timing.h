@@ -0,0 +1,20 @@
+#pragma once
+#include <QString>
+#include <QtGlobal>
+#include <vector>
+
+// Milestones of one launch, timed from the start of main(). Used from the GUI
+// thread only.
+namespace StartupTiming {
+	struct Mark {
+		// A string literal.
+		const char* phase;
+		qint64 ms;
+	};
+
+	void begin();
+	void mark(const char* phase);
+	const std::vector<Mark>& marks();
+	// One line, e.g. "window 41 ms, first paint 88 ms".
+	QString summary();
+}
@@ -0,0 +1,338 @@
+#include "task_scheduler.h"
+#include "trace.h"
+#include <QThread>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+// String literals, as spans keep only the pointer.
+constexpr std::array<const char*, TaskScheduler::kPriorities> kSpanNames{
+	"task.interactive", "task.visible", "task.background", "task.idle"};
+
+thread_local const TaskScheduler* t_scheduler = nullptr;
+thread_local int t_worker = -1;
+
+qint64 nowMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int defaultMaxRunning(int priority, int threads) {
+	switch (TaskPriority(priority)) {
+	case TaskPriority::Background:
+		return std::max(1, threads - 1);
+	case TaskPriority::Idle:
+		return 1;
+	default:
+		return threads;
+	}
+}
+}
+
+// On its own cache line, as every worker locks the others' to steal.
+struct alignas(64) TaskScheduler::Worker {
+	std::mutex mutex;
+	std::array<std::deque<Queued>, kPriorities> queues;
+	std::unique_ptr<QThread> thread;
+};
+
+TaskScheduler::TaskScheduler() : TaskScheduler(Config()) {}
+
+TaskScheduler::TaskScheduler(const Config& config) {
+	const int threads = config.threads > 0 ? config.threads : std::max(1, QThread::idealThreadCount());
+	for (int p = 0; p < kPriorities; ++p) {
+		const int max = config.maxRunning[p] > 0 ? config.maxRunning[p] : defaultMaxRunning(p, threads);
+		m_maxRunning[p] = std::min(max, threads);
+	}
+	for (int i = 0; i < threads; ++i) {
+		m_workers.push_back(std::make_unique<Worker>());
+	}
+	// Started once all exist, as each steals from the others.
+	for (int i = 0; i < threads; ++i) {
+		Worker& worker = *m_workers[i];
+		worker.thread.reset(QThread::create([this, i] { run(i); }));
+		worker.thread->setObjectName(QStringLiteral("task-%1").arg(i));
+		worker.thread->start();
+	}
+}
+
+TaskScheduler::~TaskScheduler() {
+	{
+		const std::lock_guard lock(m_wakeMutex);
+		m_stopping = true;
+		++m_epoch;
+	}
+	m_wakeCondition.notify_all();
+	for (const std::unique_ptr<Worker>& worker : m_workers) {
+		worker->thread->wait();
+	}
+}
+
+TaskScheduler& TaskScheduler::shared() {
+	static TaskScheduler scheduler([] {
+		Config config;
+		config.threads = qEnvironmentVariableIntValue("IDE_TASK_THREADS");
+		return config;
+	}());
+	return scheduler;
+}
+
+int TaskScheduler::maxRunning(TaskPriority priority) const {
+	return m_maxRunning[int(priority)];
+}
+
+void TaskScheduler::setMaxRunning(TaskPriority priority, int count) {
+	const int p = int(priority);
+	m_maxRunning[p] = std::clamp(count > 0 ? count : defaultMaxRunning(p, threadCount()), 1, threadCount());
+	wake(true);
+}
+
+bool TaskScheduler::submit(TaskPriority priority, Task task) {
+	if (m_stopping) return false;
+	const int p = int(priority);
+	Queued item{std::move(task), nowMicros()};
+	if (t_scheduler == this) {
+		Worker& own = *m_workers[t_worker];
+		const std::lock_guard lock(own.mutex);
+		own.queues[p].push_back(std::move(item));
+	} else {
+		const std::lock_guard lock(m_sharedMutex);
+		m_shared[p].push_back(std::move(item));
+	}
+	++m_queued[p];
+	IDE_TRACE_COUNTER("task.queued", m_queued[p].load());
+	wake();
+	return true;
+}
+
+LatencyHistogram TaskScheduler::waitTimes(TaskPriority priority) const {
+	const std::lock_guard lock(m_statsMutex);
+	return m_waits[int(priority)];
+}
+
+void TaskScheduler::resetStats() {
+	const std::lock_guard lock(m_statsMutex);
+	for (LatencyHistogram& waits : m_waits) {
+		waits.clear();
+	}
+}
+
+void TaskScheduler::run(int self) {
+	t_scheduler = this;
+	t_worker = self;
+	for (;;) {
+		const quint64 seen = m_epoch;
+		if (m_stopping) return;
+		Queued item;
+		int p = 0;
+		if (!take(self, &item, &p)) {
+			std::unique_lock lock(m_wakeMutex);
+			m_wakeCondition.wait(lock, [&] { return m_epoch != seen; });
+			continue;
+		}
+		{
+			const std::lock_guard lock(m_statsMutex);
+			m_waits[p].record(nowMicros() - item.queuedAt);
+		}
+		{
+			IDE_TRACE_SPAN(kSpanNames[p]);
+			item.task();
+		}
+		item.task = nullptr;
+		// A capped priority that was full may have more waiting for the slot.
+		if (m_running[p].fetch_sub(1) >= m_maxRunning[p] && m_queued[p] > 0) {
+			wake();
+		}
+	}
+}
+
+bool TaskScheduler::take(int self, Queued* item, int* priority) {
+	for (int p = 0; p < kPriorities; ++p) {
+		if (m_queued[p] == 0) continue;
+		// Claim a slot first, so the cap holds however many workers race here.
+		int running = m_running[p];
+		bool claimed = false;
+		while (running < m_maxRunning[p]) {
+			if (m_running[p].compare_exchange_weak(running, running + 1)) {
+				claimed = true;
+				break;
+			}
+		}
+		if (!claimed) continue;
+		if (takeFrom(self, p, item)) {
+			--m_queued[p];
+			*priority = p;
+			return true;
+		}
+		// Someone else got the task; another worker may have given up on the
+		// slot while it was held.
+		--m_running[p];
+		if (m_queued[p] > 0) wake();
+	}
+	return false;
+}
+
+bool TaskScheduler::takeFrom(int self, int priority, Queued* item) {
+	{
+		Worker& own = *m_workers[self];
+		const std::lock_guard lock(own.mutex);
+		std::deque<Queued>& queue = own.queues[priority];
+		if (!queue.empty()) {
+			*item = std::move(queue.back());
+			queue.pop_back();
+			return true;
+		}
+	}
+	{
+		const std::lock_guard lock(m_sharedMutex);
+		std::deque<Queued>& queue = m_shared[priority];
+		if (!queue.empty()) {
+			*item = std::move(queue.front());
+			queue.pop_front();
+			return true;
+		}
+	}
+	const int workers = threadCount();
+	for (int step = 1; step < workers; ++step) {
+		Worker& victim = *m_workers[(self + step) % workers];
+		const std::lock_guard lock(victim.mutex);
+		std::deque<Queued>& queue = victim.queues[priority];
+		if (!queue.empty()) {
+			*item = std::move(queue.front());
+			queue.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void TaskScheduler::wake(bool all) {
+	{
+		const std::lock_guard lock(m_wakeMutex);
+		++m_epoch;
+	}
+	if (all) {
+		m_wakeCondition.notify_all();
+	} else {
+		m_wakeCondition.notify_one();
+	}
+}
+
+LatestTask::LatestTask(TaskPriority priority, TaskScheduler* scheduler)
+	: m_state(std::make_shared<State>()), m_scheduler(scheduler ? scheduler : &TaskScheduler::shared()),
+	  m_priority(priority) {}
+
+LatestTask::~LatestTask() {
+	std::unique_lock lock(m_state->mutex);
+	m_state->token.cancel();
+	m_state->pending = nullptr;
+	m_state->idle.wait(lock, [this] { return !m_state->scheduled; });
+}
+
+void LatestTask::submit(Job job) {
+	{
+		const std::lock_guard lock(m_state->mutex);
+		m_state->token.cancel();
+		m_state->token = CancelToken();
+		m_state->pending = std::move(job);
+		if (m_state->scheduled) return;
+		m_state->scheduled = true;
+	}
+	schedule(m_scheduler, m_priority, m_state);
+}
+
+void LatestTask::cancel() {
+	const std::lock_guard lock(m_state->mutex);
+	m_state->token.cancel();
+	m_state->pending = nullptr;
+}
+
+void LatestTask::schedule(TaskScheduler* scheduler, TaskPriority priority, std::shared_ptr<State> state) {
+	const bool queued = scheduler->submit(priority, [scheduler, priority, state] {
+		Job job;
+		CancelToken token;
+		{
+			const std::lock_guard lock(state->mutex);
+			job = std::move(state->pending);
+			state->pending = nullptr;
+			token = state->token;
+		}
+		if (job && !token.isCancelled()) job(token);
+		{
+			const std::lock_guard lock(state->mutex);
+			if (!state->pending) {
+				state->scheduled = false;
+				state->idle.notify_all();
+				return;
+			}
+		}
+		// A newer job came while this one ran.
+		schedule(scheduler, priority, state);
+	});
+	if (!queued) {
+		const std::lock_guard lock(state->mutex);
+		state->pending = nullptr;
+		state->scheduled = false;
+		state->idle.notify_all();
+	}
+}
+
+TaskSequence::TaskSequence(TaskPriority priority, TaskScheduler* scheduler)
+	: m_state(std::make_shared<State>()), m_scheduler(scheduler ? scheduler : &TaskScheduler::shared()),
+	  m_priority(priority) {}
+
+TaskSequence::~TaskSequence() {
+	stop();
+}
+
+void TaskSequence::submit(TaskPriority priority, TaskScheduler::Task task) {
+	{
+		const std::lock_guard lock(m_state->mutex);
+		if (m_state->stopped) return;
+		m_state->tasks[int(priority)].push_back(std::move(task));
+	}
+	schedule(m_scheduler, priority, m_state);
+}
+
+void TaskSequence::stop() {
+	std::unique_lock lock(m_state->mutex);
+	m_state->stopped = true;
+	for (std::deque<TaskScheduler::Task>& tasks : m_state->tasks) {
+		tasks.clear();
+	}
+	m_state->idle.wait(lock, [this] { return !m_state->running; });
+}
+
+int TaskSequence::State::highest() const {
+	for (int p = 0; p < TaskScheduler::kPriorities; ++p) {
+		if (!tasks[p].empty()) return p;
+	}
+	return -1;
+}
+
+// Every submit schedules a run at the task's priority. A run that finds a
+// task busy, or one of a higher priority queued, does nothing: the run that
+// takes that task schedules the next when it ends.
+void TaskSequence::schedule(TaskScheduler* scheduler, TaskPriority priority, std::shared_ptr<State> state) {
+	const int p = int(priority);
+	scheduler->submit(priority, [scheduler, p, state] {
+		TaskScheduler::Task task;
+		{
+			const std::lock_guard lock(state->mutex);
+			if (state->running || state->highest() != p) return;
+			state->running = true;
+			task = std::move(state->tasks[p].front());
+			state->tasks[p].pop_front();
+		}
+		task();
+		task = nullptr;
+		int next;
+		{
+			const std::lock_guard lock(state->mutex);
+			state->running = false;
+			state->idle.notify_all();
+			next = state->highest();
+		}
+		if (next >= 0) schedule(scheduler, TaskPriority(next), state);
+	});
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <QMetaObject>
+#include <QObject>
+#include <QtGlobal>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "latency_histogram.h"
+
+class QThread;
+
+enum class TaskPriority : quint8 {
+	// Work the user is waiting on, such as the answer to a key press.
+	Interactive,
+	// Results for what is on screen.
+	Visible,
+	Background,
+	// One at a time unless configured otherwise.
+	Idle,
+};
+
+// Cooperative cancellation: the task checks it between steps and returns
+// early once it is set. Copies share one flag.
+class CancelToken {
+public:
+	CancelToken() : m_flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+	bool isCancelled() const { return m_flag->load(std::memory_order_relaxed); }
+	void cancel() const { m_flag->store(true, std::memory_order_relaxed); }
+
+private:
+	std::shared_ptr<std::atomic<bool>> m_flag;
+};
+
+// Thread pool shared by the background work of the whole application. Each
+// worker keeps a queue per priority; tasks submitted from a worker go to its
+// own queue and are taken newest first, the rest go to a shared one, and an
+// idle worker steals the oldest task of another. Workers always take the
+// highest priority they can, and each priority has a cap on how many of its
+// tasks run at once, so background work never takes every thread and a task
+// for the user starts as soon as one is free.
+//
+// How long tasks wait between submit and start is kept per priority.
+class TaskScheduler {
+public:
+	static constexpr int kPriorities = 4;
+
+	struct Config {
+		// 0 for one per core.
+		int threads = 0;
+		// Tasks of each priority that may run at once. 0 picks the default:
+		// every thread, one fewer for Background, and one for Idle.
+		std::array<int, kPriorities> maxRunning{};
+	};
+	using Task = std::function<void()>;
+
+	TaskScheduler();
+	explicit TaskScheduler(const Config& config);
+	// Tasks still queued are dropped; running ones are waited for.
+	~TaskScheduler();
+
+	// Created on first use. IDE_TASK_THREADS sets its thread count.
+	static TaskScheduler& shared();
+
+	int threadCount() const { return int(m_workers.size()); }
+	int maxRunning(TaskPriority priority) const;
+	void setMaxRunning(TaskPriority priority, int count);
+
+	// False once the scheduler is being destroyed; the task is dropped.
+	bool submit(TaskPriority priority, Task task);
+
+	// Runs fn on the thread of context, unless context is gone by then.
+	template <typename Fn>
+	static void postTo(QObject* context, Fn&& fn) {
+		QMetaObject::invokeMethod(context, std::forward<Fn>(fn), Qt::QueuedConnection);
+	}
+
+	// Microseconds from submit to start.
+	LatencyHistogram waitTimes(TaskPriority priority) const;
+	void resetStats();
+
+private:
+	struct Queued {
+		Task task;
+		qint64 queuedAt = 0;
+	};
+	struct Worker;
+
+	void run(int self);
+	bool take(int self, Queued* item, int* priority);
+	bool takeFrom(int self, int priority, Queued* item);
+	void wake(bool all = false);
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::array<std::atomic<int>, kPriorities> m_maxRunning{};
+	std::array<std::atomic<int>, kPriorities> m_running{};
+	std::array<std::atomic<int>, kPriorities> m_queued{};
+
+	std::mutex m_sharedMutex;
+	std::array<std::deque<Queued>, kPriorities> m_shared;
+
+	// Bumped under the mutex whenever there may be new work to take.
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCondition;
+	std::atomic<quint64> m_epoch{0};
+	std::atomic<bool> m_stopping{false};
+
+	mutable std::mutex m_statsMutex;
+	std::array<LatencyHistogram, kPriorities> m_waits;
+};
+
+// Runs only the newest of the jobs given to it, for work redone on every
+// keystroke: a submit cancels the job before it, and one that has not started
+// is dropped. Jobs never overlap, so they may share state.
+class LatestTask {
+public:
+	using Job = std::function<void(const CancelToken& token)>;
+
+	// Runs on the shared scheduler without one.
+	explicit LatestTask(TaskPriority priority, TaskScheduler* scheduler = nullptr);
+	// Cancels and waits for a running job.
+	~LatestTask();
+
+	void submit(Job job);
+	void cancel();
+
+private:
+	struct State {
+		std::mutex mutex;
+		std::condition_variable idle;
+		Job pending;
+		CancelToken token;
+		// A job is queued or running.
+		bool scheduled = false;
+	};
+
+	static void schedule(TaskScheduler* scheduler, TaskPriority priority, std::shared_ptr<State> state);
+
+	std::shared_ptr<State> m_state;
+	TaskScheduler* m_scheduler;
+	TaskPriority m_priority;
+};
+
+// Runs the tasks given to it one at a time, for work on state that isn't
+// thread-safe: the highest priority first, and in order within each. A task
+// only ever runs in a slot of its own priority, so background work keeps to
+// its cap, and one for the screen queued behind background work starts as
+// soon as the task running ends.
+class TaskSequence {
+public:
+	// Runs on the shared scheduler without one.
+	explicit TaskSequence(TaskPriority priority, TaskScheduler* scheduler = nullptr);
+	~TaskSequence();
+
+	void submit(TaskScheduler::Task task) { submit(m_priority, std::move(task)); }
+	void submit(TaskPriority priority, TaskScheduler::Task task);
+	// Drops the queued tasks and waits for a running one; later submits are
+	// ignored.
+	void stop();
+
+private:
+	struct State {
+		std::mutex mutex;
+		std::condition_variable idle;
+		std::array<std::deque<TaskScheduler::Task>, TaskScheduler::kPriorities> tasks;
+		bool running = false;
+		bool stopped = false;
+
+		// The highest priority with a task queued, or -1.
+		int highest() const;
+	};
+
+	static void schedule(TaskScheduler* scheduler, TaskPriority priority, std::shared_ptr<State> state);
+
+	std::shared_ptr<State> m_state;
+	TaskScheduler* m_scheduler;
+	TaskPriority m_priority;
+};
@@ -0,0 +1,231 @@
+#include "trace.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <QThread>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Trace::detail::enabled{false};
+
+namespace {
+struct Event {
+	const char* name;
+	std::int64_t begin;
+	// The end for spans, the value for counters.
+	std::int64_t end;
+	bool counter;
+};
+
+constexpr std::size_t kChunkEvents = 16 * 1024;
+// About 32 MiB of events per thread; later ones are dropped.
+constexpr int kMaxChunks = 64;
+
+struct Chunk {
+	Event events[kChunkEvents];
+	std::atomic<std::size_t> count{0};
+	std::atomic<Chunk*> next{nullptr};
+};
+
+// Appended to by its thread only. Readers walk the chunks and read each up to
+// its published count. Chunks are kept when a new session starts and filled
+// again from the first.
+struct ThreadBuffer {
+	int tid = 0;
+	QString name;
+	Chunk* head = nullptr;
+	Chunk* tail = nullptr;
+	int chunks = 1;
+	// The session the events are from.
+	unsigned session = 0;
+	std::atomic<bool> exited{false};
+
+	~ThreadBuffer() {
+		for (Chunk* chunk = head; chunk;) {
+			Chunk* next = chunk->next.load(std::memory_order_relaxed);
+			delete chunk;
+			chunk = next;
+		}
+	}
+};
+
+// Marks the thread's buffer for reclaiming once the thread exits.
+struct ThreadSlot {
+	std::shared_ptr<ThreadBuffer> buffer;
+
+	~ThreadSlot() {
+		if (buffer) buffer->exited.store(true, std::memory_order_release);
+	}
+};
+
+const auto g_epoch = std::chrono::steady_clock::now();
+std::atomic<std::int64_t> g_sessionStart{0};
+std::atomic<unsigned> g_session{0};
+std::mutex g_registryMutex;
+// Buffers of exited threads stay until the next start(), so their events can
+// still be exported.
+std::vector<std::shared_ptr<ThreadBuffer>> g_registry;
+int g_nextTid = 1;
+
+ThreadBuffer* threadBuffer() {
+	thread_local ThreadSlot slot;
+	if (slot.buffer) return slot.buffer.get();
+	auto owned = std::make_shared<ThreadBuffer>();
+	QThread* thread = QThread::currentThread();
+	owned->name = thread->objectName();
+	if (owned->name.isEmpty() && QCoreApplication::instance() && QCoreApplication::instance()->thread() == thread) {
+		owned->name = QStringLiteral("main");
+	}
+	owned->head = owned->tail = new Chunk;
+	owned->session = g_session.load(std::memory_order_relaxed);
+	std::lock_guard lock(g_registryMutex);
+	owned->tid = g_nextTid++;
+	if (owned->name.isEmpty()) {
+		owned->name = QStringLiteral("thread %1").arg(owned->tid);
+	}
+	g_registry.push_back(owned);
+	slot.buffer = std::move(owned);
+	return slot.buffer.get();
+}
+
+void rewind(ThreadBuffer* buffer, unsigned session) {
+	for (Chunk* chunk = buffer->head; chunk; chunk = chunk->next.load(std::memory_order_relaxed)) {
+		chunk->count.store(0, std::memory_order_release);
+	}
+	buffer->tail = buffer->head;
+	buffer->chunks = 1;
+	buffer->session = session;
+}
+
+void append(const Event& event) {
+	ThreadBuffer* buffer = threadBuffer();
+	const unsigned session = g_session.load(std::memory_order_relaxed);
+	if (buffer->session != session) {
+		rewind(buffer, session);
+	}
+	Chunk* chunk = buffer->tail;
+	std::size_t n = chunk->count.load(std::memory_order_relaxed);
+	if (n == kChunkEvents) {
+		if (buffer->chunks == kMaxChunks) return;
+		Chunk* next = chunk->next.load(std::memory_order_relaxed);
+		if (!next) {
+			next = new Chunk;
+			chunk->next.store(next, std::memory_order_release);
+		}
+		buffer->tail = chunk = next;
+		++buffer->chunks;
+		n = 0;
+	}
+	chunk->events[n] = event;
+	chunk->count.store(n + 1, std::memory_order_release);
+}
+
+QByteArray escaped(const QString& text) {
+	QByteArray out = text.toUtf8();
+	out.replace('\\', "\\\\");
+	out.replace('"', "\\\"");
+	return out;
+}
+
+QByteArray micros(std::int64_t ns) {
+	return QByteArray::number(double(ns) / 1000.0, 'f', 3);
+}
+}
+
+std::int64_t Trace::detail::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_epoch).count();
+}
+
+void Trace::detail::span(const char* name, std::int64_t begin, std::int64_t end) {
+	append({name, begin, end, false});
+}
+
+void Trace::detail::counter(const char* name, std::int64_t value) {
+	append({name, now(), value, true});
+}
+
+void Trace::start() {
+	{
+		std::lock_guard lock(g_registryMutex);
+		std::erase_if(g_registry, [](const std::shared_ptr<ThreadBuffer>& buffer) {
+			return buffer->exited.load(std::memory_order_acquire);
+		});
+	}
+	// Each thread rewinds its own buffer on its next event.
+	g_session.fetch_add(1, std::memory_order_relaxed);
+	g_sessionStart.store(detail::now(), std::memory_order_relaxed);
+	detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::stop() {
+	detail::enabled.store(false, std::memory_order_relaxed);
+}
+
+bool Trace::exportChromeJson(const QString& path, QString* error) {
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		if (error) {
+			*error = file.errorString();
+		}
+		return false;
+	}
+	std::vector<std::shared_ptr<const ThreadBuffer>> buffers;
+	{
+		std::lock_guard lock(g_registryMutex);
+		buffers.assign(g_registry.begin(), g_registry.end());
+	}
+	const std::int64_t from = g_sessionStart.load(std::memory_order_relaxed);
+	QByteArray out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	bool first = true;
+	auto next = [&] {
+		if (!first) out += ",\n";
+		first = false;
+	};
+	for (const std::shared_ptr<const ThreadBuffer>& buffer : buffers) {
+		const QByteArray tid = QByteArray::number(buffer->tid);
+		next();
+		out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid
+			+ ",\"args\":{\"name\":\"" + escaped(buffer->name) + "\"}}";
+		for (const Chunk* chunk = buffer->head; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+			const std::size_t count = chunk->count.load(std::memory_order_acquire);
+			for (std::size_t i = 0; i < count; ++i) {
+				const Event& event = chunk->events[i];
+				if (event.begin < from) continue;
+				next();
+				out += "{\"name\":\"" + escaped(QString::fromLatin1(event.name)) + "\",\"pid\":1,\"tid\":" + tid
+					+ ",\"ts\":" + micros(event.begin - from);
+				if (event.counter) {
+					out += ",\"ph\":\"C\",\"args\":{\"value\":" + QByteArray::number(event.end) + "}}";
+				} else {
+					out += ",\"ph\":\"X\",\"dur\":" + micros(event.end - event.begin) + "}";
+				}
+			}
+			if (out.size() > (1 << 20)) {
+				file.write(out);
+				out.clear();
+			}
+		}
+	}
+	out += "\n]}\n";
+	file.write(out);
+	file.close();
+	if (file.error() != QFile::NoError) {
+		if (error) {
+			*error = file.errorString();
+		}
+		return false;
+	}
+	return true;
+}
+
+void Trace::startFromEnvironment() {
+	const QString path = qEnvironmentVariable("IDE_TRACE");
+	QCoreApplication* app = QCoreApplication::instance();
+	if (path.isEmpty() || !app) return;
+	start();
+	QObject::connect(app, &QCoreApplication::aboutToQuit, app, [path] {
+		stop();
+		exportChromeJson(path);
+	});
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <QString>
+#include <atomic>
+#include <cstdint>
+
+// Scoped spans and counters for hot paths. Each thread records into its own
+// append-only buffer without locks; exportChromeJson() writes what was recorded since
+// start() as Chrome trace JSON for chrome://tracing or ui.perfetto.dev. Every
+// start() begins a new session in the same buffers and frees those of threads
+// that have exited.
+// Recording is off until started, and without IDE_TRACING the macros below
+// compile to nothing.
+namespace Trace {
+	void start();
+	void stop();
+	inline bool isEnabled();
+	bool exportChromeJson(const QString& path, QString* error = nullptr);
+	// Starts recording when IDE_TRACE names an output file, which is written
+	// when the application quits.
+	void startFromEnvironment();
+
+	namespace detail {
+		extern std::atomic<bool> enabled;
+		std::int64_t now();
+		// Names must be string literals; only the pointer is kept.
+		void span(const char* name, std::int64_t begin, std::int64_t end);
+		void counter(const char* name, std::int64_t value);
+	}
+
+	inline bool isEnabled() {
+		return detail::enabled.load(std::memory_order_relaxed);
+	}
+
+	class Span {
+	public:
+		explicit Span(const char* name)
+			: m_name(isEnabled() ? name : nullptr), m_begin(m_name ? detail::now() : 0) {}
+		~Span() {
+			if (m_name) detail::span(m_name, m_begin, detail::now());
+		}
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+
+	private:
+		const char* m_name;
+		std::int64_t m_begin;
+	};
+}
+
+#if defined(IDE_TRACING)
+#define IDE_TRACE_CONCAT_(a, b) a##b
+#define IDE_TRACE_CONCAT(a, b) IDE_TRACE_CONCAT_(a, b)
+#define IDE_TRACE_SPAN(name) const ::Trace::Span IDE_TRACE_CONCAT(ideTraceSpan, __LINE__)(name)
+#define IDE_TRACE_COUNTER(name, value) \
+	do { if (::Trace::isEnabled()) ::Trace::detail::counter(name, std::int64_t(value)); } while (false)
+#else
+#define IDE_TRACE_SPAN(name) do {} while (false)
+#define IDE_TRACE_COUNTER(name, value) do {} while (false)
+#endif